@@ -29,6 +29,11 @@
  */
 #define MULTITHREADED 1
 
+/*
+ * Count memory allocations by subsystem (see gmem.h).
+ */
+#undef GMEM_ACCOUNTING
+
 /*
  * Enable C++ exceptions.
  */
@@ -30,6 +30,11 @@
  */
 /* #undef MULTITHREADED */
 
+/*
+ * Count memory allocations by subsystem (see gmem.h).
+ */
+/* #undef GMEM_ACCOUNTING */
+
 /*
  * Enable C++ exceptions.
  */
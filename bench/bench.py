@@ -0,0 +1,306 @@
+#!/usr/bin/env python3
+#========================================================================
+#
+# bench.py
+#
+# End-to-end throughput benchmark: run pdftojson, pdftotext and
+# pdftoppm over the generated corpus (see mkcorpus.py), and report
+# pages/sec, per-page latency percentiles and peak RSS as JSON.
+#
+#   bench.py [options]                 run the benchmark
+#   bench.py -compare <old> <new>      compare two result files (also
+#                                      reads pdfmicrobench -json output)
+#
+# Per-page latency comes from pdftojson -profile for pdftojson.  The
+# other tools have no per-page timing, so they are run once per page
+# (-f N -l N), and their latencies include process startup and
+# opening the document.
+#
+#========================================================================
+
+import argparse
+import json
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mkcorpus
+
+RESULT_FORMAT = 1
+
+#------------------------------------------------------------------------
+
+# Path to the runstat helper (see runstat.c), set by buildRunstat.
+runstat = None
+
+def buildRunstat(dir):
+    global runstat
+    src = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                       "runstat.c")
+    runstat = os.path.join(dir, "runstat")
+    if not os.path.exists(runstat) or \
+       os.path.getmtime(runstat) < os.path.getmtime(src):
+        subprocess.check_call([os.environ.get("CC", "cc"), "-O2", "-o",
+                               runstat, src])
+
+def run(cmd):
+    """Run cmd, returning (exit code, wall seconds, peak RSS in KB)."""
+    out = subprocess.check_output([runstat] + cmd, universal_newlines=True)
+    code, wall, rss = out.split()
+    return int(code), float(wall), int(rss)
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    v = sorted(values)
+    return v[max(0, math.ceil(p / 100.0 * len(v)) - 1)]
+
+def median(values):
+    v = sorted(values)
+    n = len(v)
+    return v[n // 2] if n % 2 else 0.5 * (v[n // 2 - 1] + v[n // 2])
+
+def countPages(binDir, pdf):
+    out = subprocess.run([os.path.join(binDir, "pdfinfo"), pdf],
+                         stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                         universal_newlines=True).stdout
+    for line in out.splitlines():
+        if line.startswith("Pages:"):
+            return int(line.split()[1])
+    raise RuntimeError("couldn't get the page count of " + pdf)
+
+#------------------------------------------------------------------------
+# tools
+#------------------------------------------------------------------------
+
+# Each tool returns the command for a whole-document run (outDir is a
+# scratch directory), and optionally per-page latencies from that run.
+
+# pdftojson writes the page PNGs too (-createpng), at the same
+# resolution as pdftoppm, so that image decoding is measured.
+class PDFToJSON:
+    name = "pdftojson"
+    latency = "in-process"
+
+    def __init__(self, resolution):
+        self.resolution = resolution
+
+    def command(self, exe, pdf, outDir, page=None):
+        return [exe, "-q", "-createpng", "-r", str(self.resolution),
+                "-profile", os.path.join(outDir, "profile.json"),
+                pdf, os.path.join(outDir, "out.json")]
+
+    def pageLatencies(self, outDir):
+        with open(os.path.join(outDir, "profile.json")) as f:
+            prof = json.load(f)
+        return [pg["wall"] for pg in prof["page"]]
+
+class PDFToText:
+    name = "pdftotext"
+    latency = "per-process"
+
+    def command(self, exe, pdf, outDir, page=None):
+        cmd = [exe, "-q"]
+        if page:
+            cmd += ["-f", str(page), "-l", str(page)]
+        return cmd + [pdf, os.path.join(outDir, "out.txt")]
+
+    def pageLatencies(self, outDir):
+        return None
+
+class PDFToPPM:
+    name = "pdftoppm"
+    latency = "per-process"
+
+    def __init__(self, resolution):
+        self.resolution = resolution
+
+    def command(self, exe, pdf, outDir, page=None):
+        cmd = [exe, "-q", "-r", str(self.resolution)]
+        if page:
+            cmd += ["-f", str(page), "-l", str(page)]
+        return cmd + [pdf, os.path.join(outDir, "out")]
+
+    def pageLatencies(self, outDir):
+        return None
+
+#------------------------------------------------------------------------
+
+def benchTool(tool, binDir, corpus, repeat):
+    exe = os.path.join(binDir, tool.name)
+    docs = {}
+    allLatencies = []
+    totalPages = 0
+    totalSeconds = 0.0
+    peakRSS = 0
+    for name, pdf, nPages in corpus:
+        walls = []
+        latencies = []
+        rss = 0
+        for _ in range(repeat):
+            outDir = tempfile.mkdtemp(prefix="pdfbench")
+            try:
+                code, wall, r = run(tool.command(exe, pdf, outDir))
+                if code != 0:
+                    raise RuntimeError("%s failed on %s (exit code %d)"
+                                       % (tool.name, name, code))
+                walls.append(wall)
+                rss = max(rss, r)
+                lat = tool.pageLatencies(outDir)
+                if lat is None:
+                    lat = []
+                    for pg in range(1, nPages + 1):
+                        for f in os.listdir(outDir):
+                            os.unlink(os.path.join(outDir, f))
+                        code, wall, r = run(tool.command(exe, pdf, outDir, pg))
+                        lat.append(wall)
+                latencies += lat
+            finally:
+                shutil.rmtree(outDir)
+        seconds = median(walls)
+        docs[name] = {
+            "pages": nPages,
+            "seconds": round(seconds, 6),
+            "pagesPerSec": round(nPages / seconds, 3),
+            "latencyP50Ms": round(percentile(latencies, 50) * 1000, 3),
+            "latencyP99Ms": round(percentile(latencies, 99) * 1000, 3),
+            "peakRSSKB": rss,
+        }
+        allLatencies += latencies
+        totalPages += nPages
+        totalSeconds += seconds
+        peakRSS = max(peakRSS, rss)
+        sys.stderr.write("  %-10s %-14s %8.1f pages/s  p50 %7.2f ms"
+                         "  p99 %7.2f ms  %7d KB\n"
+                         % (tool.name, name, docs[name]["pagesPerSec"],
+                            docs[name]["latencyP50Ms"],
+                            docs[name]["latencyP99Ms"], rss))
+    return {
+        "latency": tool.latency,
+        "pages": totalPages,
+        "seconds": round(totalSeconds, 6),
+        "pagesPerSec": round(totalPages / totalSeconds, 3),
+        "latencyP50Ms": round(percentile(allLatencies, 50) * 1000, 3),
+        "latencyP99Ms": round(percentile(allLatencies, 99) * 1000, 3),
+        "peakRSSKB": peakRSS,
+        "docs": docs,
+    }
+
+def prepareCorpus(dir):
+    versionFile = os.path.join(dir, "VERSION")
+    try:
+        with open(versionFile) as f:
+            version = int(f.read())
+    except (IOError, ValueError):
+        version = None
+    if version != mkcorpus.CORPUS_VERSION:
+        sys.stderr.write("generating the corpus in %s\n" % dir)
+        mkcorpus.makeCorpus(dir)
+    return sorted(os.path.join(dir, f) for f in os.listdir(dir)
+                  if f.endswith(".pdf"))
+
+#------------------------------------------------------------------------
+
+def compareKernels(old, new):
+    """Compare two pdfmicrobench -json result files."""
+    print("%-18s %13s %13s %8s   %15s" % ("", "old median us", "new median us",
+                                         "change", "stddev % (o/n)"))
+    for name in sorted(set(old["kernels"]) & set(new["kernels"])):
+        o = old["kernels"][name]
+        n = new["kernels"][name]
+        print("%-18s %13.1f %13.1f %+7.1f%%   %7.2f %7.2f"
+              % (name, o["medianUs"], n["medianUs"],
+                 100.0 * (n["medianUs"] / o["medianUs"] - 1),
+                 100.0 * o["stddevUs"] / o["meanUs"],
+                 100.0 * n["stddevUs"] / n["meanUs"]))
+
+def compare(oldFile, newFile):
+    with open(oldFile) as f:
+        old = json.load(f)
+    with open(newFile) as f:
+        new = json.load(f)
+
+    if "kernels" in old and "kernels" in new:
+        compareKernels(old, new)
+        return
+
+    def row(label, o, n):
+        print("%-26s %9.1f %9.1f %+7.1f%%   %8.2f %8.2f   %8.2f %8.2f"
+              "   %7d %7d"
+              % (label, o["pagesPerSec"], n["pagesPerSec"],
+                 100.0 * (n["pagesPerSec"] / o["pagesPerSec"] - 1),
+                 o["latencyP50Ms"], n["latencyP50Ms"],
+                 o["latencyP99Ms"], n["latencyP99Ms"],
+                 o["peakRSSKB"], n["peakRSSKB"]))
+
+    print("%-26s %9s %9s %8s   %17s   %17s   %15s"
+          % ("", "old pg/s", "new pg/s", "change", "p50 ms (old/new)",
+             "p99 ms (old/new)", "RSS KB"))
+    for tool in sorted(set(old["tools"]) & set(new["tools"])):
+        o = old["tools"][tool]
+        n = new["tools"][tool]
+        row(tool, o, n)
+        for doc in sorted(set(o["docs"]) & set(n["docs"])):
+            row("  " + doc, o["docs"][doc], n["docs"][doc])
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description="pdftojson throughput benchmark")
+    ap.add_argument("-bin", default=os.path.join(here, "..", "xpdf"),
+                    help="directory containing the built tools")
+    ap.add_argument("-corpus", default="bench-corpus",
+                    help="corpus directory (generated if missing)")
+    ap.add_argument("-o", dest="out", default="-",
+                    help="write the results to this file (default stdout)")
+    ap.add_argument("-repeat", type=int, default=3,
+                    help="runs per document; the median time is used")
+    ap.add_argument("-tools", default="pdftojson,pdftotext,pdftoppm",
+                    help="comma-separated list of tools to run")
+    ap.add_argument("-r", dest="resolution", type=int, default=150,
+                    help="pdftoppm and pdftojson -createpng resolution")
+    ap.add_argument("-compare", nargs=2, metavar=("OLD", "NEW"),
+                    help="compare two result files and exit")
+    args = ap.parse_args()
+
+    if args.compare:
+        compare(*args.compare)
+        return 0
+
+    tools = {"pdftojson": PDFToJSON(args.resolution),
+             "pdftotext": PDFToText(),
+             "pdftoppm": PDFToPPM(args.resolution)}
+    corpus = [(os.path.basename(pdf)[:-4], pdf, countPages(args.bin, pdf))
+              for pdf in prepareCorpus(args.corpus)]
+    buildRunstat(args.corpus)
+    result = {
+        "format": RESULT_FORMAT,
+        "corpusVersion": mkcorpus.CORPUS_VERSION,
+        "bin": os.path.abspath(args.bin),
+        "repeat": args.repeat,
+        "tools": {},
+    }
+    for name in args.tools.split(","):
+        if name not in tools:
+            sys.stderr.write("unknown tool '%s'\n" % name)
+            return 1
+        if not os.path.exists(os.path.join(args.bin, name)):
+            sys.stderr.write("skipping %s: not built in %s\n"
+                             % (name, args.bin))
+            continue
+        result["tools"][name] = benchTool(tools[name], args.bin, corpus,
+                                          args.repeat)
+
+    text = json.dumps(result, indent=1, sort_keys=True) + "\n"
+    if args.out == "-":
+        sys.stdout.write(text)
+    else:
+        with open(args.out, "w") as f:
+            f.write(text)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
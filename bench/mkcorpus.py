@@ -0,0 +1,815 @@
+#!/usr/bin/env python3
+#========================================================================
+#
+# mkcorpus.py
+#
+# Generate the benchmark corpus used by bench.py.  The files are
+# built from a fixed random seed, so every run (and every machine)
+# produces byte-identical PDFs.  Only the Python standard library is
+# used.
+#
+#   mkcorpus.py <output-dir>
+#
+#========================================================================
+
+import os
+import random
+import struct
+import sys
+import zlib
+
+# Bump this when the generated files change, so stale corpora are
+# regenerated by bench.py.
+CORPUS_VERSION = 1
+
+#------------------------------------------------------------------------
+# PDF writer
+#------------------------------------------------------------------------
+
+class PDFWriter:
+
+    def __init__(self):
+        self.objs = [None]          # object number -> bytes
+        self.isStream = [False]
+
+    def reserve(self):
+        self.objs.append(None)
+        self.isStream.append(False)
+        return len(self.objs) - 1
+
+    def set(self, num, data, isStream=False):
+        self.objs[num] = data
+        self.isStream[num] = isStream
+
+    def add(self, data):
+        num = self.reserve()
+        self.set(num, data)
+        return num
+
+    def addStream(self, dict, data, compress=True):
+        num = self.reserve()
+        self.set(num, streamObj(dict, data, compress), True)
+        return num
+
+    # Write a classic cross-reference table, or, with objStm, put all
+    # the non-stream objects in object streams and write a
+    # cross-reference stream (PDF 1.5).
+    def write(self, path, rootNum, objStm=False):
+        out = bytearray(b"%PDF-1.5\n%\xe2\xe3\xcf\xd3\n")
+        n = len(self.objs)
+        offsets = [0] * n
+        inStm = {}                  # object number -> (stream, index)
+        if objStm:
+            loose = [i for i in range(1, n) if not self.isStream[i]]
+            for k in range(0, len(loose), 100):
+                group = loose[k:k + 100]
+                stmNum = len(self.objs)
+                hdr = bytearray()
+                body = bytearray()
+                for i, num in enumerate(group):
+                    hdr += b"%d %d " % (num, len(body))
+                    body += self.objs[num] + b"\n"
+                    inStm[num] = (stmNum, i)
+                self.objs.append(streamObj(
+                    b"/Type /ObjStm /N %d /First %d" % (len(group), len(hdr)),
+                    bytes(hdr + body)))
+                self.isStream.append(True)
+            offsets += [0] * (len(self.objs) - n)
+            n = len(self.objs)
+        for num in range(1, n):
+            if num in inStm:
+                continue
+            offsets[num] = len(out)
+            out += b"%d 0 obj\n" % num + self.objs[num] + b"\nendobj\n"
+        xrefPos = len(out)
+        if objStm:
+            rows = bytearray(struct.pack(">BIH", 0, 0, 65535))
+            for num in range(1, n + 1):
+                if num == n:
+                    rows += struct.pack(">BIH", 1, xrefPos, 0)
+                elif num in inStm:
+                    rows += struct.pack(">BIH", 2, inStm[num][0], inStm[num][1])
+                else:
+                    rows += struct.pack(">BIH", 1, offsets[num], 0)
+            out += b"%d 0 obj\n" % n
+            out += streamObj(b"/Type /XRef /Size %d /W [1 4 2] /Root %d 0 R"
+                             % (n + 1, rootNum), bytes(rows))
+            out += b"\nendobj\n"
+        else:
+            out += b"xref\n0 %d\n0000000000 65535 f \n" % n
+            for num in range(1, n):
+                out += b"%010d 00000 n \n" % offsets[num]
+            out += b"trailer\n<< /Size %d /Root %d 0 R >>\n" % (n, rootNum)
+        out += b"startxref\n%d\n%%%%EOF\n" % xrefPos
+        with open(path, "wb") as f:
+            f.write(out)
+
+def streamObj(dict, data, compress=True):
+    if compress:
+        data = zlib.compress(data, 6)
+        dict += b" /Filter /FlateDecode"
+    return b"<< " + dict + b" /Length %d >>\nstream\n" % len(data) + \
+           data + b"\nendstream"
+
+def pdfString(s):
+    return b"(" + s.replace("\\", "\\\\").replace("(", "\\(") \
+                   .replace(")", "\\)").encode("latin-1") + b")"
+
+# Build a document: pages is a list of (content, resources, annots)
+# tuples, where annots is a list of annotation object numbers.
+# extraCatalog is added to the catalog dictionary.
+def buildDoc(w, pages, extraCatalog=b""):
+    catalogNum = w.reserve()
+    pagesNum = w.reserve()
+    kids = []
+    for content, resources, annots in pages:
+        pageNum = w.reserve()
+        contentNum = w.addStream(b"", content)
+        a = b""
+        if annots:
+            a = b" /Annots [" + b" ".join(b"%d 0 R" % x for x in annots) + b"]"
+        w.set(pageNum, b"<< /Type /Page /Parent %d 0 R /MediaBox [0 0 612 792]"
+                       b" /Resources %s /Contents %d 0 R%s >>"
+                       % (pagesNum, resources, contentNum, a))
+        kids.append(pageNum)
+    w.set(pagesNum, b"<< /Type /Pages /Kids [" +
+                    b" ".join(b"%d 0 R" % k for k in kids) +
+                    b"] /Count %d >>" % len(kids))
+    w.set(catalogNum, b"<< /Type /Catalog /Pages %d 0 R%s >>"
+                      % (pagesNum, extraCatalog))
+    return catalogNum
+
+#------------------------------------------------------------------------
+# text
+#------------------------------------------------------------------------
+
+SYLLABLES = ["ta", "ne", "ri", "mo", "ku", "sa", "le", "vi", "do", "pe",
+             "ra", "co", "mi", "tu", "na", "lo", "se", "di", "ga", "be",
+             "tion", "ment", "ing", "er", "al", "ous", "st", "pr", "an"]
+
+def makeWord(rnd):
+    n = 1 + min(rnd.randint(0, 3), rnd.randint(0, 3))
+    return "".join(rnd.choice(SYLLABLES) for _ in range(n))
+
+def makeLine(rnd, width, fontSize):
+    # approximate widths -- 0.5 em per character is close enough
+    words = []
+    used = 0
+    while True:
+        word = makeWord(rnd)
+        if rnd.random() < 0.05:
+            word = word.capitalize() + ","
+        wd = (len(word) + 1) * 0.5 * fontSize
+        if used + wd > width:
+            break
+        words.append(word)
+        used += wd
+    return " ".join(words)
+
+#------------------------------------------------------------------------
+# embedded Type 1 font
+#------------------------------------------------------------------------
+
+# The standard 14 fonts are not available everywhere, so the text
+# documents use an embedded Type 1 font with blocky glyphs (runs of
+# cells on a 5x7 grid), which exercises the font loader and the
+# rasterizer in the same way as a real font.
+
+FONT_CHARS = " ,.0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+GLYPH_NAMES = {" ": "space", ",": "comma", ".": "period",
+               "0": "zero", "1": "one", "2": "two", "3": "three",
+               "4": "four", "5": "five", "6": "six", "7": "seven",
+               "8": "eight", "9": "nine"}
+
+def csNum(v):
+    if -107 <= v <= 107:
+        return bytes([v + 139])
+    if 108 <= v <= 1131:
+        v -= 108
+        return bytes([247 + (v >> 8), v & 0xff])
+    if -1131 <= v <= -108:
+        v = -v - 108
+        return bytes([251 + (v >> 8), v & 0xff])
+    return b"\xff" + struct.pack(">i", v)
+
+def t1Encrypt(data, r):
+    out = bytearray()
+    for p in data:
+        c = p ^ (r >> 8)
+        r = ((c + r) * 52845 + 22719) & 0xffff
+        out.append(c)
+    return bytes(out)
+
+def glyphCharString(rnd, ch, width):
+    cs = csNum(0) + csNum(width) + b"\x0d"               # hsbw
+    if ch != " ":
+        if ch in ",.":
+            cells = [(2, 0)] if ch == "." else [(2, 0), (1, -1)]
+        else:
+            top = 7 if ch.isupper() or ch.isdigit() else 5
+            cells = [(x, y) for y in range(top) for x in range(5)
+                     if rnd.random() < 0.45]
+            if not cells:
+                cells = [(2, 0)]
+        cx = cy = 0
+        y = None
+        for y in sorted(set(c[1] for c in cells)):
+            xs = sorted(c[0] for c in cells if c[1] == y)
+            # merge runs of cells into rectangles
+            x = xs[0]
+            end = x + 1
+            for nx in xs[1:] + [None]:
+                if nx == end:
+                    end += 1
+                    continue
+                rx, ry, rw = x * 100 + 50, y * 100, (end - x) * 100
+                cs += csNum(rx - cx) + csNum(ry - cy) + b"\x15"   # rmoveto
+                cs += csNum(rw) + b"\x06"                       # hlineto
+                cs += csNum(100) + b"\x07"                      # vlineto
+                cs += csNum(-rw) + b"\x06" + b"\x09"            # closepath
+                cx, cy = rx, ry + 100
+                if nx is not None:
+                    x = nx
+                    end = x + 1
+    return cs + b"\x0e"                                    # endchar
+
+def type1Font(w):
+    rnd = random.Random("BenchSans")
+    charStrings = b""
+    widths = {}
+    for ch in FONT_CHARS:
+        width = 300 if ch in " ,." else 600
+        widths[ch] = width
+        cs = t1Encrypt(b"\0\0\0\0" + glyphCharString(rnd, ch, width), 4330)
+        name = GLYPH_NAMES.get(ch, ch).encode("ascii")
+        charStrings += b"/%s %d RD " % (name, len(cs)) + cs + b" ND\n"
+    clear = (b"%!PS-AdobeFont-1.0: BenchSans 001.000\n"
+             b"12 dict begin\n"
+             b"/FontName /BenchSans def\n"
+             b"/Encoding StandardEncoding def\n"
+             b"/PaintType 0 def\n"
+             b"/FontType 1 def\n"
+             b"/FontMatrix [0.001 0 0 0.001 0 0] readonly def\n"
+             b"/FontBBox {0 -100 600 700} readonly def\n"
+             b"currentdict end\n"
+             b"currentfile eexec\n")
+    private = (b"dup /Private 8 dict dup begin\n"
+               b"/RD {string currentfile exch readstring pop} executeonly def\n"
+               b"/ND {noaccess def} executeonly def\n"
+               b"/NP {noaccess put} executeonly def\n"
+               b"/MinFeature {16 16} def\n"
+               b"/password 5839 def\n"
+               b"/BlueValues [] def\n"
+               b"2 index /CharStrings %d dict dup begin\n" % len(FONT_CHARS) +
+               charStrings +
+               b"end\nend\nreadonly put\nnoaccess put\n"
+               b"dup /FontName get exch definefont pop\n"
+               b"mark currentfile closefile\n")
+    enc = t1Encrypt(b"\0\0\0\0" + private, 55665)
+    fileNum = w.addStream(b"/Length1 %d /Length2 %d /Length3 0"
+                          % (len(clear), len(enc)), clear + enc)
+    descNum = w.add(b"<< /Type /FontDescriptor /FontName /BenchSans"
+                    b" /Flags 32 /FontBBox [0 -100 600 700] /ItalicAngle 0"
+                    b" /Ascent 700 /Descent -100 /CapHeight 700 /StemV 80"
+                    b" /FontFile %d 0 R >>" % fileNum)
+    return w.add(b"<< /Type /Font /Subtype /Type1 /BaseFont /BenchSans"
+                 b" /FirstChar 32 /LastChar 122 /Widths [%s]"
+                 b" /Encoding /WinAnsiEncoding /FontDescriptor %d 0 R >>"
+                 % (b" ".join(b"%d" % widths.get(chr(c), 0)
+                              for c in range(32, 123)), descNum))
+
+def textResources(fontNum):
+    return b"<< /Font << /F1 %d 0 R >> >>" % fontNum
+
+# Lay out a column of paragraphs at (x, top), returning the content.
+def textColumn(rnd, x, top, bottom, width, fontSize, font=b"F1",
+               lower=False):
+    lead = fontSize * 1.2
+    out = [b"BT /%s %g Tf %g TL %g %g Td" % (font, fontSize, lead, x, top)]
+    y = top
+    while y > bottom:
+        if rnd.random() < 0.08:
+            out.append(b"T*")
+            y -= lead
+            continue
+        line = makeLine(rnd, width, fontSize)
+        if lower:
+            line = line.lower().replace(",", "")
+        out.append(pdfString(line) + b" '")
+        y -= lead
+    out.append(b"ET")
+    return b"\n".join(out) + b"\n"
+
+def denseTextPage(rnd, fontNum):
+    content = b"BT /F1 14 Tf 72 740 Td " + \
+              pdfString(makeLine(rnd, 400, 14).title()) + b" Tj ET\n"
+    content += textColumn(rnd, 72, 715, 60, 468, 9)
+    return content, textResources(fontNum), []
+
+def multiColumnPage(rnd, fontNum):
+    content = b"BT /F1 16 Tf 72 740 Td " + \
+              pdfString(makeLine(rnd, 400, 16).title()) + b" Tj ET\n"
+    for i in range(3):
+        content += textColumn(rnd, 54 + i * 172, 710, 60, 156, 8.5)
+    return content, textResources(fontNum), []
+
+def tablePage(rnd, fontNum):
+    rows, cols = 30, 6
+    x0, y0, cw, rh = 54, 740, 84, 22
+    out = [b"0.5 w"]
+    for r in range(rows + 1):
+        out.append(b"%g %g m %g %g l S" % (x0, y0 - r * rh,
+                                          x0 + cols * cw, y0 - r * rh))
+    for c in range(cols + 1):
+        out.append(b"%g %g m %g %g l S" % (x0 + c * cw, y0,
+                                          x0 + c * cw, y0 - rows * rh))
+    out.append(b"BT")
+    for r in range(rows):
+        for c in range(cols):
+            if r == 0:
+                cell = makeWord(rnd).capitalize()
+                font = b"F1"
+            elif c == 0:
+                cell = makeWord(rnd)
+                font = b"F1"
+            else:
+                cell = "%.2f" % (rnd.random() * 10 ** rnd.randint(1, 5))
+                font = b"F1"
+            out.append(b"/%s 8 Tf 1 0 0 1 %g %g Tm %s Tj"
+                       % (font, x0 + c * cw + 4, y0 - r * rh - 14,
+                          pdfString(cell)))
+    out.append(b"ET")
+    return b"\n".join(out) + b"\n", textResources(fontNum), []
+
+#------------------------------------------------------------------------
+# forms
+#------------------------------------------------------------------------
+
+def formPages(w, rnd, nPages, helvNum):
+    dr = b"<< /Font << /Helv %d 0 R >> >>" % helvNum
+    offNum = w.addStream(b"/Type /XObject /Subtype /Form /BBox [0 0 12 12]",
+                         b"0 G 0.5 w 0.5 0.5 11 11 re S\n")
+    yesNum = w.addStream(b"/Type /XObject /Subtype /Form /BBox [0 0 12 12]",
+                         b"0 G 0.5 w 0.5 0.5 11 11 re S\n"
+                         b"1.5 w 3 6 m 5 3 l 9 10 l S\n")
+    fields = []
+    pages = []
+    for pg in range(nPages):
+        annots = []
+        content = b"BT /Helv 14 Tf 72 740 Td (Application form, page %d) Tj" \
+                  b" ET\n" % (pg + 1)
+        y = 700
+        for i in range(20):
+            label = makeWord(rnd).capitalize()
+            content += b"BT /Helv 9 Tf 72 %g Td %s Tj ET\n" % (y + 4,
+                                                              pdfString(label))
+            # text field, with an appearance stream
+            value = makeLine(rnd, 200, 9)
+            apNum = w.addStream(
+                b"/Type /XObject /Subtype /Form /BBox [0 0 220 16]"
+                b" /Resources " + dr,
+                b"0 G 0.5 w 0.5 0.5 219 15 re S\n/Tx BMC BT /Helv 9 Tf"
+                b" 2 4 Td %s Tj ET EMC\n" % pdfString(value))
+            fieldNum = w.add(
+                b"<< /Type /Annot /Subtype /Widget /FT /Tx /T %s /V %s"
+                b" /DA (/Helv 9 Tf 0 g) /Rect [180 %g 400 %g] /F 4"
+                b" /AP << /N %d 0 R >> >>"
+                % (pdfString("p%d.text%d" % (pg + 1, i)), pdfString(value),
+                   y, y + 16, apNum))
+            annots.append(fieldNum)
+            fields.append(fieldNum)
+            # check box
+            on = rnd.random() < 0.5
+            boxNum = w.add(
+                b"<< /Type /Annot /Subtype /Widget /FT /Btn /T %s /V /%s"
+                b" /AS /%s /Rect [420 %g 432 %g] /F 4"
+                b" /AP << /N << /Yes %d 0 R /Off %d 0 R >> >> >>"
+                % (pdfString("p%d.check%d" % (pg + 1, i)),
+                   b"Yes" if on else b"Off", b"Yes" if on else b"Off",
+                   y + 2, y + 14, yesNum, offNum))
+            annots.append(boxNum)
+            fields.append(boxNum)
+            y -= 32
+        pages.append((content, b"<< /Font << /Helv %d 0 R >> >>" % helvNum,
+                      annots))
+    acroForm = b" /AcroForm << /Fields [" + \
+               b" ".join(b"%d 0 R" % f for f in fields) + \
+               b"] /DA (/Helv 0 Tf 0 g) /DR " + dr + b" >>"
+    return pages, acroForm
+
+#------------------------------------------------------------------------
+# Type 3 fonts
+#------------------------------------------------------------------------
+
+# A Type 3 font with a blocky glyph for each lowercase letter, drawn
+# with paths on a 5x7 grid.
+def type3Font(w):
+    rnd = random.Random(3)
+    procs = []
+    widths = []
+    for c in range(ord("a"), ord("z") + 1):
+        ops = [b"600 0 0 0 500 700 d1"]
+        for gy in range(7):
+            for gx in range(5):
+                if rnd.random() < 0.45:
+                    ops.append(b"%d %d 100 100 re" % (gx * 100, gy * 100))
+        ops.append(b"f")
+        procs.append((c, w.addStream(b"", b"\n".join(ops) + b"\n")))
+        widths.append(b"600")
+    spaceNum = w.addStream(b"", b"300 0 0 0 0 0 d1\n")
+    charProcs = b"<< /space %d 0 R " % spaceNum + \
+                b" ".join(b"/%s %d 0 R" % (bytes([c]), num)
+                          for c, num in procs) + b" >>"
+    diffs = b"[32 /space 97 " + \
+            b" ".join(b"/" + bytes([c]) for c, _ in procs) + b"]"
+    return w.add(b"<< /Type /Font /Subtype /Type3 /FontBBox [0 0 500 700]"
+                 b" /FontMatrix [0.001 0 0 0.001 0 0] /CharProcs %s"
+                 b" /Encoding << /Type /Encoding /Differences %s >>"
+                 b" /FirstChar 32 /LastChar 122 /Widths [300 %s %s] >>"
+                 % (charProcs, diffs, b"0 " * 64, b" ".join(widths)))
+
+def type3Page(rnd, fontNum):
+    content = textColumn(rnd, 72, 740, 60, 468, 10, b"T3", lower=True)
+    return content, b"<< /Font << /T3 %d 0 R >> >>" % fontNum, []
+
+#------------------------------------------------------------------------
+# scanned pages
+#------------------------------------------------------------------------
+
+# Render a "scanned" text page into a bitmap (list of bytearrays of
+# 0/1 values, 1 = black), using random blocky glyphs.
+def scanBitmap(rnd, w, h):
+    glyphs = []
+    for i in range(26):
+        g = [[1 if rnd.random() < 0.4 else 0 for _ in range(5)]
+             for _ in range(7)]
+        glyphs.append(g)
+    rows = [bytearray(w) for _ in range(h)]
+    scale = max(1, w // 600)
+    gw, gh = 6 * scale, 7 * scale
+    y = h // 15
+    while y + gh < h - h // 15:
+        if rnd.random() < 0.1:
+            y += 2 * gh
+            continue
+        x = w // 10
+        while x + gw < w - w // 10:
+            if rnd.random() < 0.18:
+                x += gw
+                continue
+            g = glyphs[rnd.randrange(26)]
+            for gy in range(7):
+                for gx in range(5):
+                    if g[gy][gx]:
+                        for sy in range(scale):
+                            r = rows[y + gy * scale + sy]
+                            for sx in range(scale):
+                                r[x + gx * scale + sx] = 1
+            x += gw
+        y += 2 * gh
+    # speckle
+    for _ in range(w * h // 2000):
+        rows[rnd.randrange(h)][rnd.randrange(w)] = 1
+    return rows
+
+#----- JPEG (baseline, grayscale)
+
+ZIGZAG = [0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+          12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+          35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+          58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63]
+
+LUM_QUANT = [16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+             14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+             18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113,
+             92, 49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100,
+             103, 99]
+
+DC_BITS = [0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0]
+DC_VALS = list(range(12))
+AC_BITS = [0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d]
+AC_VALS = [
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+    0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa]
+
+def huffCodes(bits, vals):
+    codes = {}
+    code = 0
+    k = 0
+    for length in range(1, 17):
+        for _ in range(bits[length - 1]):
+            codes[vals[k]] = (code, length)
+            code += 1
+            k += 1
+        code <<= 1
+    return codes
+
+class BitWriter:
+
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def put(self, code, length):
+        self.acc = (self.acc << length) | code
+        self.n += length
+        while self.n >= 8:
+            self.n -= 8
+            b = (self.acc >> self.n) & 0xff
+            self.out.append(b)
+            if b == 0xff:
+                self.out.append(0)
+        self.acc &= (1 << self.n) - 1
+
+    def flush(self):
+        if self.n:
+            self.put((1 << (8 - self.n)) - 1, 8 - self.n)
+        return bytes(self.out)
+
+def magnitude(v):
+    a = abs(v)
+    n = a.bit_length()
+    return n, (v if v >= 0 else v + (1 << n) - 1)
+
+def encodeJPEG(pixels, w, h, quality=75):
+    import math
+    scale = 5000 // quality if quality < 50 else 200 - 2 * quality
+    quant = [max(1, min(255, (q * scale + 50) // 100)) for q in LUM_QUANT]
+    cosTab = [[(math.sqrt(0.5) if u == 0 else 1.0) * 0.5 *
+               math.cos((2 * x + 1) * u * math.pi / 16) for x in range(8)]
+              for u in range(8)]
+    dcCodes = huffCodes(DC_BITS, DC_VALS)
+    acCodes = huffCodes(AC_BITS, AC_VALS)
+    bw = BitWriter()
+    pred = 0
+    bx = (w + 7) // 8
+    by = (h + 7) // 8
+    for yb in range(by):
+        for xb in range(bx):
+            blk = []
+            for y in range(8):
+                row = pixels[min(yb * 8 + y, h - 1)]
+                for x in range(8):
+                    blk.append(row[min(xb * 8 + x, w - 1)] - 128)
+            if min(blk) == max(blk):
+                # flat block -- DC only
+                coef = [0] * 64
+                coef[0] = int(round(blk[0] * 8 / quant[0]))
+            else:
+                tmp = [sum(cosTab[u][x] * blk[y * 8 + x] for x in range(8))
+                       for y in range(8) for u in range(8)]
+                coef = [0] * 64
+                for v in range(8):
+                    cv = cosTab[v]
+                    for u in range(8):
+                        s = 0.0
+                        for y in range(8):
+                            s += cv[y] * tmp[y * 8 + u]
+                        coef[v * 8 + u] = int(round(s / quant[v * 8 + u]))
+            zz = [coef[ZIGZAG[i]] for i in range(64)]
+            n, bits = magnitude(zz[0] - pred)
+            pred = zz[0]
+            bw.put(*dcCodes[n])
+            if n:
+                bw.put(bits, n)
+            run = 0
+            for i in range(1, 64):
+                if zz[i] == 0:
+                    run += 1
+                    continue
+                while run > 15:
+                    bw.put(*acCodes[0xf0])
+                    run -= 16
+                n, bits = magnitude(zz[i])
+                bw.put(*acCodes[(run << 4) | n])
+                bw.put(bits, n)
+                run = 0
+            if run:
+                bw.put(*acCodes[0x00])
+    data = bw.flush()
+
+    def segment(marker, body):
+        return struct.pack(">BBH", 0xff, marker, len(body) + 2) + body
+
+    def dht(cls, ident, bits, vals):
+        return bytes([(cls << 4) | ident]) + bytes(bits) + bytes(vals)
+
+    out = b"\xff\xd8"
+    out += segment(0xdb, b"\x00" + bytes(quant[ZIGZAG[i]] for i in range(64)))
+    out += segment(0xc0, struct.pack(">BHHB", 8, h, w, 1) + b"\x01\x11\x00")
+    out += segment(0xc4, dht(0, 0, DC_BITS, DC_VALS))
+    out += segment(0xc4, dht(1, 0, AC_BITS, AC_VALS))
+    out += segment(0xda, b"\x01\x01\x00\x00\x3f\x00")
+    return out + data + b"\xff\xd9"
+
+def jpegScanPage(w, rnd, width, height):
+    bits = scanBitmap(rnd, width, height)
+    # gray paper with a slight vertical shading, dark gray ink
+    pixels = []
+    for y in range(height):
+        paper = 235 - (y * 12) // height
+        pixels.append([60 if b else paper for b in bits[y]])
+    imgNum = w.addStream(b"/Type /XObject /Subtype /Image /Width %d"
+                         b" /Height %d /ColorSpace /DeviceGray"
+                         b" /BitsPerComponent 8 /Filter /DCTDecode"
+                         % (width, height),
+                         encodeJPEG(pixels, width, height), False)
+    return (b"q 612 0 0 792 0 0 cm /Im1 Do Q\n",
+            b"<< /XObject << /Im1 %d 0 R >> >>" % imgNum, [])
+
+#----- JBIG2 (generic region, template 0, arithmetic coding, TPGDON)
+
+QE = [(0x5601, 1, 1, 1), (0x3401, 2, 6, 0), (0x1801, 3, 9, 0),
+      (0x0AC1, 4, 12, 0), (0x0521, 5, 29, 0), (0x0221, 38, 33, 0),
+      (0x5601, 7, 6, 1), (0x5401, 8, 14, 0), (0x4801, 9, 14, 0),
+      (0x3801, 10, 14, 0), (0x3001, 11, 17, 0), (0x2401, 12, 18, 0),
+      (0x1C01, 13, 20, 0), (0x1601, 29, 21, 0), (0x5601, 15, 14, 1),
+      (0x5401, 16, 14, 0), (0x5101, 17, 15, 0), (0x4801, 18, 16, 0),
+      (0x3801, 19, 17, 0), (0x3401, 20, 18, 0), (0x3001, 21, 19, 0),
+      (0x2801, 22, 19, 0), (0x2401, 23, 20, 0), (0x2201, 24, 21, 0),
+      (0x1C01, 25, 22, 0), (0x1801, 26, 23, 0), (0x1601, 27, 24, 0),
+      (0x1401, 28, 25, 0), (0x1201, 29, 26, 0), (0x1101, 30, 27, 0),
+      (0x0AC1, 31, 28, 0), (0x09C1, 32, 29, 0), (0x08A1, 33, 30, 0),
+      (0x0521, 34, 31, 0), (0x0441, 35, 32, 0), (0x02A1, 36, 33, 0),
+      (0x0221, 37, 34, 0), (0x0141, 38, 35, 0), (0x0111, 39, 36, 0),
+      (0x0085, 40, 37, 0), (0x0049, 41, 38, 0), (0x0025, 42, 39, 0),
+      (0x0015, 43, 40, 0), (0x0009, 44, 41, 0), (0x0005, 45, 42, 0),
+      (0x0001, 45, 43, 0), (0x5601, 46, 46, 0)]
+
+class MQEncoder:
+
+    def __init__(self, nContexts):
+        self.a = 0x8000
+        self.c = 0
+        self.ct = 12
+        self.out = bytearray(b"\x00")
+        self.index = [0] * nContexts
+        self.mps = [0] * nContexts
+
+    def byteOut(self):
+        if self.out[-1] == 0xff:
+            self.out.append((self.c >> 20) & 0xff)
+            self.c &= 0xfffff
+            self.ct = 7
+        elif self.c < 0x8000000:
+            self.out.append((self.c >> 19) & 0xff)
+            self.c &= 0x7ffff
+            self.ct = 8
+        else:
+            self.out[-1] += 1
+            if self.out[-1] == 0xff:
+                self.c &= 0x7ffffff
+                self.out.append((self.c >> 20) & 0xff)
+                self.c &= 0xfffff
+                self.ct = 7
+            else:
+                self.out.append((self.c >> 19) & 0xff)
+                self.c &= 0x7ffff
+                self.ct = 8
+
+    def encode(self, cx, d):
+        qe, nmps, nlps, switch = QE[self.index[cx]]
+        self.a -= qe
+        if d == self.mps[cx]:
+            if self.a & 0x8000:
+                self.c += qe
+                return
+            if self.a < qe:
+                self.a = qe
+            else:
+                self.c += qe
+            self.index[cx] = nmps
+        else:
+            if self.a < qe:
+                self.c += qe
+            else:
+                self.a = qe
+            if switch:
+                self.mps[cx] = 1 - self.mps[cx]
+            self.index[cx] = nlps
+        while True:
+            self.a <<= 1
+            self.c <<= 1
+            self.ct -= 1
+            if self.ct == 0:
+                self.byteOut()
+            if self.a & 0x8000:
+                break
+
+    def finish(self):
+        t = self.c + self.a
+        self.c |= 0xffff
+        if self.c >= t:
+            self.c -= 0x8000
+        self.c <<= self.ct
+        self.byteOut()
+        self.c <<= self.ct
+        self.byteOut()
+        if self.out[-1] != 0xff:
+            self.out.append(0xff)
+        self.out.append(0xac)
+        return bytes(self.out[1:])
+
+def encodeJBIG2(rows, w, h):
+    mq = MQEncoder(65536)
+    pad = 4
+    zero = bytearray(w + 2 * pad)
+    prev2 = prev1 = zero
+    ltp = 0
+    for y in range(h):
+        cur = bytearray(pad) + rows[y] + bytearray(pad)
+        same = 1 if cur == prev1 else 0
+        mq.encode(0x9b25, same ^ ltp)
+        ltp = same
+        if not same:
+            r0, r1, r2 = prev2, prev1, cur
+            for x in range(pad, w + pad):
+                # template 0 with the nominal AT pixels
+                cx = (r0[x - 1] << 15) | (r0[x] << 14) | (r0[x + 1] << 13) | \
+                     (r1[x - 2] << 12) | (r1[x - 1] << 11) | (r1[x] << 10) | \
+                     (r1[x + 1] << 9) | (r1[x + 2] << 8) | \
+                     (r2[x - 4] << 7) | (r2[x - 3] << 6) | (r2[x - 2] << 5) | \
+                     (r2[x - 1] << 4) | (r1[x + 3] << 3) | (r1[x - 3] << 2) | \
+                     (r0[x + 2] << 1) | r0[x - 2]
+                mq.encode(cx, r2[x])
+        prev2, prev1 = prev1, cur
+    data = mq.finish()
+
+    def seg(num, typ, body):
+        return struct.pack(">IBBBI", num, typ, 0, 1, len(body)) + body
+
+    out = seg(0, 48, struct.pack(">IIIIBH", w, h, 0, 0, 0, 0))
+    hdr = struct.pack(">IIIIB", w, h, 0, 0, 0)
+    hdr += bytes([0x08]) + struct.pack(">bbbbbbbb", 3, -1, -3, -1, 2, -2, -2, -2)
+    out += seg(1, 38, hdr + data)
+    return out
+
+def jbig2ScanPage(w, rnd, width, height):
+    rows = scanBitmap(rnd, width, height)
+    imgNum = w.addStream(b"/Type /XObject /Subtype /Image /Width %d"
+                         b" /Height %d /ColorSpace /DeviceGray"
+                         b" /BitsPerComponent 1"
+                         b" /Filter /JBIG2Decode" % (width, height),
+                         encodeJBIG2(rows, width, height), False)
+    return (b"q 612 0 0 792 0 0 cm /Im1 Do Q\n",
+            b"<< /XObject << /Im1 %d 0 R >> >>" % imgNum, [])
+
+#------------------------------------------------------------------------
+
+def makeCorpus(dir):
+    os.makedirs(dir, exist_ok=True)
+
+    def simple(name, nPages, pageFunc, objStm=False):
+        rnd = random.Random(name)
+        w = PDFWriter()
+        fontNum = type1Font(w)
+        root = buildDoc(w, [pageFunc(rnd, fontNum) for _ in range(nPages)])
+        w.write(os.path.join(dir, name + ".pdf"), root, objStm)
+
+    simple("text-dense", 40, denseTextPage)
+    simple("multicolumn", 30, multiColumnPage)
+    simple("tables", 30, tablePage)
+    simple("objstm", 40, denseTextPage, objStm=True)
+
+    rnd = random.Random("forms")
+    w = PDFWriter()
+    pages, acroForm = formPages(w, rnd, 10, type1Font(w))
+    w.write(os.path.join(dir, "forms.pdf"), buildDoc(w, pages, acroForm))
+
+    rnd = random.Random("type3")
+    w = PDFWriter()
+    fontNum = type3Font(w)
+    root = buildDoc(w, [type3Page(rnd, fontNum) for _ in range(20)])
+    w.write(os.path.join(dir, "type3.pdf"), root)
+
+    rnd = random.Random("scan-jpeg")
+    w = PDFWriter()
+    root = buildDoc(w, [jpegScanPage(w, rnd, 850, 1100) for _ in range(4)])
+    w.write(os.path.join(dir, "scan-jpeg.pdf"), root)
+
+    rnd = random.Random("scan-jbig2")
+    w = PDFWriter()
+    root = buildDoc(w, [jbig2ScanPage(w, rnd, 1275, 1650) for _ in range(4)])
+    w.write(os.path.join(dir, "scan-jbig2.pdf"), root)
+
+    with open(os.path.join(dir, "VERSION"), "w") as f:
+        f.write("%d\n" % CORPUS_VERSION)
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: mkcorpus.py <output-dir>\n")
+        sys.exit(1)
+    makeCorpus(sys.argv[1])
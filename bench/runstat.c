@@ -0,0 +1,67 @@
+/*========================================================================
+ *
+ * runstat.c
+ *
+ * Run a command, with its output discarded, and print
+ * "<exit-code> <wall-seconds> <peak-RSS-KB>".
+ *
+ * bench.py uses this instead of measuring the child itself: a process
+ * forked from the (comparatively large) Python interpreter inherits
+ * its resident set, and Linux carries that peak across the exec, so
+ * ru_maxrss would never drop below the size of Python.
+ *
+ *========================================================================*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static double now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char *argv[]) {
+  struct rusage usage;
+  double start;
+  pid_t pid;
+  int status, fd, code;
+  long rss;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: runstat <command> [<arg> ...]\n");
+    return 99;
+  }
+  start = now();
+  if ((pid = fork()) < 0) {
+    perror("fork");
+    return 99;
+  }
+  if (pid == 0) {
+    if ((fd = open("/dev/null", O_WRONLY)) >= 0) {
+      dup2(fd, 1);
+      dup2(fd, 2);
+      close(fd);
+    }
+    execv(argv[1], argv + 1);
+    _exit(127);
+  }
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    perror("wait4");
+    return 99;
+  }
+  code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  rss = usage.ru_maxrss;
+#ifdef __APPLE__
+  rss /= 1024;			/* bytes on macOS */
+#endif
+  printf("%d %.6f %ld\n", code, now() - start, rss);
+  return 0;
+}
@@ -59,6 +59,7 @@ del *.o
 %CXX% %CXXFLAGS% -c OutputDev.cc
 %CXX% %CXXFLAGS% -c PDFDoc.cc
 %CXX% %CXXFLAGS% -c PDFDocEncoding.cc
+%CXX% %CXXFLAGS% -c PerfCounters.cc
 %CXX% %CXXFLAGS% -c PSOutputDev.cc
 %CXX% %CXXFLAGS% -c PSTokenizer.cc
 %CXX% %CXXFLAGS% -c Page.cc
@@ -0,0 +1,95 @@
+//========================================================================
+//
+// GThread.h
+//
+// Portable thread macros.
+//
+//========================================================================
+
+#ifndef GTHREAD_H
+#define GTHREAD_H
+
+// Usage:
+//
+// static GThreadReturn gThreadCallConv func(void *data) {
+//   ...
+//   return 0;
+// }
+//
+// GThreadID t;
+// if (gCreateThread(&t, &func, data)) {
+//   ...
+//   gJoinThread(t);
+// }
+//
+// GCond c;                      // used with a GMutex (see GMutex.h)
+// gInitCond(&c);
+// gLockMutex(&m);
+//   while (!ready) gWaitCond(&c, &m);
+// gUnlockMutex(&m);
+// ...                           // in another thread:
+// gLockMutex(&m);  ready = 1;  gSignalCond(&c);  gUnlockMutex(&m);
+// ...
+// gDestroyCond(&c);
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef HANDLE GThreadID;
+typedef DWORD GThreadReturn;
+#define gThreadCallConv WINAPI
+
+#define gCreateThread(t, func, data) \
+  ((*(t) = CreateThread(NULL, 0, (func), (data), 0, NULL)) != NULL)
+#define gJoinThread(t) \
+  (WaitForSingleObject((t), INFINITE), CloseHandle(t))
+
+typedef CONDITION_VARIABLE GCond;
+
+#define gInitCond(c) InitializeConditionVariable(c)
+#define gDestroyCond(c)
+#define gWaitCond(c, m) SleepConditionVariableCS((c), (m), INFINITE)
+#define gSignalCond(c) WakeConditionVariable(c)
+
+static inline int gGetNumCPUs() {
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+}
+
+#else // assume pthreads
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t GThreadID;
+typedef void *GThreadReturn;
+#define gThreadCallConv
+
+#define gCreateThread(t, func, data) \
+  (pthread_create((t), NULL, (func), (data)) == 0)
+#define gJoinThread(t) pthread_join((t), NULL)
+
+typedef pthread_cond_t GCond;
+
+#define gInitCond(c) pthread_cond_init((c), NULL)
+#define gDestroyCond(c) pthread_cond_destroy(c)
+#define gWaitCond(c, m) pthread_cond_wait((c), (m))
+#define gSignalCond(c) pthread_cond_signal(c)
+
+static inline int gGetNumCPUs() {
+#ifdef _SC_NPROCESSORS_ONLN
+  long n;
+
+  if ((n = sysconf(_SC_NPROCESSORS_ONLN)) > 0) {
+    return (int)n;
+  }
+#endif
+  return 1;
+}
+
+#endif
+
+#endif
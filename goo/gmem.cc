@@ -48,6 +48,60 @@ static int gMaxMemInUse = 0;
 
 #endif /* DEBUG_MEM */
 
+#ifdef GMEM_ACCOUNTING
+
+/* header in front of each block (padded to keep malloc's alignment) */
+typedef struct {
+  int size;
+  int tag;
+} GMemAcctHdr;
+
+#define gMemAcctHdrSize 16
+
+#if MULTITHREADED
+#  ifdef _WIN32
+#    include <windows.h>
+#    define gMemAtomicAdd(p, n) (InterlockedExchangeAdd64((p), (n)) + (n))
+#    define gMemAtomicCAS(p, oldVal, newVal) \
+       (InterlockedCompareExchange64((p), (newVal), (oldVal)) == (oldVal))
+#    define gMemThreadLocal __declspec(thread)
+#  else
+#    define gMemAtomicAdd(p, n) __sync_add_and_fetch((p), (n))
+#    define gMemAtomicCAS(p, oldVal, newVal) \
+       __sync_bool_compare_and_swap((p), (oldVal), (newVal))
+#    define gMemThreadLocal __thread
+#  endif
+#else
+#  define gMemAtomicAdd(p, n) (*(p) += (n))
+#  define gMemAtomicCAS(p, oldVal, newVal) (*(p) = (newVal), 1)
+#  define gMemThreadLocal
+#endif
+
+/* [gMemTagAll] is the sum of the others */
+static GMemStats gMemAcctStats[gMemNTags + 1];
+
+static gMemThreadLocal int gMemCurTag = gMemTagOther;
+
+static void gMemAcctUpdate(GMemStats *st, int delta) {
+  long long live, peak;
+
+  if (delta > 0) {
+    gMemAtomicAdd(&st->allocs, 1);
+    gMemAtomicAdd(&st->allocBytes, delta);
+  }
+  live = gMemAtomicAdd(&st->liveBytes, delta);
+  while (delta > 0 && (peak = st->peakBytes) < live &&
+	 !gMemAtomicCAS(&st->peakBytes, peak, live)) ;
+}
+
+/* Count an allocation (<delta> > 0) or a free (<delta> < 0). */
+static void gMemAcct(int tag, int delta) {
+  gMemAcctUpdate(&gMemAcctStats[tag], delta);
+  gMemAcctUpdate(&gMemAcctStats[gMemTagAll], delta);
+}
+
+#endif /* GMEM_ACCOUNTING */
+
 void *gmalloc(int size) GMEM_EXCEP {
 #ifdef DEBUG_MEM
   int size1;
@@ -90,6 +144,22 @@ void *gmalloc(int size) GMEM_EXCEP {
     *p = gMemDeadVal;
   }
   return data;
+#elif defined(GMEM_ACCOUNTING)
+  GMemAcctHdr *hdr;
+
+  if (size < 0) {
+    gMemError("Invalid memory allocation size");
+  }
+  if (size == 0) {
+    return NULL;
+  }
+  if (!(hdr = (GMemAcctHdr *)malloc(size + gMemAcctHdrSize))) {
+    gMemError("Out of memory");
+  }
+  hdr->size = size;
+  hdr->tag = gMemCurTag;
+  gMemAcct(hdr->tag, size);
+  return (char *)hdr + gMemAcctHdrSize;
 #else
   void *p;
 
@@ -131,6 +201,33 @@ void *grealloc(void *p, int size) GMEM_EXCEP {
     q = gmalloc(size);
   }
   return q;
+#elif defined(GMEM_ACCOUNTING)
+  GMemAcctHdr *hdr;
+  int oldSize;
+
+  if (size < 0) {
+    gMemError("Invalid memory allocation size");
+  }
+  if (size == 0) {
+    if (p) {
+      gfree(p);
+    }
+    return NULL;
+  }
+  if (!p) {
+    return gmalloc(size);
+  }
+  // a realloc is counted as a free of the old block and an allocation
+  // of the new one, with the tag of the original allocation
+  hdr = (GMemAcctHdr *)((char *)p - gMemAcctHdrSize);
+  oldSize = hdr->size;
+  if (!(hdr = (GMemAcctHdr *)realloc(hdr, size + gMemAcctHdrSize))) {
+    gMemError("Out of memory");
+  }
+  gMemAcct(hdr->tag, -oldSize);
+  hdr->size = size;
+  gMemAcct(hdr->tag, size);
+  return (char *)hdr + gMemAcctHdrSize;
 #else
   void *q;
 
@@ -221,6 +318,14 @@ void gfree(void *p) {
       fprintf(stderr, "Attempted to free bad address %p\n", p);
     }
   }
+#elif defined(GMEM_ACCOUNTING)
+  GMemAcctHdr *hdr;
+
+  if (p) {
+    hdr = (GMemAcctHdr *)((char *)p - gMemAcctHdrSize);
+    gMemAcct(hdr->tag, -hdr->size);
+    free(hdr);
+  }
 #else
   if (p) {
     free(p);
@@ -256,6 +361,42 @@ void gMemReport(FILE *f) {
 }
 #endif
 
+#ifdef GMEM_ACCOUNTING
+int gMemSetTag(int tag) {
+  int oldTag;
+
+  oldTag = gMemCurTag;
+  gMemCurTag = tag;
+  return oldTag;
+}
+#endif
+
+void gMemGetStats(int tag, GMemStats *stats) {
+#ifdef GMEM_ACCOUNTING
+  *stats = gMemAcctStats[tag];
+#else
+  memset(stats, 0, sizeof(GMemStats));
+#endif
+}
+
+void gMemResetPeaks(void) {
+#ifdef GMEM_ACCOUNTING
+  int tag;
+
+  for (tag = 0; tag <= gMemTagAll; ++tag) {
+    gMemAcctStats[tag].peakBytes = gMemAcctStats[tag].liveBytes;
+  }
+#endif
+}
+
+const char *gMemTagName(int tag) {
+  static const char *names[gMemNTags + 1] = {
+    "other", "parser", "text", "font", "bitmap", "stream", "all"
+  };
+
+  return names[tag];
+}
+
 char *copyString(const char *s) {
   char *s1;
 
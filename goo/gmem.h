@@ -77,8 +77,81 @@ extern void gMemReport(FILE *f);
  */
 extern char *copyString(const char *s);
 
+/*
+ * Allocation accounting.  With GMEM_ACCOUNTING (configure
+ * --enable-mem-accounting), every block carries a small header
+ * recording its size and the subsystem that was current (per thread)
+ * when it was allocated, and counts, bytes and peak bytes are kept for
+ * each subsystem.  The counters are updated atomically, without
+ * locks.  Without GMEM_ACCOUNTING, gMemSetTag and GMemTagScope compile
+ * to nothing and gMemGetStats returns zeros.  Not available with
+ * DEBUG_MEM.
+ */
+enum {
+  gMemTagOther,			/* anything not tagged below */
+  gMemTagParser,		/* objects built by the parser, xref tables */
+  gMemTagText,			/* text layout */
+  gMemTagFont,			/* font loading, glyph caches */
+  gMemTagBitmap,		/* page and image bitmaps */
+  gMemTagStream,		/* stream decoders and their buffers */
+  gMemNTags,
+  gMemTagAll = gMemNTags	/* all subsystems together */
+};
+
+typedef struct {
+  long long allocs;		/* number of allocations */
+  long long allocBytes;		/* total bytes allocated */
+  long long liveBytes;		/* bytes currently allocated */
+  long long peakBytes;		/* high-water mark of liveBytes */
+} GMemStats;
+
+#if defined(GMEM_ACCOUNTING) && defined(DEBUG_MEM)
+#error "GMEM_ACCOUNTING can't be used with DEBUG_MEM"
+#endif
+
+/*
+ * Set the current thread's subsystem tag, returning the previous one.
+ */
+#ifdef GMEM_ACCOUNTING
+extern int gMemSetTag(int tag);
+#else
+#define gMemSetTag(tag) gMemTagOther
+#endif
+
+/*
+ * Get the stats for <tag> (or gMemTagAll).
+ */
+extern void gMemGetStats(int tag, GMemStats *stats);
+
+/*
+ * Restart the peak counts from the current live byte counts, to
+ * measure the peak over some piece of work.
+ */
+extern void gMemResetPeaks(void);
+
+/*
+ * Name of a subsystem tag, e.g., "parser".
+ */
+extern const char *gMemTagName(int tag);
+
 #ifdef __cplusplus
 }
+
+/*
+ * Make <tag> the current subsystem for the lifetime of the object.
+ */
+class GMemTagScope {
+public:
+#ifdef GMEM_ACCOUNTING
+  GMemTagScope(int tag) { savedTag = gMemSetTag(tag); }
+  ~GMemTagScope() { gMemSetTag(savedTag); }
+private:
+  int savedTag;
+#else
+  GMemTagScope(int tag) {}
+#endif
+};
+
 #endif
 
 #endif
@@ -2,7 +2,8 @@
 //
 // gmempp.cc
 //
-// Use gmalloc/gfree for C++ new/delete operators.
+// Use gmalloc/gfree for C++ new/delete operators (with DEBUG_MEM or
+// GMEM_ACCOUNTING, so that objects are tracked too).
 //
 // Copyright 1996-2003 Glyph & Cog, LLC
 //
@@ -11,7 +12,7 @@
 #include <aconf.h>
 #include "gmem.h"
 
-#ifdef DEBUG_MEM
+#if defined(DEBUG_MEM) || defined(GMEM_ACCOUNTING)
 
 void *operator new(size_t size) {
   return gmalloc((int)size);
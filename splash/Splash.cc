@@ -3224,6 +3224,7 @@ void Splash::getImageBounds(SplashCoord xyMin, SplashCoord xyMax,
 SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
 				  int w, int h, SplashCoord *mat,
 				  GBool glyphMode, GBool interpolate) {
+  GMemTagScope memTag(gMemTagBitmap);
   SplashBitmap *scaledMask;
   SplashClipResult clipRes;
   GBool minorAxisZero;
@@ -4269,6 +4270,7 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 			      SplashColorMode srcMode, GBool srcAlpha,
 			      int w, int h, SplashCoord *mat,
 			      GBool interpolate) {
+  GMemTagScope memTag(gMemTagBitmap);
   GBool ok;
   SplashBitmap *scaledImg;
   SplashClipResult clipRes;
@@ -25,6 +25,7 @@
 SplashBitmap::SplashBitmap(int widthA, int heightA, int rowPad,
 			   SplashColorMode modeA, GBool alphaA,
 			   GBool topDown) {
+  GMemTagScope memTag(gMemTagBitmap);
   width = widthA;
   height = heightA;
   mode = modeA;
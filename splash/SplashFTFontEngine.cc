@@ -48,6 +48,27 @@ static void gstringWrite(void *stream, const char *data, int len) {
 }
 #endif
 
+#ifdef GMEM_ACCOUNTING
+// Route FreeType's allocations through gmalloc, so they are counted
+// as font memory.
+static void *ftAlloc(FT_Memory memory, long size) {
+  GMemTagScope memTag(gMemTagFont);
+
+  return gmalloc((int)size);
+}
+
+static void ftFree(FT_Memory memory, void *block) {
+  gfree(block);
+}
+
+static void *ftRealloc(FT_Memory memory, long curSize, long newSize,
+		       void *block) {
+  return grealloc(block, (int)newSize);
+}
+
+static FT_MemoryRec_ ftMemory = { NULL, &ftAlloc, &ftFree, &ftRealloc };
+#endif
+
 //------------------------------------------------------------------------
 // SplashFTFontEngine
 //------------------------------------------------------------------------
@@ -69,14 +90,26 @@ SplashFTFontEngine::SplashFTFontEngine(GBool aaA, Guint flagsA,
 SplashFTFontEngine *SplashFTFontEngine::init(GBool aaA, Guint flagsA) {
   FT_Library libA;
 
+#ifdef GMEM_ACCOUNTING
+  if (FT_New_Library(&ftMemory, &libA)) {
+    return NULL;
+  }
+  FT_Add_Default_Modules(libA);
+#else
   if (FT_Init_FreeType(&libA)) {
     return NULL;
   }
+#endif
   return new SplashFTFontEngine(aaA, flagsA, libA);
 }
 
 SplashFTFontEngine::~SplashFTFontEngine() {
+#ifdef GMEM_ACCOUNTING
+  // FT_Done_FreeType would also free the (static) FT_MemoryRec_
+  FT_Done_Library(lib);
+#else
   FT_Done_FreeType(lib);
+#endif
 }
 
 SplashFontFile *SplashFTFontEngine::loadType1Font(SplashFontFileID *idA,
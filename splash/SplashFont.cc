@@ -98,6 +98,7 @@ SplashFont::~SplashFont() {
 
 GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
 			   SplashGlyphBitmap *bitmap) {
+  GMemTagScope memTag(gMemTagFont);
   SplashGlyphBitmap bitmap2;
   int size;
   Guchar *p;
@@ -0,0 +1,419 @@
+#!/usr/bin/env python3
+#========================================================================
+#
+# regress.py
+#
+# Regression tests for pdftojson.  Each test builds a small PDF file
+# (with the PDF writer from bench/mkcorpus.py), runs pdftojson on it
+# and checks the output.
+#
+#   regress.py [-bin <dir>] [-k <test>,...] [-keep]
+#
+#========================================================================
+
+import argparse
+import json
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "..", "bench"))
+import mkcorpus
+
+bin = None          # directory with the pdftojson binary
+tmp = None          # scratch directory
+
+#------------------------------------------------------------------------
+
+class TestFailure(Exception):
+    pass
+
+def check(cond, msg):
+    if not cond:
+        raise TestFailure(msg)
+
+def path(name):
+    return os.path.join(tmp, name)
+
+def pdftojson(args, expectCode=0, stdin=None):
+    """Run pdftojson with args (plus -q), returning its exit code."""
+    cmd = [os.path.join(bin, "pdftojson"), "-q"] + args
+    code = subprocess.call(cmd, stdin=stdin)
+    check(expectCode is None or code == expectCode,
+          "%s: exit code %d" % (" ".join(cmd), code))
+    return code
+
+def convert(pdfFile, args=[]):
+    """Convert pdfFile with -ndjson, returning the page objects."""
+    out = pdfFile + ".ndjson"
+    pdftojson(args + ["-ndjson", pdfFile, out])
+    with open(out) as f:
+        return [json.loads(line) for line in f if line.strip()]
+
+def countWords(page, word):
+    return sum(1 for w in page["text"] if w[5].strip() == word)
+
+def helvetica(w):
+    return w.add(b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica"
+                 b" /Encoding /WinAnsiEncoding >>")
+
+def helvResources(fontNum):
+    return b"<< /Font << /F1 %d 0 R >> >>" % fontNum
+
+# A page with nLines of text, one Tj and one Td per line: BT, Tf and
+# Td, 2 * nLines, and ET make 2 * nLines + 4 operators.
+def linesPage(fontNum, nLines, label=b"line"):
+    ops = [b"BT /F1 9 Tf 72 740 Td"]
+    for i in range(nLines):
+        ops.append(b"(%s %d %s) Tj 0 -11 Td" % (label, i + 1, b"x" * 50))
+    ops.append(b"ET")
+    return b"\n".join(ops) + b"\n", helvResources(fontNum), []
+
+# Write a linearized file with nPages pages, each a Page object and a
+# content stream that shows "Page <n>", in a flat page tree.  The page
+# offset hint table gives hintCounts[i] objects for page i+1 (the
+# actual count is 2), so wrong hints can be tested.  Only the parts of
+# the hint table that Catalog reads are filled in.
+def writeLinearized(fileName, nPages, hintCounts=None):
+    if hintCounts is None:
+        hintCounts = [2] * nPages
+    objs = {}
+    # pages 2..nPages, numbered from 1
+    pageNums = []
+    for pg in range(2, nPages + 1):
+        num = 2 * pg - 3
+        pageNums.append(num)
+        c = b"BT /F1 12 Tf 72 700 Td (Page %d) Tj ET" % pg
+        objs[num] = b"<< /Type /Page /Parent %%d 0 R /Contents %d 0 R >>" \
+                    % (num + 1)
+        objs[num + 1] = b"<< /Length %d >>\nstream\n%s\nendstream" \
+                        % (len(c), c)
+    m = 2 * (nPages - 1)
+    lin, cat, root, page1, font, hint = range(m + 1, m + 7)
+    for num in pageNums:
+        objs[num] = objs[num] % root
+    c = b"BT /F1 12 Tf 72 700 Td (Page 1) Tj ET"
+    objs[page1] = b"<< /Type /Page /Parent %d 0 R /Contents %d 0 R >>" \
+                  % (root, hint + 1)
+    objs[hint + 1] = b"<< /Length %d >>\nstream\n%s\nendstream" % (len(c), c)
+    objs[root] = (b"<< /Type /Pages /Count %d /MediaBox [0 0 612 792]"
+                  b" /Resources << /Font << /F1 %d 0 R >> >> /Kids [%s] >>"
+                  % (nPages, font, b" ".join(b"%d 0 R" % n
+                                             for n in [page1] + pageNums)))
+    objs[cat] = b"<< /Type /Catalog /Pages %d 0 R >>" % root
+    objs[font] = b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"
+    # page offset hint table: header, then the object count of each page
+    least = min(hintCounts)
+    nBits = max(n - least for n in hintCounts).bit_length()
+    bits = []
+    def put(v, width):
+        bits.extend((v >> i) & 1 for i in range(width - 1, -1, -1))
+    put(least, 32)
+    put(0, 32)
+    put(nBits, 16)
+    for width in (32, 16, 32, 16, 32, 16, 16, 16, 16, 16):
+        put(0, width)
+    for n in hintCounts:
+        put(n - least, nBits)
+    bits += [0] * (-len(bits) % 8)
+    data = bytes(int("".join(map(str, bits[i:i + 8])), 2)
+                 for i in range(0, len(bits), 8))
+    objs[hint] = b"<< /S %d /Length %d >>\nstream\n" \
+                 % (len(data), len(data) + 24) + data + bytes(24) + \
+                 b"\nendstream"
+    last = hint + 1
+    # first page section (linearization dict, first-page xref, catalog,
+    # ...), then the other pages and the main xref table
+    out = bytearray(b"%PDF-1.5\n%\xe2\xe3\xcf\xd3\n")
+    offsets = {}
+    offsets[lin] = len(out)
+    out += b"%d 0 obj\n<< /Linearized 1 /L @@@@@@@@@@ /H [ ########## 100 ]" \
+           b" /O %d /E 0 /N %d /T 0 >>\nendobj\n" % (lin, page1, nPages)
+    firstXRef = len(out)
+    first = list(range(lin, last + 1))
+    out += b"xref\n%d %d\n" % (lin, len(first)) + b"$" * 20 * len(first) + \
+           b"trailer\n<< /Size %d /Root %d 0 R /Prev %%%%%%%%%%%%%%%%%%%% >>\n" \
+           b"startxref\n0\n%%%%EOF\n" % (last + 1, cat)
+    for num in list(range(cat, last + 1)) + list(range(1, m + 1)):
+        offsets[num] = len(out)
+        out += b"%d 0 obj\n%s\nendobj\n" % (num, objs[num])
+    mainXRef = len(out)
+    out += b"xref\n0 %d\n0000000000 65535 f \n" % (m + 1)
+    out += b"".join(b"%010d 00000 n \n" % offsets[n] for n in range(1, m + 1))
+    out += b"trailer\n<< /Size %d >>\nstartxref\n%d\n%%%%EOF\n" \
+           % (last + 1, firstXRef)
+    out = bytes(out)
+    out = out.replace(b"$" * 20 * len(first),
+                      b"".join(b"%010d 00000 n \n" % offsets[n] for n in first))
+    out = out.replace(b"##########", b"%010d" % offsets[hint])
+    out = out.replace(b"%" * 10, b"%010d" % mainXRef, 1)
+    out = out.replace(b"@@@@@@@@@@", b"%010d" % len(out))
+    with open(fileName, "wb") as f:
+        f.write(out)
+
+# Write a file with two pages that each draw an image small and then
+# large.  Page 1 draws the same image XObject both times; page 2 draws
+# two separate copies of it, so its large draw is never reduced.
+def writeSmallLarge(fileName, imgDict, imgData):
+    w = mkcorpus.PDFWriter()
+    imgs = [w.addStream(imgDict, imgData, False) for _ in range(3)]
+    pages = []
+    for small, large in ((imgs[0], imgs[0]), (imgs[1], imgs[2])):
+        pages.append((b"q 4 0 0 4 36 36 cm /ImS Do Q"
+                      b" q 400 0 0 400 100 200 cm /ImL Do Q\n",
+                      b"<< /XObject << /ImS %d 0 R /ImL %d 0 R >> >>"
+                      % (small, large), []))
+    w.write(fileName, mkcorpus.buildDoc(w, pages))
+
+def readFile(fileName):
+    with open(fileName, "rb") as f:
+        return f.read()
+
+#------------------------------------------------------------------------
+# tests
+#------------------------------------------------------------------------
+
+# -maxops on a text-heavy page: text operators make Gfx's display
+# update counter wrap well before the limit is reached, which must not
+# stop the limit from being checked.
+def testMaxOpsText():
+    w = mkcorpus.PDFWriter()
+    root = mkcorpus.buildDoc(w, [linesPage(helvetica(w), 60)])
+    w.write(path("maxops.pdf"), root)
+    nOps = 2 * 60 + 4
+    page = convert(path("maxops.pdf"), ["-maxops", str(nOps)])[0]
+    check(not page.get("truncated"), "truncated with -maxops %d" % nOps)
+    check(countWords(page, "line") == 60,
+          "%d lines" % countWords(page, "line"))
+    for limit in (nOps - 1, nOps - 10, 30):
+        page = convert(path("maxops.pdf"), ["-maxops", str(limit)])[0]
+        check(page.get("truncated"), "not truncated with -maxops %d" % limit)
+        # the last line's Tj is operator nOps - 2
+        if limit < nOps - 2:
+            check(countWords(page, "line") < 60,
+                  "%d lines with -maxops %d"
+                  % (countWords(page, "line"), limit))
+
+# A cross-reference stream that is too short for its /Size: the
+# entries are only decoded on first use, but a file whose xref table
+# can't be reconstructed (there's no trailer dictionary to find) must
+# still fail to open.
+def testDamagedXRefStream():
+    w = mkcorpus.PDFWriter()
+    fontNum = helvetica(w)
+    root = mkcorpus.buildDoc(w, [linesPage(fontNum, 5) for _ in range(4)])
+    w.write(path("xref.pdf"), root)
+    with open(path("xref.pdf"), "rb") as f:
+        data = f.read()
+    xrefPos = int(data[data.rindex(b"startxref") + 9:].split()[0])
+    lines = data[xrefPos:].split(b"\n")
+    n = int(lines[1].split()[1])
+    rows = struct.pack(">BIH", 0, 0, 65535)
+    for line in lines[3:n + 2]:
+        rows += struct.pack(">BIH", 1, int(line[:10]), 0)
+    rows = zlib.compress(rows[:len(rows) // 2])
+    with open(path("xref-damaged.pdf"), "wb") as f:
+        f.write(data[:xrefPos] +
+                b"%d 0 obj\n<< /Type /XRef /Size %d /W [1 4 2] /Root %d 0 R"
+                b" /Filter /FlateDecode /Length %d >>\nstream\n"
+                % (n, n + 1, root, len(rows)) + rows +
+                b"\nendstream\nendobj\nstartxref\n%d\n%%%%EOF\n" % xrefPos)
+    check(len(convert(path("xref.pdf"))) == 4, "undamaged file")
+    pdftojson([path("xref-damaged.pdf"), path("xref-damaged.json")],
+              expectCode=1)
+
+# Linearization hints that point at the wrong page object: with the
+# object counts shifted, pages 3-5 are given the page objects of pages
+# 4-6, which are in the page tree too, so they are only caught by
+# checking each page's position in the tree.
+def testLinearizedShiftedHints():
+    for name, counts in (("lin", None), ("lin-shifted", [2, 4, 2, 2, 2, 2])):
+        writeLinearized(path(name + ".pdf"), 6, counts)
+        pages = convert(path(name + ".pdf"))
+        check(len(pages) == 6, "%s: %d pages" % (name, len(pages)))
+        for pg, page in enumerate(pages, 1):
+            check(countWords(page, str(pg)) == 1,
+                  "%s: page %d has the text of another page" % (name, pg))
+        # one page at a time, as a page cache or viewer would
+        for pg in (4, 3):
+            page = convert(path(name + ".pdf"),
+                           ["-f", str(pg), "-l", str(pg)])[0]
+            check(countWords(page, str(pg)) == 1,
+                  "%s -f %d: got the text of another page" % (name, pg))
+
+# -cache with a config file: editing the config file, or a file it
+# includes, must change the cache key, so the next run misses and
+# stores new entries.
+def testCacheConfig():
+    w = mkcorpus.PDFWriter()
+    fontNum = helvetica(w)
+    root = mkcorpus.buildDoc(w, [linesPage(fontNum, 5, b"page%d" % i)
+                                 for i in range(3)])
+    w.write(path("cache.pdf"), root)
+    cacheDir = path("cache")
+    cfg = path("cache.cfg")
+    inc = path("cache-inc.cfg")
+    def run(what, expectNew):
+        before = len(os.listdir(cacheDir)) if os.path.isdir(cacheDir) else 0
+        pdftojson(["-cfg", cfg, "-cache", cacheDir, path("cache.pdf"),
+                   path("cache.json")])
+        n = len(os.listdir(cacheDir)) - before
+        check((n > 0) == expectNew,
+              "%s: %d new cache entries" % (what, n))
+    def writeFile(fileName, text):
+        with open(fileName, "w") as f:
+            f.write(text)
+    writeFile(inc, "textPageBreaks yes\n")
+    writeFile(cfg, "include %s\n" % inc)
+    run("first run", True)
+    run("same config", False)
+    writeFile(inc, "textPageBreaks no\n")
+    run("included file edited", True)
+    writeFile(cfg, "include %s\ntextEOL unix\n" % inc)
+    run("config file edited", True)
+    run("same config", False)
+
+# A 64x64 grayscale JPEG 2000 codestream (3 decomposition levels),
+# made by OpenJPEG: the same XOR pattern as the DCT image below.
+JPX_64 = bytes.fromhex(
+    "ff4fff5100290000000000400000004000000000000000000000004000000040"
+    "00000000000000000001070101ff52000c00000001000304040000ff5c001742"
+    "673867506750676850055005504757d357d35762ff6400250001437265617465"
+    "64206279204f70656e4a5045472076657273696f6e20322e352e34ff90000a00"
+    "000000005d0001ff93c7c47c111dbe1b408af0bec9c647cdf64662cd43fdc8df"
+    "9d19f3a1671efc640ab290c3a4c3a50024d2b6eea7ceaca74324c07da889b0ae"
+    "94d952cf113a4082fe0f3f7df0483e82fdefa8c1ee6a2980ffd9")
+
+# An image drawn small is decoded at reduced resolution; drawing the
+# same image XObject large afterwards (the stream comes from the XRef
+# object cache, with the reduction still set) must render it at full
+# resolution again.
+def testImageReduction():
+    size = 64
+    pixels = [[(x * 4) ^ (y * 4) for x in range(size)] for y in range(size)]
+    imgDict = (b"/Type /XObject /Subtype /Image /Width %d /Height %d"
+               b" /ColorSpace /DeviceGray /BitsPerComponent 8"
+               % (size, size))
+    for name, filter, data in (
+            ("dct", b"DCTDecode", mkcorpus.encodeJPEG(pixels, size, size)),
+            ("jpx", b"JPXDecode", JPX_64)):
+        writeSmallLarge(path(name + ".pdf"),
+                        imgDict + b" /Filter /" + filter, data)
+        convert(path(name + ".pdf"), ["-createpng"])
+        check(readFile(path(name + ".pdf.ndjson-page1-notext.png")) ==
+              readFile(path(name + ".pdf.ndjson-page2-notext.png")),
+              "%s image drawn small, then large, differs from an"
+              " unreduced render" % name)
+
+# -cache with a form page that is page 1 of one file and page 2 of
+# another: the page cache hit must give the form fields the page's
+# own number.
+def testCacheFormPage():
+    for name, nBefore in (("form-a", 0), ("form-b", 1)):
+        w = mkcorpus.PDFWriter()
+        fontNum = helvetica(w)
+        pages, acroForm = mkcorpus.formPages(w, random.Random(1), 1, fontNum)
+        pages = [linesPage(fontNum, 5)] * nBefore + pages
+        w.write(path(name + ".pdf"), mkcorpus.buildDoc(w, pages, acroForm))
+    cache = ["-cache", path("form-cache")]
+    convert(path("form-a.pdf"), cache)
+    nEntries = len(os.listdir(path("form-cache")))
+    expected = convert(path("form-b.pdf"))
+    pages = convert(path("form-b.pdf"), cache)
+    check(len(os.listdir(path("form-cache"))) == nEntries + 2,
+          "form page wasn't found in the cache")
+    check(len(pages[1]["formfields"]) == 40,
+          "%d form fields" % len(pages[1]["formfields"]))
+    for pg, (page, exp) in enumerate(zip(pages, expected), 1):
+        check(page == exp, "page %d differs with -cache" % pg)
+        for field in page["formfields"]:
+            check(field[4] == pg,
+                  "page %d has a form field on page %d" % (pg, field[4]))
+
+# Reading the PDF file through a RangeStream (-rangeread) must give
+# the same output as reading it directly, or from stdin, with block
+# sizes that split objects and streams in different places.
+def testRangeRead():
+    rnd = random.Random(2)
+    w = mkcorpus.PDFWriter()
+    fontNum = helvetica(w)
+    pages = [linesPage(fontNum, 40, b"page%d" % i) for i in range(6)]
+    pages.insert(3, mkcorpus.jpegScanPage(w, rnd, 300, 400))
+    root = mkcorpus.buildDoc(w, pages)
+    w.write(path("range.pdf"), root)
+    w.write(path("range-objstm.pdf"), root, objStm=True)
+    writeLinearized(path("range-lin.pdf"), 6)
+    for name in ("range", "range-objstm", "range-lin"):
+        pdfFile = path(name + ".pdf")
+        pdftojson([pdfFile, path(name + ".json")])
+        expected = readFile(path(name + ".json"))
+        with open(pdfFile, "rb") as f:
+            pdftojson(["-", path(name + "-stdin.json")], stdin=f)
+        check(readFile(path(name + "-stdin.json")) == expected,
+              "%s: output differs when read from stdin" % name)
+        for kb in (1, 3, 64):
+            out = path("%s-range%d.json" % (name, kb))
+            pdftojson(["-rangeread", str(kb), pdfFile, out])
+            check(readFile(out) == expected,
+                  "%s: output differs with -rangeread %d" % (name, kb))
+        # a few pages only, as a viewer would fetch them, with the PNG
+        # files (page 4 of the first two files is a JPEG image)
+        for suffix, args in (("", []), ("-range", ["-rangeread", "1"])):
+            pdftojson(args + ["-f", "3", "-l", "4", "-createpng", pdfFile,
+                              path(name + "-34%s.json" % suffix)])
+        for suffix in (".json", ".json-page3-notext.png",
+                       ".json-page4-notext.png"):
+            check(readFile(path(name + "-34-range" + suffix)) ==
+                  readFile(path(name + "-34" + suffix)),
+                  "%s: pages 3-4 differ with -rangeread 1" % name)
+
+TESTS = [
+    ("maxops-text", testMaxOpsText),
+    ("damaged-xref-stream", testDamagedXRefStream),
+    ("linearized-shifted-hints", testLinearizedShiftedHints),
+    ("cache-config", testCacheConfig),
+    ("image-reduction", testImageReduction),
+    ("cache-form-page", testCacheFormPage),
+    ("range-read", testRangeRead),
+]
+
+#------------------------------------------------------------------------
+
+def main():
+    global bin, tmp
+    ap = argparse.ArgumentParser(description="pdftojson regression tests")
+    ap.add_argument("-bin", default="xpdf",
+                    help="directory with the pdftojson binary")
+    ap.add_argument("-k", help="comma-separated list of tests to run")
+    ap.add_argument("-keep", action="store_true",
+                    help="keep the scratch directory")
+    opts = ap.parse_args()
+    bin = opts.bin
+    names = opts.k.split(",") if opts.k else None
+    tmp = tempfile.mkdtemp(prefix="pdftojson-regress-")
+    nFailed = 0
+    for name, func in TESTS:
+        if names and name not in names:
+            continue
+        try:
+            func()
+            print("ok      %s" % name)
+        except TestFailure as e:
+            print("FAILED  %s: %s" % (name, e))
+            nFailed += 1
+    if opts.keep:
+        print("scratch files are in %s" % tmp)
+    else:
+        shutil.rmtree(tmp)
+    if nFailed:
+        print("%d test(s) failed" % nFailed)
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
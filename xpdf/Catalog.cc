@@ -25,6 +25,9 @@
 #include "Array.h"
 #include "Dict.h"
 #include "Page.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "Parser.h"
 #include "Error.h"
 #include "Link.h"
 #include "Form.h"
@@ -32,35 +35,171 @@
 #include "Catalog.h"
 
 //------------------------------------------------------------------------
-// PageTreeNode
+
+// Max depth of the page tree above a page loaded with the help of the
+// linearization hints.
+#define linMaxPageTreeDepth 64
+
+// Sizes of the fields in the page offset hint table header, after the
+// first three.
+static int pageOffsetHintHeaderBits[10] = {
+  32, 16, 32, 16, 32, 16, 16, 16, 16, 16
+};
+
+//------------------------------------------------------------------------
+// PageRefHash
 //------------------------------------------------------------------------
 
-class PageTreeNode {
+// Maps object IDs to page indexes.
+class PageRefHash {
 public:
 
-  PageTreeNode(Ref refA, int countA, PageTreeNode *parentA);
-  ~PageTreeNode();
+  PageRefHash(int expectedSize);
+  ~PageRefHash();
+
+  // Returns the value for <ref>, or -1 if there isn't one.
+  int lookup(Ref ref);
 
+  // Add <ref>, which must not already be in the table, with value
+  // <val> (>= 0).
+  void add(Ref ref, int val);
+
+private:
+
+  int hashRef(Ref ref);
+  void expand();
+
+  struct Bucket {
+    Ref ref;
+    int val;			// -1 for an empty bucket
+  } *tab;
+  int size;			// number of buckets (a power of 2)
+  int len;			// number of refs in the table
+};
+
+PageRefHash::PageRefHash(int expectedSize) {
+  int i;
+
+  for (size = 64; size < 2 * expectedSize && size < 0x40000000; size <<= 1) ;
+  tab = (Bucket *)gmallocn(size, sizeof(Bucket));
+  for (i = 0; i < size; ++i) {
+    tab[i].val = -1;
+  }
+  len = 0;
+}
+
+PageRefHash::~PageRefHash() {
+  gfree(tab);
+}
+
+int PageRefHash::hashRef(Ref ref) {
+  return (int)(((Guint)ref.num * 2654435761U + (Guint)ref.gen) &
+	       (Guint)(size - 1));
+}
+
+int PageRefHash::lookup(Ref ref) {
+  int h;
+
+  for (h = hashRef(ref); tab[h].val >= 0; h = (h + 1) & (size - 1)) {
+    if (tab[h].ref.num == ref.num && tab[h].ref.gen == ref.gen) {
+      return tab[h].val;
+    }
+  }
+  return -1;
+}
+
+void PageRefHash::add(Ref ref, int val) {
+  int h;
+
+  if (2 * (len + 1) > size) {
+    expand();
+  }
+  for (h = hashRef(ref); tab[h].val >= 0; h = (h + 1) & (size - 1)) ;
+  tab[h].ref = ref;
+  tab[h].val = val;
+  ++len;
+}
+
+void PageRefHash::expand() {
+  Bucket *oldTab;
+  int oldSize, h, i;
+
+  oldTab = tab;
+  oldSize = size;
+  size *= 2;
+  tab = (Bucket *)gmallocn(size, sizeof(Bucket));
+  for (i = 0; i < size; ++i) {
+    tab[i].val = -1;
+  }
+  for (i = 0; i < oldSize; ++i) {
+    if (oldTab[i].val >= 0) {
+      for (h = hashRef(oldTab[i].ref);
+	   tab[h].val >= 0;
+	   h = (h + 1) & (size - 1)) ;
+      tab[h] = oldTab[i];
+    }
+  }
+  gfree(oldTab);
+}
+
+//------------------------------------------------------------------------
+// PageTreeFrame
+//------------------------------------------------------------------------
+
+// A Pages node on the way down the page tree (see buildPageIndex).
+struct PageTreeFrame {
   Ref ref;
-  int count;
-  PageTreeNode *parent;
-  GList *kids;			// [PageTreeNode]
+  Object kids;
+  int nextKid;
   PageAttrs *attrs;
 };
 
-PageTreeNode::PageTreeNode(Ref refA, int countA, PageTreeNode *parentA) {
-  ref = refA;
-  count = countA;
-  parent = parentA;
-  kids = NULL;
-  attrs = NULL;
+//------------------------------------------------------------------------
+// HintBitReader
+//------------------------------------------------------------------------
+
+// Reads the big-endian bit fields of a linearization hint table.
+class HintBitReader {
+public:
+
+  HintBitReader(Stream *strA);
+
+  // Read an <n>-bit (n <= 32) value.  Returns false at end of stream.
+  GBool read(int n, Guint *val);
+
+private:
+
+  Stream *str;
+  Guint buf;			// current byte
+  int bufBits;			// number of unread bits in buf
+};
+
+HintBitReader::HintBitReader(Stream *strA) {
+  str = strA;
+  buf = 0;
+  bufBits = 0;
 }
 
-PageTreeNode::~PageTreeNode() {
-  delete attrs;
-  if (kids) {
-    deleteGList(kids, PageTreeNode);
+GBool HintBitReader::read(int n, Guint *val) {
+  Guint x;
+  int c, k;
+
+  x = 0;
+  while (n > 0) {
+    if (bufBits == 0) {
+      if ((c = str->getChar()) == EOF) {
+	return gFalse;
+      }
+      buf = (Guint)c;
+      bufBits = 8;
+    }
+    k = n < bufBits ? n : bufBits;
+    x = (x << k) | ((buf >> (bufBits - k)) & ((1 << k) - 1));
+    bufBits -= k;
+    n -= k;
   }
+  *val = x;
+  return gTrue;
 }
 
 //------------------------------------------------------------------------
@@ -98,13 +237,22 @@ Catalog::Catalog(PDFDoc *docA) {
   ok = gTrue;
   doc = docA;
   xref = doc->getXRef();
-  pageTree = NULL;
+  pagesRef.num = pagesRef.gen = -1;
   pages = NULL;
   pageRefs = NULL;
+  pageIndexBuilt = gFalse;
+  pageParentAttrs = NULL;
+  pageNodeAttrs = NULL;
+  pageRefHash = NULL;
   numPages = 0;
   baseURI = NULL;
   form = NULL;
+  formLoaded = gFalse;
+  linChecked = gFalse;
+  linPageObjs = NULL;
+  linHintsPos = -1;
   embeddedFiles = NULL;
+  embeddedFilesLoaded = gFalse;
 
   xref->getCatalog(&catDict);
   if (!catDict.isDict()) {
@@ -161,19 +309,13 @@ Catalog::Catalog(PDFDoc *docA) {
   // get the outline dictionary
   catDict.dictLookup("Outlines", &outline);
 
-  // get the AcroForm dictionary
+  // get the AcroForm dictionary (the form itself is loaded by
+  // getForm())
   catDict.dictLookup("AcroForm", &acroForm);
 
-  if (!acroForm.isNull()) {
-    form = Form::load(doc, this, &acroForm);
-  }
-
   // get the OCProperties dictionary
   catDict.dictLookup("OCProperties", &ocProperties);
 
-  // get the list of embedded files
-  readEmbeddedFileList(catDict.getDict());
-
   catDict.free();
   return;
 
@@ -187,9 +329,6 @@ Catalog::Catalog(PDFDoc *docA) {
 Catalog::~Catalog() {
   int i;
 
-  if (pageTree) {
-    delete pageTree;
-  }
   if (pages) {
     for (i = 0; i < numPages; ++i) {
       if (pages[i]) {
@@ -199,6 +338,14 @@ Catalog::~Catalog() {
     gfree(pages);
     gfree(pageRefs);
   }
+  gfree(pageParentAttrs);
+  if (pageNodeAttrs) {
+    deleteGList(pageNodeAttrs, PageAttrs);
+  }
+  if (pageRefHash) {
+    delete pageRefHash;
+  }
+  gfree(linPageObjs);
   dests.free();
   nameTree.free();
   if (baseURI) {
@@ -217,6 +364,16 @@ Catalog::~Catalog() {
   }
 }
 
+Form *Catalog::getForm() {
+  if (!formLoaded) {
+    formLoaded = gTrue;
+    if (!acroForm.isNull()) {
+      form = Form::load(doc, this, &acroForm);
+    }
+  }
+  return form;
+}
+
 Page *Catalog::getPage(int i) {
   if (!pages[i-1]) {
     loadPage(i);
@@ -225,7 +382,7 @@ Page *Catalog::getPage(int i) {
 }
 
 Ref *Catalog::getPageRef(int i) {
-  if (!pages[i-1]) {
+  if (!pages[i-1] && !pageIndexBuilt) {
     loadPage(i);
   }
   return &pageRefs[i-1];
@@ -264,16 +421,14 @@ GString *Catalog::readMetadata() {
 }
 
 int Catalog::findPage(int num, int gen) {
-  int i;
+  Ref ref;
 
-  for (i = 0; i < numPages; ++i) {
-    if (!pages[i]) {
-      loadPage(i+1);
-    }
-    if (pageRefs[i].num == num && pageRefs[i].gen == gen)
-      return i + 1;
+  if (!pageIndexBuilt) {
+    buildPageIndex();
   }
-  return 0;
+  ref.num = num;
+  ref.gen = gen;
+  return pageRefHash->lookup(ref) + 1;
 }
 
 LinkDest *Catalog::findDest(GString *name) {
@@ -415,7 +570,7 @@ GBool Catalog::readPageTree(Object *catDict) {
     numPages = 0;
     return gFalse;
   }
-  pageTree = new PageTreeNode(topPagesRef.getRef(), numPages, NULL);
+  pagesRef = topPagesRef.getRef();
   topPagesObj.free();
   topPagesRef.free();
   pages = (Page **)greallocn(pages, numPages, sizeof(Page *));
@@ -456,125 +611,490 @@ int Catalog::countPageTree(Object *pagesObj) {
 }
 
 void Catalog::loadPage(int pg) {
-  loadPage2(pg, pg - 1, pageTree);
-}
+  Object pageObj;
 
-void Catalog::loadPage2(int pg, int relPg, PageTreeNode *node) {
-  Object pageRefObj, pageObj, kidsObj, kidRefObj, kidObj, countObj;
-  PageTreeNode *kidNode, *p;
-  PageAttrs *attrs;
-  int count, i;
+  if (!pageIndexBuilt) {
+    if (!linChecked) {
+      readLinearization();
+    }
+    if (linPageObjs) {
+      if (!linPageObjs[pg-1] && linHintsPos >= 0) {
+	readPageOffsetHints();
+      }
+      if (linPageObjs[pg-1]) {
+	if (loadPageFromHints(pg)) {
+	  return;
+	}
+	error(errSyntaxWarning, -1,
+	      "Linearization hints don't match the page tree - ignoring them");
+	gfree(linPageObjs);
+	linPageObjs = NULL;
+      }
+    }
+    buildPageIndex();
+  }
 
-  if (relPg >= node->count) {
-    error(errSyntaxError, -1, "Internal error in page tree");
+  if (pageRefs[pg-1].num < 0 ||
+      !xref->fetch(pageRefs[pg-1].num, pageRefs[pg-1].gen,
+		   &pageObj)->isDict()) {
+    pageObj.free();
     pages[pg-1] = new Page(doc, pg);
     return;
   }
+  pages[pg-1] = new Page(doc, pg, pageObj.getDict(),
+			 new PageAttrs(pageParentAttrs[pg-1],
+				       pageObj.getDict()));
+  if (!pages[pg-1]->isOk()) {
+    delete pages[pg-1];
+    pages[pg-1] = new Page(doc, pg);
+  }
+  pageObj.free();
+}
 
-  // if this node has not been filled in yet, it's either a leaf node
-  // or an unread internal node
-  if (!node->kids) {
+// Read the whole page tree, in order, recording the object ID of each
+// page and the attributes it inherits.  A Pages node that is its own
+// ancestor is skipped, and the walk is cut off if it visits more nodes
+// than there are objects in the file (which takes a tree with shared
+// subtrees).
+void Catalog::buildPageIndex() {
+  PageTreeFrame *stack, *frame;
+  PageAttrs *attrs;
+  Object rootObj, kidRef, kid, kids;
+  int stackSize, depth, nNodes, n, i;
+
+  pageIndexBuilt = gTrue;
+  pageParentAttrs = (PageAttrs **)gmallocn(numPages, sizeof(PageAttrs *));
+  for (n = 0; n < numPages; ++n) {
+    pageRefs[n].num = pageRefs[n].gen = -1;
+    pageParentAttrs[n] = NULL;
+  }
+  pageNodeAttrs = new GList();
+  pageRefHash = new PageRefHash(numPages);
+  if (numPages == 0) {
+    return;
+  }
 
-    // check for a loop in the page tree
-    for (p = node->parent; p; p = p->parent) {
-      if (node->ref.num == p->ref.num && node->ref.gen == p->ref.gen) {
+  n = 0;
+  stackSize = 16;
+  stack = (PageTreeFrame *)gmallocn(stackSize, sizeof(PageTreeFrame));
+  depth = 0;
+  nNodes = 1;
+  if (!xref->fetch(pagesRef.num, pagesRef.gen, &rootObj)->isDict()) {
+    error(errSyntaxError, -1, "Page tree object is wrong type ({0:s})",
+	  rootObj.getTypeName());
+  } else if (rootObj.dictLookup("Kids", &kids)->isArray()) {
+    attrs = new PageAttrs(NULL, rootObj.getDict());
+    pageNodeAttrs->append(attrs);
+    stack[0].ref = pagesRef;
+    kids.copy(&stack[0].kids);
+    stack[0].nextKid = 0;
+    stack[0].attrs = attrs;
+    depth = 1;
+  } else {
+    // the top-level node is a Page, not a Pages node
+    pageRefs[0] = pagesRef;
+    pageRefHash->add(pagesRef, 0);
+    n = 1;
+  }
+  kids.free();
+  rootObj.free();
+
+  while (depth > 0 && n < numPages) {
+    frame = &stack[depth - 1];
+    if (frame->nextKid >= frame->kids.arrayGetLength()) {
+      frame->kids.free();
+      --depth;
+      continue;
+    }
+    if (!frame->kids.arrayGetNF(frame->nextKid++, &kidRef)->isRef()) {
+      error(errSyntaxError, -1, "Page tree reference is wrong type ({0:s})",
+	    kidRef.getTypeName());
+      kidRef.free();
+      continue;
+    }
+    if (!kidRef.fetch(xref, &kid)->isDict()) {
+      error(errSyntaxError, -1, "Page tree object is wrong type ({0:s})",
+	    kid.getTypeName());
+    } else if (kid.dictLookup("Kids", &kids)->isArray()) {
+      // an internal node
+      for (i = 0; i < depth; ++i) {
+	if (stack[i].ref.num == kidRef.getRefNum() &&
+	    stack[i].ref.gen == kidRef.getRefGen()) {
+	  break;
+	}
+      }
+      if (i < depth) {
+	error(errSyntaxError, -1, "Loop in Pages tree");
+      } else if (++nNodes > xref->getNumObjects()) {
 	error(errSyntaxError, -1, "Loop in Pages tree");
-	pages[pg-1] = new Page(doc, pg);
-	return;
+	kids.free();
+	kid.free();
+	kidRef.free();
+	break;
+      } else {
+	attrs = new PageAttrs(frame->attrs, kid.getDict());
+	pageNodeAttrs->append(attrs);
+	if (depth == stackSize) {
+	  stackSize *= 2;
+	  stack = (PageTreeFrame *)greallocn(stack, stackSize,
+					     sizeof(PageTreeFrame));
+	}
+	frame = &stack[depth++];
+	frame->ref = kidRef.getRef();
+	kids.copy(&frame->kids);
+	frame->nextKid = 0;
+	frame->attrs = attrs;
       }
+    } else {
+      // a page
+      pageRefs[n] = kidRef.getRef();
+      pageParentAttrs[n] = frame->attrs;
+      if (pageRefHash->lookup(pageRefs[n]) < 0) {
+	pageRefHash->add(pageRefs[n], n);
+      }
+      ++n;
     }
+    kids.free();
+    kid.free();
+    kidRef.free();
+  }
+  while (depth > 0) {
+    stack[--depth].kids.free();
+  }
+  gfree(stack);
 
-    // fetch the Page/Pages object
-    pageRefObj.initRef(node->ref.num, node->ref.gen);
-    if (!pageRefObj.fetch(xref, &pageObj)->isDict()) {
-      error(errSyntaxError, -1, "Page tree object is wrong type ({0:s})",
-	    pageObj.getTypeName());
-      pageObj.free();
-      pageRefObj.free();
-      pages[pg-1] = new Page(doc, pg);
-      return;
-    }
+  if (n < numPages) {
+    error(errSyntaxError, -1, "Invalid page count in page tree");
+  }
+}
 
-    // merge the PageAttrs
-    attrs = new PageAttrs(node->parent ? node->parent->attrs
-			               : (PageAttrs *)NULL,
-			  pageObj.getDict());
+// If this is a linearized file, get the first page's object number
+// from the linearization dictionary, and note where the page offset
+// hint table is.  The hints are ignored if the file has been updated
+// since it was linearized.
+void Catalog::readLinearization() {
+  BaseStream *str;
+  Parser *parser;
+  Object obj1, obj2, obj3, linDict, obj4, obj5;
+  GFileOffset fileLength, hintsPos;
+  int firstPage, firstPageObj;
+
+  linChecked = gTrue;
+  str = doc->getBaseStream();
+  obj1.initNull();
+  parser = new Parser(xref,
+	     new Lexer(xref,
+	       str->makeSubStream(str->getStart(), gFalse, 0, &obj1)),
+	     gTrue);
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&linDict);
+  delete parser;
+  if (!obj1.isInt() || !obj2.isInt() || !obj3.isCmd("obj") ||
+      !linDict.isDict() ||
+      !linDict.dictLookup("Linearized", &obj4)->isNum() ||
+      obj4.getNum() <= 0) {
+    goto done;
+  }
+  obj4.free();
 
-    // if "Kids" exists, it's an internal node
-    if (pageObj.dictLookup("Kids", &kidsObj)->isArray()) {
+  str->setPos(0, -1);
+  fileLength = str->getPos() - str->getStart();
+  if (!linDict.dictLookup("L", &obj4)->isInt() ||
+      (GFileOffset)obj4.getInt() != fileLength) {
+    goto done;
+  }
+  obj4.free();
+  if (!linDict.dictLookup("N", &obj4)->isInt() ||
+      obj4.getInt() != numPages) {
+    goto done;
+  }
+  obj4.free();
+  if (!linDict.dictLookup("O", &obj4)->isInt() ||
+      obj4.getInt() <= 0 || obj4.getInt() >= xref->getNumObjects()) {
+    goto done;
+  }
+  firstPageObj = obj4.getInt();
+  obj4.free();
+  firstPage = 0;
+  if (linDict.dictLookup("P", &obj4)->isInt()) {
+    firstPage = obj4.getInt();
+  }
+  if (firstPage < 0 || firstPage >= numPages) {
+    goto done;
+  }
+  obj4.free();
+  hintsPos = -1;
+  if (linDict.dictLookup("H", &obj4)->isArray() &&
+      obj4.arrayGetLength() >= 2 &&
+      obj4.arrayGet(0, &obj5)->isInt() && obj5.getInt() > 0) {
+    hintsPos = obj5.getInt();
+  }
+  obj5.free();
+
+  linPageObjs = (int *)gmallocn(numPages, sizeof(int));
+  memset(linPageObjs, 0, numPages * sizeof(int));
+  linPageObjs[firstPage] = firstPageObj;
+  // the object numbering of the other pages is only known when the
+  // first page is the first in the file
+  linHintsPos = firstPage == 0 ? hintsPos : -1;
+
+ done:
+  obj4.free();
+  linDict.free();
+  obj3.free();
+  obj2.free();
+  obj1.free();
+}
 
-      // save the PageAttrs
-      node->attrs = attrs;
+// Read the object counts from the page offset hint table, and use them
+// to number the page objects: the objects of each page other than the
+// first are numbered consecutively from 1, starting with the page
+// object.
+void Catalog::readPageOffsetHints() {
+  BaseStream *str;
+  Parser *parser;
+  HintBitReader *bits;
+  Object obj1, obj2, obj3, hintsObj;
+  Guint nObjsLeast, nObjsBits, x;
+  int objNum, nObjs, i;
+
+  str = doc->getBaseStream();
+  obj1.initNull();
+  parser = new Parser(xref,
+	     new Lexer(xref,
+	       str->makeSubStream(str->getStart() + linHintsPos, gFalse, 0,
+				  &obj1)),
+	     gTrue);
+  linHintsPos = -1;
+  parser->getObj(&obj1, gTrue);
+  parser->getObj(&obj2, gTrue);
+  parser->getObj(&obj3, gTrue);
+  delete parser;
+  if (!obj1.isInt() || !obj2.isInt() || !obj3.isCmd("obj") ||
+      !xref->fetch(obj1.getInt(), obj2.getInt(), &hintsObj)->isStream()) {
+    goto err1;
+  }
 
-      // read the kids
-      node->kids = new GList();
-      for (i = 0; i < kidsObj.arrayGetLength(); ++i) {
-	if (kidsObj.arrayGetNF(i, &kidRefObj)->isRef()) {
-	  if (kidRefObj.fetch(xref, &kidObj)->isDict()) {
-	    if (kidObj.dictLookup("Count", &countObj)->isInt()) {
-	      count = countObj.getInt();
-	    } else {
-	      count = 1;
-	    }
-	    countObj.free();
-	    node->kids->append(new PageTreeNode(kidRefObj.getRef(), count,
-						node));
-	  } else {
-	    error(errSyntaxError, -1, "Page tree object is wrong type ({0:s})",
-		  kidObj.getTypeName());
-	  }
-	  kidObj.free();
-	} else {
-	  error(errSyntaxError, -1,
-		"Page tree reference is wrong type ({0:s})",
-		kidRefObj.getTypeName());
-	}
-	kidRefObj.free();
-      }
+  // header: the least number of objects in a page, and the number of
+  // bits in each page's difference from that; the rest of the header
+  // isn't needed
+  hintsObj.streamReset();
+  bits = new HintBitReader(hintsObj.getStream());
+  if (!bits->read(32, &nObjsLeast) ||
+      !bits->read(32, &x) ||
+      !bits->read(16, &nObjsBits) ||
+      nObjsLeast < 1 || nObjsLeast > 0x10000 || nObjsBits > 32) {
+    goto err2;
+  }
+  for (i = 0; i < 10; ++i) {
+    if (!bits->read(pageOffsetHintHeaderBits[i], &x)) {
+      goto err2;
+    }
+  }
 
-    } else {
-      
-      // create the Page object
-      pageRefs[pg-1] = node->ref;
-      pages[pg-1] = new Page(doc, pg, pageObj.getDict(), attrs);
-      if (!pages[pg-1]->isOk()) {
-	delete pages[pg-1];
-	pages[pg-1] = new Page(doc, pg);
+  objNum = 1;
+  for (i = 0; i < numPages; ++i) {
+    if (!bits->read(nObjsBits, &x) || x > 0x10000) {
+      goto err2;
+    }
+    if (i > 0) {
+      if (objNum >= xref->getNumObjects()) {
+	goto err2;
       }
-
+      linPageObjs[i] = objNum;
+      nObjs = (int)(nObjsLeast + x);
+      objNum += nObjs;
     }
+  }
+  delete bits;
+  hintsObj.streamClose();
+  hintsObj.free();
+  obj3.free();
+  obj2.free();
+  obj1.free();
+  return;
+
+ err2:
+  delete bits;
+  hintsObj.streamClose();
+  memset(linPageObjs + 1, 0, (numPages - 1) * sizeof(int));
+ err1:
+  hintsObj.free();
+  obj3.free();
+  obj2.free();
+  obj1.free();
+}
 
-    kidsObj.free();
+// Load page <pg> directly from the object number given by the
+// linearization hints.  The object has to be a Page whose chain of
+// parents leads to the root of the page tree.
+GBool Catalog::loadPageFromHints(int pg) {
+  Object ancestors[linMaxPageTreeDepth];
+  Object pageObj, parentRef;
+  XRefEntry entry;
+  PageAttrs *attrs, *attrs2;
+  Ref ref, kidRef;
+  int nAncestors, pos, offset, i;
+
+  ref.num = linPageObjs[pg-1];
+  ref.gen = 0;
+  if (xref->getEntry(ref.num, &entry)->type == xrefEntryUncompressed) {
+    ref.gen = entry.gen;
+  }
+  if (!xref->fetch(ref.num, ref.gen, &pageObj)->isDict("Page")) {
     pageObj.free();
-    pageRefObj.free();
+    return gFalse;
   }
 
-  // recursively descend the tree
-  if (node->kids) {
-    for (i = 0; i < node->kids->getLength(); ++i) {
-      kidNode = (PageTreeNode *)node->kids->get(i);
-      if (relPg < kidNode->count) {
-	loadPage2(pg, relPg, kidNode);
-	break;
-      }
-      relPg -= kidNode->count;
+  // walk up to the root, adding up the page's position in the tree --
+  // a page object that is in the tree, but isn't page <pg>, means the
+  // hints are wrong
+  nAncestors = 0;
+  pos = 0;
+  kidRef = ref;
+  pageObj.dictLookupNF("Parent", &parentRef);
+  while (1) {
+    if (!parentRef.isRef() || nAncestors == linMaxPageTreeDepth) {
+      goto err;
+    }
+    if (!parentRef.fetch(xref, &ancestors[nAncestors++])->isDict()) {
+      goto err;
+    }
+    offset = getKidPageOffset(&ancestors[nAncestors - 1], kidRef);
+    if (offset < 0 || offset > INT_MAX - pos) {
+      goto err;
+    }
+    pos += offset;
+    if (parentRef.getRefNum() == pagesRef.num &&
+	parentRef.getRefGen() == pagesRef.gen) {
+      break;
+    }
+    kidRef = parentRef.getRef();
+    parentRef.free();
+    ancestors[nAncestors - 1].dictLookupNF("Parent", &parentRef);
+  }
+  parentRef.free();
+  if (pos != pg - 1) {
+    for (i = 0; i < nAncestors; ++i) {
+      ancestors[i].free();
     }
+    pageObj.free();
+    return gFalse;
+  }
+
+  // merge the PageAttrs down from the root
+  attrs = NULL;
+  for (i = nAncestors - 1; i >= 0; --i) {
+    attrs2 = new PageAttrs(attrs, ancestors[i].getDict());
+    delete attrs;
+    attrs = attrs2;
+    ancestors[i].free();
+  }
+  attrs2 = new PageAttrs(attrs, pageObj.getDict());
+  delete attrs;
+
+  pageRefs[pg-1] = ref;
+  pages[pg-1] = new Page(doc, pg, pageObj.getDict(), attrs2);
+  pageObj.free();
+  if (!pages[pg-1]->isOk()) {
+    delete pages[pg-1];
+    pages[pg-1] = NULL;
+    pageRefs[pg-1].num = pageRefs[pg-1].gen = -1;
+    return gFalse;
+  }
+  return gTrue;
 
-    // this will only happen if the page tree is invalid
-    // (i.e., parent count > sum of children counts)
-    if (i == node->kids->getLength()) {
-      error(errSyntaxError, -1, "Invalid page count in page tree");
-      pages[pg-1] = new Page(doc, pg);
+ err:
+  parentRef.free();
+  for (i = 0; i < nAncestors; ++i) {
+    ancestors[i].free();
+  }
+  pageObj.free();
+  return gFalse;
+}
+
+// Return the number of pages under Pages node <node> that come before
+// its kid <kidRef>, or -1 if <kidRef> isn't one of its kids.  This is
+// only used before the page index is built, so the preceding internal
+// nodes are counted by their /Count, without walking them.
+// buildPageIndex numbers the pages by walking the tree, so the two
+// numberings differ if a /Count is wrong: loadPageFromHints then
+// (usually) rejects the hints and loadPage falls back to
+// buildPageIndex, but a wrong /Count that happens to agree with the
+// hints isn't caught.
+int Catalog::getKidPageOffset(Object *node, Ref kidRef) {
+  Object kids, kidRef2, kid, kids2, count;
+  GBool allPages;
+  int n, n2, i;
+
+  if (!node->dictLookup("Kids", &kids)->isArray()) {
+    kids.free();
+    return -1;
+  }
+  // if the node's page count is its number of kids, the kids are all
+  // pages (unless there are empty Pages nodes), so they don't need to
+  // be fetched -- this keeps flat page trees cheap
+  allPages = node->dictLookup("Count", &count)->isInt() &&
+             count.getInt() == kids.arrayGetLength();
+  count.free();
+  n = 0;
+  for (i = 0; i < kids.arrayGetLength(); ++i) {
+    if (!kids.arrayGetNF(i, &kidRef2)->isRef()) {
+      kidRef2.free();
+      continue;
+    }
+    if (kidRef2.getRefNum() == kidRef.num &&
+	kidRef2.getRefGen() == kidRef.gen) {
+      kidRef2.free();
+      kids.free();
+      return n;
+    }
+    if (allPages) {
+      n2 = 1;
+    } else if (!kidRef2.fetch(xref, &kid)->isDict()) {
+      n2 = 0;
+    } else if (kid.dictLookup("Kids", &kids2)->isArray()) {
+      if (!kid.dictLookup("Count", &count)->isInt() || count.getInt() < 0) {
+	n2 = -1;
+      } else {
+	n2 = count.getInt();
+      }
+      count.free();
+      kids2.free();
+    } else {
+      kids2.free();
+      n2 = 1;
+    }
+    if (!allPages) {
+      kid.free();
     }
+    kidRef2.free();
+    if (n2 < 0 || n2 > INT_MAX - n) {
+      kids.free();
+      return -1;
+    }
+    n += n2;
   }
+  kids.free();
+  return -1;
 }
 
-void Catalog::readEmbeddedFileList(Dict *catDict) {
-  Object obj1, obj2;
+// Read the list of embedded files (on first use, since it means
+// looking at every page's annotations).
+void Catalog::readEmbeddedFileList() {
+  Object catDict, obj1, obj2;
   char *touchedObjs;
 
+  embeddedFilesLoaded = gTrue;
+  if (!xref->getCatalog(&catDict)->isDict()) {
+    catDict.free();
+    return;
+  }
+
   // read the embedded file name tree
-  if (catDict->lookup("Names", &obj1)->isDict()) {
+  if (catDict.dictLookup("Names", &obj1)->isDict()) {
     if (obj1.dictLookup("EmbeddedFiles", &obj2)->isDict()) {
       readEmbeddedFileTree(&obj2);
     }
@@ -585,9 +1105,10 @@ void Catalog::readEmbeddedFileList(Dict *catDict) {
   // look for file attachment annotations
   touchedObjs = (char *)gmalloc(xref->getNumObjects());
   memset(touchedObjs, 0, xref->getNumObjects());
-  readFileAttachmentAnnots(catDict->lookupNF("Pages", &obj1), touchedObjs);
+  readFileAttachmentAnnots(catDict.dictLookupNF("Pages", &obj1), touchedObjs);
   obj1.free();
   gfree(touchedObjs);
+  catDict.free();
 }
 
 void Catalog::readEmbeddedFileTree(Object *node) {
@@ -710,6 +1231,9 @@ void Catalog::readEmbeddedFile(Object *fileSpec, Object *name1) {
 }
 
 int Catalog::getNumEmbeddedFiles() {
+  if (!embeddedFilesLoaded) {
+    readEmbeddedFileList();
+  }
   return embeddedFiles ? embeddedFiles->getLength() : 0;
 }
 
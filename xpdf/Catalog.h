@@ -15,6 +15,7 @@
 #pragma interface
 #endif
 
+#include "gfile.h"
 #include "CharTypes.h"
 
 class GList;
@@ -25,7 +26,7 @@ class Page;
 class PageAttrs;
 struct Ref;
 class LinkDest;
-class PageTreeNode;
+class PageRefHash;
 class Form;
 
 //------------------------------------------------------------------------
@@ -83,11 +84,14 @@ public:
 
   Object *getAcroForm() { return &acroForm; }
 
-  Form *getForm() { return form; }
+  // Return the parsed form, or NULL if there isn't one.  The form is
+  // loaded on the first call.
+  Form *getForm();
 
   Object *getOCProperties() { return &ocProperties; }
 
-  // Get the list of embedded files.
+  // Get the list of embedded files.  The list is read on the first
+  // call to getNumEmbeddedFiles().
   int getNumEmbeddedFiles();
   Unicode *getEmbeddedFileName(int idx);
   int getEmbeddedFileNameLength(int idx);
@@ -98,9 +102,15 @@ private:
 
   PDFDoc *doc;
   XRef *xref;			// the xref table for this PDF file
-  PageTreeNode *pageTree;	// the page tree
+  Ref pagesRef;			// root of the page tree
   Page **pages;			// array of pages
   Ref *pageRefs;		// object ID for each page
+  GBool pageIndexBuilt;		// set once the page tree has been read
+  PageAttrs **pageParentAttrs;	// attributes inherited by each page
+				//   (from pageNodeAttrs)
+  GList *pageNodeAttrs;		// attributes of each Pages node
+				//   [PageAttrs]
+  PageRefHash *pageRefHash;	// page object ID -> page index
   int numPages;			// number of pages
   int pagesSize;		// size of pages array
   Object dests;			// named destination dictionary
@@ -111,16 +121,29 @@ private:
   Object outline;		// outline dictionary
   Object acroForm;		// AcroForm dictionary
   Form *form;			// parsed form
+  GBool formLoaded;		// set once form has been loaded
+  GBool linChecked;		// set once the linearization dict has
+				//   been looked at
+  int *linPageObjs;		// page object numbers from the
+				//   linearization hints (0 if unknown),
+				//   or NULL
+  GFileOffset linHintsPos;	// offset of the primary hint stream, or
+				//   -1 once it has been read
   Object ocProperties;		// OCProperties dictionary
   GList *embeddedFiles;		// embedded file list [EmbeddedFile]
+  GBool embeddedFilesLoaded;	// set once embeddedFiles has been read
   GBool ok;			// true if catalog is valid
 
   Object *findDestInTree(Object *tree, GString *name, Object *obj);
   GBool readPageTree(Object *catDict);
   int countPageTree(Object *pagesObj);
   void loadPage(int pg);
-  void loadPage2(int pg, int relPg, PageTreeNode *node);
-  void readEmbeddedFileList(Dict *catDict);
+  void buildPageIndex();
+  void readLinearization();
+  void readPageOffsetHints();
+  GBool loadPageFromHints(int pg);
+  int getKidPageOffset(Object *node, Ref kidRef);
+  void readEmbeddedFileList();
   void readEmbeddedFileTree(Object *node);
   void readFileAttachmentAnnots(Object *pageNodeRef,
 				char *touchedObjs);
@@ -1288,60 +1288,93 @@ static void sha256HashBlock(Guchar *blk, Guint *H) {
   H[7] += h;
 }
 
-static void sha256(Guchar *msg, int msgLen, Guchar *hash) {
-  Guchar blk[64];
-  Guint H[8];
-  int blkLen, i;
+void sha256Start(SHA256State *state) {
+  state->h[0] = 0x6a09e667;
+  state->h[1] = 0xbb67ae85;
+  state->h[2] = 0x3c6ef372;
+  state->h[3] = 0xa54ff53a;
+  state->h[4] = 0x510e527f;
+  state->h[5] = 0x9b05688c;
+  state->h[6] = 0x1f83d9ab;
+  state->h[7] = 0x5be0cd19;
+  state->bufLen = 0;
+  state->msgLen = 0;
+}
 
-  H[0] = 0x6a09e667;
-  H[1] = 0xbb67ae85;
-  H[2] = 0x3c6ef372;
-  H[3] = 0xa54ff53a;
-  H[4] = 0x510e527f;
-  H[5] = 0x9b05688c;
-  H[6] = 0x1f83d9ab;
-  H[7] = 0x5be0cd19;
+void sha256Append(SHA256State *state, Guchar *data, int dataLen) {
+  Guchar *p;
+  int remain, k;
 
-  blkLen = 0;
-  for (i = 0; i + 64 <= msgLen; i += 64) {
-    sha256HashBlock(msg + i, H);
+  p = data;
+  remain = dataLen;
+  if (state->bufLen > 0) {
+    k = 64 - state->bufLen;
+    if (k > remain) {
+      k = remain;
+    }
+    memcpy(state->buf + state->bufLen, p, k);
+    state->bufLen += k;
+    p += k;
+    remain -= k;
+    if (state->bufLen < 64) {
+      state->msgLen += dataLen;
+      return;
+    }
+    sha256HashBlock(state->buf, state->h);
+    state->bufLen = 0;
   }
-  blkLen = msgLen - i;
-  if (blkLen > 0) {
-    memcpy(blk, msg + i, blkLen);
+  while (remain >= 64) {
+    sha256HashBlock(p, state->h);
+    p += 64;
+    remain -= 64;
   }
+  if (remain > 0) {
+    memcpy(state->buf, p, remain);
+    state->bufLen = remain;
+  }
+  state->msgLen += dataLen;
+}
+
+void sha256Finish(SHA256State *state) {
+  unsigned long long bits;
+  int i;
 
   // pad the message
-  blk[blkLen++] = 0x80;
-  if (blkLen > 56) {
-    while (blkLen < 64) {
-      blk[blkLen++] = 0;
+  state->buf[state->bufLen++] = 0x80;
+  if (state->bufLen > 56) {
+    while (state->bufLen < 64) {
+      state->buf[state->bufLen++] = 0;
     }
-    sha256HashBlock(blk, H);
-    blkLen = 0;
+    sha256HashBlock(state->buf, state->h);
+    state->bufLen = 0;
   }
-  while (blkLen < 56) {
-    blk[blkLen++] = 0;
+  while (state->bufLen < 56) {
+    state->buf[state->bufLen++] = 0;
+  }
+  bits = state->msgLen << 3;
+  for (i = 0; i < 8; ++i) {
+    state->buf[56 + i] = (Guchar)(bits >> (56 - 8 * i));
   }
-  blk[56] = 0;
-  blk[57] = 0;
-  blk[58] = 0;
-  blk[59] = 0;
-  blk[60] = (Guchar)(msgLen >> 21);
-  blk[61] = (Guchar)(msgLen >> 13);
-  blk[62] = (Guchar)(msgLen >> 5);
-  blk[63] = (Guchar)(msgLen << 3);
-  sha256HashBlock(blk, H);
+  sha256HashBlock(state->buf, state->h);
 
   // copy the output into the buffer (convert words to bytes)
   for (i = 0; i < 8; ++i) {
-    hash[i*4]     = (Guchar)(H[i] >> 24);
-    hash[i*4 + 1] = (Guchar)(H[i] >> 16);
-    hash[i*4 + 2] = (Guchar)(H[i] >> 8);
-    hash[i*4 + 3] = (Guchar)H[i];
+    state->digest[i*4]     = (Guchar)(state->h[i] >> 24);
+    state->digest[i*4 + 1] = (Guchar)(state->h[i] >> 16);
+    state->digest[i*4 + 2] = (Guchar)(state->h[i] >> 8);
+    state->digest[i*4 + 3] = (Guchar)state->h[i];
   }
 }
 
+static void sha256(Guchar *msg, int msgLen, Guchar *hash) {
+  SHA256State state;
+
+  sha256Start(&state);
+  sha256Append(&state, msg, msgLen);
+  sha256Finish(&state);
+  memcpy(hash, state.digest, 32);
+}
+
 //------------------------------------------------------------------------
 // SHA-384 and SHA-512 hashes
 //------------------------------------------------------------------------
@@ -114,12 +114,23 @@ struct MD5State {
   Guchar digest[16];
 };
 
+struct SHA256State {
+  Guint h[8];
+  Guchar buf[64];
+  int bufLen;
+  unsigned long long msgLen;
+  Guchar digest[32];
+};
+
 extern void rc4InitKey(Guchar *key, int keyLen, Guchar *state);
 extern Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c);
 void md5Start(MD5State *state);
 void md5Append(MD5State *state, Guchar *data, int dataLen);
 void md5Finish(MD5State *state);
 extern void md5(Guchar *msg, int msgLen, Guchar *digest);
+void sha256Start(SHA256State *state);
+void sha256Append(SHA256State *state, Guchar *data, int dataLen);
+void sha256Finish(SHA256State *state);
 extern void aesKeyExpansion(DecryptAESState *s,
 			    Guchar *objKey, int objKeyLen,
 			    GBool decrypt);
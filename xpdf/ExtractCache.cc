@@ -0,0 +1,756 @@
+//========================================================================
+//
+// ExtractCache.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#  include <process.h>
+#  include <sys/utime.h>
+#else
+#  include <unistd.h>
+#  include <utime.h>
+#endif
+#include "gmem.h"
+#include "GString.h"
+#include "GList.h"
+#include "Object.h"
+#include "Array.h"
+#include "Dict.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "PDFDoc.h"
+#include "Decrypt.h"
+#include "ExtractCache.h"
+
+//------------------------------------------------------------------------
+
+// First line of every entry; bump the version when the format of the
+// entries, or of the page records, changes.
+#define extractCacheHeader "pdftojson-cache 1\n"
+
+// Page attributes that can be inherited from the page tree.
+static const char *extractCacheInheritedKeys[] = {
+  "Resources",
+  "MediaBox",
+  "CropBox",
+  "Rotate",
+  NULL
+};
+
+#define extractCacheMaxTreeDepth 64
+
+// Temporary files left behind by a crashed run are removed after
+// this many seconds.
+#define extractCacheTmpMaxAge 3600
+
+//------------------------------------------------------------------------
+
+struct ExtractCacheFile {
+  GString *name;
+  GFileOffset size;
+  time_t mtime;
+};
+
+static int cmpExtractCacheFiles(const void *p1, const void *p2) {
+  ExtractCacheFile *f1 = *(ExtractCacheFile **)p1;
+  ExtractCacheFile *f2 = *(ExtractCacheFile **)p2;
+
+  if (f1->mtime != f2->mtime) {
+    return f1->mtime < f2->mtime ? -1 : 1;
+  }
+  return f1->name->cmp(f2->name);
+}
+
+static void sha256AppendInt(SHA256State *st, int x) {
+  Guchar buf[4];
+
+  buf[0] = (Guchar)(x >> 24);
+  buf[1] = (Guchar)(x >> 16);
+  buf[2] = (Guchar)(x >> 8);
+  buf[3] = (Guchar)x;
+  sha256Append(st, buf, 4);
+}
+
+static void sha256AppendStr(SHA256State *st, const char *s, int len) {
+  sha256AppendInt(st, len);
+  sha256Append(st, (Guchar *)s, len);
+}
+
+//------------------------------------------------------------------------
+// ExtractCache
+//------------------------------------------------------------------------
+
+ExtractCache::ExtractCache(char *dirA, GFileOffset maxSizeA,
+			   GString *optionsA) {
+  struct stat st;
+
+  dir = new GString(dirA);
+  maxSize = maxSizeA;
+  options = optionsA->copy();
+  stored = gFalse;
+  doc = NULL;
+  xref = NULL;
+  numObjects = 0;
+  memset(globalsHash, 0, extractCacheKeyLen);
+  formFieldNums = NULL;
+  nFormFieldNums = 0;
+  reached = NULL;
+  objIDs = NULL;
+  pass = 0;
+  nextID = 0;
+  queue = NULL;
+  queueHead = queueLen = queueSize = 0;
+
+  // make sure the directory exists
+  if (stat(dir->getCString(), &st)) {
+    createDir(dir->getCString(), 0777);
+    ok = !stat(dir->getCString(), &st) && S_ISDIR(st.st_mode);
+  } else {
+    ok = S_ISDIR(st.st_mode);
+  }
+}
+
+ExtractCache::~ExtractCache() {
+  if (stored) {
+    trim();
+  }
+  delete dir;
+  delete options;
+  gfree(formFieldNums);
+  gfree(reached);
+  gfree(objIDs);
+  gfree(queue);
+}
+
+GBool ExtractCache::isNullKey(ExtractCacheKey *key) {
+  int i;
+
+  for (i = 0; i < extractCacheKeyLen; ++i) {
+    if (key->hash[i]) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+//------------------------------------------------------------------------
+// entries
+//------------------------------------------------------------------------
+
+GString *ExtractCache::getEntryPath(ExtractCacheKey *key, const char *ext) {
+  GString *path;
+  int i;
+
+  path = dir->copy();
+  path->append('/');
+  for (i = 0; i < extractCacheKeyLen; ++i) {
+    path->appendf("{0:02x}", key->hash[i]);
+  }
+  path->append(ext);
+  return path;
+}
+
+// Read an entry, and mark it as recently used.
+GString *ExtractCache::readEntry(ExtractCacheKey *key, const char *ext) {
+  GString *path, *data;
+  FILE *f;
+  char buf[4096];
+  int n;
+
+  path = getEntryPath(key, ext);
+  if (!(f = fopen(path->getCString(), "rb"))) {
+    delete path;
+    return NULL;
+  }
+  data = new GString();
+  while ((n = (int)fread(buf, 1, sizeof(buf), f)) > 0) {
+    data->append(buf, n);
+  }
+  fclose(f);
+  utime(path->getCString(), NULL);
+  delete path;
+  if (data->getLength() < (int)strlen(extractCacheHeader) ||
+      strncmp(data->getCString(), extractCacheHeader,
+	      strlen(extractCacheHeader))) {
+    delete data;
+    return NULL;
+  }
+  data->del(0, (int)strlen(extractCacheHeader));
+  return data;
+}
+
+// Write an entry.  It's written to a temporary file first, and then
+// renamed, so other processes using the cache never see half of it.
+void ExtractCache::writeEntry(ExtractCacheKey *key, const char *ext,
+			      GString *data) {
+  GString *path, *tmpPath;
+  FILE *f;
+  GBool err;
+
+  path = getEntryPath(key, ext);
+  tmpPath = GString::format("{0:t}.{1:d}.tmp", path, (int)getpid());
+  if (!(f = fopen(tmpPath->getCString(), "wb"))) {
+    delete path;
+    delete tmpPath;
+    return;
+  }
+  fputs(extractCacheHeader, f);
+  fwrite(data->getCString(), 1, data->getLength(), f);
+  err = ferror(f);
+  if (fclose(f) || err) {
+    err = gTrue;
+  }
+  if (!err) {
+#ifdef _WIN32
+    unlink(path->getCString());
+#endif
+    err = rename(tmpPath->getCString(), path->getCString()) != 0;
+  }
+  if (err) {
+    unlink(tmpPath->getCString());
+  } else {
+    stored = gTrue;
+  }
+  delete path;
+  delete tmpPath;
+}
+
+// Remove the least recently used entries until the cache fits.
+void ExtractCache::trim() {
+  GDir *d;
+  GDirEntry *ent;
+  GList *files;
+  ExtractCacheFile *file;
+  GString *path;
+  struct stat st;
+  GFileOffset total;
+  time_t now;
+  int i;
+
+  now = time(NULL);
+  files = new GList();
+  total = 0;
+  d = new GDir(dir->getCString(), gFalse);
+  while ((ent = d->getNextEntry())) {
+    path = appendToPath(dir->copy(), ent->getName()->getCString());
+    if (stat(path->getCString(), &st) || !S_ISREG(st.st_mode)) {
+      delete path;
+      delete ent;
+      continue;
+    }
+    if (ent->getName()->getLength() > 4 &&
+	!strcmp(ent->getName()->getCString() +
+		  ent->getName()->getLength() - 4, ".tmp")) {
+      if (now - st.st_mtime > extractCacheTmpMaxAge) {
+	unlink(path->getCString());
+      }
+      delete path;
+      delete ent;
+      continue;
+    }
+    file = (ExtractCacheFile *)gmalloc(sizeof(ExtractCacheFile));
+    file->name = path;
+    file->size = (GFileOffset)st.st_size;
+    file->mtime = st.st_mtime;
+    files->append(file);
+    total += file->size;
+    delete ent;
+  }
+  delete d;
+
+  if (total > maxSize) {
+    files->sort(&cmpExtractCacheFiles);
+    for (i = 0; i < files->getLength() && total > maxSize; ++i) {
+      file = (ExtractCacheFile *)files->get(i);
+      if (!unlink(file->name->getCString())) {
+	total -= file->size;
+      }
+    }
+  }
+
+  for (i = 0; i < files->getLength(); ++i) {
+    file = (ExtractCacheFile *)files->get(i);
+    delete file->name;
+    gfree(file);
+  }
+  delete files;
+}
+
+//------------------------------------------------------------------------
+// documents
+//------------------------------------------------------------------------
+
+void ExtractCache::getDocKey(BaseStream *str, ExtractCacheKey *key) {
+  SHA256State st;
+  Guchar buf[65536];
+  int n;
+
+  sha256Start(&st);
+  sha256AppendStr(&st, options->getCString(), options->getLength());
+  sha256AppendStr(&st, "doc", 3);
+  str->reset();
+  while ((n = str->getBlock((char *)buf, sizeof(buf))) > 0) {
+    sha256Append(&st, buf, n);
+  }
+  str->close();
+  sha256Finish(&st);
+  memcpy(key->hash, st.digest, extractCacheKeyLen);
+}
+
+// A document entry is the number of pages, and then one line per
+// page: the page key in hex, or '-' if it isn't known.
+GBool ExtractCache::lookupDoc(ExtractCacheKey *key, int *nPages,
+			      ExtractCacheKey **pageKeys) {
+  GString *data;
+  char *p, *end;
+  int n, pg, i, x;
+
+  if (!(data = readEntry(key, ".doc"))) {
+    return gFalse;
+  }
+  p = data->getCString();
+  end = p + data->getLength();
+  if (sscanf(p, "pages %d", &n) != 1 || n < 1 ||
+      n > data->getLength() / 2) {
+    delete data;
+    return gFalse;
+  }
+  *pageKeys = (ExtractCacheKey *)gmallocn(n, sizeof(ExtractCacheKey));
+  memset(*pageKeys, 0, n * sizeof(ExtractCacheKey));
+  for (pg = 0; pg < n; ++pg) {
+    if (!(p = (char *)memchr(p, '\n', end - p))) {
+      goto err;
+    }
+    ++p;
+    if (p < end && *p == '-') {
+      continue;
+    }
+    if (end - p < 2 * extractCacheKeyLen) {
+      goto err;
+    }
+    for (i = 0; i < extractCacheKeyLen; ++i) {
+      if (sscanf(p + 2 * i, "%2x", &x) != 1) {
+	goto err;
+      }
+      (*pageKeys)[pg].hash[i] = (Guchar)x;
+    }
+  }
+  delete data;
+  *nPages = n;
+  return gTrue;
+
+ err:
+  gfree(*pageKeys);
+  *pageKeys = NULL;
+  delete data;
+  return gFalse;
+}
+
+void ExtractCache::storeDoc(ExtractCacheKey *key, int nPages,
+			    ExtractCacheKey *pageKeys) {
+  GString *data;
+  int pg, i;
+
+  data = GString::format("pages {0:d}\n", nPages);
+  for (pg = 0; pg < nPages; ++pg) {
+    if (isNullKey(&pageKeys[pg])) {
+      data->append('-');
+    } else {
+      for (i = 0; i < extractCacheKeyLen; ++i) {
+	data->appendf("{0:02x}", pageKeys[pg].hash[i]);
+      }
+    }
+    data->append('\n');
+  }
+  writeEntry(key, ".doc", data);
+  delete data;
+}
+
+//------------------------------------------------------------------------
+// pages
+//------------------------------------------------------------------------
+
+void ExtractCache::startDoc(PDFDoc *docA, ExtractCacheKey *docKey) {
+  SHA256State st;
+  Object catObj, acroForm, obj, kids, kid;
+  int *stack;
+  int stackLen, stackSize, num, i;
+
+  doc = docA;
+  xref = doc->getXRef();
+  numObjects = xref->getNumObjects();
+  gfree(reached);
+  gfree(objIDs);
+  reached = (int *)gmallocn(numObjects, sizeof(int));
+  memset(reached, 0, numObjects * sizeof(int));
+  objIDs = (int *)gmallocn(numObjects, sizeof(int));
+  pass = 0;
+
+  // the catalog entries that affect every page: optional content, and
+  // the AcroForm dictionary, apart from the fields
+  sha256Start(&st);
+  if (xref->isEncrypted()) {
+    sha256Append(&st, docKey->hash, extractCacheKeyLen);
+  }
+  startPass();
+  xref->getCatalog(&catObj);
+  if (catObj.isDict()) {
+    catObj.dictLookupNF("OCProperties", &obj);
+    hashObject(&st, &obj, NULL);
+    obj.free();
+    catObj.dictLookup("AcroForm", &acroForm);
+    hashObject(&st, &acroForm, "Fields");
+    acroForm.free();
+  }
+  hashQueued(&st);
+  sha256Finish(&st);
+  memcpy(globalsHash, st.digest, extractCacheKeyLen);
+
+  // the form field tree, in the order the fields are loaded
+  gfree(formFieldNums);
+  formFieldNums = NULL;
+  nFormFieldNums = 0;
+  stack = NULL;
+  stackLen = stackSize = 0;
+  startPass();
+  if (catObj.isDict()) {
+    catObj.dictLookup("AcroForm", &acroForm);
+    if (acroForm.isDict()) {
+      acroForm.dictLookup("Fields", &kids);
+      if (kids.isArray()) {
+	for (i = kids.arrayGetLength() - 1; i >= 0; --i) {
+	  kids.arrayGetNF(i, &kid);
+	  if (kid.isRef()) {
+	    if (stackLen == stackSize) {
+	      stackSize = stackSize ? 2 * stackSize : 64;
+	      stack = (int *)greallocn(stack, stackSize, sizeof(int));
+	    }
+	    stack[stackLen++] = kid.getRefNum();
+	  }
+	  kid.free();
+	}
+      }
+      kids.free();
+    }
+    acroForm.free();
+  }
+  while (stackLen > 0) {
+    num = stack[--stackLen];
+    if (num < 0 || num >= numObjects || reached[num] == pass) {
+      continue;
+    }
+    reached[num] = pass;
+    formFieldNums = (int *)greallocn(formFieldNums, nFormFieldNums + 1,
+				     sizeof(int));
+    formFieldNums[nFormFieldNums++] = num;
+    xref->fetch(num, 0, &obj);
+    if (obj.isDict()) {
+      obj.dictLookup("Kids", &kids);
+      if (kids.isArray()) {
+	for (i = kids.arrayGetLength() - 1; i >= 0; --i) {
+	  kids.arrayGetNF(i, &kid);
+	  if (kid.isRef()) {
+	    if (stackLen == stackSize) {
+	      stackSize = stackSize ? 2 * stackSize : 64;
+	      stack = (int *)greallocn(stack, stackSize, sizeof(int));
+	    }
+	    stack[stackLen++] = kid.getRefNum();
+	  }
+	  kid.free();
+	}
+      }
+      kids.free();
+    }
+    obj.free();
+  }
+  gfree(stack);
+  catObj.free();
+}
+
+void ExtractCache::getPageKey(int pg, ExtractCacheKey *key) {
+  SHA256State st;
+  Object pageObj, node, parent, obj;
+  Ref *ref;
+  int depth, i;
+
+  sha256Start(&st);
+  sha256AppendStr(&st, options->getCString(), options->getLength());
+  sha256AppendStr(&st, "page", 4);
+  sha256Append(&st, globalsHash, extractCacheKeyLen);
+  startPass();
+
+  ref = doc->getCatalog()->getPageRef(pg);
+  if (ref->num >= 0 && ref->num < numObjects) {
+    reached[ref->num] = pass;
+    objIDs[ref->num] = nextID++;
+    xref->fetch(ref->num, ref->gen, &pageObj);
+  } else {
+    pageObj.initNull();
+  }
+  hashObject(&st, &pageObj, "Parent");
+
+  // inherited attributes
+  if (pageObj.isDict()) {
+    for (i = 0; extractCacheInheritedKeys[i]; ++i) {
+      if (!pageObj.dictLookupNF(extractCacheInheritedKeys[i],
+				&obj)->isNull()) {
+	obj.free();
+	continue;
+      }
+      obj.free();
+      pageObj.dictLookup("Parent", &node);
+      for (depth = 0;
+	   node.isDict() && depth < extractCacheMaxTreeDepth;
+	   ++depth) {
+	if (!node.dictLookupNF(extractCacheInheritedKeys[i],
+			       &obj)->isNull()) {
+	  sha256AppendStr(&st, extractCacheInheritedKeys[i],
+			  (int)strlen(extractCacheInheritedKeys[i]));
+	  hashObject(&st, &obj, NULL);
+	  obj.free();
+	  break;
+	}
+	obj.free();
+	node.dictLookup("Parent", &parent);
+	node.free();
+	parent.copy(&node);
+	parent.free();
+      }
+      node.free();
+    }
+  }
+  pageObj.free();
+
+  hashQueued(&st);
+
+  // the order of the page's form fields
+  sha256AppendStr(&st, "fields", 6);
+  for (i = 0; i < nFormFieldNums; ++i) {
+    if (reached[formFieldNums[i]] == pass) {
+      sha256AppendInt(&st, objIDs[formFieldNums[i]]);
+    }
+  }
+
+  sha256Finish(&st);
+  memcpy(key->hash, st.digest, extractCacheKeyLen);
+}
+
+void ExtractCache::startPass() {
+  ++pass;
+  nextID = 0;
+  queueHead = queueLen = 0;
+}
+
+// Hash <obj>, a direct object.  Refs are hashed as the order in
+// which the objects were reached, and the objects are queued up to
+// be hashed later.  Entries named <skipKey> are left out of
+// dictionaries.
+void ExtractCache::hashObject(SHA256State *st, Object *obj,
+			      const char *skipKey) {
+  Object obj2;
+  Dict *dict;
+  Stream *str;
+  Guchar buf[4096];
+  double x;
+  int n, i;
+
+  switch (obj->getType()) {
+  case objBool:
+    sha256Append(st, (Guchar *)(obj->getBool() ? "t" : "f"), 1);
+    break;
+  case objInt:
+    sha256Append(st, (Guchar *)"i", 1);
+    sha256AppendInt(st, obj->getInt());
+    break;
+  case objReal:
+    sha256Append(st, (Guchar *)"r", 1);
+    x = obj->getReal();
+    sha256Append(st, (Guchar *)&x, sizeof(x));
+    break;
+  case objString:
+    sha256Append(st, (Guchar *)"s", 1);
+    sha256AppendStr(st, obj->getString()->getCString(),
+		    obj->getString()->getLength());
+    break;
+  case objName:
+    sha256Append(st, (Guchar *)"/", 1);
+    sha256AppendStr(st, obj->getName(), (int)strlen(obj->getName()));
+    break;
+  case objArray:
+    sha256Append(st, (Guchar *)"[", 1);
+    sha256AppendInt(st, obj->arrayGetLength());
+    for (i = 0; i < obj->arrayGetLength(); ++i) {
+      hashObject(st, obj->arrayGetNF(i, &obj2), NULL);
+      obj2.free();
+    }
+    break;
+  case objDict:
+  case objStream:
+    dict = obj->isDict() ? obj->getDict() : obj->streamGetDict();
+    sha256Append(st, (Guchar *)"<", 1);
+    sha256AppendInt(st, dict->getLength());
+    for (i = 0; i < dict->getLength(); ++i) {
+      if (skipKey && !strcmp(dict->getKey(i), skipKey)) {
+	continue;
+      }
+      sha256AppendStr(st, dict->getKey(i), (int)strlen(dict->getKey(i)));
+      hashObject(st, dict->getValNF(i, &obj2), NULL);
+      obj2.free();
+    }
+    // the raw (undecoded, possibly encrypted) stream data
+    if (obj->isStream()) {
+      sha256Append(st, (Guchar *)"S", 1);
+      str = obj->getStream()->getUndecodedStream();
+      str->reset();
+      while ((n = str->getBlock((char *)buf, sizeof(buf))) > 0) {
+	sha256Append(st, buf, n);
+      }
+      str->close();
+    }
+    break;
+  case objRef:
+    hashRef(st, obj->getRefNum(), obj->getRefGen());
+    break;
+  case objNull:
+  default:
+    sha256Append(st, (Guchar *)"n", 1);
+    break;
+  }
+}
+
+void ExtractCache::hashRef(SHA256State *st, int num, int gen) {
+  if (num < 0 || num >= numObjects) {
+    sha256Append(st, (Guchar *)"n", 1);
+    return;
+  }
+  if (reached[num] != pass) {
+    reached[num] = pass;
+    objIDs[num] = nextID++;
+    if (queueLen == queueSize) {
+      queueSize = queueSize ? 2 * queueSize : 64;
+      queue = (Ref *)greallocn(queue, queueSize, sizeof(Ref));
+    }
+    queue[queueLen].num = num;
+    queue[queueLen].gen = gen;
+    ++queueLen;
+  }
+  sha256Append(st, (Guchar *)"R", 1);
+  sha256AppendInt(st, objIDs[num]);
+}
+
+// Hash the queued objects, in the order they were reached.  Other
+// pages (e.g., link destinations) and page tree nodes are hashed as
+// a marker only: the page record doesn't depend on them.
+void ExtractCache::hashQueued(SHA256State *st) {
+  Object obj, type;
+  Ref ref;
+
+  while (queueHead < queueLen) {
+    ref = queue[queueHead++];
+    sha256Append(st, (Guchar *)"o", 1);
+    sha256AppendInt(st, objIDs[ref.num]);
+    xref->fetch(ref.num, ref.gen, &obj);
+    if (obj.isDict()) {
+      obj.dictLookupNF("Type", &type);
+      if (type.isName("Page") || type.isName("Pages")) {
+	sha256Append(st, (Guchar *)"p", 1);
+	type.free();
+	obj.free();
+	continue;
+      }
+      type.free();
+    }
+    hashObject(st, &obj, NULL);
+    obj.free();
+  }
+}
+
+// A page entry holds up to three parts: "json", "png" and "fullpng",
+// each as "<name> <length>\n<data>".
+GBool ExtractCache::lookupPage(ExtractCacheKey *key, GString **json,
+			       GString **png, GString **fullPng) {
+  GString *data, **part;
+  char name[16];
+  char *p, *end;
+  int len;
+
+  *json = *png = *fullPng = NULL;
+  if (!(data = readEntry(key, ".pg"))) {
+    return gFalse;
+  }
+  p = data->getCString();
+  end = p + data->getLength();
+  while (p < end) {
+    if (sscanf(p, "%15s %d", name, &len) != 2 || len < 0 ||
+	!(p = (char *)memchr(p, '\n', end - p)) || len > end - p - 1) {
+      goto err;
+    }
+    ++p;
+    if (!strcmp(name, "json")) {
+      part = json;
+    } else if (!strcmp(name, "png")) {
+      part = png;
+    } else if (!strcmp(name, "fullpng")) {
+      part = fullPng;
+    } else {
+      goto err;
+    }
+    if (*part) {
+      goto err;
+    }
+    *part = new GString(p, len);
+    p += len;
+  }
+  delete data;
+  if (!*json) {
+    goto err2;
+  }
+  return gTrue;
+
+ err:
+  delete data;
+ err2:
+  if (*json) {
+    delete *json;
+  }
+  if (*png) {
+    delete *png;
+  }
+  if (*fullPng) {
+    delete *fullPng;
+  }
+  *json = *png = *fullPng = NULL;
+  return gFalse;
+}
+
+void ExtractCache::storePage(ExtractCacheKey *key, GString *json,
+			     GString *png, GString *fullPng) {
+  GString *data;
+
+  data = GString::format("json {0:d}\n", json->getLength());
+  data->append(json);
+  if (png) {
+    data->appendf("png {0:d}\n", png->getLength());
+    data->append(png);
+  }
+  if (fullPng) {
+    data->appendf("fullpng {0:d}\n", fullPng->getLength());
+    data->append(fullPng);
+  }
+  writeEntry(key, ".pg", data);
+  delete data;
+}
@@ -0,0 +1,137 @@
+//========================================================================
+//
+// ExtractCache.h
+//
+// An on-disk cache of converted pages, for pdftojson.  Entries are
+// content-addressed: a document is found by the SHA-256 hash of its
+// file, and a page by the hash of everything its conversion depends on
+// (see getPageKey), so that identical pages in different files share
+// an entry.
+//
+//========================================================================
+
+#ifndef EXTRACTCACHE_H
+#define EXTRACTCACHE_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#include "gfile.h"
+#include "Object.h"
+
+class GString;
+class BaseStream;
+class PDFDoc;
+class XRef;
+struct SHA256State;
+
+//------------------------------------------------------------------------
+
+#define extractCacheKeyLen 32
+
+struct ExtractCacheKey {
+  Guchar hash[extractCacheKeyLen];
+};
+
+//------------------------------------------------------------------------
+// ExtractCache
+//------------------------------------------------------------------------
+
+class ExtractCache {
+public:
+
+  // Use the cache in directory <dirA> (created if needed), limited to
+  // <maxSizeA> bytes.  <optionsA> describes everything besides the
+  // PDF file that affects the output (conversion options, config
+  // file, etc.); it goes into every key, so that entries made with
+  // different options are kept apart.
+  ExtractCache(char *dirA, GFileOffset maxSizeA, GString *optionsA);
+
+  // If anything was added, evict the least recently used entries
+  // until the cache fits in its size limit.
+  ~ExtractCache();
+
+  GBool isOk() { return ok; }
+
+  //----- documents
+
+  // Compute the key for the PDF file in <str> (a file, or a
+  // MemStream).
+  void getDocKey(BaseStream *str, ExtractCacheKey *key);
+
+  // Look up a document.  On a hit, returns the number of pages, and
+  // the key of each page (an all-zero key for pages that were never
+  // converted); the caller must gfree <pageKeys>.
+  GBool lookupDoc(ExtractCacheKey *key, int *nPages,
+		  ExtractCacheKey **pageKeys);
+
+  void storeDoc(ExtractCacheKey *key, int nPages,
+		ExtractCacheKey *pageKeys);
+
+  //----- pages
+
+  // Set up for computing page keys for <docA>, whose key is <docKey>.
+  // Raw stream data in an encrypted file depends on the file's key,
+  // so the pages of an encrypted file are only shared with the same
+  // file.
+  void startDoc(PDFDoc *docA, ExtractCacheKey *docKey);
+
+  // Compute the key for page <pg>.  It covers the page object and
+  // everything reachable from it (contents, resources, annotations,
+  // and their form fields, with the raw stream data), the attributes
+  // the page inherits from the page tree, the order of its form
+  // fields, and the catalog entries that affect every page.  Object
+  // numbers are replaced by the order in which the objects are
+  // reached.
+  void getPageKey(int pg, ExtractCacheKey *key);
+
+  // Look up a page.  On a hit, returns the page record and, if they
+  // were stored, the two page images; the caller must delete them.
+  GBool lookupPage(ExtractCacheKey *key, GString **json,
+		   GString **png, GString **fullPng);
+
+  void storePage(ExtractCacheKey *key, GString *json,
+		 GString *png, GString *fullPng);
+
+  //----- utilities
+
+  static GBool isNullKey(ExtractCacheKey *key);
+
+private:
+
+  GString *getEntryPath(ExtractCacheKey *key, const char *ext);
+  GString *readEntry(ExtractCacheKey *key, const char *ext);
+  void writeEntry(ExtractCacheKey *key, const char *ext, GString *data);
+  void trim();
+  void hashObject(SHA256State *st, Object *obj, const char *skipKey);
+  void hashRef(SHA256State *st, int num, int gen);
+  void hashQueued(SHA256State *st);
+  void startPass();
+
+  GString *dir;
+  GFileOffset maxSize;
+  GString *options;
+  GBool stored;			// set once an entry has been written
+  GBool ok;
+
+  PDFDoc *doc;
+  XRef *xref;
+  int numObjects;
+  Guchar globalsHash[extractCacheKeyLen];
+  int *formFieldNums;		// the form field tree, in order
+  int nFormFieldNums;
+  int *reached;			// pass that last reached each object
+				//   [numObjects]
+  int *objIDs;			// order in which each object was
+				//   reached, in that pass [numObjects]
+  int pass;
+  int nextID;
+  Ref *queue;			// objects reached but not yet hashed
+  int queueHead, queueLen, queueSize;
+};
+
+#endif
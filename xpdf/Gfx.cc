@@ -37,6 +37,7 @@
 #include "OptionalContent.h"
 #include "Error.h"
 #include "TextString.h"
+#include "PerfCounters.h"
 #include "Gfx.h"
 
 // the MSVC math.h doesn't define this
@@ -685,11 +686,10 @@ void Gfx::go(GBool topLevel) {
   Object obj;
   Object args[maxArgs];
   int numArgs, i;
-  int lastAbortCheck, errCount;
+  int errCount;
 
   // scan a sequence of objects
   updateLevel = 1; // make sure even empty pages trigger a call to dump()
-  lastAbortCheck = 0;
   errCount = 0;
   numArgs = 0;
   parser->getObj(&obj);
@@ -709,6 +709,7 @@ void Gfx::go(GBool topLevel) {
       if (!execOp(&obj, args, numArgs)) {
 	++errCount;
       }
+      ++perfCounters.ops;
       obj.free();
       for (i = 0; i < numArgs; ++i)
 	args[i].free();
@@ -720,14 +721,10 @@ void Gfx::go(GBool topLevel) {
 	updateLevel = 0;
       }
 
-      // check for an abort
-      if (abortCheckCbk) {
-	if (updateLevel - lastAbortCheck > 10) {
-	  if ((*abortCheckCbk)(abortCheckCbkData)) {
-	    break;
-	  }
-	  lastAbortCheck = updateLevel;
-	}
+      // check for an abort -- after every operator, so that an
+      // operator limit in the callback is exact
+      if (abortCheckCbk && (*abortCheckCbk)(abortCheckCbkData)) {
+	break;
       }
 
       // check for too many errors
@@ -781,9 +778,38 @@ void Gfx::go(GBool topLevel) {
 }
 
 // Returns true if successful, false on error.
+// Trace category for the operators that do real work; the others
+// (path construction, graphics state, ...) are too cheap to be worth
+// a trace event each.
+static const char *getOpTraceCategory(const char *name) {
+  static const char *paintOps[] = {
+    "f", "F", "f*", "S", "s", "B", "B*", "b", "b*", NULL
+  };
+  static const char *textOps[] = {
+    "Tj", "TJ", "'", "\"", NULL
+  };
+  int i;
+
+  for (i = 0; paintOps[i]; ++i) {
+    if (!strcmp(name, paintOps[i])) {
+      return "paint";
+    }
+  }
+  for (i = 0; textOps[i]; ++i) {
+    if (!strcmp(name, textOps[i])) {
+      return "text";
+    }
+  }
+  if (!strcmp(name, "sh")) {
+    return "shading";
+  }
+  return NULL;
+}
+
 GBool Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   Operator *op;
   char *name;
+  const char *traceCat;
   Object *argPtr;
   int i;
 
@@ -831,7 +857,12 @@ GBool Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   }
 
   // do it
-  (this->*op->func)(argPtr, numArgs);
+  if (perfTraceEnabled && (traceCat = getOpTraceCategory(name))) {
+    PerfTraceScope trace(traceCat, name);
+    (this->*op->func)(argPtr, numArgs);
+  } else {
+    (this->*op->func)(argPtr, numArgs);
+  }
 
   return gTrue;
 }
@@ -1885,6 +1916,7 @@ void Gfx::doPatternImageMask(Object *ref, Stream *str, int width, int height,
 
 void Gfx::doTilingPatternFill(GfxTilingPattern *tPat,
 			      GBool stroke, GBool eoFill, GBool text) {
+  PerfTraceScope trace("gfx", "doTilingPatternFill");
   GfxPatternColorSpace *patCS;
   GfxColorSpace *cs;
   GfxState *savedState;
@@ -2083,6 +2115,7 @@ void Gfx::doTilingPatternFill(GfxTilingPattern *tPat,
 
 void Gfx::doShadingPatternFill(GfxShadingPattern *sPat,
 			       GBool stroke, GBool eoFill, GBool text) {
+  PerfTraceScope trace("gfx", "doShadingPatternFill");
   GfxShading *shading;
   GfxState *savedState;
   double *ctm, *btm, *ptm;
@@ -3012,6 +3045,10 @@ void Gfx::doGouraudTriangleShFill(GfxGouraudTriangleShading *shading) {
   int i;
 
   for (i = 0; i < shading->getNTriangles(); ++i) {
+    // large meshes can take a long time -- check for an abort
+    if (abortCheckCbk && !(i & 15) && (*abortCheckCbk)(abortCheckCbkData)) {
+      break;
+    }
     shading->getTriangle(i, &x0, &y0, color0,
 			 &x1, &y1, color1,
 			 &x2, &y2, color2);
@@ -3099,6 +3136,9 @@ void Gfx::doPatchMeshShFill(GfxPatchMeshShading *shading) {
     start = 0;
   }
   for (i = 0; i < shading->getNPatches(); ++i) {
+    if (abortCheckCbk && !(i & 15) && (*abortCheckCbk)(abortCheckCbkData)) {
+      break;
+    }
     fillPatch(shading->getPatch(i), shading, start);
   }
 }
@@ -3809,6 +3849,8 @@ void Gfx::opXObject(Object args[], int numArgs) {
 }
 
 void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
+  PerfTraceScope trace("gfx", "doImage", "obj",
+		       ref && ref->isRef() ? ref->getRefNum() : -1);
   Dict *dict, *maskDict;
   int width, height;
   int bits, maskBits;
@@ -3937,7 +3979,12 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
 
     // draw it
     } else {
-      if (state->getFillColorSpace()->getMode() == csPattern) {
+      ++perfCounters.images;
+      perfCounters.imagePixels += (long long)width * height;
+      if (abortCheckCbk && (*abortCheckCbk)(abortCheckCbkData)) {
+	// the caller is giving up on the page (e.g., it ran over an
+	// image budget) -- don't decode the image
+      } else if (state->getFillColorSpace()->getMode() == csPattern) {
 	doPatternImageMask(ref, str, width, height, invert, inlineImg,
 			   interpolate);
       } else {
@@ -4166,7 +4213,14 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
 
     // draw it
     } else {
-      if (haveSoftMask) {
+      ++perfCounters.images;
+      perfCounters.imagePixels += (long long)width * height;
+      if (abortCheckCbk && (*abortCheckCbk)(abortCheckCbkData)) {
+	// the caller is giving up on the page -- don't decode the image
+	if (haveSoftMask) {
+	  delete maskColorMap;
+	}
+      } else if (haveSoftMask) {
 	out->drawSoftMaskedImage(state, ref, str, width, height, colorMap,
 				 maskStr, maskWidth, maskHeight, maskColorMap,
 				 interpolate);
@@ -4201,6 +4255,8 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
 }
 
 void Gfx::doForm(Object *strRef, Object *str) {
+  PerfTraceScope trace("gfx", "doForm", "obj",
+		       strRef->isRef() ? strRef->getRefNum() : -1);
   Dict *dict;
   GBool transpGroup, isolated, knockout;
   GfxColorSpace *blendingColorSpace;
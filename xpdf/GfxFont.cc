@@ -23,6 +23,7 @@
 #endif
 #include "gmem.h"
 #include "Error.h"
+#include "PerfCounters.h"
 #include "Object.h"
 #include "Dict.h"
 #include "GlobalParams.h"
@@ -165,6 +166,8 @@ GfxFontLoc::~GfxFontLoc() {
 //------------------------------------------------------------------------
 
 GfxFont *GfxFont::makeFont(XRef *xref, char *tagA, Ref idA, Dict *fontDict) {
+  GMemTagScope memTag(gMemTagFont);
+  PerfTraceScope trace("font", "makeFont", "font", tagA);
   GString *nameA;
   Ref embFontIDA;
   GfxFontType typeA;
@@ -799,6 +802,7 @@ GfxFontLoc *GfxFont::getExternalFont(GString *path, int fontNum,
 }
 
 char *GfxFont::readEmbFontFile(XRef *xref, int *len) {
+  PerfTraceScope trace("font", "readEmbFontFile", "obj", embFontID.num);
   char *buf;
   Object obj1, obj2;
   Stream *str;
@@ -1975,6 +1979,7 @@ GString *GfxCIDFont::getCollection() {
 //------------------------------------------------------------------------
 
 GfxFontDict::GfxFontDict(XRef *xref, Ref *fontDictRef, Dict *fontDict) {
+  GMemTagScope memTag(gMemTagFont);
   int i;
   Object obj1, obj2;
   Ref r;
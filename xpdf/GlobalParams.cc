@@ -662,6 +662,8 @@ GlobalParams::GlobalParams(const char *cfgFileName) {
 
   initBuiltinFontTables();
 
+  configText = new GString();
+
   // scan the encoding in reverse because we want the lowest-numbered
   // index for each char name ('space' is encoded twice)
   macRomanReverseMap = new NameToCharCode();
@@ -976,6 +978,7 @@ void GlobalParams::parseFile(GString *fileName, FILE *f) {
 
   line = 1;
   while (getLine(buf, sizeof(buf) - 1, f)) {
+    configText->append(buf);
     parseLine(buf, fileName, line);
     ++line;
   }
@@ -1877,6 +1880,7 @@ GlobalParams::~GlobalParams() {
 
   delete macRomanReverseMap;
 
+  delete configText;
   delete baseDir;
   delete nameToUnicode;
   deleteGHash(cidToUnicodes, GString);
@@ -2323,6 +2327,36 @@ GString *GlobalParams::findCCFontFile(GString *collection) {
   return path;
 }
 
+static int cmpConfigKeyLines(const void *p1, const void *p2) {
+  return (*(GString **)p1)->cmp(*(GString **)p2);
+}
+
+GString *GlobalParams::getConfigKey() {
+  GString *key, *fontName;
+  Base14FontInfo *fi;
+  GHashIter *iter;
+  GList *lines;
+  int i;
+
+  lockGlobalParams;
+  key = configText->copy();
+  // GHash iteration order depends on the insertion history, so sort
+  lines = new GList();
+  base14SysFonts->startIter(&iter);
+  while (base14SysFonts->getNext(&iter, &fontName, (void **)&fi)) {
+    lines->append(GString::format("base14 {0:t} {1:t} {2:d} {3:.4g}\n",
+				  fontName, fi->fileName, fi->fontNum,
+				  fi->oblique));
+  }
+  unlockGlobalParams;
+  lines->sort(&cmpConfigKeyLines);
+  for (i = 0; i < lines->getLength(); ++i) {
+    key->append((GString *)lines->get(i));
+  }
+  deleteGList(lines, GString);
+  return key;
+}
+
 GString *GlobalParams::getPSFile() {
   GString *s;
 
@@ -198,6 +198,14 @@ public:
   GString *findSystemFontFile(GString *fontName, SysFontType *type,
 			      int *fontNum);
   GString *findCCFontFile(GString *collection);
+
+  // Returns a string that changes whenever a setting read from the
+  // config files, or a Base-14 font file found by setupBaseFonts,
+  // changes: the text of the config files (including files they
+  // include) and the Base-14 font paths.  Files the config names
+  // (fonts, CMaps, ...) are identified by path only.
+  GString *getConfigKey();
+
   GString *getPSFile();
   int getPSPaperWidth();
   int getPSPaperHeight();
@@ -368,6 +376,8 @@ private:
 
   //----- user-modifiable settings
 
+  GString *configText;		// text of the config files read, in the
+				//   order they were parsed
   GString *baseDir;		// base directory - for plugins, etc.
   NameToCharCode *		// mapping from char name to Unicode
     nameToUnicode;
@@ -0,0 +1,180 @@
+//========================================================================
+//
+// GzipWriter.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "gmem.h"
+#include "GzipWriter.h"
+
+//------------------------------------------------------------------------
+
+// Size of the input and output buffers.
+#define gzipBufSize (256 * 1024)
+
+// deflateInit2 window bits: 15, plus 16 for a gzip wrapper.
+#define gzipWindowBits (15 + 16)
+
+//------------------------------------------------------------------------
+// GzipWriter
+//------------------------------------------------------------------------
+
+GzipWriter::GzipWriter(FILE *fA, int level) {
+  f = fA;
+  memset(&zs, 0, sizeof(zs));
+  ok = deflateInit2(&zs, level, Z_DEFLATED, gzipWindowBits, 8,
+		    Z_DEFAULT_STRATEGY) == Z_OK;
+  buf = (char *)gmalloc(gzipBufSize);
+  bufLen = 0;
+  outBuf = (char *)gmalloc(gzipBufSize);
+  closed = !ok;
+#if MULTITHREADED
+  workBuf = (char *)gmalloc(gzipBufSize);
+  workLen = 0;
+  workFlush = Z_NO_FLUSH;
+  workReady = gFalse;
+  gInitMutex(&mutex);
+  gInitCond(&cond);
+  threadRunning = ok && gCreateThread(&thread, &compressThread, this);
+#endif
+}
+
+GzipWriter::~GzipWriter() {
+  if (!closed) {
+    close();
+  }
+#if MULTITHREADED
+  gDestroyCond(&cond);
+  gDestroyMutex(&mutex);
+  gfree(workBuf);
+#endif
+  gfree(buf);
+  gfree(outBuf);
+}
+
+int GzipWriter::writeFunc(void *stream, const char *data, int size) {
+  return ((GzipWriter *)stream)->write(data, size);
+}
+
+int GzipWriter::write(const char *data, int size) {
+  int n, left;
+
+  if (closed) {
+    return 0;
+  }
+  left = size;
+  while (left > 0) {
+    n = gzipBufSize - bufLen;
+    if (n > left) {
+      n = left;
+    }
+    memcpy(buf + bufLen, data, n);
+    bufLen += n;
+    data += n;
+    left -= n;
+    if (bufLen == gzipBufSize) {
+      handOff(Z_NO_FLUSH);
+    }
+  }
+  return ok ? size : 0;
+}
+
+void GzipWriter::flush() {
+  if (!closed) {
+    handOff(Z_SYNC_FLUSH);
+  }
+}
+
+GBool GzipWriter::close() {
+  if (closed) {
+    return ok;
+  }
+  handOff(Z_FINISH);
+#if MULTITHREADED
+  if (threadRunning) {
+    gJoinThread(thread);
+    threadRunning = gFalse;
+  }
+#endif
+  deflateEnd(&zs);
+  closed = gTrue;
+  return ok;
+}
+
+// Pass the buffered data to the compressor, and start a new buffer.
+// With multithreading, this waits for the thread to finish the
+// previous buffer, then swaps the two.
+void GzipWriter::handOff(int flushMode) {
+#if MULTITHREADED
+  char *tmp;
+
+  if (threadRunning) {
+    gLockMutex(&mutex);
+    while (workReady) {
+      gWaitCond(&cond, &mutex);
+    }
+    tmp = workBuf;
+    workBuf = buf;
+    buf = tmp;
+    workLen = bufLen;
+    workFlush = flushMode;
+    workReady = gTrue;
+    gSignalCond(&cond);
+    gUnlockMutex(&mutex);
+    bufLen = 0;
+    return;
+  }
+#endif
+  compress(buf, bufLen, flushMode);
+  bufLen = 0;
+}
+
+void GzipWriter::compress(char *data, int len, int flushMode) {
+  int n;
+
+  zs.next_in = (Bytef *)data;
+  zs.avail_in = len;
+  do {
+    zs.next_out = (Bytef *)outBuf;
+    zs.avail_out = gzipBufSize;
+    deflate(&zs, flushMode);
+    n = gzipBufSize - zs.avail_out;
+    if (n > 0 && (int)fwrite(outBuf, 1, n, f) != n) {
+      ok = gFalse;
+    }
+  } while (zs.avail_out == 0);
+  if (flushMode != Z_NO_FLUSH) {
+    fflush(f);
+  }
+}
+
+#if MULTITHREADED
+
+GThreadReturn gThreadCallConv GzipWriter::compressThread(void *arg) {
+  GzipWriter *gz = (GzipWriter *)arg;
+  int flushMode;
+
+  gLockMutex(&gz->mutex);
+  do {
+    while (!gz->workReady) {
+      gWaitCond(&gz->cond, &gz->mutex);
+    }
+    gUnlockMutex(&gz->mutex);
+    flushMode = gz->workFlush;
+    gz->compress(gz->workBuf, gz->workLen, flushMode);
+    gLockMutex(&gz->mutex);
+    gz->workReady = gFalse;
+    gSignalCond(&gz->cond);
+  } while (flushMode != Z_FINISH);
+  gUnlockMutex(&gz->mutex);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,82 @@
+//========================================================================
+//
+// GzipWriter.h
+//
+// Write a gzip-compressed stream to a file.  With multithreading
+// enabled, compression runs on a background thread, so it overlaps
+// with whatever the caller does between writes.
+//
+//========================================================================
+
+#ifndef GZIPWRITER_H
+#define GZIPWRITER_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include <zlib.h>
+#include "gtypes.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#include "GThread.h"
+#endif
+
+//------------------------------------------------------------------------
+// GzipWriter
+//------------------------------------------------------------------------
+
+class GzipWriter {
+public:
+
+  // Compress to <fA> at <level> (0-9, or -1 for the zlib default).
+  // The file is not closed by the writer.
+  GzipWriter(FILE *fA, int level);
+  ~GzipWriter();
+
+  GBool isOk() { return ok; }
+
+  // Append data to the stream.  Returns <size>, or 0 after an error.
+  int write(const char *data, int size);
+
+  // Compress and write out everything written so far, so a reader of
+  // the file can decompress it (a zlib sync flush).
+  void flush();
+
+  // Finish the stream.  Returns false if there was a write error.
+  GBool close();
+
+  // Callback for the JSONGen write functions.
+  static int writeFunc(void *stream, const char *data, int size);
+
+private:
+
+  void handOff(int flushMode);
+  void compress(char *data, int len, int flushMode);
+#if MULTITHREADED
+  static GThreadReturn gThreadCallConv compressThread(void *arg);
+#endif
+
+  FILE *f;
+  z_stream zs;
+  char *buf;			// data being written by the caller
+  int bufLen;
+  char *outBuf;			// compressed data
+  GBool ok;
+  GBool closed;
+#if MULTITHREADED
+  char *workBuf;		// data being compressed by the thread
+  int workLen;
+  int workFlush;		// zlib flush mode for workBuf
+  GBool workReady;		// set while workBuf is waiting/in use
+  GMutex mutex;
+  GCond cond;
+  GThreadID thread;
+  GBool threadRunning;
+#endif
+};
+
+#endif
@@ -72,8 +72,20 @@ public:
   // Read any leftover data in the stream.
   void cleanup();
 
-  // Decode one bit.
-  int decodeBit(Guint context, JArithmeticDecoderStats *stats);
+  // Decode one bit.  The common case (MPS without renormalization)
+  // is handled inline; everything else goes to decodeBitSlow.
+  int decodeBit(Guint context, JArithmeticDecoderStats *stats)
+  {
+    Guint cx, aa;
+
+    cx = stats->cxTab[context];
+    aa = a - qeTab[cx >> 1];
+    if ((aa & 0x80000000) && c < aa) {
+      a = aa;
+      return cx & 1;
+    }
+    return decodeBitSlow(context, stats);
+  }
 
   // Decode eight bits.
   int decodeByte(Guint context, JArithmeticDecoderStats *stats);
@@ -90,6 +102,7 @@ public:
 private:
 
   Guint readByte();
+  int decodeBitSlow(Guint context, JArithmeticDecoderStats *stats);
   int decodeIntBit(JArithmeticDecoderStats *stats);
   void byteIn();
 
@@ -14,8 +14,10 @@
 
 #include <stdlib.h>
 #include <limits.h>
+#include "gmem.h"
 #include "GList.h"
 #include "Error.h"
+#include "PerfCounters.h"
 #include "JArithmeticDecoder.h"
 #include "JBIG2Stream.h"
 
@@ -495,6 +497,9 @@ int JBIG2MMRDecoder::get2DCode() {
     p = &twoDimTab1[(buf >> 1) & 0x7f];
   } else if (bufLen == 8) {
     p = &twoDimTab1[(buf >> 1) & 0x7f];
+  } else if (bufLen > 8) {
+    // this can only happen after a bad white/black code
+    p = &twoDimTab1[(buf >> (bufLen - 7)) & 0x7f];
   } else {
     p = &twoDimTab1[(buf << (7 - bufLen)) & 0x7f];
     if (p->bits < 0 || p->bits > (int)bufLen) {
@@ -1196,6 +1201,9 @@ JBIG2Stream::~JBIG2Stream() {
 }
 
 void JBIG2Stream::reset() {
+  GMemTagScope memTag(gMemTagStream);
+  PerfTraceScope trace("stream", "JBIG2Stream::reset");
+
   // read the globals stream
   globalSegments = new GList();
   if (globalsStream.isStream()) {
@@ -2754,16 +2762,21 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 					    int *atx, int *aty,
 					    int mmrDataLength) {
   JBIG2Bitmap *bitmap;
-  GBool ltp;
-  Guint ltpCX, cx, cx0, cx1, cx2;
+  GBool ltp, nominal, atBuffered;
+  Guint ltpCX, cx, atCX, cxMask, f0, f1, n0, n1;
   int *refLine, *codingLine;
   int code1, code2, code3;
-  Guchar *p0, *p1, *p2, *pp;
-  Guchar *atP0, *atP1, *atP2, *atP3;
-  Guint buf0, buf1, buf2;
+  Guchar *p0, *p1, *pp, *ppEnd;
+  Guchar *atP[4];
+  Guint buf0, buf1, bits;
   Guint atBuf0, atBuf1, atBuf2, atBuf3;
+  Guint atMask[4], atCur[4];
+  Guint atMask0, atMask1, atMask2, atMask3;
+  Guint atCur0, atCur1, atCur2, atCur3;
+  Guchar mask0, mask1;
+  int atBit[4], atShift[4];
   int atShift0, atShift1, atShift2, atShift3;
-  Guchar mask;
+  int off0, off1, nAT, n;
   int x, y, x0, x1, a0i, b1i, blackPixels, pix, i;
 
   bitmap = new JBIG2Bitmap(0, w, h);
@@ -2936,16 +2949,29 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 	}
       }
 
-      // convert the run lengths to a bitmap line
-      i = 0;
-      while (1) {
-	for (x = codingLine[i]; x < codingLine[i+1]; ++x) {
-	  bitmap->setPixel(x, y);
+      // convert the run lengths to a bitmap line -- codingLine[0 ..
+      // a0i] are valid, with codingLine[a0i] = w, and the black runs
+      // are [codingLine[i], codingLine[i+1]) for even i
+      pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
+      for (i = 0; i < a0i; i += 2) {
+	x0 = codingLine[i];
+	x1 = codingLine[i+1];
+	if (x0 >= x1) {
+	  continue;
 	}
-	if (codingLine[i+1] >= w || codingLine[i+2] >= w) {
-	  break;
+	p0 = pp + (x0 >> 3);
+	ppEnd = pp + ((x1 - 1) >> 3);
+	mask0 = (Guchar)(0xff >> (x0 & 7));
+	mask1 = (Guchar)(0xff << (7 - ((x1 - 1) & 7)));
+	if (p0 == ppEnd) {
+	  *p0 |= mask0 & mask1;
+	} else {
+	  *p0++ |= mask0;
+	  while (p0 < ppEnd) {
+	    *p0++ = 0xff;
+	  }
+	  *p0 |= mask1;
 	}
-	i += 2;
       }
     }
 
@@ -2964,27 +2990,110 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
   //----- arithmetic decode
 
   } else {
-    // set up the typical row context
-    ltpCX = 0; // make gcc happy
-    if (tpgdOn) {
-      switch (templ) {
-      case 0:
-	ltpCX = 0x3953; // 001 11001 0101 0011
-	break;
-      case 1:
-	ltpCX = 0x079a; // 0011 11001 101 0
-	break;
-      case 2:
-	ltpCX = 0x0e3; // 001 1100 01 1
-	break;
-      case 3:
-	ltpCX = 0x18b; // 01100 0101 1
-	break;
+    // The context is built in the pixel order used by the JBIG2 spec:
+    // the pixels taken from each row form a contiguous bit field, with
+    // the leftmost pixel in the most significant bit.  Moving one
+    // pixel to the right is then a shift-and-mask of the context, plus
+    // the newly decoded pixel and one new pixel from each of the two
+    // previous rows.  Those rows are kept in rolling buffers, aligned
+    // (by off0/off1) so that the same fixed shift extracts the new
+    // pixels for every template.  If the AT pixels are in their
+    // nominal positions, they simply extend the row fields; otherwise
+    // they are ORed in separately for each pixel.
+    switch (templ) {
+    case 0:
+    default:
+      nominal = atx[0] == 3 && aty[0] == -1 && atx[1] == -3 && aty[1] == -1 &&
+	        atx[2] == 2 && aty[2] == -2 && atx[3] == -2 && aty[3] == -2;
+      ltpCX = 0x9b25;
+      nAT = 4;
+      atBit[0] = 4;  atBit[1] = 10;  atBit[2] = 11;  atBit[3] = 15;
+      off0 = 5;
+      off1 = 3;
+      if (nominal) {
+	cxMask = 0x7bf7;
+	f0 = 0xf800;  n0 = 0x0800;
+	f1 = 0x07f0;  n1 = 0x0010;
+      } else {
+	cxMask = 0x31e7;
+	f0 = 0x7000;  n0 = 0x1000;
+	f1 = 0x03e0;  n1 = 0x0020;
+      }
+      break;
+    case 1:
+      nominal = atx[0] == 3 && aty[0] == -1;
+      ltpCX = 0x0795;
+      nAT = 1;
+      atBit[0] = 3;
+      off0 = 3;
+      off1 = 2;
+      f0 = 0x1e00;  n0 = 0x0200;
+      if (nominal) {
+	cxMask = 0x0efb;
+	f1 = 0x01f8;  n1 = 0x0008;
+      } else {
+	cxMask = 0x0ef3;
+	f1 = 0x01f0;  n1 = 0x0010;
+      }
+      break;
+    case 2:
+      nominal = atx[0] == 2 && aty[0] == -1;
+      ltpCX = 0x00e5;
+      nAT = 1;
+      atBit[0] = 2;
+      off0 = 0;
+      off1 = 0;
+      f0 = 0x0380;  n0 = 0x0080;
+      if (nominal) {
+	cxMask = 0x01bd;
+	f1 = 0x007c;  n1 = 0x0004;
+      } else {
+	cxMask = 0x01b9;
+	f1 = 0x0078;  n1 = 0x0008;
+      }
+      break;
+    case 3:
+      nominal = atx[0] == 2 && aty[0] == -1;
+      ltpCX = 0x0195;
+      nAT = 1;
+      atBit[0] = 4;
+      off0 = 0;
+      off1 = 2;
+      f0 = n0 = 0; // template 3 doesn't use row y-2
+      if (nominal) {
+	cxMask = 0x01f7;
+	f1 = 0x03f0;  n1 = 0x0010;
+      } else {
+	cxMask = 0x01e7;
+	f1 = 0x03e0;  n1 = 0x0020;
+      }
+      break;
+    }
+
+    // AT pixels that aren't in their nominal positions are read from
+    // their own rolling buffers (pixel x in bit 23) if they are within
+    // 8 pixels of x, and from the bitmap otherwise
+    atBuffered = gTrue;
+    for (i = 0; i < 4; ++i) {
+      if (i < nAT) {
+	if (atx[i] < -8 || atx[i] > 8 || aty[i] > 0) {
+	  atBuffered = gFalse;
+	}
+	atShift[i] = 23 - atx[i] - atBit[i];
+	atMask[i] = 1 << atBit[i];
+	atCur[i] = aty[i] == 0 ? 0x800000 : 0;
+      } else {
+	atBit[i] = atShift[i] = 0;
+	atMask[i] = atCur[i] = 0;
       }
     }
+    atShift0 = atShift[0];  atMask0 = atMask[0];  atCur0 = atCur[0];
+    atShift1 = atShift[1];  atMask1 = atMask[1];  atCur1 = atCur[1];
+    atShift2 = atShift[2];  atMask2 = atMask[2];  atCur2 = atCur[2];
+    atShift3 = atShift[3];  atMask3 = atMask[3];  atCur3 = atCur[3];
+    atBuf0 = atBuf1 = atBuf2 = atBuf3 = 0; // make gcc happy
 
     ltp = 0;
-    cx = cx0 = cx1 = cx2 = 0; // make gcc happy
     for (y = 0; y < h; ++y) {
 
       // check for a "typical" (duplicate) row
@@ -3000,503 +3109,129 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 	}
       }
 
-      switch (templ) {
-      case 0:
-
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	  if (y >= 2) {
-	    p0 = bitmap->getDataPtr() + (y - 2) * bitmap->getLineSize();
-	    buf0 = *p0++ << 8;
+      // set up the row buffers and the context for x = 0
+      pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
+      if (y >= 1) {
+	p1 = pp - bitmap->getLineSize();
+	buf1 = *p1++ << (8 + off1);
+      } else {
+	p1 = NULL;
+	buf1 = 0;
+      }
+      if (y >= 2) {
+	p0 = pp - 2 * bitmap->getLineSize();
+	buf0 = *p0++ << (8 + off0);
+      } else {
+	p0 = NULL;
+	buf0 = 0;
+      }
+      cx = ((buf0 >> 7) & f0) | ((buf1 >> 11) & f1);
+      if (!nominal && atBuffered) {
+	for (i = 0; i < 4; ++i) {
+	  if (i < nAT && y + aty[i] >= 0) {
+	    atP[i] = bitmap->getDataPtr() + (y + aty[i]) * bitmap->getLineSize();
 	  } else {
-	    p0 = NULL;
-	    buf0 = 0;
+	    atP[i] = NULL;
 	  }
-	} else {
-	  p1 = p0 = NULL;
-	  buf1 = buf0 = 0;
 	}
-
-	if (atx[0] >= -8 && atx[0] <= 8 &&
-	    atx[1] >= -8 && atx[1] <= 8 &&
-	    atx[2] >= -8 && atx[2] <= 8 &&
-	    atx[3] >= -8 && atx[3] <= 8) {
-	  // set up the adaptive context
-	  if (y + aty[0] >= 0) {
-	    atP0 = bitmap->getDataPtr() + (y + aty[0]) * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = NULL;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
-	  if (y + aty[1] >= 0) {
-	    atP1 = bitmap->getDataPtr() + (y + aty[1]) * bitmap->getLineSize();
-	    atBuf1 = *atP1++ << 8;
-	  } else {
-	    atP1 = NULL;
-	    atBuf1 = 0;
-	  }
-	  atShift1 = 15 - atx[1];
-	  if (y + aty[2] >= 0) {
-	    atP2 = bitmap->getDataPtr() + (y + aty[2]) * bitmap->getLineSize();
-	    atBuf2 = *atP2++ << 8;
-	  } else {
-	    atP2 = NULL;
-	    atBuf2 = 0;
+	atBuf0 = atP[0] ? *atP[0]++ << 16 : 0;
+	atBuf1 = atP[1] ? *atP[1]++ << 16 : 0;
+	atBuf2 = atP[2] ? *atP[2]++ << 16 : 0;
+	atBuf3 = atP[3] ? *atP[3]++ << 16 : 0;
+      }
+
+      // decode the row
+      for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
+	n = w - x0 < 8 ? w - x0 : 8;
+	if (x0 + 8 < w) {
+	  if (p0) {
+	    buf0 |= *p0++ << off0;
 	  }
-	  atShift2 = 15 - atx[2];
-	  if (y + aty[3] >= 0) {
-	    atP3 = bitmap->getDataPtr() + (y + aty[3]) * bitmap->getLineSize();
-	    atBuf3 = *atP3++ << 8;
-	  } else {
-	    atP3 = NULL;
-	    atBuf3 = 0;
-	  }
-	  atShift3 = 15 - atx[3];
-
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
-	      }
-	      if (atP1) {
-		atBuf1 |= *atP1++;
-	      }
-	      if (atP2) {
-		atBuf2 |= *atP2++;
-	      }
-	      if (atP3) {
-		atBuf3 |= *atP3++;
-	      }
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx0 << 13) | (cx1 << 8) | (cx2 << 4) |
-		   (((atBuf0 >> atShift0) & 1) << 3) |
-		   (((atBuf1 >> atShift1) & 1) << 2) |
-		   (((atBuf2 >> atShift2) & 1) << 1) |
-		   ((atBuf3 >> atShift3) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		  if (aty[1] == 0) {
-		    atBuf1 |= 0x8000;
-		  }
-		  if (aty[2] == 0) {
-		    atBuf2 |= 0x8000;
-		  }
-		  if (aty[3] == 0) {
-		    atBuf3 |= 0x8000;
-		  }
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
-	      atBuf1 <<= 1;
-	      atBuf2 <<= 1;
-	      atBuf3 <<= 1;
-	    }
-	  }
-
-	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx0 << 13) | (cx1 << 8) | (cx2 << 4) |
-		   (bitmap->getPixel(x + atx[0], y + aty[0]) << 3) |
-		   (bitmap->getPixel(x + atx[1], y + aty[1]) << 2) |
-		   (bitmap->getPixel(x + atx[2], y + aty[2]) << 1) |
-		   bitmap->getPixel(x + atx[3], y + aty[3]);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	    }
+	  if (p1) {
+	    buf1 |= *p1++ << off1;
 	  }
 	}
-	break;
 
-      case 1:
-
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	  if (y >= 2) {
-	    p0 = bitmap->getDataPtr() + (y - 2) * bitmap->getLineSize();
-	    buf0 = *p0++ << 8;
-	  } else {
-	    p0 = NULL;
-	    buf0 = 0;
-	  }
-	} else {
-	  p1 = p0 = NULL;
-	  buf1 = buf0 = 0;
-	}
-
-	if (atx[0] >= -8 && atx[0] <= 8) {
-	  // set up the adaptive context
-	  if (y + aty[0] >= 0) {
-	    atP0 = bitmap->getDataPtr() + (y + aty[0]) * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = NULL;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
-
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
-	      }
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 13) & 0x0f;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x07;
-	      cx = (cx0 << 9) | (cx1 << 4) | (cx2 << 1) |
-		   ((atBuf0 >> atShift0) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
+	if (nominal) {
+	  bits = 0;
+	  for (x1 = 0; x1 < n; ++x1, ++x) {
+	    if (useSkip && skip->getPixel(x, y)) {
+	      pix = 0;
+	    } else {
+	      pix = arithDecoder->decodeBit(cx, genericRegionStats);
 	    }
+	    bits = (bits << 1) | pix;
+	    buf0 <<= 1;
+	    buf1 <<= 1;
+	    cx = ((cx & cxMask) << 1) | pix |
+		 ((buf0 >> 7) & n0) | ((buf1 >> 11) & n1);
 	  }
+	  *pp = (Guchar)(bits << (8 - n));
 
-	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 13) & 0x0f;
-	      cx1 = (buf1 >> 13) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x07;
-	      cx = (cx0 << 9) | (cx1 << 4) | (cx2 << 1) |
-		   bitmap->getPixel(x + atx[0], y + aty[0]);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	    }
-	  }
-	}
-	break;
-
-      case 2:
-
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	  if (y >= 2) {
-	    p0 = bitmap->getDataPtr() + (y - 2) * bitmap->getLineSize();
-	    buf0 = *p0++ << 8;
-	  } else {
-	    p0 = NULL;
-	    buf0 = 0;
-	  }
-	} else {
-	  p1 = p0 = NULL;
-	  buf1 = buf0 = 0;
-	}
-
-	if (atx[0] >= -8 && atx[0] <= 8) {
-	  // set up the adaptive context
-	  if (y + aty[0] >= 0) {
-	    atP0 = bitmap->getDataPtr() + (y + aty[0]) * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = NULL;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
-
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
-	      }
+	} else if (atBuffered) {
+	  if (x0 + 8 < w) {
+	    if (atP[0]) {
+	      atBuf0 |= *atP[0]++ << 8;
 	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 14) & 0x0f;
-	      cx2 = (buf2 >> 16) & 0x03;
-	      cx = (cx0 << 7) | (cx1 << 3) | (cx2 << 1) |
-		   ((atBuf0 >> atShift0) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
+	    if (atP[1]) {
+	      atBuf1 |= *atP[1]++ << 8;
 	    }
-	  }
-
-	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p0) {
-		buf0 |= *p0++;
-	      }
-	      if (p1) {
-		buf1 |= *p1++;
-	      }
-	      buf2 |= *p2++;
+	    if (atP[2]) {
+	      atBuf2 |= *atP[2]++ << 8;
 	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx0 = (buf0 >> 14) & 0x07;
-	      cx1 = (buf1 >> 14) & 0x0f;
-	      cx2 = (buf2 >> 16) & 0x03;
-	      cx = (cx0 << 7) | (cx1 << 3) | (cx2 << 1) |
-		   bitmap->getPixel(x + atx[0], y + aty[0]);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
-	      }
-
-	      // update the context
-	      buf0 <<= 1;
-	      buf1 <<= 1;
-	      buf2 <<= 1;
+	    if (atP[3]) {
+	      atBuf3 |= *atP[3]++ << 8;
 	    }
 	  }
-	}
-	break;
-
-      case 3:
-
-	// set up the context
-	p2 = pp = bitmap->getDataPtr() + y * bitmap->getLineSize();
-	buf2 = *p2++ << 8;
-	if (y >= 1) {
-	  p1 = bitmap->getDataPtr() + (y - 1) * bitmap->getLineSize();
-	  buf1 = *p1++ << 8;
-	} else {
-	  p1 = NULL;
-	  buf1 = 0;
-	}
-
-	if (atx[0] >= -8 && atx[0] <= 8) {
-	  // set up the adaptive context
-	  if (y + aty[0] >= 0) {
-	    atP0 = bitmap->getDataPtr() + (y + aty[0]) * bitmap->getLineSize();
-	    atBuf0 = *atP0++ << 8;
-	  } else {
-	    atP0 = NULL;
-	    atBuf0 = 0;
-	  }
-	  atShift0 = 15 - atx[0];
-
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p1) {
-		buf1 |= *p1++;
+	  bits = 0;
+	  for (x1 = 0; x1 < n; ++x1, ++x) {
+	    if (useSkip && skip->getPixel(x, y)) {
+	      pix = 0;
+	    } else {
+	      atCX = cx | ((atBuf0 >> atShift0) & atMask0) |
+		          ((atBuf1 >> atShift1) & atMask1) |
+		          ((atBuf2 >> atShift2) & atMask2) |
+		          ((atBuf3 >> atShift3) & atMask3);
+	      if ((pix = arithDecoder->decodeBit(atCX, genericRegionStats))) {
+		atBuf0 |= atCur0;
+		atBuf1 |= atCur1;
+		atBuf2 |= atCur2;
+		atBuf3 |= atCur3;
 	      }
-	      buf2 |= *p2++;
-	      if (atP0) {
-		atBuf0 |= *atP0++;
-	      }
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx1 = (buf1 >> 14) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx1 << 5) | (cx2 << 1) |
-		   ((atBuf0 >> atShift0) & 1);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		  if (aty[0] == 0) {
-		    atBuf0 |= 0x8000;
-		  }
-		}
-	      }
-
-	      // update the context
-	      buf1 <<= 1;
-	      buf2 <<= 1;
-	      atBuf0 <<= 1;
 	    }
+	    bits = (bits << 1) | pix;
+	    buf0 <<= 1;
+	    buf1 <<= 1;
+	    atBuf0 <<= 1;
+	    atBuf1 <<= 1;
+	    atBuf2 <<= 1;
+	    atBuf3 <<= 1;
+	    cx = ((cx & cxMask) << 1) | pix |
+		 ((buf0 >> 7) & n0) | ((buf1 >> 11) & n1);
 	  }
+	  *pp = (Guchar)(bits << (8 - n));
 
 	} else {
-	  // decode the row
-	  for (x0 = 0, x = 0; x0 < w; x0 += 8, ++pp) {
-	    if (x0 + 8 < w) {
-	      if (p1) {
-		buf1 |= *p1++;
+	  // AT pixels may be read from this row, so each pixel is
+	  // written to the bitmap as soon as it's decoded
+	  for (x1 = 0; x1 < n; ++x1, ++x) {
+	    if (useSkip && skip->getPixel(x, y)) {
+	      pix = 0;
+	    } else {
+	      atCX = cx;
+	      for (i = 0; i < nAT; ++i) {
+		atCX |= bitmap->getPixel(x + atx[i], y + aty[i]) << atBit[i];
 	      }
-	      buf2 |= *p2++;
-	    }
-	    for (x1 = 0, mask = 0x80; x1 < 8 && x < w; ++x1, ++x, mask >>= 1) {
-
-	      // build the context
-	      cx1 = (buf1 >> 14) & 0x1f;
-	      cx2 = (buf2 >> 16) & 0x0f;
-	      cx = (cx1 << 5) | (cx2 << 1) |
-		   bitmap->getPixel(x + atx[0], y + aty[0]);
-
-	      // check for a skipped pixel
-	      if (!(useSkip && skip->getPixel(x, y))) {
-
-		// decode the pixel
-		if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-		  *pp |= mask;
-		  buf2 |= 0x8000;
-		}
+	      if ((pix = arithDecoder->decodeBit(atCX, genericRegionStats))) {
+		*pp |= 0x80 >> x1;
 	      }
-
-	      // update the context
-	      buf1 <<= 1;
-	      buf2 <<= 1;
 	    }
+	    buf0 <<= 1;
+	    buf1 <<= 1;
+	    cx = ((cx & cxMask) << 1) | pix |
+		 ((buf0 >> 7) & n0) | ((buf1 >> 11) & n1);
 	  }
 	}
-	break;
       }
     }
   }
@@ -13,8 +13,14 @@
 #endif
 
 #include <limits.h>
+#include <string.h>
 #include "gmem.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#include "GThread.h"
+#endif
 #include "Error.h"
+#include "PerfCounters.h"
 #include "JArithmeticDecoder.h"
 #include "JPXStream.h"
 
@@ -157,6 +163,20 @@ static Guint signContext[5][5][2] = {
 // in the IDWT
 #define fracBits 24
 
+// number of rows (or columns) that go through the IDWT together: they
+// are interleaved in the tile-comp buffer, so each lifting step runs
+// over all of them at once (which the compiler can vectorize), and the
+// column transform reads runs of adjacent samples from each row
+#define jpxIDWTLanes 8
+
+// copy element <src> to element <dst> in an interleaved IDWT buffer
+#define jpxCopyLanes(data, dst, src)					\
+  memcpy((data) + (dst) * jpxIDWTLanes, (data) + (src) * jpxIDWTLanes,	\
+	 jpxIDWTLanes * sizeof(int))
+
+// max number of worker threads used to decode one image
+#define jpxMaxThreads 16
+
 //------------------------------------------------------------------------
 
 // floor(x / y)
@@ -224,6 +244,83 @@ JPXCover jpxCover(150);
 
 #endif //----- coverage tracking
 
+//------------------------------------------------------------------------
+// worker threads
+//------------------------------------------------------------------------
+
+typedef void (*JPXTaskFunc)(void *data, int idx);
+
+#if MULTITHREADED
+
+struct JPXTaskQueue {
+  JPXTaskFunc func;
+  void *data;
+  int nTasks;
+  int nextTask;
+  GMutex mutex;
+};
+
+static GThreadReturn gThreadCallConv jpxWorker(void *arg) {
+  JPXTaskQueue *queue = (JPXTaskQueue *)arg;
+  int idx;
+
+  while (1) {
+    gLockMutex(&queue->mutex);
+    idx = queue->nextTask++;
+    gUnlockMutex(&queue->mutex);
+    if (idx >= queue->nTasks) {
+      break;
+    }
+    (*queue->func)(queue->data, idx);
+  }
+  return 0;
+}
+
+#endif
+
+// Run func(data, 0) ... func(data, nTasks - 1).  With multithreading
+// enabled, the tasks are handed out to worker threads (including the
+// calling thread) as they become free; otherwise they're run in order.
+static void jpxRunTasks(JPXTaskFunc func, void *data, int nTasks) {
+  int i;
+#if MULTITHREADED
+  JPXTaskQueue queue;
+  GThreadID threads[jpxMaxThreads];
+  int nThreads;
+
+  nThreads = gGetNumCPUs();
+  if (nThreads > jpxMaxThreads) {
+    nThreads = jpxMaxThreads;
+  }
+  if (nThreads > nTasks) {
+    nThreads = nTasks;
+  }
+  if (nThreads > 1) {
+    queue.func = func;
+    queue.data = data;
+    queue.nTasks = nTasks;
+    queue.nextTask = 0;
+    gInitMutex(&queue.mutex);
+    for (i = 1; i < nThreads; ++i) {
+      if (!gCreateThread(&threads[i], &jpxWorker, &queue)) {
+	break;
+      }
+    }
+    nThreads = i;
+    jpxWorker(&queue);
+    for (i = 1; i < nThreads; ++i) {
+      gJoinThread(threads[i]);
+    }
+    gDestroyMutex(&queue.mutex);
+    return;
+  }
+#endif
+
+  for (i = 0; i < nTasks; ++i) {
+    (*func)(data, i);
+  }
+}
+
 //------------------------------------------------------------------------
 
 JPXStream::JPXStream(Stream *strA):
@@ -235,6 +332,7 @@ JPXStream::JPXStream(Stream *strA):
   bpc = NULL;
   width = height = 0;
   reduction = 0;
+  maxReduction = -1;
   haveCS = gFalse;
 
   palette.bpc = NULL;
@@ -265,6 +363,9 @@ JPXStream::~JPXStream() {
 }
 
 void JPXStream::reset() {
+  GMemTagScope memTag(gMemTagStream);
+  PerfTraceScope trace("stream", "JPXStream::reset");
+
   bufStr->reset();
   if (readBoxes() == jpxDecodeFatalError) {
     // readBoxes reported an error, so we go immediately to EOF
@@ -330,6 +431,8 @@ void JPXStream::close() {
 			for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
 			  cb = &subband->cbs[k];
 			  gfree(cb->dataLen);
+			  gfree(cb->segData);
+			  gfree(cb->segInfo);
 			  gfree(cb->touched);
 			  if (cb->arithDecoder) {
 			    delete cb->arithDecoder;
@@ -400,7 +503,7 @@ int JPXStream::lookChar() {
 
 void JPXStream::fillReadBuf() {
   JPXTileComp *tileComp;
-  Guint tileIdx, tx, ty;
+  Guint tileIdx, tileX, tileY, tileX0, tileY0, tx, ty;
   int pix, pixBits, k;
   GBool eol;
 
@@ -408,15 +511,32 @@ void JPXStream::fillReadBuf() {
     if (curY >= img.ySizeR) {
       return;
     }
-    tileIdx = ((curY - img.yTileOffsetR) / img.yTileSizeR) * img.nXTiles
-              + (curX - img.xTileOffsetR) / img.xTileSizeR;
+    tileX = (curX - img.xTileOffsetR) / img.xTileSizeR;
+    tileY = (curY - img.yTileOffsetR) / img.yTileSizeR;
+    tileIdx = tileY * img.nXTiles + tileX;
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
     tileComp = &img.tiles[tileIdx].tileComps[curComp];
 #else
     tileComp = &img.tiles[tileIdx].tileComps[havePalette ? 0 : curComp];
 #endif
-    tx = jpxCeilDiv((curX - img.xTileOffsetR) % img.xTileSizeR, tileComp->hSep);
-    ty = jpxCeilDiv((curY - img.yTileOffsetR) % img.yTileSizeR, tileComp->vSep);
+    // the first tile row/column starts at the image offset, which may
+    // be inside the tile grid cell
+    tileX0 = img.xTileOffsetR + tileX * img.xTileSizeR;
+    if (tileX0 < img.xOffsetR) {
+      tileX0 = img.xOffsetR;
+    }
+    tileY0 = img.yTileOffsetR + tileY * img.yTileSizeR;
+    if (tileY0 < img.yOffsetR) {
+      tileY0 = img.yOffsetR;
+    }
+    tx = jpxCeilDiv(curX - tileX0, tileComp->hSep);
+    ty = jpxCeilDiv(curY - tileY0, tileComp->vSep);
+    if (tx >= tileComp->w) {
+      tx = tileComp->w - 1;
+    }
+    if (ty >= tileComp->h) {
+      ty = tileComp->h - 1;
+    }
     pix = (int)tileComp->data[ty * tileComp->w + tx];
     pixBits = tileComp->prec;
     eol = gFalse;
@@ -527,7 +647,11 @@ void JPXStream::getImageParams(int *bitsPerComponent,
 	}
       } else if (boxType == 0x6A703263) { // codestream
 	cover(3);
-	if (!(haveBPC && haveCSMode)) {
+	if (haveBPC && haveCSMode) {
+	  // still need to scan the codestream header for maxReduction
+	  csMode1 = *csMode;
+	  getImageParams2(&dummy2, &csMode1);
+	} else {
 	  getImageParams2(bitsPerComponent, csMode);
 	}
 	break;
@@ -540,20 +664,27 @@ void JPXStream::getImageParams(int *bitsPerComponent,
   bufStr->close();
 }
 
-// Get image parameters from the codestream.
+// Get image parameters from the codestream.  This also scans the
+// rest of the main header for COD/COC segments, to find the number
+// of decomposition levels, which (along with the image offset) limits
+// reduceResolution.
 void JPXStream::getImageParams2(int *bitsPerComponent,
 				StreamColorSpaceMode *csMode) {
   int segType;
-  Guint segLen, nComps1, bpc1, dummy;
+  Guint segLen, nComps1, bpc1, xOffset1, yOffset1, nDecompLevels1, dummy;
+  int minDecompLevels;
 
+  nComps1 = 0;
+  xOffset1 = yOffset1 = 0;
+  minDecompLevels = -1;
   while (readMarkerHdr(&segType, &segLen)) {
     if (segType == 0x51) { // SIZ - image and tile size
       cover(5);
       if (readUWord(&dummy) &&
 	  readULong(&dummy) &&
 	  readULong(&dummy) &&
-	  readULong(&dummy) &&
-	  readULong(&dummy) &&
+	  readULong(&xOffset1) &&
+	  readULong(&yOffset1) &&
 	  readULong(&dummy) &&
 	  readULong(&dummy) &&
 	  readULong(&dummy) &&
@@ -569,7 +700,39 @@ void JPXStream::getImageParams2(int *bitsPerComponent,
 	} else if (nComps1 == 4) {
 	  *csMode = streamCSDeviceCMYK;
 	}
+      } else {
+	break;
+      }
+      if (segLen > 2 + 37) {
+	bufStr->discardChars(segLen - 2 - 37);
       }
+    } else if (segType == 0x52) { // COD - coding style default
+      if (!readUByte(&dummy) ||
+	  !readUByte(&dummy) ||
+	  !readUWord(&dummy) ||
+	  !readUByte(&dummy) ||
+	  !readUByte(&nDecompLevels1)) {
+	break;
+      }
+      if (minDecompLevels < 0 || (int)nDecompLevels1 < minDecompLevels) {
+	minDecompLevels = (int)nDecompLevels1;
+      }
+      if (segLen > 2 + 6) {
+	bufStr->discardChars(segLen - 2 - 6);
+      }
+    } else if (segType == 0x53) { // COC - coding style component
+      if (!(nComps1 > 256 ? readUWord(&dummy) : readUByte(&dummy)) ||
+	  !readUByte(&dummy) ||
+	  !readUByte(&nDecompLevels1)) {
+	break;
+      }
+      if (minDecompLevels < 0 || (int)nDecompLevels1 < minDecompLevels) {
+	minDecompLevels = (int)nDecompLevels1;
+      }
+      if (segLen > 2 + (nComps1 > 256 ? 4 : 3)) {
+	bufStr->discardChars(segLen - 2 - (nComps1 > 256 ? 4 : 3));
+      }
+    } else if (segType == 0x90) { // SOT - start of tile
       break;
     } else {
       cover(6);
@@ -578,6 +741,31 @@ void JPXStream::getImageParams2(int *bitsPerComponent,
       }
     }
   }
+  // the reduced image is (xSize >> reduction) - (xOffset >> reduction)
+  // pixels wide, which only matches the caller's (width >> reduction)
+  // if the offset is a multiple of 2^reduction
+  maxReduction = minDecompLevels < 0 ? 0 : minDecompLevels;
+  while (maxReduction > 0 &&
+	 ((xOffset1 | yOffset1) & ((1 << maxReduction) - 1))) {
+    --maxReduction;
+  }
+}
+
+void JPXStream::reduceResolution(int reductionA) {
+  int bitsPerComponent;
+  StreamColorSpaceMode csMode;
+
+  if (reductionA <= 0) {
+    reduction = 0;
+    return;
+  }
+  if (maxReduction < 0) {
+    getImageParams(&bitsPerComponent, &csMode);
+  }
+  if (reductionA > maxReduction) {
+    reductionA = maxReduction;
+  }
+  reduction = reductionA < 0 ? 0 : reductionA;
 }
 
 JPXDecodeResult JPXStream::readBoxes() {
@@ -884,7 +1072,6 @@ GBool JPXStream::readColorSpecBox(Guint dataLen) {
 
 JPXDecodeResult JPXStream::readCodestream(Guint len) {
   JPXTile *tile;
-  JPXTileComp *tileComp;
   int segType;
   GBool haveSIZ, haveCOD, haveQCD, haveSOT, ok;
   Guint precinctSize, style;
@@ -1015,6 +1202,7 @@ JPXDecodeResult JPXStream::readCodestream(Guint len) {
 	return jpxDecodeFatalError;
       }
       if (img.tiles[0].tileComps[0].nDecompLevels > 32 ||
+	  img.tiles[0].tileComps[0].nDecompLevels < (Guint)reduction ||
 	  img.tiles[0].tileComps[0].codeBlockW > 8 ||
 	  img.tiles[0].tileComps[0].codeBlockH > 8) {
 	error(errSyntaxError, getPos(), "Error in JPX COD marker segment");
@@ -1109,6 +1297,7 @@ JPXDecodeResult JPXStream::readCodestream(Guint len) {
 	return jpxDecodeFatalError;
       }
       if (img.tiles[0].tileComps[comp].nDecompLevels > 32 ||
+	  img.tiles[0].tileComps[comp].nDecompLevels < (Guint)reduction ||
 	  img.tiles[0].tileComps[comp].codeBlockW > 8 ||
 	  img.tiles[0].tileComps[comp].codeBlockH > 8) {
 	error(errSyntaxError, getPos(), "Error in JPX COC marker segment");
@@ -1474,13 +1663,9 @@ JPXDecodeResult JPXStream::readCodestream(Guint len) {
       error(errSyntaxError, getPos(), "Uninitialized tile in JPX codestream");
       return jpxDecodeFatalError;
     }
-    for (comp = 0; comp < img.nComps; ++comp) {
-      tileComp = &tile->tileComps[comp];
-      inverseTransform(tileComp);
-    }
-    if (!inverseMultiCompAndDC(tile)) {
-      return jpxDecodeFatalError;
-    }
+  }
+  if (!decodeTiles()) {
+    return jpxDecodeFatalError;
   }
 
   //~ can free memory below tileComps here, and also tileComp.buf
@@ -1550,6 +1735,7 @@ GBool JPXStream::readTilePart() {
 	return gFalse;
       }
       if (img.tiles[tileIdx].tileComps[0].nDecompLevels > 32 ||
+	  img.tiles[tileIdx].tileComps[0].nDecompLevels < (Guint)reduction ||
 	  img.tiles[tileIdx].tileComps[0].codeBlockW > 8 ||
 	  img.tiles[tileIdx].tileComps[0].codeBlockH > 8) {
 	error(errSyntaxError, getPos(), "Error in JPX COD marker segment");
@@ -1631,6 +1817,8 @@ GBool JPXStream::readTilePart() {
 	return gFalse;
       }
       if (img.tiles[tileIdx].tileComps[comp].nDecompLevels > 32 ||
+	  img.tiles[tileIdx].tileComps[comp].nDecompLevels
+	    < (Guint)reduction ||
 	  img.tiles[tileIdx].tileComps[comp].codeBlockW > 8 ||
 	  img.tiles[tileIdx].tileComps[comp].codeBlockH > 8) {
 	error(errSyntaxError, getPos(), "Error in JPX COD marker segment");
@@ -1926,7 +2114,8 @@ GBool JPXStream::readTilePart() {
       } else {
 	n = tileComp->y1 - tileComp->y0;
       }
-      tileComp->buf = (int *)gmallocn(n + 8, sizeof(int));
+      tileComp->buf = (int *)gmallocn(n + 8, jpxIDWTLanes * sizeof(int));
+      memset(tileComp->buf, 0, (n + 8) * jpxIDWTLanes * sizeof(int));
       for (r = 0; r <= tileComp->nDecompLevels; ++r) {
 	resLevel = &tileComp->resLevels[r];
 	k = r == 0 ? tileComp->nDecompLevels
@@ -2012,6 +2201,12 @@ GBool JPXStream::readTilePart() {
 						    sizeof(JPXCodeBlock));
 	    for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
 	      subband->cbs[k].dataLen = NULL;
+	      subband->cbs[k].segData = NULL;
+	      subband->cbs[k].segDataLen = 0;
+	      subband->cbs[k].segDataSize = 0;
+	      subband->cbs[k].segInfo = NULL;
+	      subband->cbs[k].segInfoLen = 0;
+	      subband->cbs[k].segInfoSize = 0;
 	      subband->cbs[k].touched = NULL;
 	      subband->cbs[k].arithDecoder = NULL;
 	      subband->cbs[k].stats = NULL;
@@ -2423,339 +2618,537 @@ GBool JPXStream::readCodeBlockData(JPXTileComp *tileComp,
 				   JPXSubband *subband,
 				   Guint res, Guint sb,
 				   JPXCodeBlock *cb) {
-  int *coeff0, *coeff1, *coeff;
-  char *touched0, *touched1, *touched;
-  Guint horiz, vert, diag, all, cx, xorBit;
-  int horizSign, vertSign, bit;
-  int segSym;
-  Guint n, i, x, y0, y1;
+  Guint nSegs, n, nRead, i;
+  int n1;
+
+  if (tileComp->codeBlockStyle & 0x04) {
+    nSegs = cb->nCodingPasses;
+  } else {
+    nSegs = 1;
+  }
+  n = 0;
+  for (i = 0; i < nSegs; ++i) {
+    n += cb->dataLen[i];
+  }
 
   if (res > tileComp->nDecompLevels - reduction) {
     // skip the codeblock data
-    if (tileComp->codeBlockStyle & 0x04) {
-      n = 0;
-      for (i = 0; i < cb->nCodingPasses; ++i) {
-	n += cb->dataLen[i];
-      }
-    } else {
-      n = cb->dataLen[0];
-    }
     bufStr->discardChars(n);
     return gTrue;
   }
 
-  if (cb->arithDecoder) {
-    cover(63);
-    cb->arithDecoder->restart(cb->dataLen[0]);
-  } else {
-    cover(64);
-    cb->arithDecoder = new JArithmeticDecoder();
-    cb->arithDecoder->setStream(bufStr, cb->dataLen[0]);
-    cb->arithDecoder->start();
-    cb->stats = new JArithmeticDecoderStats(jpxNContexts);
-    cb->stats->setEntry(jpxContextSigProp, 4, 0);
-    cb->stats->setEntry(jpxContextRunLength, 3, 0);
-    cb->stats->setEntry(jpxContextUniform, 46, 0);
-  }
-
-  for (i = 0; i < cb->nCodingPasses; ++i) {
-    if ((tileComp->codeBlockStyle & 0x04) && i > 0) {
-      cb->arithDecoder->setStream(bufStr, cb->dataLen[i]);
-      cb->arithDecoder->start();
+  // save the coding pass info and the codeword segment(s) -- the
+  // arithmetic decoding is done later, by decodeCodeBlock()
+  if (cb->segInfoLen + 1 + nSegs > cb->segInfoSize) {
+    cb->segInfoSize = 2 * cb->segInfoSize + 1 + nSegs;
+    cb->segInfo = (Guint *)greallocn(cb->segInfo, cb->segInfoSize,
+				     sizeof(Guint));
+  }
+  cb->segInfo[cb->segInfoLen++] = cb->nCodingPasses;
+  for (i = 0; i < nSegs; ++i) {
+    cb->segInfo[cb->segInfoLen++] = cb->dataLen[i];
+  }
+  // read in chunks, so a bogus length can't cause a huge allocation
+  // -- if the stream ends early, the arithmetic decoder will see EOF
+  // at the same point it would have when reading directly from bufStr
+  while (n > 0) {
+    n1 = n < 65536 ? (int)n : 65536;
+    if (cb->segDataLen + n1 > cb->segDataSize) {
+      cb->segDataSize = 2 * cb->segDataSize + n1;
+      cb->segData = (Guchar *)grealloc(cb->segData, cb->segDataSize);
+    }
+    nRead = bufStr->getBlock((char *)cb->segData + cb->segDataLen, n1);
+    cb->segDataLen += nRead;
+    if (nRead < (Guint)n1) {
+      break;
     }
+    n -= nRead;
+  }
 
-    switch (cb->nextPass) {
+  return gTrue;
+}
 
-    //----- significance propagation pass
-    case jpxPassSigProp:
-      cover(65);
-      for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 * tileComp->w,
-	     touched0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
-	     x < cb->x1;
-	     ++x, ++coeff1, ++touched1) {
-	  for (y1 = 0, coeff = coeff1, touched = touched1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
-	    if (!*coeff) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1]) {
-		  ++horiz;
-		  horizSign += coeff[-1] < 0 ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
-		}
-		if (y0+y1 < cb->y1 - 1 &&
-		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w - 1] ? 1 : 0;
-		}
-	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1]) {
-		  ++horiz;
-		  horizSign += coeff[1] < 0 ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
-		}
-		if (y0+y1 < cb->y1 - 1 &&
-		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w + 1] ? 1 : 0;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-(int)tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1 &&
-		  (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		if (coeff[tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
-		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (cx != 0) {
-		if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
-		  cx = signContext[horizSign][vertSign][0];
-		  xorBit = signContext[horizSign][vertSign][1];
-		  if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		    *coeff = -1;
-		  } else {
-		    *coeff = 1;
-		  }
-		}
-		*touched = 1;
-	      }
+//------------------------------------------------------------------------
+
+struct JPXCodeBlockTask {
+  JPXTileComp *tileComp;
+  Guint res, sb;
+  JPXCodeBlock *cb;
+  GBool segSymOk;
+};
+
+struct JPXTileTask {
+  JPXTile *tile;
+  GBool ok;
+};
+
+struct JPXTaskList {
+  JPXStream *str;
+  void *tasks;
+};
+
+// Finish decoding the image, once all of the tile-parts have been
+// read: arithmetic decoding of the code-blocks, then the IDWT for each
+// tile-component, then the inverse multi-component transform and DC
+// level shift for each tile.  Each step consists of independent tasks,
+// which are run on the worker threads.
+GBool JPXStream::decodeTiles() {
+  JPXTaskList list;
+  JPXCodeBlockTask *cbTasks;
+  JPXTileComp **tileCompTasks;
+  JPXTileTask *tileTasks;
+  JPXTile *tile;
+  JPXTileComp *tileComp;
+  JPXSubband *subband;
+  JPXCodeBlock *cb;
+  int nCBTasks, cbTasksSize, nTiles, i;
+  Guint comp, r, sb, k;
+  GBool ok;
+
+  list.str = this;
+  nTiles = img.nXTiles * img.nYTiles;
+
+  //----- code-blocks
+  cbTasks = NULL;
+  nCBTasks = cbTasksSize = 0;
+  for (i = 0; i < nTiles; ++i) {
+    tile = &img.tiles[i];
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tileComp = &tile->tileComps[comp];
+      for (r = 0; r <= tileComp->nDecompLevels; ++r) {
+	for (sb = 0; sb < (Guint)(r == 0 ? 1 : 3); ++sb) {
+	  subband = &tileComp->resLevels[r].precincts[0].subbands[sb];
+	  for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
+	    cb = &subband->cbs[k];
+	    if (!cb->segInfoLen) {
+	      continue;
 	    }
+	    if (nCBTasks == cbTasksSize) {
+	      cbTasksSize = cbTasksSize ? 2 * cbTasksSize : 256;
+	      cbTasks = (JPXCodeBlockTask *)greallocn(cbTasks, cbTasksSize,
+						    sizeof(JPXCodeBlockTask));
+	    }
+	    cbTasks[nCBTasks].tileComp = tileComp;
+	    cbTasks[nCBTasks].res = r;
+	    cbTasks[nCBTasks].sb = sb;
+	    cbTasks[nCBTasks].cb = cb;
+	    ++nCBTasks;
 	  }
 	}
       }
-      ++cb->nextPass;
-      break;
+    }
+  }
+  list.tasks = cbTasks;
+  jpxRunTasks(&decodeCodeBlockTask, &list, nCBTasks);
+  for (i = 0; i < nCBTasks; ++i) {
+    if (!cbTasks[i].segSymOk) {
+      // in theory this should be a fatal error, but it seems to be
+      // problematic
+      error(errSyntaxWarning, getPos(),
+	    "Missing or invalid segmentation symbol in JPX stream");
+    }
+  }
+  gfree(cbTasks);
 
-    //----- magnitude refinement pass
-    case jpxPassMagRef:
-      cover(66);
-      for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 * tileComp->w,
-	     touched0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
-	     x < cb->x1;
-	     ++x, ++coeff1, ++touched1) {
-	  for (y1 = 0, coeff = coeff1, touched = touched1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
-	    if (*coeff && !*touched) {
-	      if (*coeff == 1 || *coeff == -1) {
-		all = 0;
+  //----- IDWT
+  tileCompTasks = (JPXTileComp **)gmallocn(nTiles * img.nComps,
+					   sizeof(JPXTileComp *));
+  for (i = 0; i < nTiles; ++i) {
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tileCompTasks[i * img.nComps + comp] = &img.tiles[i].tileComps[comp];
+    }
+  }
+  list.tasks = tileCompTasks;
+  jpxRunTasks(&inverseTransformTask, &list, nTiles * img.nComps);
+  gfree(tileCompTasks);
+
+  //----- inverse multi-component transform and DC level shift
+  tileTasks = (JPXTileTask *)gmallocn(nTiles, sizeof(JPXTileTask));
+  for (i = 0; i < nTiles; ++i) {
+    tileTasks[i].tile = &img.tiles[i];
+  }
+  list.tasks = tileTasks;
+  jpxRunTasks(&inverseMultiCompAndDCTask, &list, nTiles);
+  ok = gTrue;
+  for (i = 0; i < nTiles; ++i) {
+    ok = ok && tileTasks[i].ok;
+  }
+  gfree(tileTasks);
+
+  return ok;
+}
+
+void JPXStream::decodeCodeBlockTask(void *data, int idx) {
+  JPXTaskList *list = (JPXTaskList *)data;
+  JPXCodeBlockTask *task = &((JPXCodeBlockTask *)list->tasks)[idx];
+
+  task->segSymOk = list->str->decodeCodeBlock(task->tileComp,
+					      task->res, task->sb, task->cb);
+}
+
+void JPXStream::inverseTransformTask(void *data, int idx) {
+  JPXTaskList *list = (JPXTaskList *)data;
+
+  list->str->inverseTransform(((JPXTileComp **)list->tasks)[idx]);
+}
+
+void JPXStream::inverseMultiCompAndDCTask(void *data, int idx) {
+  JPXTaskList *list = (JPXTaskList *)data;
+  JPXTileTask *task = &((JPXTileTask *)list->tasks)[idx];
+
+  task->ok = list->str->inverseMultiCompAndDC(task->tile);
+}
+
+// Run the arithmetic decoder over all of the data collected for a
+// code-block.  This only touches the code-block (and its part of the
+// tile-component data array), so code-blocks can be decoded in
+// parallel.  Returns false if there was a bad segmentation symbol.
+GBool JPXStream::decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+				 JPXCodeBlock *cb) {
+  MemStream *segStr;
+  Object obj;
+  int *coeff0, *coeff1, *coeff;
+  char *touched0, *touched1, *touched;
+  Guint horiz, vert, diag, all, cx, xorBit;
+  int horizSign, vertSign, bit;
+  int segSym;
+  GBool segSymOk;
+  Guint *segLen;
+  Guint nCodingPasses, nSegs, pkt, i, x, y0, y1;
+
+  if (!cb->segInfoLen) {
+    return gTrue;
+  }
+  obj.initNull();
+  segStr = new MemStream((char *)cb->segData, 0, cb->segDataLen, &obj);
+  segSymOk = gTrue;
+
+  for (pkt = 0; pkt < cb->segInfoLen; pkt += 1 + nSegs) {
+    nCodingPasses = cb->segInfo[pkt];
+    segLen = &cb->segInfo[pkt + 1];
+    nSegs = (tileComp->codeBlockStyle & 0x04) ? nCodingPasses : 1;
+
+    if (cb->arithDecoder) {
+      cover(63);
+      cb->arithDecoder->restart(segLen[0]);
+    } else {
+      cover(64);
+      cb->arithDecoder = new JArithmeticDecoder();
+      cb->arithDecoder->setStream(segStr, segLen[0]);
+      cb->arithDecoder->start();
+      cb->stats = new JArithmeticDecoderStats(jpxNContexts);
+      cb->stats->setEntry(jpxContextSigProp, 4, 0);
+      cb->stats->setEntry(jpxContextRunLength, 3, 0);
+      cb->stats->setEntry(jpxContextUniform, 46, 0);
+    }
+
+    for (i = 0; i < nCodingPasses; ++i) {
+      if ((tileComp->codeBlockStyle & 0x04) && i > 0) {
+	cb->arithDecoder->setStream(segStr, segLen[i]);
+	cb->arithDecoder->start();
+      }
+
+      switch (cb->nextPass) {
+
+      //----- significance propagation pass
+      case jpxPassSigProp:
+	cover(65);
+	for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 * tileComp->w,
+	       touched0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
+	       x < cb->x1;
+	       ++x, ++coeff1, ++touched1) {
+	    for (y1 = 0, coeff = coeff1, touched = touched1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
+	      if (!*coeff) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
 		if (x > cb->x0) {
-		  all += coeff[-1] ? 1 : 0;
+		  if (coeff[-1]) {
+		    ++horiz;
+		    horizSign += coeff[-1] < 0 ? -1 : 1;
+		  }
 		  if (y0+y1 > cb->y0) {
-		    all += coeff[-(int)tileComp->w - 1] ? 1 : 0;
+		    diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
 		  }
 		  if (y0+y1 < cb->y1 - 1 &&
 		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		    all += coeff[tileComp->w - 1] ? 1 : 0;
+		    diag += coeff[tileComp->w - 1] ? 1 : 0;
 		  }
 		}
 		if (x < cb->x1 - 1) {
-		  all += coeff[1] ? 1 : 0;
+		  if (coeff[1]) {
+		    ++horiz;
+		    horizSign += coeff[1] < 0 ? -1 : 1;
+		  }
 		  if (y0+y1 > cb->y0) {
-		    all += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		    diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
 		  }
 		  if (y0+y1 < cb->y1 - 1 &&
 		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		    all += coeff[tileComp->w + 1] ? 1 : 0;
+		    diag += coeff[tileComp->w + 1] ? 1 : 0;
 		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  all += coeff[-(int)tileComp->w] ? 1 : 0;
+		  if (coeff[-(int)tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1 &&
 		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  all += coeff[tileComp->w] ? 1 : 0;
+		  if (coeff[tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
+		  }
+		}
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (cx != 0) {
+		  if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
+		    cx = signContext[horizSign][vertSign][0];
+		    xorBit = signContext[horizSign][vertSign][1];
+		    if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
+		      *coeff = -1;
+		    } else {
+		      *coeff = 1;
+		    }
+		  }
+		  *touched = 1;
 		}
-		cx = all ? 15 : 14;
-	      } else {
-		cx = 16;
-	      }
-	      bit = cb->arithDecoder->decodeBit(cx, cb->stats);
-	      if (*coeff < 0) {
-		*coeff = (*coeff << 1) - bit;
-	      } else {
-		*coeff = (*coeff << 1) + bit;
 	      }
-	      *touched = 1;
 	    }
 	  }
 	}
-      }
-      ++cb->nextPass;
-      break;
+	++cb->nextPass;
+	break;
 
-    //----- cleanup pass
-    case jpxPassCleanup:
-      cover(67);
-      for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 * tileComp->w,
-	     touched0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
-	     x < cb->x1;
-	     ++x, ++coeff1, ++touched1) {
-	  y1 = 0;
-	  if (y0 + 3 < cb->y1 &&
-	      !(*touched1) &&
-	      !(touched1[tileComp->cbW]) &&
-	      !(touched1[2 * tileComp->cbW]) &&
-	      !(touched1[3 * tileComp->cbW]) &&
-	      (x == cb->x0 || y0 == cb->y0 ||
-	       !coeff1[-(int)tileComp->w - 1]) &&
-	      (y0 == cb->y0 ||
-	       !coeff1[-(int)tileComp->w]) &&
-	      (x == cb->x1 - 1 || y0 == cb->y0 ||
-	       !coeff1[-(int)tileComp->w + 1]) &&
-	      (x == cb->x0 ||
-	       (!coeff1[-1] &&
-		!coeff1[tileComp->w - 1] &&
-		!coeff1[2 * tileComp->w - 1] && 
-		!coeff1[3 * tileComp->w - 1])) &&
-	      (x == cb->x1 - 1 ||
-	       (!coeff1[1] &&
-		!coeff1[tileComp->w + 1] &&
-		!coeff1[2 * tileComp->w + 1] &&
-		!coeff1[3 * tileComp->w + 1])) &&
-	      ((tileComp->codeBlockStyle & 0x08) ||
-	       ((x == cb->x0 || y0+4 == cb->y1 ||
-		 !coeff1[4 * tileComp->w - 1]) &&
-		(y0+4 == cb->y1 ||
-		 !coeff1[4 * tileComp->w]) &&
-		(x == cb->x1 - 1 || y0+4 == cb->y1 ||
-		 !coeff1[4 * tileComp->w + 1])))) {
-	    if (cb->arithDecoder->decodeBit(jpxContextRunLength, cb->stats)) {
-	      y1 = cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      y1 = (y1 << 1) |
-		   cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      coeff = &coeff1[y1 * tileComp->w];
-	      cx = signContext[2][2][0];
-	      xorBit = signContext[2][2][1];
-	      if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		*coeff = -1;
-	      } else {
-		*coeff = 1;
+      //----- magnitude refinement pass
+      case jpxPassMagRef:
+	cover(66);
+	for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 * tileComp->w,
+	       touched0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
+	       x < cb->x1;
+	       ++x, ++coeff1, ++touched1) {
+	    for (y1 = 0, coeff = coeff1, touched = touched1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
+	      if (*coeff && !*touched) {
+		if (*coeff == 1 || *coeff == -1) {
+		  all = 0;
+		  if (x > cb->x0) {
+		    all += coeff[-1] ? 1 : 0;
+		    if (y0+y1 > cb->y0) {
+		      all += coeff[-(int)tileComp->w - 1] ? 1 : 0;
+		    }
+		    if (y0+y1 < cb->y1 - 1 &&
+			(!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		      all += coeff[tileComp->w - 1] ? 1 : 0;
+		    }
+		  }
+		  if (x < cb->x1 - 1) {
+		    all += coeff[1] ? 1 : 0;
+		    if (y0+y1 > cb->y0) {
+		      all += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		    }
+		    if (y0+y1 < cb->y1 - 1 &&
+			(!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		      all += coeff[tileComp->w + 1] ? 1 : 0;
+		    }
+		  }
+		  if (y0+y1 > cb->y0) {
+		    all += coeff[-(int)tileComp->w] ? 1 : 0;
+		  }
+		  if (y0+y1 < cb->y1 - 1 &&
+		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		    all += coeff[tileComp->w] ? 1 : 0;
+		  }
+		  cx = all ? 15 : 14;
+		} else {
+		  cx = 16;
+		}
+		bit = cb->arithDecoder->decodeBit(cx, cb->stats);
+		if (*coeff < 0) {
+		  *coeff = (*coeff << 1) - bit;
+		} else {
+		  *coeff = (*coeff << 1) + bit;
+		}
+		*touched = 1;
 	      }
-	      ++y1;
-	    } else {
-	      y1 = 4;
 	    }
 	  }
-	  for (coeff = &coeff1[y1 * tileComp->w],
-		 touched = &touched1[y1 << tileComp->codeBlockW];
-	       y1 < 4 && y0 + y1 < cb->y1;
-	       ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
-	    if (!*touched) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1]) {
-		  ++horiz;
-		  horizSign += coeff[-1] < 0 ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
-		}
-		if (y0+y1 < cb->y1 - 1 &&
-		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w - 1] ? 1 : 0;
+	}
+	++cb->nextPass;
+	break;
+
+      //----- cleanup pass
+      case jpxPassCleanup:
+	cover(67);
+	for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 * tileComp->w,
+	       touched0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
+	       x < cb->x1;
+	       ++x, ++coeff1, ++touched1) {
+	    y1 = 0;
+	    if (y0 + 3 < cb->y1 &&
+		!(*touched1) &&
+		!(touched1[tileComp->cbW]) &&
+		!(touched1[2 * tileComp->cbW]) &&
+		!(touched1[3 * tileComp->cbW]) &&
+		(x == cb->x0 || y0 == cb->y0 ||
+		 !coeff1[-(int)tileComp->w - 1]) &&
+		(y0 == cb->y0 ||
+		 !coeff1[-(int)tileComp->w]) &&
+		(x == cb->x1 - 1 || y0 == cb->y0 ||
+		 !coeff1[-(int)tileComp->w + 1]) &&
+		(x == cb->x0 ||
+		 (!coeff1[-1] &&
+		  !coeff1[tileComp->w - 1] &&
+		  !coeff1[2 * tileComp->w - 1] && 
+		  !coeff1[3 * tileComp->w - 1])) &&
+		(x == cb->x1 - 1 ||
+		 (!coeff1[1] &&
+		  !coeff1[tileComp->w + 1] &&
+		  !coeff1[2 * tileComp->w + 1] &&
+		  !coeff1[3 * tileComp->w + 1])) &&
+		((tileComp->codeBlockStyle & 0x08) ||
+		 ((x == cb->x0 || y0+4 == cb->y1 ||
+		   !coeff1[4 * tileComp->w - 1]) &&
+		  (y0+4 == cb->y1 ||
+		   !coeff1[4 * tileComp->w]) &&
+		  (x == cb->x1 - 1 || y0+4 == cb->y1 ||
+		   !coeff1[4 * tileComp->w + 1])))) {
+	      if (cb->arithDecoder->decodeBit(jpxContextRunLength,
+					      cb->stats)) {
+		y1 = cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
+		y1 = (y1 << 1) |
+		     cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
+		coeff = &coeff1[y1 * tileComp->w];
+		cx = signContext[2][2][0];
+		xorBit = signContext[2][2][1];
+		if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
+		  *coeff = -1;
+		} else {
+		  *coeff = 1;
 		}
+		++y1;
+	      } else {
+		y1 = 4;
 	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1]) {
-		  ++horiz;
-		  horizSign += coeff[1] < 0 ? -1 : 1;
+	    }
+	    for (coeff = &coeff1[y1 * tileComp->w],
+		   touched = &touched1[y1 << tileComp->codeBlockW];
+		 y1 < 4 && y0 + y1 < cb->y1;
+		 ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
+	      if (!*touched) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
+		if (x > cb->x0) {
+		  if (coeff[-1]) {
+		    ++horiz;
+		    horizSign += coeff[-1] < 0 ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
+		  }
+		  if (y0+y1 < cb->y1 - 1 &&
+		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		    diag += coeff[tileComp->w - 1] ? 1 : 0;
+		  }
+		}
+		if (x < cb->x1 - 1) {
+		  if (coeff[1]) {
+		    ++horiz;
+		    horizSign += coeff[1] < 0 ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		  }
+		  if (y0+y1 < cb->y1 - 1 &&
+		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		    diag += coeff[tileComp->w + 1] ? 1 : 0;
+		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		  if (coeff[-(int)tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1 &&
 		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w + 1] ? 1 : 0;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-(int)tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1 &&
-		  (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		if (coeff[tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
+		  if (coeff[tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
+		  }
 		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
-		cx = signContext[horizSign][vertSign][0];
-		xorBit = signContext[horizSign][vertSign][1];
-		if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		  *coeff = -1;
-		} else {
-		  *coeff = 1;
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
+		  cx = signContext[horizSign][vertSign][0];
+		  xorBit = signContext[horizSign][vertSign][1];
+		  if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
+		    *coeff = -1;
+		  } else {
+		    *coeff = 1;
+		  }
 		}
+	      } else {
+		*touched = 0;
 	      }
-	    } else {
-	      *touched = 0;
 	    }
 	  }
 	}
+	++cb->len;
+	// look for a segmentation symbol
+	if (tileComp->codeBlockStyle & 0x20) {
+	  segSym = cb->arithDecoder->decodeBit(jpxContextUniform,
+					       cb->stats) << 3;
+	  segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
+						cb->stats) << 2;
+	  segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
+						cb->stats) << 1;
+	  segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
+						cb->stats);
+	  if (segSym != 0x0a) {
+	    segSymOk = gFalse;
+	  }
+	}
+	cb->nextPass = jpxPassSigProp;
+	break;
       }
-      ++cb->len;
-      // look for a segmentation symbol
-      if (tileComp->codeBlockStyle & 0x20) {
-	segSym = cb->arithDecoder->decodeBit(jpxContextUniform,
-					     cb->stats) << 3;
-	segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
-					      cb->stats) << 2;
-	segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
-					      cb->stats) << 1;
-	segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
-					      cb->stats);
-	if (segSym != 0x0a) {
-	  // in theory this should be a fatal error, but it seems to
-	  // be problematic
-	  error(errSyntaxWarning, getPos(),
-		"Missing or invalid segmentation symbol in JPX stream");
-	}
-      }
-      cb->nextPass = jpxPassSigProp;
-      break;
-    }
 
-    if (tileComp->codeBlockStyle & 0x02) {
-      cb->stats->reset();
-      cb->stats->setEntry(jpxContextSigProp, 4, 0);
-      cb->stats->setEntry(jpxContextRunLength, 3, 0);
-      cb->stats->setEntry(jpxContextUniform, 46, 0);
-    }
+      if (tileComp->codeBlockStyle & 0x02) {
+	cb->stats->reset();
+	cb->stats->setEntry(jpxContextSigProp, 4, 0);
+	cb->stats->setEntry(jpxContextRunLength, 3, 0);
+	cb->stats->setEntry(jpxContextUniform, 46, 0);
+      }
 
-    if (tileComp->codeBlockStyle & 0x04) {
-      cb->arithDecoder->cleanup();
+      if (tileComp->codeBlockStyle & 0x04) {
+	cb->arithDecoder->cleanup();
+      }
     }
+
+    cb->arithDecoder->cleanup();
   }
 
-  cb->arithDecoder->cleanup();
-  return gTrue;
+  delete cb->arithDecoder;
+  cb->arithDecoder = NULL;
+  delete cb->stats;
+  cb->stats = NULL;
+  delete segStr;
+  gfree(cb->segData);
+  cb->segData = NULL;
+  cb->segDataLen = cb->segDataSize = 0;
+
+  return segSymOk;
 }
 
 // Inverse quantization, and wavelet transform (IDWT).  This also does
@@ -2870,7 +3263,7 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
   double mu;
   int val;
   int *dataPtr, *bufPtr;
-  Guint nx1, nx2, ny1, ny2, offset;
+  Guint nx1, nx2, ny1, ny2, offset, nLanes, lane;
   Guint x, y, sb, cbX, cbY;
 
   //----- fixed-point adjustment and dequantization
@@ -2961,97 +3354,124 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
   ny1 = precinct->subbands[0].y1 - precinct->subbands[0].y0;
   ny2 = ny1 + precinct->subbands[1].y1 - precinct->subbands[1].y0;
 
-  // horizontal (row) transforms
+  // horizontal (row) transforms -- jpxIDWTLanes rows at a time
   if (r == tileComp->nDecompLevels) {
     offset = 3 + (tileComp->x0 & 1);
   } else {
     offset = 3 + (tileComp->resLevels[r+1].x0 & 1);
   }
-  for (y = 0, dataPtr = tileComp->data; y < ny2; ++y, dataPtr += tileComp->w) {
-    if (precinct->subbands[0].x0 == precinct->subbands[1].x0) {
-      // fetch LL/LH
-      for (x = 0, bufPtr = tileComp->buf + offset;
-	   x < nx1;
-	   ++x, bufPtr += 2) {
-	*bufPtr = dataPtr[x];
-      }
-      // fetch HL/HH
-      for (x = nx1, bufPtr = tileComp->buf + offset + 1;
-	   x < nx2;
-	   ++x, bufPtr += 2) {
-	*bufPtr = dataPtr[x];
-      }
-    } else {
-      // fetch LL/LH
-      for (x = 0, bufPtr = tileComp->buf + offset + 1;
-	   x < nx1;
-	   ++x, bufPtr += 2) {
-	*bufPtr = dataPtr[x];
-      }
-      // fetch HL/HH
-      for (x = nx1, bufPtr = tileComp->buf + offset;
-	   x < nx2;
-	   ++x, bufPtr += 2) {
-	*bufPtr = dataPtr[x];
+  for (y = 0; y < ny2; y += jpxIDWTLanes) {
+    nLanes = ny2 - y < jpxIDWTLanes ? ny2 - y : jpxIDWTLanes;
+    for (lane = 0, dataPtr = tileComp->data + y * tileComp->w;
+	 lane < nLanes;
+	 ++lane, dataPtr += tileComp->w) {
+      if (precinct->subbands[0].x0 == precinct->subbands[1].x0) {
+	// fetch LL/LH
+	for (x = 0, bufPtr = tileComp->buf + offset * jpxIDWTLanes + lane;
+	     x < nx1;
+	     ++x, bufPtr += 2 * jpxIDWTLanes) {
+	  *bufPtr = dataPtr[x];
+	}
+	// fetch HL/HH
+	for (x = nx1,
+	       bufPtr = tileComp->buf + (offset + 1) * jpxIDWTLanes + lane;
+	     x < nx2;
+	     ++x, bufPtr += 2 * jpxIDWTLanes) {
+	  *bufPtr = dataPtr[x];
+	}
+      } else {
+	// fetch LL/LH
+	for (x = 0,
+	       bufPtr = tileComp->buf + (offset + 1) * jpxIDWTLanes + lane;
+	     x < nx1;
+	     ++x, bufPtr += 2 * jpxIDWTLanes) {
+	  *bufPtr = dataPtr[x];
+	}
+	// fetch HL/HH
+	for (x = nx1, bufPtr = tileComp->buf + offset * jpxIDWTLanes + lane;
+	     x < nx2;
+	     ++x, bufPtr += 2 * jpxIDWTLanes) {
+	  *bufPtr = dataPtr[x];
+	}
       }
     }
     inverseTransform1D(tileComp, tileComp->buf, offset, nx2);
-    for (x = 0, bufPtr = tileComp->buf + offset; x < nx2; ++x, ++bufPtr) {
-      dataPtr[x] = *bufPtr;
+    for (lane = 0, dataPtr = tileComp->data + y * tileComp->w;
+	 lane < nLanes;
+	 ++lane, dataPtr += tileComp->w) {
+      for (x = 0, bufPtr = tileComp->buf + offset * jpxIDWTLanes + lane;
+	   x < nx2;
+	   ++x, bufPtr += jpxIDWTLanes) {
+	dataPtr[x] = *bufPtr;
+      }
     }
   }
 
-  // vertical (column) transforms
+  // vertical (column) transforms -- jpxIDWTLanes columns at a time
   if (r == tileComp->nDecompLevels) {
     offset = 3 + (tileComp->y0 & 1);
   } else {
     offset = 3 + (tileComp->resLevels[r+1].y0 & 1);
   }
-  for (x = 0, dataPtr = tileComp->data; x < nx2; ++x, ++dataPtr) {
+  for (x = 0; x < nx2; x += jpxIDWTLanes) {
+    nLanes = nx2 - x < jpxIDWTLanes ? nx2 - x : jpxIDWTLanes;
     if (precinct->subbands[1].y0 == precinct->subbands[0].y0) {
       // fetch LL/HL
-      for (y = 0, bufPtr = tileComp->buf + offset;
+      for (y = 0, bufPtr = tileComp->buf + offset * jpxIDWTLanes;
 	   y < ny1;
-	   ++y, bufPtr += 2) {
-	*bufPtr = dataPtr[y * tileComp->w];
+	   ++y, bufPtr += 2 * jpxIDWTLanes) {
+	memcpy(bufPtr, tileComp->data + y * tileComp->w + x,
+	       nLanes * sizeof(int));
       }
       // fetch LH/HH
-      for (y = ny1, bufPtr = tileComp->buf + offset + 1;
+      for (y = ny1, bufPtr = tileComp->buf + (offset + 1) * jpxIDWTLanes;
 	   y < ny2;
-	   ++y, bufPtr += 2) {
-	*bufPtr = dataPtr[y * tileComp->w];
+	   ++y, bufPtr += 2 * jpxIDWTLanes) {
+	memcpy(bufPtr, tileComp->data + y * tileComp->w + x,
+	       nLanes * sizeof(int));
       }
     } else {
       // fetch LL/HL
-      for (y = 0, bufPtr = tileComp->buf + offset + 1;
+      for (y = 0, bufPtr = tileComp->buf + (offset + 1) * jpxIDWTLanes;
 	   y < ny1;
-	   ++y, bufPtr += 2) {
-	*bufPtr = dataPtr[y * tileComp->w];
+	   ++y, bufPtr += 2 * jpxIDWTLanes) {
+	memcpy(bufPtr, tileComp->data + y * tileComp->w + x,
+	       nLanes * sizeof(int));
       }
       // fetch LH/HH
-      for (y = ny1, bufPtr = tileComp->buf + offset;
+      for (y = ny1, bufPtr = tileComp->buf + offset * jpxIDWTLanes;
 	   y < ny2;
-	   ++y, bufPtr += 2) {
-	*bufPtr = dataPtr[y * tileComp->w];
+	   ++y, bufPtr += 2 * jpxIDWTLanes) {
+	memcpy(bufPtr, tileComp->data + y * tileComp->w + x,
+	       nLanes * sizeof(int));
       }
     }
     inverseTransform1D(tileComp, tileComp->buf, offset, ny2);
-    for (y = 0, bufPtr = tileComp->buf + offset; y < ny2; ++y, ++bufPtr) {
-      dataPtr[y * tileComp->w] = *bufPtr;
+    for (y = 0, bufPtr = tileComp->buf + offset * jpxIDWTLanes;
+	 y < ny2;
+	 ++y, bufPtr += jpxIDWTLanes) {
+      memcpy(tileComp->data + y * tileComp->w + x, bufPtr,
+	     nLanes * sizeof(int));
     }
   }
 }
 
+// Do the 1D inverse transform on jpxIDWTLanes interleaved rows (or
+// columns): element i of lane k is data[i * jpxIDWTLanes + k].
 void JPXStream::inverseTransform1D(JPXTileComp *tileComp, int *data,
 				   Guint offset, Guint n) {
+  int *p;
   Guint end, i;
+  int k;
 
   //----- special case for length = 1
   if (n == 1) {
     cover(79);
     if (offset == 4) {
       cover(104);
-      *data >>= 1;
+      for (k = 0; k < jpxIDWTLanes; ++k) {
+	data[k] >>= 1;
+      }
     }
 
   } else {
@@ -3060,39 +3480,39 @@ void JPXStream::inverseTransform1D(JPXTileComp *tileComp, int *data,
     end = offset + n;
 
     //----- extend right
-    data[end] = data[end - 2];
+    jpxCopyLanes(data, end, end - 2);
     if (n == 2) {
       cover(81);
-      data[end+1] = data[offset + 1];
-      data[end+2] = data[offset];
-      data[end+3] = data[offset + 1];
+      jpxCopyLanes(data, end + 1, offset + 1);
+      jpxCopyLanes(data, end + 2, offset);
+      jpxCopyLanes(data, end + 3, offset + 1);
     } else {
       cover(82);
-      data[end+1] = data[end - 3];
+      jpxCopyLanes(data, end + 1, end - 3);
       if (n == 3) {
 	cover(105);
-	data[end+2] = data[offset + 1];
-	data[end+3] = data[offset + 2];
+	jpxCopyLanes(data, end + 2, offset + 1);
+	jpxCopyLanes(data, end + 3, offset + 2);
       } else {
 	cover(106);
-	data[end+2] = data[end - 4];
+	jpxCopyLanes(data, end + 2, end - 4);
 	if (n == 4) {
 	  cover(107);
-	  data[end+3] = data[offset + 1];
+	  jpxCopyLanes(data, end + 3, offset + 1);
 	} else {
 	  cover(108);
-	  data[end+3] = data[end - 5];
+	  jpxCopyLanes(data, end + 3, end - 5);
 	}
       }
     }
 
     //----- extend left
-    data[offset - 1] = data[offset + 1];
-    data[offset - 2] = data[offset + 2];
-    data[offset - 3] = data[offset + 3];
+    jpxCopyLanes(data, offset - 1, offset + 1);
+    jpxCopyLanes(data, offset - 2, offset + 2);
+    jpxCopyLanes(data, offset - 3, offset + 3);
     if (offset == 4) {
       cover(83);
-      data[0] = data[offset + 4];
+      jpxCopyLanes(data, 0, offset + 4);
     }
 
     //----- 9-7 irreversible filter
@@ -3101,27 +3521,49 @@ void JPXStream::inverseTransform1D(JPXTileComp *tileComp, int *data,
       cover(84);
       // step 1 (even)
       for (i = 1; i <= end + 2; i += 2) {
-	data[i] = (int)(idwtKappa * data[i]);
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] = (int)(idwtKappa * p[k]);
+	}
       }
       // step 2 (odd)
       for (i = 0; i <= end + 3; i += 2) {
-	data[i] = (int)(idwtIKappa * data[i]);
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] = (int)(idwtIKappa * p[k]);
+	}
       }
       // step 3 (even)
       for (i = 1; i <= end + 2; i += 2) {
-	data[i] = (int)(data[i] - idwtDelta * (data[i-1] + data[i+1]));
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] = (int)(p[k] - idwtDelta * (p[k - jpxIDWTLanes] +
+					   p[k + jpxIDWTLanes]));
+	}
       }
       // step 4 (odd)
       for (i = 2; i <= end + 1; i += 2) {
-	data[i] = (int)(data[i] - idwtGamma * (data[i-1] + data[i+1]));
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] = (int)(p[k] - idwtGamma * (p[k - jpxIDWTLanes] +
+					   p[k + jpxIDWTLanes]));
+	}
       }
       // step 5 (even)
       for (i = 3; i <= end; i += 2) {
-	data[i] = (int)(data[i] - idwtBeta * (data[i-1] + data[i+1]));
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] = (int)(p[k] - idwtBeta * (p[k - jpxIDWTLanes] +
+					  p[k + jpxIDWTLanes]));
+	}
       }
       // step 6 (odd)
       for (i = 4; i <= end - 1; i += 2) {
-	data[i] = (int)(data[i] - idwtAlpha * (data[i-1] + data[i+1]));
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] = (int)(p[k] - idwtAlpha * (p[k - jpxIDWTLanes] +
+					   p[k + jpxIDWTLanes]));
+	}
       }
 
     //----- 5-3 reversible filter
@@ -3130,11 +3572,17 @@ void JPXStream::inverseTransform1D(JPXTileComp *tileComp, int *data,
       cover(85);
       // step 1 (even)
       for (i = 3; i <= end; i += 2) {
-	data[i] -= (data[i-1] + data[i+1] + 2) >> 2;
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] -= (p[k - jpxIDWTLanes] + p[k + jpxIDWTLanes] + 2) >> 2;
+	}
       }
       // step 2 (odd)
       for (i = 4; i < end; i += 2) {
-	data[i] += (data[i-1] + data[i+1]) >> 1;
+	p = data + i * jpxIDWTLanes;
+	for (k = 0; k < jpxIDWTLanes; ++k) {
+	  p[k] += (p[k - jpxIDWTLanes] + p[k + jpxIDWTLanes]) >> 1;
+	}
       }
     }
   }
@@ -121,6 +121,17 @@ struct JPXCodeBlock {
   Guint *dataLen;		// data lengths (one per codeword segment)
   Guint dataLenSize;		// size of the dataLen array
 
+  //----- compressed data (collected from all packets, and decoded
+  //      after the last tile-part has been read)
+  Guchar *segData;		// codeword segments, concatenated
+  Guint segDataLen;		// number of bytes in segData
+  Guint segDataSize;		// size of the segData array
+  Guint *segInfo;		// for each packet: number of coding
+				//   passes, followed by the codeword
+				//   segment length(s)
+  Guint segInfoLen;		// number of entries in segInfo
+  Guint segInfoSize;		// size of the segInfo array
+
   //----- coefficient data
   int *coeffs;
   char *touched;		// coefficient 'touched' flags
@@ -206,7 +217,8 @@ struct JPXTileComp {
   //----- image data
   int *data;			// the decoded image data
   int *buf;			// intermediate buffer for the inverse
-				//   transform
+				//   transform (jpxIDWTLanes rows or
+				//   columns, interleaved)
 
   //----- children
   JPXResLevel *resLevels;	// the resolution levels
@@ -289,7 +301,13 @@ public:
   virtual GBool isBinary(GBool last = gTrue);
   virtual void getImageParams(int *bitsPerComponent,
 			      StreamColorSpaceMode *csMode);
-  void reduceResolution(int reductionA) { reduction = reductionA; }
+
+  // Decode at 1/2^<reductionA> of full resolution, by skipping the
+  // finest decomposition levels.  This is limited to the number of
+  // decomposition levels in the main header, so callers should use
+  // getReduction() to find the resulting image size.
+  void reduceResolution(int reductionA);
+  int getReduction() { return reduction; }
 
 private:
 
@@ -307,6 +325,12 @@ private:
 			  JPXSubband *subband,
 			  Guint res, Guint sb,
 			  JPXCodeBlock *cb);
+  GBool decodeTiles();
+  static void decodeCodeBlockTask(void *data, int idx);
+  static void inverseTransformTask(void *data, int idx);
+  static void inverseMultiCompAndDCTask(void *data, int idx);
+  GBool decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+			JPXCodeBlock *cb);
   void inverseTransform(JPXTileComp *tileComp);
   void inverseTransformLevel(JPXTileComp *tileComp,
 			     Guint r, JPXResLevel *resLevel);
@@ -332,6 +356,9 @@ private:
   Guint *bpc;			// bits per component, for each component
   Guint width, height;		// image size
   int reduction;		// log2(reduction in resolution)
+  int maxReduction;		// max reduction allowed by the main header
+				//   (decomposition levels, image offset),
+				//   or -1 if it hasn't been checked yet
   GBool haveImgHdr;		// set if a JP2/JPX image header has been
 				//   found
   JPXColorSpec cs;		// color specification
@@ -0,0 +1,218 @@
+//========================================================================
+//
+// JSONBinary.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "gmem.h"
+#include "JSONBinary.h"
+
+//------------------------------------------------------------------------
+
+// Largest record we accept, to protect against corrupt length fields.
+#define maxRecordSize 0x40000000
+
+static inline GBool getVarint(const char **p, const char *end, Guint *x) {
+  const char *q;
+  Guint v;
+  int shift;
+
+  q = *p;
+  v = 0;
+  for (shift = 0; shift < 35 && q < end; shift += 7) {
+    v |= (Guint)(*q & 0x7f) << shift;
+    if (!(*q++ & 0x80)) {
+      *p = q;
+      *x = v;
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+static inline GBool getSVarint(const char **p, const char *end, int *x) {
+  Guint v;
+
+  if (!getVarint(p, end, &v)) {
+    return gFalse;
+  }
+  *x = (int)(v >> 1) ^ -(int)(v & 1);
+  return gTrue;
+}
+
+//------------------------------------------------------------------------
+// JSONBinReader
+//------------------------------------------------------------------------
+
+JSONBinReader::JSONBinReader(FILE *fA) {
+  char magic[jsonBinMagicLen + 1];
+
+  f = fA;
+  buf = NULL;
+  bufSize = 0;
+  p = end = NULL;
+  memset(&page, 0, sizeof(page));
+  stringsSize = 0;
+  wordsSize = 0;
+  corrupt = gFalse;
+  ok = fread(magic, 1, jsonBinMagicLen + 1, f) == jsonBinMagicLen + 1 &&
+       !memcmp(magic, jsonBinMagic, jsonBinMagicLen) &&
+       magic[jsonBinMagicLen] == jsonBinVersion;
+}
+
+JSONBinReader::~JSONBinReader() {
+  gfree(buf);
+  gfree(page.strings);
+  gfree(page.stringLens);
+  gfree(page.words);
+}
+
+GBool JSONBinReader::readVarint(Guint *x) {
+  Guint v;
+  int c, shift;
+
+  v = 0;
+  for (shift = 0; shift < 35; shift += 7) {
+    if ((c = fgetc(f)) == EOF) {
+      return gFalse;
+    }
+    v |= (Guint)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *x = v;
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+JSONBinPage *JSONBinReader::nextPage() {
+  Guint len;
+  int c;
+
+  if (!ok || corrupt) {
+    return NULL;
+  }
+  if ((c = fgetc(f)) == EOF) {
+    return NULL;
+  }
+  ungetc(c, f);
+  if (!readVarint(&len) || len > maxRecordSize) {
+    corrupt = gTrue;
+    return NULL;
+  }
+  if ((int)len > bufSize) {
+    bufSize = (int)len;
+    buf = (char *)grealloc(buf, bufSize);
+  }
+  if (fread(buf, 1, len, f) != len) {
+    corrupt = gTrue;
+    return NULL;
+  }
+  p = buf;
+  end = buf + len;
+  if (!decodePage()) {
+    corrupt = gTrue;
+    return NULL;
+  }
+  return &page;
+}
+
+GBool JSONBinReader::decodePage() {
+  JSONBinWord *w;
+  Guint x, n, width, height;
+  int top, right, i;
+
+  if (!getVarint(&p, end, &x)) {
+    return gFalse;
+  }
+  page.number = (int)x;
+  if (!getVarint(&p, end, &x)) {
+    return gFalse;
+  }
+  page.pages = (int)x;
+  if (!getVarint(&p, end, &x)) {
+    return gFalse;
+  }
+  page.width = (int)x;
+  if (!getVarint(&p, end, &x)) {
+    return gFalse;
+  }
+  page.height = (int)x;
+  if (!getVarint(&p, end, &x)) {
+    return gFalse;
+  }
+  page.dpi = (double)x / jsonBinDPIScale;
+  if (!getVarint(&p, end, &x)) {
+    return gFalse;
+  }
+  page.truncated = (x & jsonBinTruncated) != 0;
+
+  if (!getVarint(&p, end, &x) || x > (Guint)(end - p)) {
+    return gFalse;
+  }
+  page.formFields = p;
+  page.formFieldsLen = (int)x;
+  p += x;
+
+  // string table -- each string takes at least one byte, which bounds
+  // the count
+  if (!getVarint(&p, end, &n) || n > (Guint)(end - p)) {
+    return gFalse;
+  }
+  if ((int)n > stringsSize) {
+    stringsSize = (int)n;
+    page.strings = (const char **)greallocn(page.strings, stringsSize,
+					    sizeof(const char *));
+    page.stringLens = (int *)greallocn(page.stringLens, stringsSize,
+				       sizeof(int));
+  }
+  page.nStrings = (int)n;
+  for (i = 0; i < page.nStrings; ++i) {
+    if (!getVarint(&p, end, &x) || x > (Guint)(end - p)) {
+      return gFalse;
+    }
+    page.strings[i] = p;
+    page.stringLens[i] = (int)x;
+    p += x;
+  }
+
+  // words -- each word takes at least six bytes
+  if (!getVarint(&p, end, &n) || n > (Guint)(end - p) / 6) {
+    return gFalse;
+  }
+  if ((int)n > wordsSize) {
+    wordsSize = (int)n;
+    page.words = (JSONBinWord *)greallocn(page.words, wordsSize,
+					  sizeof(JSONBinWord));
+  }
+  page.nWords = (int)n;
+  top = right = 0;
+  for (i = 0, w = page.words; i < page.nWords; ++i, ++w) {
+    if (!getSVarint(&p, end, &w->top) ||
+	!getSVarint(&p, end, &w->left) ||
+	!getVarint(&p, end, &width) ||
+	!getVarint(&p, end, &height) ||
+	!getSVarint(&p, end, &w->baseline) ||
+	!getVarint(&p, end, &x) ||
+	x >= (Guint)page.nStrings) {
+      return gFalse;
+    }
+    w->width = (int)width;
+    w->height = (int)height;
+    w->top += top;
+    w->left += right;
+    w->baseline += w->top;
+    w->text = (int)x;
+    top = w->top;
+    right = w->left + w->width;
+  }
+
+  return p == end;
+}
@@ -0,0 +1,127 @@
+//========================================================================
+//
+// JSONBinary.h
+//
+// Compact binary page format written by pdftojson -binary, and a
+// reader for it.
+//
+//========================================================================
+
+#ifndef JSONBINARY_H
+#define JSONBINARY_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include "gtypes.h"
+
+//------------------------------------------------------------------------
+//
+// File layout:
+//
+//   magic     "PJB" followed by the version byte (jsonBinVersion)
+//   records   one per page, until end of file
+//
+// Each page record is a varint byte count followed by that many bytes:
+//
+//   number, pages, width, height     varints
+//   dpi                              varint, in 1/10000 DPI
+//   flags                            varint (jsonBinTruncated)
+//   formfields                       varint length + JSON text
+//   string table                     varint count, then for each
+//                                    string: varint length + UTF-8
+//   words                            varint count, then for each
+//                                    word: the fields below
+//
+//   top       svarint, delta from the previous word's top
+//   left      svarint, delta from the previous word's right edge
+//   width     varint
+//   height    varint
+//   baseline  svarint, delta from this word's top
+//   text      varint, index into the string table
+//
+// Varints are little-endian base-128 (7 bits per byte, high bit set
+// on all but the last byte); svarints are zigzag-encoded varints.
+// The "previous word" values start at zero on each page.  The word
+// text is unescaped, and includes the trailing space, exactly as in
+// the JSON output.
+//
+//------------------------------------------------------------------------
+
+#define jsonBinMagic    "PJB"
+#define jsonBinMagicLen 3
+#define jsonBinVersion  2
+
+// Fixed-point scale for the dpi field.
+#define jsonBinDPIScale 10000
+
+// Page flags.
+#define jsonBinTruncated 0x01	// page ran over a budget (see JSONGen)
+
+//------------------------------------------------------------------------
+
+struct JSONBinWord {
+  int top, left, width, height, baseline;
+  int text;			// index into JSONBinPage::strings
+};
+
+// A decoded page record.  The strings point into the reader's record
+// buffer (they are not NUL-terminated), and everything is only valid
+// until the next call to JSONBinReader::nextPage.
+struct JSONBinPage {
+  int number;
+  int pages;
+  int width, height;
+  double dpi;
+  GBool truncated;
+  const char *formFields;
+  int formFieldsLen;
+  int nStrings;
+  const char **strings;
+  int *stringLens;
+  int nWords;
+  JSONBinWord *words;
+};
+
+//------------------------------------------------------------------------
+// JSONBinReader
+//------------------------------------------------------------------------
+
+class JSONBinReader {
+public:
+
+  // Read records from <fA>, which can be a pipe.  The file is not
+  // closed by the reader.
+  JSONBinReader(FILE *fA);
+  ~JSONBinReader();
+
+  // Check the magic number and version.
+  GBool isOk() { return ok; }
+
+  // Decode the next page.  Returns NULL at end of file, or if the
+  // record is corrupt (in which case isCorrupt returns true).
+  JSONBinPage *nextPage();
+
+  GBool isCorrupt() { return corrupt; }
+
+private:
+
+  GBool readVarint(Guint *x);
+  GBool decodePage();
+
+  FILE *f;
+  char *buf;			// current record
+  int bufSize;
+  const char *p, *end;		// decode position in buf
+  JSONBinPage page;
+  int stringsSize;		// allocated size of page.strings
+  int wordsSize;		// allocated size of page.words
+  GBool ok;
+  GBool corrupt;
+};
+
+#endif
@@ -27,11 +27,16 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <png.h>
 #include "gmem.h"
 #include "GString.h"
 #include "GList.h"
+#include "GHash.h"
 #include "SplashBitmap.h"
+#include "Object.h"
+#include "Stream.h"
 #include "PDFDoc.h"
 #include "TextOutputDev.h"
 #include "SplashOutputDev.h"
@@ -42,7 +47,9 @@
 #  include "BuiltinFontTables.h"
 #  include "FontEncodingTables.h"
 #endif
+#include "JSONBinary.h"
 #include "JSONGen.h"
+#include "UTF8.h"
 
 #ifdef _WIN32
 #  define strcasecmp stricmp
@@ -234,6 +241,20 @@ JSONGen::JSONGen(double backgroundResolutionA) {
   ok = gTrue;
 
   backgroundResolution = backgroundResolutionA;
+  maxPixels = maxWidth = maxHeight = 0;
+  binaryOutput = gFalse;
+  pngCompressionLevel = -1;
+  pageTimeLimit = 0;
+  maxOps = maxImagePixels = 0;
+  truncated = gFalse;
+  pageStart = 0;
+  memset(&passCounters, 0, sizeof(passCounters));
+  passRenders = gFalse;
+  profile = gFalse;
+  nStages = 0;
+  stageWall = stageCPU = 0;
+  pageChars = pageWords = 0;
+  memset(&pageCounters, 0, sizeof(pageCounters));
   drawInvisibleText = gTrue;
 
   // set up the TextOutputDev
@@ -258,11 +279,143 @@ JSONGen::~JSONGen() {
   delete splashOut;
 }
 
+PDFDoc *JSONGen::openDoc(char *buf, Guint len, GString *ownerPassword,
+			 GString *userPassword) {
+  Object obj;
+
+  obj.initNull();
+  return new PDFDoc(new MemStream(buf, 0, len, &obj),
+		    ownerPassword, userPassword);
+}
+
 void JSONGen::startDoc(PDFDoc *docA) {
   doc = docA;
   splashOut->startDoc(doc->getXRef());
 }
 
+double JSONGen::getPageResolution(int pg) {
+  double w, h, res, r;
+  int rot;
+
+  if (maxPixels <= 0 && maxWidth <= 0 && maxHeight <= 0) {
+    return backgroundResolution;
+  }
+
+  // size of the rendered page, in points
+  w = doc->getPageCropWidth(pg);
+  h = doc->getPageCropHeight(pg);
+  rot = doc->getPageRotate(pg);
+  if (rot == 90 || rot == 270) {
+    r = w;  w = h;  h = r;
+  }
+  if (w < 1) {
+    w = 1;
+  }
+  if (h < 1) {
+    h = 1;
+  }
+
+  res = 0;
+  if (maxWidth > 0) {
+    res = 72 * maxWidth / w;
+  }
+  if (maxHeight > 0) {
+    r = 72 * maxHeight / h;
+    if (res == 0 || r < res) {
+      res = r;
+    }
+  }
+  if (maxPixels > 0) {
+    r = 72 * sqrt(maxPixels / (w * h));
+    if (res == 0 || r < res) {
+      res = r;
+    }
+    // SplashOutputDev rounds the bitmap size to the nearest pixel,
+    // which can push it just over the budget
+    while (res > 1 &&
+	   (double)(int)(w * res / 72 + 0.5) * (int)(h * res / 72 + 0.5)
+	     > maxPixels) {
+      res *= 0.999;
+    }
+  }
+  return res;
+}
+
+// Run one pass over page <pg>, with the abort callback if there are
+// any budgets.  <render> is set for the passes that decode images.
+void JSONGen::displayPage(OutputDev *out, int pg, double res,
+			  GBool render) {
+  if (pageTimeLimit <= 0 && maxOps <= 0 && maxImagePixels <= 0) {
+    doc->displayPage(out, pg, res, res, 0, gFalse, gTrue, gFalse);
+    return;
+  }
+  passCounters = perfCounters;
+  passRenders = render;
+  doc->displayPage(out, pg, res, res, 0, gFalse, gTrue, gFalse,
+		   &abortCheck, this);
+}
+
+GBool JSONGen::abortCheck(void *data) {
+  return ((JSONGen *)data)->checkBudget();
+}
+
+// Called by Gfx after every operator, and before drawing each image.
+// The op and pixel counts are per pass, since every pass runs the
+// same content streams; the time limit covers the whole page.
+GBool JSONGen::checkBudget() {
+  if ((maxOps > 0 &&
+       perfCounters.ops - passCounters.ops > maxOps) ||
+      (maxImagePixels > 0 && passRenders &&
+       perfCounters.imagePixels - passCounters.imagePixels
+         > maxImagePixels) ||
+      (pageTimeLimit > 0 && perfWallTime() - pageStart > pageTimeLimit)) {
+    truncated = gTrue;
+    return gTrue;
+  }
+  return gFalse;
+}
+
+void JSONGen::startStage(const char *name) {
+  if (profile) {
+    stageWall = perfWallTime();
+    stageCPU = perfCPUTime();
+  }
+  if (perfTraceEnabled) {
+    perfTraceBegin("pdftojson", name);
+  }
+}
+
+// End the current stage.  Stages that are entered more than once are
+// added up.
+void JSONGen::endStage(const char *name) {
+  JSONGenStage *st;
+  double wall, cpu;
+  int i;
+
+  if (perfTraceEnabled) {
+    perfTraceEnd();
+  }
+  if (!profile) {
+    return;
+  }
+  wall = perfWallTime() - stageWall;
+  cpu = perfCPUTime() - stageCPU;
+  for (i = 0; i < nStages; ++i) {
+    if (!strcmp(stages[i].name, name)) {
+      stages[i].wall += wall;
+      stages[i].cpu += cpu;
+      return;
+    }
+  }
+  if (nStages < jsonGenMaxStages) {
+    st = &stages[nStages++];
+    st->name = name;
+    st->start = stageWall;
+    st->wall = wall;
+    st->cpu = cpu;
+  }
+}
+
 static inline int pr(int (*writeFunc)(void *stream, const char *data, int size),
 		     void *stream, const char *data) {
   return writeFunc(stream, data, (int)strlen(data));
@@ -320,20 +473,55 @@ int JSONGen::convertPage(
     int y, i, u;
     double xMin, xMax;		// bounding box x coordinates
     double yMin, yMax;		// bounding box y coordinates
+    double res;
+
+    res = getPageResolution(pg);
+
+    nStages = 0;
+    pageChars = pageWords = 0;
+    pageCounters = perfCounters;
+    truncated = gFalse;
+    pageStart = perfWallTime();
+
+    // page size
+    pageW = doc->getPageCropWidth(pg);
+    pageH = doc->getPageCropHeight(pg);
+
+    // get the PDF text -- this comes first so that it survives if
+    // rendering runs out of time
+    startStage("text");
+    displayPage(textOut, pg, 72, gFalse);
+    endStage("text");
+    startStage("links");
+    doc->processLinks(textOut, pg);
+    endStage("links");
+    //printf("Processing forms\n");
+    startStage("forms");
+    doc->processForms(textOut, pg);
+    // important to call getTextoutFormFields before takeText because takeText clears the TextPage
+    GString *formfields = textOut->getTextoutFormFields();
+    endStage("forms");
+    text = textOut->takeText();
 
     if (createPng)
     {
         // generate the background bitmap (no text)
+        startStage("render-notext");
         splashOut->setSkipText(gTrue, gTrue);//horizontal but also non horizontal (e.g. Italic)
-        doc->displayPage(splashOut, pg, backgroundResolution, backgroundResolution,
-           0, gFalse, gTrue, gFalse);
+        displayPage(splashOut, pg, res, gTrue);
+        endStage("render-notext");
+        startStage("png-notext");
         bitmap = splashOut->getBitmap();
         if (!(png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
         NULL, NULL, NULL)) ||
         !(pngInfo = png_create_info_struct(png))) {
+        delete formfields;
+        delete text;
         return errFileIO;
         }
         if (setjmp(png_jmpbuf(png))) {
+        delete formfields;
+        delete text;
         return errFileIO;
         }
         writeInfo.writePNG = writePNG;
@@ -348,6 +536,9 @@ int JSONGen::convertPage(
                      8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
                      PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 #endif
+        if (pngCompressionLevel >= 0) {
+            png_set_compression_level(png, pngCompressionLevel);
+        }
         png_write_info(png, pngInfo);
         p = bitmap->getDataPtr();
         for (y = 0; y < bitmap->getHeight(); ++y) {
@@ -356,21 +547,28 @@ int JSONGen::convertPage(
         }
         png_write_end(png, pngInfo);
         png_destroy_write_struct(&png, &pngInfo);
+        endStage("png-notext");
     }
 
     if (pngStream2 != NULL)
     {
         // generate bitmap (with text drawn)
+        startStage("render");
         splashOut->setSkipText(gFalse, gFalse);
-        doc->displayPage(splashOut, pg, backgroundResolution, backgroundResolution,
-                         0, gFalse, gTrue, gFalse);
+        displayPage(splashOut, pg, res, gTrue);
+        endStage("render");
+        startStage("png");
         bitmap = splashOut->getBitmap();
         if (!(png = png_create_write_struct(PNG_LIBPNG_VER_STRING,
                                             NULL, NULL, NULL)) ||
             !(pngInfo = png_create_info_struct(png))) {
+            delete formfields;
+            delete text;
             return errFileIO;
         }
         if (setjmp(png_jmpbuf(png))) {
+            delete formfields;
+            delete text;
             return errFileIO;
         }
         writeInfo.writePNG = writePNG;
@@ -379,6 +577,9 @@ int JSONGen::convertPage(
         png_set_IHDR(png, pngInfo, bitmap->getWidth(), bitmap->getHeight(),
                      8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
                      PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        if (pngCompressionLevel >= 0) {
+            png_set_compression_level(png, pngCompressionLevel);
+        }
         png_write_info(png, pngInfo);
         p = bitmap->getDataPtr();
         for (y = 0; y < bitmap->getHeight(); ++y) {
@@ -387,25 +588,37 @@ int JSONGen::convertPage(
         }
         png_write_end(png, pngInfo);
         png_destroy_write_struct(&png, &pngInfo);
+        endStage("png");
     }
 
-    // page size
-    pageW = doc->getPageCropWidth(pg);
-    pageH = doc->getPageCropHeight(pg);
-    
-    // get the PDF text
-    doc->displayPage(textOut, pg, 72, 72, 0, gFalse, gTrue, gFalse);
-    doc->processLinks(textOut, pg);
-    //printf("Processing forms\n");
-    doc->processForms(textOut, pg);
-    // important to call getTextoutFormFields before takeText because takeText clears the TextPage
-    GString *formfields = textOut->getTextoutFormFields();
-    text = textOut->takeText();
-    fprintf((FILE*)htmlStream,"{\"formfields\":%s,\"pages\":%d,\"number\":%d,\"width\":%d,\"height\":%d,\"text\":[",formfields->getCString(),doc->getNumPages(),pg,(int)pageW,(int)pageH);
+    if (binaryOutput) {
+        writeBinaryPage(pg, pageW, pageH, res, formfields, text,
+                        writeHTML, htmlStream);
+        delete formfields;
+        delete text;
+        finishPageCounters();
+        return errNone;
+    }
+    startStage("json");
+    // the page object must stay on a single line (see pdftojson -ndjson),
+    // and must go through writeHTML rather than straight to the stream
+    s = GString::format("{{\"formfields\":{0:t},\"pages\":{1:d},"
+                        "\"number\":{2:d},\"width\":{3:d},"
+                        "\"height\":{4:d},\"dpi\":{5:.4g},{6:s}\"text\":[",
+                        formfields, doc->getNumPages(), pg,
+                        (int)pageW, (int)pageH, res,
+                        truncated ? "\"truncated\":true," : "");
+    pr(writeHTML, htmlStream, s->getCString());
+    delete s;
+    delete formfields;
+    endStage("json");
     
     first=0;
     // generate the JSON text
+    startStage("layout");
     cols = text->makeColumns();
+    endStage("layout");
+    startStage("json");
     for (colIdx = 0; colIdx < cols->getLength(); ++colIdx) {
         col = (TextColumn *)cols->get(colIdx);
         pars = col->getParagraphs();
@@ -430,6 +643,8 @@ int JSONGen::convertPage(
                     if (!drawInvisibleText && word1->isInvisible()) {
                         continue;
                     }
+                    ++pageWords;
+                    pageChars += word1->getLength();
                     word1->getBBox(&xMin, &yMin, &xMax, &yMax);
                     s->appendf("[{0:d},{1:d},{2:d},{3:d},{4:d},\"",(int)yMin, (int)xMin, (int)(xMax-xMin), (int)(yMax-yMin),(int)word1->getBaseline());
                     for (i = 0; i < word1->getLength(); ++i) {
@@ -508,9 +723,163 @@ int JSONGen::convertPage(
     pr(writeHTML, htmlStream, "]}");
     delete text;
     deleteGList(cols, TextColumn);
+    endStage("json");
+    finishPageCounters();
     return errNone;
 }
 
+// Turn pageCounters, which holds the counters at the start of the
+// page, into the work done on the page.
+void JSONGen::finishPageCounters() {
+    pageCounters.ops = perfCounters.ops - pageCounters.ops;
+    pageCounters.images = perfCounters.images - pageCounters.images;
+    pageCounters.imagePixels =
+        perfCounters.imagePixels - pageCounters.imagePixels;
+    pageCounters.inflatedBytes =
+        perfCounters.inflatedBytes - pageCounters.inflatedBytes;
+}
+
+//------------------------------------------------------------------------
+// binary output (see JSONBinary.h)
+//------------------------------------------------------------------------
+
+static void appendVarint(GString *s, Guint x) {
+    while (x >= 0x80) {
+        s->append((char)((x & 0x7f) | 0x80));
+        x >>= 7;
+    }
+    s->append((char)x);
+}
+
+static inline void appendSVarint(GString *s, int x) {
+    appendVarint(s, ((Guint)x << 1) ^ (Guint)(x >> 31));
+}
+
+void JSONGen::writeBinaryHeader(
+		 int (*writeHTML)(void *stream, const char *data, int size),
+		 void *htmlStream) {
+    char hdr[jsonBinMagicLen + 1];
+
+    memcpy(hdr, jsonBinMagic, jsonBinMagicLen);
+    hdr[jsonBinMagicLen] = jsonBinVersion;
+    writeHTML(htmlStream, hdr, jsonBinMagicLen + 1);
+}
+
+void JSONGen::writeBinaryPage(
+		 int pg, double pageW, double pageH, double res,
+		 GString *formfields, TextPage *text,
+		 int (*writeHTML)(void *stream, const char *data, int size),
+		 void *htmlStream) {
+    GList *cols, *pars, *lines, *words;
+    TextColumn *col;
+    TextParagraph *par;
+    TextLine *line;
+    TextWord *word1;
+    GHash *strIdx;
+    GString *strs, *wordBuf, *t, *rec, *len;
+    double xMin, xMax, yMin, yMax;
+    char buf[8];
+    int colIdx, parIdx, lineIdx, wordIdx;
+    int nStrings, nWords, idx, top, left, right, i, n;
+    Unicode u;
+
+    // the strings are interned per page, so repeated words ("the",
+    // "of", ...) are stored once
+    strIdx = new GHash(gTrue);
+    strs = new GString();
+    wordBuf = new GString();
+    nStrings = nWords = 0;
+    top = right = 0;
+    startStage("layout");
+    cols = text->makeColumns();
+    endStage("layout");
+    startStage("binary");
+    for (colIdx = 0; colIdx < cols->getLength(); ++colIdx) {
+        col = (TextColumn *)cols->get(colIdx);
+        pars = col->getParagraphs();
+        for (parIdx = 0; parIdx < pars->getLength(); ++parIdx) {
+            par = (TextParagraph *)pars->get(parIdx);
+            lines = par->getLines();
+            for (lineIdx = 0; lineIdx < lines->getLength(); ++lineIdx) {
+                line = (TextLine *)lines->get(lineIdx);
+                if (line->getRotation() != 0) {
+                    continue;
+                }
+                words = line->getWords();
+                for (wordIdx = 0; wordIdx < words->getLength(); ++wordIdx) {
+                    word1 = (TextWord *)words->get(wordIdx);
+                    if (!drawInvisibleText && word1->isInvisible()) {
+                        continue;
+                    }
+                    ++pageWords;
+                    pageChars += word1->getLength();
+                    t = new GString();
+                    for (i = 0; i < word1->getLength(); ++i) {
+                        u = word1->getChar(i);
+                        if (u >= privateUnicodeMapStart &&
+                            u <= privateUnicodeMapEnd &&
+                            privateUnicodeMap[u - privateUnicodeMapStart]) {
+                            u = privateUnicodeMap[u - privateUnicodeMapStart];
+                        }
+                        n = mapUTF8(u, buf, sizeof(buf));
+                        t->append(buf, n);
+                    }
+                    if (word1->getSpaceAfter()) {
+                        t->append(' ');
+                    }
+                    if ((idx = strIdx->lookupInt(t))) {
+                        delete t;
+                    } else {
+                        appendVarint(strs, t->getLength());
+                        strs->append(t);
+                        idx = ++nStrings;
+                        strIdx->add(t, idx);
+                    }
+
+                    word1->getBBox(&xMin, &yMin, &xMax, &yMax);
+                    left = (int)xMin;
+                    appendSVarint(wordBuf, (int)yMin - top);
+                    appendSVarint(wordBuf, left - right);
+                    appendVarint(wordBuf, (int)(xMax - xMin));
+                    appendVarint(wordBuf, (int)(yMax - yMin));
+                    appendSVarint(wordBuf,
+                                  (int)word1->getBaseline() - (int)yMin);
+                    appendVarint(wordBuf, idx - 1);
+                    top = (int)yMin;
+                    right = left + (int)(xMax - xMin);
+                    ++nWords;
+                }
+            }
+        }
+    }
+    deleteGList(cols, TextColumn);
+    delete strIdx;
+
+    rec = new GString();
+    appendVarint(rec, pg);
+    appendVarint(rec, doc->getNumPages());
+    appendVarint(rec, (int)pageW);
+    appendVarint(rec, (int)pageH);
+    appendVarint(rec, (Guint)(res * jsonBinDPIScale + 0.5));
+    appendVarint(rec, truncated ? jsonBinTruncated : 0);
+    appendVarint(rec, formfields->getLength());
+    rec->append(formfields);
+    appendVarint(rec, nStrings);
+    rec->append(strs);
+    appendVarint(rec, nWords);
+    rec->append(wordBuf);
+    delete strs;
+    delete wordBuf;
+
+    len = new GString();
+    appendVarint(len, rec->getLength());
+    writeHTML(htmlStream, len->getCString(), len->getLength());
+    writeHTML(htmlStream, rec->getCString(), rec->getLength());
+    delete len;
+    delete rec;
+    endStage("binary");
+}
+
 /*GString *JSONGen::getFontDefn(TextFontInfo *font, double *scale) {
   GString *fontName;
   char *fontName2;
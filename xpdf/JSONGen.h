@@ -15,14 +15,31 @@
 #pragma interface
 #endif
 
+#include "gtypes.h"
+#include "PerfCounters.h"
+
 class GString;
 class PDFDoc;
 class TextOutputDev;
 class TextFontInfo;
+class TextPage;
+class OutputDev;
 class SplashOutputDev;
 
 //------------------------------------------------------------------------
 
+#define jsonGenMaxStages 16
+
+// Time spent in one stage of convertPage (see JSONGen::setProfile).
+struct JSONGenStage {
+  const char *name;
+  double start;			// perfWallTime() at the start of the stage
+  double wall;			// elapsed wall clock time, in seconds
+  double cpu;			// elapsed CPU time, in seconds
+};
+
+//------------------------------------------------------------------------
+
 class JSONGen {
 public:
 
@@ -35,10 +52,66 @@ public:
   void setBackgroundResolution(double backgroundResolutionA)
     { backgroundResolution = backgroundResolutionA; }
 
+  // Pixel budget for the page images.  If any of these are non-zero,
+  // each page is rendered at the largest resolution that fits all of
+  // them, and the background resolution is ignored.
+  void setMaxPixels(int maxPixelsA) { maxPixels = maxPixelsA; }
+  void setMaxWidth(int maxWidthA) { maxWidth = maxWidthA; }
+  void setMaxHeight(int maxHeightA) { maxHeight = maxHeightA; }
+
+  // Returns the resolution used for the images of page <pg>.
+  double getPageResolution(int pg);
+
+  // Write page records in the binary format described in JSONBinary.h
+  // instead of JSON.  The caller must write the file header first
+  // with writeBinaryHeader.
+  GBool getBinaryOutput() { return binaryOutput; }
+  void setBinaryOutput(GBool binaryOutputA) { binaryOutput = binaryOutputA; }
+  void writeBinaryHeader(
+		 int (*writeHTML)(void *stream, const char *data, int size),
+		 void *htmlStream);
+
+  // zlib compression level (0-9) for the PNG files; -1 uses the
+  // libpng default.
+  void setPNGCompressionLevel(int level) { pngCompressionLevel = level; }
+
+  // Per-page budgets (zero means no limit): wall clock time for the
+  // whole page, in seconds; content stream operators per pass over
+  // the page; and decoded image pixels per rendering pass.  A page
+  // that runs over is cut off, and written with whatever text was
+  // collected, and with "truncated":true.  The text is extracted
+  // before the page images are rendered, so a slow render doesn't
+  // lose the text.
+  void setPageTimeLimit(double seconds) { pageTimeLimit = seconds; }
+  void setMaxOps(int maxOpsA) { maxOps = maxOpsA; }
+  void setMaxImagePixels(int maxImagePixelsA)
+    { maxImagePixels = maxImagePixelsA; }
+
+  // Returns true if the last page converted ran over a budget.
+  GBool getPageTruncated() { return truncated; }
+
+  // Record the time spent in each stage of convertPage, and count
+  // the work done.  The results for the last page converted are
+  // available from the getters below.  The counters cover all of the
+  // passes over the page (text, and the PNG images if any).
+  void setProfile(GBool profileA) { profile = profileA; }
+  int getNumStages() { return nStages; }
+  JSONGenStage *getStage(int i) { return &stages[i]; }
+  int getPageChars() { return pageChars; }
+  int getPageWords() { return pageWords; }
+  PerfCounters *getPageCounters() { return &pageCounters; }
+
   GBool getDrawInvisibleText() { return drawInvisibleText; }
   void setDrawInvisibleText(GBool drawInvisibleTextA)
     { drawInvisibleText = drawInvisibleTextA; }
 
+  // Open a PDF file held in memory (<len> bytes at <buf>) without
+  // copying it.  The buffer must stay valid, and unchanged, until the
+  // PDFDoc is deleted.  Check isOk() on the result.
+  static PDFDoc *openDoc(char *buf, Guint len,
+			 GString *ownerPassword = NULL,
+			 GString *userPassword = NULL);
+
   void startDoc(PDFDoc *docA);
   int convertPage(int pg,
                   int (*writeHTML)(void *stream, const char *data, int size),
@@ -48,10 +121,38 @@ public:
 private:
 
   GString *getFontDefn(TextFontInfo *font, double *scale);
+  void displayPage(OutputDev *out, int pg, double res, GBool render);
+  static GBool abortCheck(void *data);
+  GBool checkBudget();
+  void startStage(const char *name);
+  void endStage(const char *name);
+  void finishPageCounters();
+  void writeBinaryPage(int pg, double pageW, double pageH, double res,
+		       GString *formfields, TextPage *text,
+		       int (*writeHTML)(void *stream, const char *data,
+					int size),
+		       void *htmlStream);
 
   double backgroundResolution;
+  int maxPixels, maxWidth, maxHeight;
+  GBool binaryOutput;
+  int pngCompressionLevel;
   GBool drawInvisibleText;
 
+  double pageTimeLimit;
+  int maxOps, maxImagePixels;
+  GBool truncated;		// the current page ran over a budget
+  double pageStart;		// perfWallTime() at the start of the page
+  PerfCounters passCounters;	// counters at the start of the pass
+  GBool passRenders;		// the current pass decodes images
+
+  GBool profile;
+  JSONGenStage stages[jsonGenMaxStages];
+  int nStages;
+  double stageWall, stageCPU;	// start of the current stage
+  int pageChars, pageWords;
+  PerfCounters pageCounters;
+
   PDFDoc *doc;
   TextOutputDev *textOut;
   SplashOutputDev *splashOut;
@@ -223,14 +223,8 @@ GBool PDFDoc::setup(GString *ownerPassword, GString *userPassword) {
     }
   }
 
-#ifndef DISABLE_OUTLINE
-  // read outline
-  outline = new Outline(catalog->getOutline(), xref);
-#endif
-
-  // read the optional content info
-  optContent = new OptionalContent(this);
-
+  // the outline and the optional content info are read on first use,
+  // by getOutline() and getOptionalContent()
 
   // done
   return gTrue;
@@ -268,9 +262,37 @@ GBool PDFDoc::setup2(GString *ownerPassword, GString *userPassword,
     return gFalse;
   }
 
+  // xref sections are decoded on first use, so reading the catalog
+  // may have found one that is damaged beyond repair
+  if (!xref->isOk()) {
+    error(errSyntaxError, -1, "Couldn't read xref table");
+    errCode = xref->getErrorCode();
+    delete catalog;
+    catalog = NULL;
+    delete xref;
+    xref = NULL;
+    return gFalse;
+  }
+
   return gTrue;
 }
 
+#ifndef DISABLE_OUTLINE
+Outline *PDFDoc::getOutline() {
+  if (!outline) {
+    outline = new Outline(catalog->getOutline(), xref);
+  }
+  return outline;
+}
+#endif
+
+OptionalContent *PDFDoc::getOptionalContent() {
+  if (!optContent) {
+    optContent = new OptionalContent(this);
+  }
+  return optContent;
+}
+
 PDFDoc::~PDFDoc() {
   if (optContent) {
     delete optContent;
@@ -131,12 +131,14 @@ public:
   void processForms(OutputDev *out, int page);
 
 #ifndef DISABLE_OUTLINE
-  // Return the outline object.
-  Outline *getOutline() { return outline; }
+  // Return the outline object.  The outline is read on the first
+  // call.
+  Outline *getOutline();
 #endif
 
-  // Return the OptionalContent object.
-  OptionalContent *getOptionalContent() { return optContent; }
+  // Return the OptionalContent object.  It is built on the first
+  // call.
+  OptionalContent *getOptionalContent();
 
   // Is the file encrypted?
   GBool isEncrypted() { return xref->isEncrypted(); }
@@ -0,0 +1,310 @@
+//========================================================================
+//
+// PageChanges.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "gmem.h"
+#include "Object.h"
+#include "Array.h"
+#include "Dict.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "PDFDoc.h"
+#include "PageChanges.h"
+
+//------------------------------------------------------------------------
+
+// Catalog entries that apply to every page.
+static const char *pageChangesGlobalKeys[] = {
+  "OCProperties",
+  "Names",
+  "Dests",
+  NULL
+};
+
+// Page attributes that can be inherited from the page tree.
+static const char *pageChangesInheritedKeys[] = {
+  "Resources",
+  "MediaBox",
+  "CropBox",
+  "Rotate",
+  NULL
+};
+
+//------------------------------------------------------------------------
+// PageChanges
+//------------------------------------------------------------------------
+
+PageChanges::PageChanges(PDFDoc *docA, GFileOffset prevSize) {
+  Object pageObj;
+  Ref *ref;
+  int n, pg;
+
+  doc = docA;
+  xref = doc->getXRef();
+  numObjects = xref->getNumObjects();
+  nUpdates = 0;
+  updated = NULL;
+  visited = NULL;
+  pass = 0;
+  refStack = NULL;
+  refStackLen = refStackSize = 0;
+  hit = gFalse;
+  nPages = doc->getNumPages();
+  changed = (GBool *)gmallocn(nPages, sizeof(GBool));
+  for (pg = 0; pg < nPages; ++pg) {
+    changed[pg] = gTrue;
+  }
+  nChanged = nPages;
+  ok = gFalse;
+
+  // find the updates made since the earlier revision -- there must
+  // be at least one xref section left over from that revision
+  n = xref->getNumUpdates();
+  if (prevSize > 0) {
+    while (nUpdates < n && xref->getUpdatePos(nUpdates) >= prevSize) {
+      ++nUpdates;
+    }
+  } else {
+    nUpdates = 1;
+  }
+  if (nUpdates >= n) {
+    return;
+  }
+
+  updated = (char *)gmalloc(numObjects);
+  memset(updated, 0, numObjects);
+  xref->getUpdatedObjects(nUpdates, updated);
+  visited = (int *)gmallocn(numObjects, sizeof(int));
+  memset(visited, 0, numObjects * sizeof(int));
+
+  if (!checkGlobals()) {
+    return;
+  }
+
+  nChanged = 0;
+  for (pg = 1; pg <= nPages; ++pg) {
+    ++pass;
+    refStackLen = 0;
+    hit = gFalse;
+    ref = doc->getCatalog()->getPageRef(pg);
+    if (ref->num < 0 || ref->num >= numObjects) {
+      ++nChanged;
+      continue;
+    }
+    visited[ref->num] = pass;
+    if (!xref->fetch(ref->num, ref->gen, &pageObj)->isDict()) {
+      pageObj.free();
+      ++nChanged;
+      continue;
+    }
+    if (!checkPageTree(&pageObj)) {
+      pageObj.free();
+      goto err;
+    }
+    addRefs(&pageObj, gTrue);
+    pageObj.free();
+    changed[pg - 1] = updated[ref->num] || scan();
+    if (changed[pg - 1]) {
+      ++nChanged;
+    }
+  }
+
+  // fetching a bad object can make XRef rebuild the xref table, which
+  // throws away the updates
+  if (xref->getNumUpdates() == 0) {
+    goto err;
+  }
+
+  ok = gTrue;
+  return;
+
+ err:
+  for (pg = 0; pg < nPages; ++pg) {
+    changed[pg] = gTrue;
+  }
+  nChanged = nPages;
+}
+
+PageChanges::~PageChanges() {
+  gfree(updated);
+  gfree(visited);
+  gfree(refStack);
+  gfree(changed);
+}
+
+// Check the catalog entries that affect every page.  Returns false if
+// any of them (or the catalog itself) was updated.  The form fields
+// are left out, since each one only shows up on the pages that have
+// its widgets; only the AcroForm dictionary itself and its field list
+// are checked.
+GBool PageChanges::checkGlobals() {
+  Object catObj, acroForm, obj;
+  int i;
+
+  if (xref->getRootNum() < 0 || xref->getRootNum() >= numObjects ||
+      updated[xref->getRootNum()]) {
+    return gFalse;
+  }
+  ++pass;
+  refStackLen = 0;
+  hit = gFalse;
+  if (!xref->getCatalog(&catObj)->isDict()) {
+    catObj.free();
+    return gFalse;
+  }
+  for (i = 0; pageChangesGlobalKeys[i]; ++i) {
+    catObj.dictLookupNF(pageChangesGlobalKeys[i], &obj);
+    addRefs(&obj, gFalse);
+    obj.free();
+  }
+  catObj.dictLookupNF("AcroForm", &obj);
+  if (obj.isRef()) {
+    pushRef(obj.getRefNum(), obj.getRefGen());
+    obj.fetch(xref, &acroForm);
+  } else {
+    obj.copy(&acroForm);
+  }
+  obj.free();
+  catObj.free();
+  if (acroForm.isDict()) {
+    for (i = 0; i < acroForm.dictGetLength(); ++i) {
+      acroForm.dictGetValNF(i, &obj);
+      if (!strcmp(acroForm.dictGetKey(i), "Fields")) {
+	if (obj.isRef() && obj.getRefNum() >= 0 &&
+	    obj.getRefNum() < numObjects && updated[obj.getRefNum()]) {
+	  hit = gTrue;
+	}
+      } else {
+	addRefs(&obj, gFalse);
+      }
+      obj.free();
+    }
+  }
+  acroForm.free();
+  return !scan();
+}
+
+// Check the page tree nodes above a page, and queue up the attributes
+// the page can inherit from them.  Returns false if a node, or its
+// Kids array, was updated -- the pages may have been added, removed,
+// or moved around.
+GBool PageChanges::checkPageTree(Object *pageObj) {
+  Object node, parent, obj;
+  int num, i;
+
+  pageObj->dictLookupNF("Parent", &parent);
+  while (parent.isRef()) {
+    num = parent.getRefNum();
+    if (num < 0 || num >= numObjects || visited[num] == pass) {
+      break;
+    }
+    visited[num] = pass;
+    if (updated[num]) {
+      parent.free();
+      return gFalse;
+    }
+    parent.fetch(xref, &node);
+    parent.free();
+    if (!node.isDict()) {
+      node.free();
+      return gFalse;
+    }
+    node.dictLookupNF("Kids", &obj);
+    if (obj.isRef() && obj.getRefNum() >= 0 &&
+	obj.getRefNum() < numObjects && updated[obj.getRefNum()]) {
+      obj.free();
+      node.free();
+      return gFalse;
+    }
+    obj.free();
+    for (i = 0; pageChangesInheritedKeys[i]; ++i) {
+      node.dictLookupNF(pageChangesInheritedKeys[i], &obj);
+      addRefs(&obj, gFalse);
+      obj.free();
+    }
+    node.dictLookupNF("Parent", &parent);
+    node.free();
+  }
+  parent.free();
+  return gTrue;
+}
+
+// Follow the queued refs until an updated object turns up.  Returns
+// true if one did.  Other pages (e.g., link destinations) and page
+// tree nodes are not followed.
+GBool PageChanges::scan() {
+  Object obj, type;
+  Ref ref;
+
+  while (!hit && refStackLen > 0) {
+    ref = refStack[--refStackLen];
+    xref->fetch(ref.num, ref.gen, &obj);
+    if (obj.isDict()) {
+      obj.dictLookupNF("Type", &type);
+      if (!type.isName("Page") && !type.isName("Pages")) {
+	addRefs(&obj, gFalse);
+      }
+      type.free();
+    } else {
+      addRefs(&obj, gFalse);
+    }
+    obj.free();
+  }
+  return hit;
+}
+
+// Queue up the refs in <obj>, a direct object.  <pageDict> is set for
+// the page object itself, whose Parent is handled by checkPageTree.
+void PageChanges::addRefs(Object *obj, GBool pageDict) {
+  Object obj2;
+  Dict *dict;
+  int i;
+
+  if (hit) {
+    return;
+  }
+  if (obj->isRef()) {
+    pushRef(obj->getRefNum(), obj->getRefGen());
+  } else if (obj->isArray()) {
+    for (i = 0; i < obj->arrayGetLength() && !hit; ++i) {
+      addRefs(obj->arrayGetNF(i, &obj2), gFalse);
+      obj2.free();
+    }
+  } else if (obj->isDict() || obj->isStream()) {
+    dict = obj->isDict() ? obj->getDict() : obj->streamGetDict();
+    for (i = 0; i < dict->getLength() && !hit; ++i) {
+      if (pageDict && !strcmp(dict->getKey(i), "Parent")) {
+	continue;
+      }
+      addRefs(dict->getValNF(i, &obj2), gFalse);
+      obj2.free();
+    }
+  }
+}
+
+void PageChanges::pushRef(int num, int gen) {
+  if (num < 0 || num >= numObjects || visited[num] == pass) {
+    return;
+  }
+  visited[num] = pass;
+  if (updated[num]) {
+    hit = gTrue;
+    return;
+  }
+  if (refStackLen == refStackSize) {
+    refStackSize = refStackSize ? 2 * refStackSize : 64;
+    refStack = (Ref *)greallocn(refStack, refStackSize, sizeof(Ref));
+  }
+  refStack[refStackLen].num = num;
+  refStack[refStackLen].gen = gen;
+  ++refStackLen;
+}
@@ -0,0 +1,87 @@
+//========================================================================
+//
+// PageChanges.h
+//
+// Finds the pages affected by the incremental updates appended to a
+// PDF file since an earlier revision, so that only those pages need
+// to be converted again.
+//
+//========================================================================
+
+#ifndef PAGECHANGES_H
+#define PAGECHANGES_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#include "gfile.h"
+#include "Object.h"
+
+class PDFDoc;
+class XRef;
+
+//------------------------------------------------------------------------
+// PageChanges
+//------------------------------------------------------------------------
+
+// A page is changed if its page object, or any object it leads to
+// (contents, resources, annotations, and the form fields behind its
+// widgets, plus the attributes it inherits from the page tree) is
+// listed in one of the updates.  Other pages are known to convert to
+// exactly what they did in the earlier revision.
+//
+// Everything is treated as changed (isOk() returns false) if that
+// can't be worked out: the file has no earlier revision, the xref
+// table was reconstructed, or one of the updates touched the page
+// tree nodes, the catalog, or the catalog entries that apply to every
+// page (AcroForm, OCProperties, Names, Dests).
+
+class PageChanges {
+public:
+
+  // Look at the updates appended after the first <prevSize> bytes of
+  // the file.  If <prevSize> is 0, only the newest update is used.
+  PageChanges(PDFDoc *docA, GFileOffset prevSize);
+
+  ~PageChanges();
+
+  // Returns false if every page has to be treated as changed.
+  GBool isOk() { return ok; }
+
+  // Number of updates looked at.
+  int getNumUpdates() { return nUpdates; }
+
+  GBool isPageChanged(int pg) { return changed[pg - 1]; }
+  int getNumChangedPages() { return nChanged; }
+
+private:
+
+  GBool checkGlobals();
+  GBool checkPageTree(Object *pageObj);
+  GBool scan();
+  void addRefs(Object *obj, GBool pageDict);
+  void pushRef(int num, int gen);
+
+  PDFDoc *doc;
+  XRef *xref;
+  int numObjects;
+  int nUpdates;
+  char *updated;		// objects listed in the updates
+				//   [numObjects]
+  int *visited;			// pass that last reached each object
+				//   [numObjects]
+  int pass;
+  Ref *refStack;		// refs still to be followed in this pass
+  int refStackLen, refStackSize;
+  GBool hit;			// an updated object was reached
+  int nPages;
+  GBool *changed;		// [nPages]
+  int nChanged;
+  GBool ok;
+};
+
+#endif
@@ -13,6 +13,7 @@
 #endif
 
 #include <stddef.h>
+#include "gmem.h"
 #include "Object.h"
 #include "Array.h"
 #include "Dict.h"
@@ -44,6 +45,7 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
 		       Guchar *fileKey,
 		       CryptAlgorithm encAlgorithm, int keyLength,
 		       int objNum, int objGen, int recursion) {
+  GMemTagScope memTag(gMemTagParser);
   char *key;
   Stream *str;
   Object obj2;
@@ -0,0 +1,161 @@
+//========================================================================
+//
+// PerfCounters.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#  include <sys/time.h>
+#  include <sys/resource.h>
+#endif
+#include "PerfCounters.h"
+
+//------------------------------------------------------------------------
+
+PerfCounters perfCounters;
+
+//------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+double perfWallTime() {
+  LARGE_INTEGER t, freq;
+
+  QueryPerformanceCounter(&t);
+  QueryPerformanceFrequency(&freq);
+  return (double)t.QuadPart / (double)freq.QuadPart;
+}
+
+double perfCPUTime() {
+  FILETIME create, exit, kernel, user;
+  ULARGE_INTEGER k, u;
+
+  GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user);
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+}
+
+#else
+
+double perfWallTime() {
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+  }
+#endif
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+double perfCPUTime() {
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec * 1e-6 +
+         (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec * 1e-6;
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// trace events
+//------------------------------------------------------------------------
+
+GBool perfTraceEnabled = gFalse;
+
+static FILE *traceFile = NULL;
+static double traceStart;		// perfWallTime() at perfTraceStart
+static GBool traceFirst;		// no events written yet
+static long long traceInflated;		// last inflatedBytes sample
+
+static void traceString(const char *s) {
+  fputc('"', traceFile);
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') {
+      fprintf(traceFile, "\\%c", *s);
+    } else if ((unsigned char)*s < 0x20) {
+      fprintf(traceFile, "\\u%04x", *s);
+    } else {
+      fputc(*s, traceFile);
+    }
+  }
+  fputc('"', traceFile);
+}
+
+// Write the fields common to all events, leaving the object open.
+static void traceEvent(const char *ph) {
+  fprintf(traceFile, "%s\n{\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":1",
+	  traceFirst ? "" : ",", ph, (perfWallTime() - traceStart) * 1e6);
+  traceFirst = gFalse;
+}
+
+GBool perfTraceStart(const char *fileName) {
+  if (!(traceFile = fopen(fileName, "wb"))) {
+    return gFalse;
+  }
+  setvbuf(traceFile, NULL, _IOFBF, 1 << 20);
+  fprintf(traceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  traceStart = perfWallTime();
+  traceFirst = gTrue;
+  traceInflated = perfCounters.inflatedBytes;
+  perfTraceEnabled = gTrue;
+  return gTrue;
+}
+
+void perfTraceStop() {
+  if (!traceFile) {
+    return;
+  }
+  perfTraceEnabled = gFalse;
+  fprintf(traceFile, "\n]}\n");
+  fclose(traceFile);
+  traceFile = NULL;
+}
+
+void perfTraceBegin(const char *cat, const char *name,
+		    const char *argName, const char *arg, int argNum) {
+  if (!traceFile) {
+    return;
+  }
+  traceEvent("B");
+  fprintf(traceFile, ",\"cat\":\"%s\",\"name\":", cat);
+  traceString(name);
+  if (argName) {
+    fprintf(traceFile, ",\"args\":{\"%s\":", argName);
+    if (arg) {
+      traceString(arg);
+    } else {
+      fprintf(traceFile, "%d", argNum);
+    }
+    fputc('}', traceFile);
+  }
+  fputc('}', traceFile);
+}
+
+void perfTraceEnd() {
+  if (!traceFile) {
+    return;
+  }
+  traceEvent("E");
+  fputc('}', traceFile);
+  if (perfCounters.inflatedBytes != traceInflated) {
+    traceInflated = perfCounters.inflatedBytes;
+    traceEvent("C");
+    fprintf(traceFile, ",\"name\":\"inflatedBytes\","
+	    "\"args\":{\"bytes\":%lld}}", traceInflated);
+  }
+}
@@ -0,0 +1,98 @@
+//========================================================================
+//
+// PerfCounters.h
+//
+// Work counters, timers and trace events for profiling (pdftojson
+// -profile and -trace).
+//
+//========================================================================
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <aconf.h>
+
+#include <stddef.h>
+#include "gtypes.h"
+
+//------------------------------------------------------------------------
+
+// These are bumped from the hot paths (Gfx, FlateStream) without any
+// locking, so they only give exact numbers when one document is being
+// processed at a time.  Callers take differences around the work they
+// want to measure.
+struct PerfCounters {
+  long long ops;		// content stream operators executed
+  long long images;		// images drawn
+  long long imagePixels;	// pixels in the images drawn
+  long long inflatedBytes;	// bytes output by FlateStream
+};
+
+extern PerfCounters perfCounters;
+
+//------------------------------------------------------------------------
+
+// Wall clock time and process CPU time, in seconds.  The wall clock
+// is monotonic, from an arbitrary starting point.
+extern double perfWallTime();
+extern double perfCPUTime();
+
+//------------------------------------------------------------------------
+// trace events
+//------------------------------------------------------------------------
+
+// Nested begin/end events in the Chrome trace-event JSON format, which
+// can be loaded into chrome://tracing or Perfetto.  Tracing is off
+// until perfTraceStart is called, and a disabled trace point costs a
+// test of perfTraceEnabled.  Events are written to the file as they
+// happen, all on one track, so trace points must only be hit from the
+// thread that runs the content streams (not from worker threads).
+// Each end event is followed by a counter sample of
+// perfCounters.inflatedBytes, when it has changed, which shows where
+// lazily decoded Flate data was consumed.
+
+extern GBool perfTraceEnabled;
+
+extern GBool perfTraceStart(const char *fileName);
+extern void perfTraceStop();
+
+// Begin an event, with an optional string (<arg>) or integer
+// (<argNum>, if <arg> is NULL) argument named <argName>.
+extern void perfTraceBegin(const char *cat, const char *name,
+			   const char *argName = NULL,
+			   const char *arg = NULL, int argNum = 0);
+extern void perfTraceEnd();
+
+// A trace event covering the lifetime of the object.
+class PerfTraceScope {
+public:
+
+  PerfTraceScope(const char *cat, const char *name) {
+    if ((active = perfTraceEnabled)) {
+      perfTraceBegin(cat, name);
+    }
+  }
+  PerfTraceScope(const char *cat, const char *name,
+		 const char *argName, const char *arg) {
+    if ((active = perfTraceEnabled)) {
+      perfTraceBegin(cat, name, argName, arg);
+    }
+  }
+  PerfTraceScope(const char *cat, const char *name,
+		 const char *argName, int argNum) {
+    if ((active = perfTraceEnabled)) {
+      perfTraceBegin(cat, name, argName, NULL, argNum);
+    }
+  }
+  ~PerfTraceScope() {
+    if (active) {
+      perfTraceEnd();
+    }
+  }
+
+private:
+
+  GBool active;
+};
+
+#endif
@@ -0,0 +1,211 @@
+//========================================================================
+//
+// ProbeOutputDev.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "gmem.h"
+#include "GfxFont.h"
+#include "ProbeOutputDev.h"
+
+//------------------------------------------------------------------------
+
+// Pages with fewer glyphs than this are not considered to have text.
+#define probeMinTextGlyphs 20
+
+// Once a page has this many mapped glyphs it is classified as text,
+// and the rest of its content can be skipped.
+#define probeDecideGlyphs 200
+
+// Pages at least this much covered by images are page images.
+#define probeMinScanCoverage 0.5
+
+//------------------------------------------------------------------------
+// ProbeOutputDev
+//------------------------------------------------------------------------
+
+ProbeOutputDev::ProbeOutputDev() {
+  decideGlyphs = probeDecideGlyphs;
+  pageW = pageH = 0;
+  glyphs = mappedGlyphs = invisibleGlyphs = 0;
+  fontIDs = NULL;
+  nFonts = fontIDsSize = 0;
+  images = 0;
+  memset(grid, 0, sizeof(grid));
+}
+
+ProbeOutputDev::~ProbeOutputDev() {
+  gfree(fontIDs);
+}
+
+void ProbeOutputDev::startPage(int pageNum, GfxState *state) {
+  pageW = state->getPageWidth();
+  pageH = state->getPageHeight();
+  glyphs = mappedGlyphs = invisibleGlyphs = 0;
+  nFonts = 0;
+  images = 0;
+  memset(grid, 0, sizeof(grid));
+}
+
+void ProbeOutputDev::endPage() {
+}
+
+void ProbeOutputDev::updateFont(GfxState *state) {
+  GfxFont *font;
+  Ref *id;
+  int i;
+
+  if (!(font = state->getFont())) {
+    return;
+  }
+  id = font->getID();
+  for (i = 0; i < nFonts; ++i) {
+    if (fontIDs[i].num == id->num && fontIDs[i].gen == id->gen) {
+      return;
+    }
+  }
+  if (nFonts == fontIDsSize) {
+    fontIDsSize = fontIDsSize ? 2 * fontIDsSize : 16;
+    fontIDs = (Ref *)greallocn(fontIDs, fontIDsSize, sizeof(Ref));
+  }
+  fontIDs[nFonts++] = *id;
+}
+
+void ProbeOutputDev::drawChar(GfxState *state, double x, double y,
+			      double dx, double dy,
+			      double originX, double originY,
+			      CharCode code, int nBytes,
+			      Unicode *u, int uLen) {
+  // spaces say nothing about the text layer
+  if (uLen > 0 && u[0] == 0x20) {
+    return;
+  }
+  ++glyphs;
+  if (uLen > 0 && u[0] > 0x20 && u[0] != 0xfffd) {
+    ++mappedGlyphs;
+    if ((state->getRender() & 3) == 3) {
+      ++invisibleGlyphs;
+    }
+  }
+}
+
+void ProbeOutputDev::drawImageMask(GfxState *state, Object *ref,
+				   Stream *str, int width, int height,
+				   GBool invert, GBool inlineImg,
+				   GBool interpolate) {
+  addImage(state);
+  // skip over the data of inline images
+  OutputDev::drawImageMask(state, ref, str, width, height, invert,
+			   inlineImg, interpolate);
+}
+
+void ProbeOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap,
+			       int *maskColors, GBool inlineImg,
+			       GBool interpolate) {
+  addImage(state);
+  // skip over the data of inline images
+  OutputDev::drawImage(state, ref, str, width, height, colorMap,
+		       maskColors, inlineImg, interpolate);
+}
+
+void ProbeOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+				     Stream *str,
+				     int width, int height,
+				     GfxImageColorMap *colorMap,
+				     Stream *maskStr,
+				     int maskWidth, int maskHeight,
+				     GBool maskInvert, GBool interpolate) {
+  addImage(state);
+}
+
+void ProbeOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+					 Stream *str,
+					 int width, int height,
+					 GfxImageColorMap *colorMap,
+					 Stream *maskStr,
+					 int maskWidth, int maskHeight,
+					 GfxImageColorMap *maskColorMap,
+					 GBool interpolate) {
+  addImage(state);
+}
+
+// Mark the grid cells whose centers lie inside the bounding box of
+// the image (the unit square in user space).
+void ProbeOutputDev::addImage(GfxState *state) {
+  double x[4], y[4], xMin, yMin, xMax, yMax, cx, cy;
+  int i, j;
+
+  ++images;
+  if (pageW <= 0 || pageH <= 0) {
+    return;
+  }
+  state->transform(0, 0, &x[0], &y[0]);
+  state->transform(1, 0, &x[1], &y[1]);
+  state->transform(0, 1, &x[2], &y[2]);
+  state->transform(1, 1, &x[3], &y[3]);
+  xMin = xMax = x[0];
+  yMin = yMax = y[0];
+  for (i = 1; i < 4; ++i) {
+    if (x[i] < xMin) {
+      xMin = x[i];
+    } else if (x[i] > xMax) {
+      xMax = x[i];
+    }
+    if (y[i] < yMin) {
+      yMin = y[i];
+    } else if (y[i] > yMax) {
+      yMax = y[i];
+    }
+  }
+  for (i = 0; i < probeGridSize; ++i) {
+    cy = (i + 0.5) * pageH / probeGridSize;
+    if (cy < yMin || cy > yMax) {
+      continue;
+    }
+    for (j = 0; j < probeGridSize; ++j) {
+      cx = (j + 0.5) * pageW / probeGridSize;
+      if (cx >= xMin && cx <= xMax) {
+	grid[i * probeGridSize + j] = 1;
+      }
+    }
+  }
+}
+
+double ProbeOutputDev::getImageCoverage() {
+  int n, i;
+
+  n = 0;
+  for (i = 0; i < probeGridSize * probeGridSize; ++i) {
+    n += grid[i];
+  }
+  return (double)n / (probeGridSize * probeGridSize);
+}
+
+ProbePageClass ProbeOutputDev::getPageClass() {
+  double coverage;
+
+  coverage = getImageCoverage();
+  if (mappedGlyphs >= probeMinTextGlyphs) {
+    if (2 * invisibleGlyphs > mappedGlyphs &&
+	coverage >= probeMinScanCoverage) {
+      return probeOCR;
+    }
+    return probeText;
+  }
+  if (glyphs >= probeMinTextGlyphs) {
+    return probeUnmapped;
+  }
+  if (coverage >= probeMinScanCoverage) {
+    return probeScanned;
+  }
+  return probeEmpty;
+}
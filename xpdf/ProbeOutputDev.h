@@ -0,0 +1,161 @@
+//========================================================================
+//
+// ProbeOutputDev.h
+//
+// A cheap output device for deciding whether a page has a usable text
+// layer or is a scanned image: it counts glyphs and fonts, and the
+// part of the page covered by images, without decoding any images or
+// loading any font files.
+//
+//========================================================================
+
+#ifndef PROBEOUTPUTDEV_H
+#define PROBEOUTPUTDEV_H
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#include "GfxState.h"
+#include "OutputDev.h"
+
+class GfxFont;
+
+//------------------------------------------------------------------------
+
+enum ProbePageClass {
+  probeEmpty,			// little or no text, and few images
+  probeText,			// text with Unicode mappings
+  probeOCR,			// mostly invisible text over a page image
+  probeScanned,			// page image, no usable text
+  probeUnmapped			// text, but without Unicode mappings
+};
+
+// Size of the grid used to measure image coverage.
+#define probeGridSize 32
+
+//------------------------------------------------------------------------
+// ProbeOutputDev
+//------------------------------------------------------------------------
+
+class ProbeOutputDev: public OutputDev {
+public:
+
+  // Constructor.
+  ProbeOutputDev();
+
+  // Destructor.
+  virtual ~ProbeOutputDev();
+
+  //----- get info about output device
+
+  // Does this device use upside-down coordinates?
+  // (Upside-down means (0,0) is the top left corner of the page.)
+  virtual GBool upsideDown() { return gTrue; }
+
+  // Does this device use drawChar() or drawString()?
+  virtual GBool useDrawChar() { return gTrue; }
+
+  // Does this device use tilingPatternFill()?  If this returns false,
+  // tiling pattern fills will be reduced to a series of other drawing
+  // operations.
+  virtual GBool useTilingPatternFill() { return gTrue; }
+
+  // Does this device use functionShadedFill(), axialShadedFill(), and
+  // radialShadedFill()?  If this returns false, these shaded fills
+  // will be reduced to a series of other drawing operations.
+  virtual GBool useShadedFills() { return gTrue; }
+
+  // Does this device use beginType3Char/endType3Char?  Otherwise,
+  // text in Type 3 fonts will be drawn with drawChar/drawString.
+  virtual GBool interpretType3Chars() { return gFalse; }
+
+  //----- initialization and control
+
+  // Start a page.
+  virtual void startPage(int pageNum, GfxState *state);
+
+  // End a page.
+  virtual void endPage();
+
+  //----- path painting
+  virtual void tilingPatternFill(GfxState *state, Gfx *gfx, Object *strRef,
+				 int paintType, Dict *resDict,
+				 double *mat, double *bbox,
+				 int x0, int y0, int x1, int y1,
+				 double xStep, double yStep) {}
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading)
+    { return gTrue; }
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading)
+    { return gTrue; }
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading)
+    { return gTrue; }
+
+  //----- update text state
+  virtual void updateFont(GfxState *state);
+
+  //----- text drawing
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+
+  //----- image drawing
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool inlineImg, GBool interpolate);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 int *maskColors, GBool inlineImg, GBool interpolate);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert, GBool interpolate);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap,
+				   GBool interpolate);
+
+  //----- special access
+
+  // Returns true once the current page has enough mapped glyphs to
+  // be classified as text; the rest of the page can then be skipped.
+  GBool isPageDecided() { return mappedGlyphs >= decideGlyphs; }
+
+  // Classify the current page.
+  ProbePageClass getPageClass();
+
+  // Stats for the current page.
+  int getGlyphs() { return glyphs; }
+  int getMappedGlyphs() { return mappedGlyphs; }
+  int getInvisibleGlyphs() { return invisibleGlyphs; }
+  int getFonts() { return nFonts; }
+  int getImages() { return images; }
+
+  // Fraction of the page (0 to 1) covered by images.
+  double getImageCoverage();
+
+private:
+
+  void addImage(GfxState *state);
+
+  int decideGlyphs;		// mapped glyphs that decide a page
+  double pageW, pageH;
+  int glyphs;			// all glyphs drawn
+  int mappedGlyphs;		// glyphs with a Unicode mapping
+  int invisibleGlyphs;		// mapped glyphs in render mode 3 or 7
+  Ref *fontIDs;			// distinct fonts used on the page
+  int nFonts, fontIDsSize;
+  int images;
+  char grid[probeGridSize * probeGridSize];	// cells covered by images
+};
+
+#endif
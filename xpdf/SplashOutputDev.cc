@@ -15,9 +15,11 @@
 #include <string.h>
 #include <math.h>
 #include <limits.h>
+#include "gmem.h"
 #include "gfile.h"
 #include "GlobalParams.h"
 #include "Error.h"
+#include "PerfCounters.h"
 #include "Object.h"
 #include "Gfx.h"
 #include "GfxFont.h"
@@ -1103,6 +1105,8 @@ void SplashOutputDev::updateFont(GfxState *state) {
 }
 
 void SplashOutputDev::doUpdateFont(GfxState *state) {
+  GMemTagScope memTag(gMemTagFont);
+  PerfTraceScope trace("font", "doUpdateFont");
   GfxFont *gfxFont;
   GfxFontLoc *fontLoc;
   GfxFontType fontType;
@@ -2996,24 +3000,52 @@ void SplashOutputDev::reduceImageResolution(Stream *str, double *ctm,
   double sw, sh;
   int reduction;
 
-  if (str->getKind() == strJPX &&
-      *width * *height > 10000000) {
-    sw = (double)*width / (fabs(ctm[2]) + fabs(ctm[3]));
-    sh = (double)*height / (fabs(ctm[0]) + fabs(ctm[1]));
-    if (sw > 8 && sh > 8) {
-      reduction = 3;
-    } else if (sw > 4 && sh > 4) {
-      reduction = 2;
-    } else if (sw > 2 && sh > 2) {
-      reduction = 1;
-    } else {
-      reduction = 0;
+  // DCT images are decoded at 1/2, 1/4, or 1/8 size whenever that
+  // still leaves (about) one image pixel per device pixel -- the
+  // thresholds are slightly less than 2/4/8 to allow for round-off
+  // in the CTM; the reduction is set on every draw, because the
+  // stream may be shared with an earlier draw of the same XObject
+  // (through the XRef object cache) at a different size
+  if (str->getKind() == strDCT) {
+    reduction = 0;
+    if (*width >= 16 && *height >= 16) {
+      sw = (double)*width / (fabs(ctm[0]) + fabs(ctm[1]));
+      sh = (double)*height / (fabs(ctm[2]) + fabs(ctm[3]));
+      if (sw > 7.99 && sh > 7.99) {
+	reduction = 3;
+      } else if (sw > 3.99 && sh > 3.99) {
+	reduction = 2;
+      } else if (sw > 1.99 && sh > 1.99) {
+	reduction = 1;
+      }
     }
-    if (reduction > 0) {
-      ((JPXStream *)str)->reduceResolution(reduction);
-      *width >>= reduction;
-      *height >>= reduction;
+    ((DCTStream *)str)->reduceResolution(reduction);
+    reduction = ((DCTStream *)str)->getReduction();
+    *width = (*width + (1 << reduction) - 1) >> reduction;
+    *height = (*height + (1 << reduction) - 1) >> reduction;
+    return;
+  }
+
+  // JPX images skip the finest decomposition levels in the same way
+  // (JPXStream may limit the reduction, depending on the codestream)
+  if (str->getKind() == strJPX) {
+    reduction = 0;
+    if (*width >= 16 && *height >= 16) {
+      sw = (double)*width / (fabs(ctm[0]) + fabs(ctm[1]));
+      sh = (double)*height / (fabs(ctm[2]) + fabs(ctm[3]));
+      for (;
+	   sw > 1.99 && sh > 1.99 &&
+	     *width >> (reduction + 1) >= 8 &&
+	     *height >> (reduction + 1) >= 8;
+	   ++reduction) {
+	sw *= 0.5;
+	sh *= 0.5;
+      }
     }
+    ((JPXStream *)str)->reduceResolution(reduction);
+    reduction = ((JPXStream *)str)->getReduction();
+    *width >>= reduction;
+    *height >>= reduction;
   }
 }
 
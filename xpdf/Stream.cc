@@ -32,6 +32,7 @@
 #include "JBIG2Stream.h"
 #include "JPXStream.h"
 #include "Stream-CCITT.h"
+#include "PerfCounters.h"
 
 #ifdef __DJGPP__
 static GBool setDJSYSFLAGS = gFalse;
@@ -121,6 +122,7 @@ GString *Stream::getPSFilter(int psLevel, const char *indent) {
 }
 
 Stream *Stream::addFilters(Object *dict, int recursion) {
+  GMemTagScope memTag(gMemTagStream);
   Object obj, obj2;
   Object params, params2;
   Stream *str;
@@ -342,6 +344,7 @@ void FilterStream::setPos(GFileOffset pos, int dir) {
 //------------------------------------------------------------------------
 
 ImageStream::ImageStream(Stream *strA, int widthA, int nCompsA, int nBitsA) {
+  GMemTagScope memTag(gMemTagStream);
   int imgLineSize;
 
   str = strA;
@@ -699,6 +702,26 @@ int FileStream::getBlock(char *blk, int size) {
   n = 0;
   while (n < size) {
     if (bufPtr >= bufEnd) {
+      // read large blocks straight into the caller's buffer
+      if (size - n >= fileStreamBufSize) {
+	bufPos += (int)(bufEnd - buf);
+	bufPtr = bufEnd = buf;
+	m = size - n;
+	if (limited) {
+	  if (bufPos >= start + length) {
+	    break;
+	  }
+	  if (bufPos + m > start + length) {
+	    m = (int)(start + length - bufPos);
+	  }
+	}
+	if ((m = (int)fread(blk + n, 1, m, f)) <= 0) {
+	  break;
+	}
+	bufPos += m;
+	n += m;
+	continue;
+      }
       if (!fillBuf()) {
 	break;
       }
@@ -845,6 +868,329 @@ void MemStream::moveStart(int delta) {
   bufPtr = buf + start;
 }
 
+//------------------------------------------------------------------------
+// RangeStreamCache
+//------------------------------------------------------------------------
+
+RangeStreamCache::RangeStreamCache(RangeStreamReadFunc readFuncA,
+				   void *readDataA, GFileOffset fileSizeA,
+				   int blockSizeA, int maxBlocksA) {
+  int i;
+
+  readFunc = readFuncA;
+  readData = readDataA;
+  fileSize = fileSizeA < 0 ? 0 : fileSizeA;
+  blockSize = blockSizeA < 1024 ? 1024 : blockSizeA;
+  nBlocks = (int)((fileSize + blockSize - 1) / blockSize);
+  slotOf = (int *)gmallocn(nBlocks, sizeof(int));
+  for (i = 0; i < nBlocks; ++i) {
+    slotOf[i] = -1;
+  }
+  // a whole read-ahead run has to fit
+  maxBlocks = maxBlocksA;
+  if (maxBlocks < rangeStreamMaxReadAhead) {
+    maxBlocks = rangeStreamMaxReadAhead;
+  }
+  slots = (RangeStreamBlock *)gmallocn(maxBlocks, sizeof(RangeStreamBlock));
+  nSlotsUsed = 0;
+  lruHead = lruTail = -1;
+  fetchBuf = (char *)gmallocn(rangeStreamMaxReadAhead, blockSize);
+  readErr = gFalse;
+  bytesFetched = 0;
+  nFetches = 0;
+  refCnt = 1;
+}
+
+RangeStreamCache::~RangeStreamCache() {
+  int i;
+
+  for (i = 0; i < nSlotsUsed; ++i) {
+    gfree(slots[i].data);
+  }
+  gfree(slots);
+  gfree(slotOf);
+  gfree(fetchBuf);
+}
+
+void RangeStreamCache::incRefCnt() {
+  ++refCnt;
+}
+
+void RangeStreamCache::decRefCnt() {
+  if (--refCnt == 0) {
+    delete this;
+  }
+}
+
+int RangeStreamCache::read(GFileOffset pos, char *buf, int size,
+			   int readAhead, GFileOffset end, GBool *fetched) {
+  int blk, endBlk, slot, off, n, m;
+
+  *fetched = gFalse;
+  if (end > fileSize) {
+    end = fileSize;
+  }
+  endBlk = (int)((end + blockSize - 1) / blockSize);
+  n = 0;
+  while (n < size && pos >= 0 && pos < fileSize) {
+    blk = (int)(pos / blockSize);
+    if ((slot = slotOf[blk]) < 0) {
+      if ((slot = fetch(blk, readAhead, endBlk)) < 0) {
+	break;
+      }
+      *fetched = gTrue;
+    } else if (slot != lruHead) {
+      unlinkSlot(slot);
+      linkSlot(slot);
+    }
+    off = (int)(pos - (GFileOffset)blk * blockSize);
+    if (off >= slots[slot].len) {
+      break;
+    }
+    m = slots[slot].len - off;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(buf + n, slots[slot].data + off, m);
+    n += m;
+    pos += m;
+  }
+  return n;
+}
+
+// Fetch block <blk>, along with up to <readAhead> - 1 following
+// blocks that are before <endBlk> and not already cached, in a single
+// call to the callback.  Returns the slot holding <blk>, or -1 on
+// error.
+int RangeStreamCache::fetch(int blk, int readAhead, int endBlk) {
+  GFileOffset pos;
+  int nBlks, len, n, slot, firstSlot, i;
+
+  if (readAhead > rangeStreamMaxReadAhead) {
+    readAhead = rangeStreamMaxReadAhead;
+  }
+  for (nBlks = 1;
+       nBlks < readAhead && blk + nBlks < endBlk &&
+	 slotOf[blk + nBlks] < 0;
+       ++nBlks) ;
+  pos = (GFileOffset)blk * blockSize;
+  if (fileSize - pos < (GFileOffset)nBlks * blockSize) {
+    len = (int)(fileSize - pos);
+  } else {
+    len = nBlks * blockSize;
+  }
+  n = (*readFunc)(readData, pos, fetchBuf, len);
+  ++nFetches;
+  if (n <= 0) {
+    if (!readErr) {
+      error(errIO, -1, "Error reading the PDF file");
+      readErr = gTrue;
+    }
+    return -1;
+  }
+  if (n > len) {
+    n = len;
+  }
+  bytesFetched += n;
+
+  firstSlot = -1;
+  for (i = 0; i < nBlks && i * blockSize < n; ++i) {
+    slot = takeSlot();
+    slots[slot].blk = blk + i;
+    slots[slot].len = n - i * blockSize;
+    if (slots[slot].len > blockSize) {
+      slots[slot].len = blockSize;
+    }
+    memcpy(slots[slot].data, fetchBuf + i * blockSize, slots[slot].len);
+    slotOf[blk + i] = slot;
+    if (i == 0) {
+      firstSlot = slot;
+    }
+  }
+  // the requested block is the most recently used one
+  if (firstSlot != lruHead) {
+    unlinkSlot(firstSlot);
+    linkSlot(firstSlot);
+  }
+  return firstSlot;
+}
+
+// Get a free slot -- a new one, or the least recently used one -- and
+// put it at the head of the LRU list.
+int RangeStreamCache::takeSlot() {
+  int slot;
+
+  if (nSlotsUsed < maxBlocks) {
+    slot = nSlotsUsed++;
+    slots[slot].data = (char *)gmalloc(blockSize);
+  } else {
+    slot = lruTail;
+    unlinkSlot(slot);
+    slotOf[slots[slot].blk] = -1;
+  }
+  linkSlot(slot);
+  return slot;
+}
+
+void RangeStreamCache::unlinkSlot(int slot) {
+  if (slots[slot].prev >= 0) {
+    slots[slots[slot].prev].next = slots[slot].next;
+  } else {
+    lruHead = slots[slot].next;
+  }
+  if (slots[slot].next >= 0) {
+    slots[slots[slot].next].prev = slots[slot].prev;
+  } else {
+    lruTail = slots[slot].prev;
+  }
+}
+
+void RangeStreamCache::linkSlot(int slot) {
+  slots[slot].prev = -1;
+  slots[slot].next = lruHead;
+  if (lruHead >= 0) {
+    slots[lruHead].prev = slot;
+  } else {
+    lruTail = slot;
+  }
+  lruHead = slot;
+}
+
+//------------------------------------------------------------------------
+// RangeStream
+//------------------------------------------------------------------------
+
+RangeStream::RangeStream(RangeStreamCache *cacheA, GFileOffset startA,
+			 GBool limitedA, GFileOffset lengthA, Object *dictA):
+    BaseStream(dictA) {
+  cache = cacheA;
+  cache->incRefCnt();
+  start = startA;
+  limited = limitedA;
+  length = lengthA;
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+  nextPos = -1;
+  readAhead = 1;
+}
+
+RangeStream::~RangeStream() {
+  cache->decRefCnt();
+}
+
+Stream *RangeStream::makeSubStream(GFileOffset startA, GBool limitedA,
+				   GFileOffset lengthA, Object *dictA) {
+  return new RangeStream(cache, startA, limitedA, lengthA, dictA);
+}
+
+void RangeStream::reset() {
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+}
+
+void RangeStream::close() {
+}
+
+int RangeStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (bufPtr >= bufEnd) {
+      // read large blocks straight into the caller's buffer
+      if (size - n >= rangeStreamBufSize) {
+	bufPos += (int)(bufEnd - buf);
+	bufPtr = bufEnd = buf;
+	m = size - n;
+	if (limited) {
+	  if (bufPos >= start + length) {
+	    break;
+	  }
+	  if (bufPos + m > start + length) {
+	    m = (int)(start + length - bufPos);
+	  }
+	}
+	if ((m = readCache(blk + n, m)) <= 0) {
+	  break;
+	}
+	bufPos += m;
+	n += m;
+	continue;
+      }
+      if (!fillBuf()) {
+	break;
+      }
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
+GBool RangeStream::fillBuf() {
+  int n;
+
+  bufPos += (int)(bufEnd - buf);
+  bufPtr = bufEnd = buf;
+  if (limited && bufPos >= start + length) {
+    return gFalse;
+  }
+  if (limited && bufPos + rangeStreamBufSize > start + length) {
+    n = (int)(start + length - bufPos);
+  } else {
+    n = rangeStreamBufSize;
+  }
+  n = readCache(buf, n);
+  bufEnd = buf + n;
+  return n > 0;
+}
+
+// Read <size> bytes at bufPos from the cache.  The read-ahead doubles
+// each time a sequential read needs another fetch, and drops back to
+// one block after a seek.
+int RangeStream::readCache(char *blk, int size) {
+  GBool sequential, fetched;
+  int n;
+
+  sequential = bufPos == nextPos;
+  if (!sequential) {
+    readAhead = 1;
+  }
+  n = cache->read(bufPos, blk, size, readAhead,
+		  limited ? start + length : cache->getFileSize(), &fetched);
+  if (fetched && sequential && readAhead < rangeStreamMaxReadAhead) {
+    readAhead *= 2;
+  }
+  nextPos = bufPos + n;
+  return n;
+}
+
+void RangeStream::setPos(GFileOffset pos, int dir) {
+  GFileOffset size;
+
+  if (dir >= 0) {
+    bufPos = pos;
+  } else {
+    size = cache->getFileSize();
+    if (pos > size) {
+      pos = size;
+    }
+    bufPos = size - pos;
+  }
+  bufPtr = bufEnd = buf;
+}
+
+void RangeStream::moveStart(int delta) {
+  start += delta;
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+}
+
 //------------------------------------------------------------------------
 // EmbedStream
 //------------------------------------------------------------------------
@@ -1427,6 +1773,7 @@ CCITTFaxStream::~CCITTFaxStream() {
 }
 
 void CCITTFaxStream::reset() {
+  GMemTagScope memTag(gMemTagStream);
   int code1;
 
   str->reset();
@@ -2134,6 +2481,19 @@ static inline int dctClip(int x) {
   return dctClipData[(dctClipOffset + x) & dctClipMask];
 }
 
+// reduced-size IDCT coefficients: C(u) * cos((2x+1)*u*pi/(2N)), for
+// N = 4 and N = 2, in 20.12 fixed point format, indexed by [x*N + u]
+static int dctReduced4[16] = {
+  2896,  3784,  2896,  1567,
+  2896,  1567, -2896, -3784,
+  2896, -1567, -2896,  3784,
+  2896, -3784,  2896, -1567
+};
+static int dctReduced2[4] = {
+  2896,  2896,
+  2896, -2896
+};
+
 // zig zag decode map
 static int dctZigZag[64] = {
    0,
@@ -2153,86 +2513,773 @@ static int dctZigZag[64] = {
   63
 };
 
-DCTStream::DCTStream(Stream *strA, GBool colorXformA):
-    FilterStream(strA) {
-  int i;
-
-  colorXform = colorXformA;
-  progressive = interleaved = gFalse;
-  width = height = 0;
-  mcuWidth = mcuHeight = 0;
-  numComps = 0;
-  comp = 0;
-  x = y = 0;
-  for (i = 0; i < 4; ++i) {
-    frameBuf[i] = NULL;
-  }
-  rowBuf = NULL;
-  memset(dcHuffTables, 0, sizeof(dcHuffTables));
-  memset(acHuffTables, 0, sizeof(acHuffTables));
-
-  dctClipInit();
-}
+//------------------------------------------------------------------------
+// DCT kernels
+//
+// The IDCT and color conversion inner loops have a scalar reference
+// implementation, plus SSE2 and AVX2 versions (x86-64 only).  The
+// fastest version supported by the CPU is selected at run time, in
+// dctKernelsInit().  All versions produce bit-identical output.
+//------------------------------------------------------------------------
 
-DCTStream::~DCTStream() {
-  close();
-  delete str;
-}
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(NO_DCT_SIMD)
+#  define DCT_SIMD 1
+#  include <immintrin.h>
+#  define DCT_AVX2 __attribute__((target("avx2")))
+#endif
 
-void DCTStream::reset() {
+// Transform one data unit -- this performs the dequantization and
+// IDCT steps.  This IDCT algorithm is taken from:
+//   Christoph Loeffler, Adriaan Ligtenberg, George S. Moschytz,
+//   "Practical Fast 1-D DCT Algorithms with 11 Multiplications",
+//   IEEE Intl. Conf. on Acoustics, Speech & Signal Processing, 1989,
+//   988-991.
+// The stage numbers mentioned in the comments refer to Figure 1 in this
+// paper.
+// Scalar IDCT -- this is the reference implementation (the SIMD
+// versions below must match it exactly).
+static void dctTransformScalar(Gushort *quantTable,
+			       int dataIn[64], Guchar dataOut[64]) {
+  int v0, v1, v2, v3, v4, v5, v6, v7, t0, t1, t2;
+  int *p;
+  Gushort *q;
   int i;
 
-  str->reset();
-
-  progressive = interleaved = gFalse;
-  width = height = 0;
-  numComps = 0;
-  numQuantTables = 0;
-  numDCHuffTables = 0;
-  numACHuffTables = 0;
-  gotJFIFMarker = gFalse;
-  gotAdobeMarker = gFalse;
-  restartInterval = 0;
-
-  if (!readHeader()) {
-    // force an EOF condition
-    progressive = gTrue;
-    y = height;
-    return;
-  }
+  // dequant; inverse DCT on rows
+  for (i = 0; i < 64; i += 8) {
+    p = dataIn + i;
+    q = quantTable + i;
 
-  // compute MCU size
-  if (numComps == 1) {
-    compInfo[0].hSample = compInfo[0].vSample = 1;
-  }
-  mcuWidth = compInfo[0].hSample;
-  mcuHeight = compInfo[0].vSample;
-  for (i = 1; i < numComps; ++i) {
-    if (compInfo[i].hSample > mcuWidth) {
-      mcuWidth = compInfo[i].hSample;
-    }
-    if (compInfo[i].vSample > mcuHeight) {
-      mcuHeight = compInfo[i].vSample;
+    // check for all-zero AC coefficients
+    if (p[1] == 0 && p[2] == 0 && p[3] == 0 &&
+	p[4] == 0 && p[5] == 0 && p[6] == 0 && p[7] == 0) {
+      t0 = p[0] * q[0];
+      p[0] = t0;
+      p[1] = t0;
+      p[2] = t0;
+      p[3] = t0;
+      p[4] = t0;
+      p[5] = t0;
+      p[6] = t0;
+      p[7] = t0;
+      continue;
     }
-  }
-  mcuWidth *= 8;
-  mcuHeight *= 8;
 
-  // figure out color transform
-  if (colorXform == -1) {
-    if (numComps == 3) {
-      if (gotJFIFMarker) {
-	colorXform = 1;
-      } else if (compInfo[0].id == 82 && compInfo[1].id == 71 &&
-		 compInfo[2].id == 66) { // ASCII "RGB"
-	colorXform = 0;
-      } else {
-	colorXform = 1;
-      }
-    } else {
-      colorXform = 0;
-    }
-  }
+    // stage 4
+    v0 = p[0] * q[0];
+    v1 = p[4] * q[4];
+    v2 = p[2] * q[2];
+    v3 = p[6] * q[6];
+    t0 = p[1] * q[1];
+    t1 = p[7] * q[7];
+    v4 = t0 - t1;
+    v7 = t0 + t1;
+    v5 = (dctSqrt2 * p[3] * q[3]) >> 12;
+    v6 = (dctSqrt2 * p[5] * q[5]) >> 12;
+
+    // stage 3
+    t0 = v0 - v1;
+    v0 = v0 + v1;
+    v1 = t0;
+    t0 = dctSqrt2Cos6 * (v2 + v3);
+    t1 = dctSqrt2Cos6PSin6 * v3;
+    t2 = dctSqrt2Sin6MCos6 * v2;
+    v2 = (t0 - t1) >> 12;
+    v3 = (t0 + t2) >> 12;
+    t0 = v4 - v6;
+    v4 = v4 + v6;
+    v6 = t0;
+    t0 = v7 + v5;
+    v5 = v7 - v5;
+    v7 = t0;
+
+    // stage 2
+    t0 = v0 - v3;
+    v0 = v0 + v3;
+    v3 = t0;
+    t0 = v1 - v2;
+    v1 = v1 + v2;
+    v2 = t0;
+    t0 = dctCos3 * (v4 + v7);
+    t1 = dctCos3PSin3 * v7;
+    t2 = dctSin3MCos3 * v4;
+    v4 = (t0 - t1) >> 12;
+    v7 = (t0 + t2) >> 12;
+    t0 = dctCos1 * (v5 + v6);
+    t1 = dctCos1PSin1 * v6;
+    t2 = dctSin1MCos1 * v5;
+    v5 = (t0 - t1) >> 12;
+    v6 = (t0 + t2) >> 12;
+
+    // stage 1
+    p[0] = v0 + v7;
+    p[7] = v0 - v7;
+    p[1] = v1 + v6;
+    p[6] = v1 - v6;
+    p[2] = v2 + v5;
+    p[5] = v2 - v5;
+    p[3] = v3 + v4;
+    p[4] = v3 - v4;
+  }
+
+  // inverse DCT on columns
+  for (i = 0; i < 8; ++i) {
+    p = dataIn + i;
+
+    // check for all-zero AC coefficients
+    if (p[1*8] == 0 && p[2*8] == 0 && p[3*8] == 0 &&
+	p[4*8] == 0 && p[5*8] == 0 && p[6*8] == 0 && p[7*8] == 0) {
+      t0 = p[0*8];
+      p[1*8] = t0;
+      p[2*8] = t0;
+      p[3*8] = t0;
+      p[4*8] = t0;
+      p[5*8] = t0;
+      p[6*8] = t0;
+      p[7*8] = t0;
+      continue;
+    }
+
+    // stage 4
+    v0 = p[0*8];
+    v1 = p[4*8];
+    v2 = p[2*8];
+    v3 = p[6*8];
+    v4 = p[1*8] - p[7*8];
+    v7 = p[1*8] + p[7*8];
+    v5 = (dctSqrt2 * p[3*8]) >> 12;
+    v6 = (dctSqrt2 * p[5*8]) >> 12;
+
+    // stage 3
+    t0 = v0 - v1;
+    v0 = v0 + v1;
+    v1 = t0;
+    t0 = dctSqrt2Cos6 * (v2 + v3);
+    t1 = dctSqrt2Cos6PSin6 * v3;
+    t2 = dctSqrt2Sin6MCos6 * v2;
+    v2 = (t0 - t1) >> 12;
+    v3 = (t0 + t2) >> 12;
+    t0 = v4 - v6;
+    v4 = v4 + v6;
+    v6 = t0;
+    t0 = v7 + v5;
+    v5 = v7 - v5;
+    v7 = t0;
+
+    // stage 2
+    t0 = v0 - v3;
+    v0 = v0 + v3;
+    v3 = t0;
+    t0 = v1 - v2;
+    v1 = v1 + v2;
+    v2 = t0;
+    t0 = dctCos3 * (v4 + v7);
+    t1 = dctCos3PSin3 * v7;
+    t2 = dctSin3MCos3 * v4;
+    v4 = (t0 - t1) >> 12;
+    v7 = (t0 + t2) >> 12;
+    t0 = dctCos1 * (v5 + v6);
+    t1 = dctCos1PSin1 * v6;
+    t2 = dctSin1MCos1 * v5;
+    v5 = (t0 - t1) >> 12;
+    v6 = (t0 + t2) >> 12;
+
+    // stage 1
+    p[0*8] = v0 + v7;
+    p[7*8] = v0 - v7;
+    p[1*8] = v1 + v6;
+    p[6*8] = v1 - v6;
+    p[2*8] = v2 + v5;
+    p[5*8] = v2 - v5;
+    p[3*8] = v3 + v4;
+    p[4*8] = v3 - v4;
+  }
+
+  // convert to 8-bit integers
+  for (i = 0; i < 64; ++i) {
+    dataOut[i] = dctClip(128 + (dataIn[i] >> 3));
+  }
+}
+
+// Convert one row of YCbCr pixels to RGB.
+static void dctYCbCrToRGBScalar(Guchar *pY, Guchar *pCb, Guchar *pCr,
+				Guchar *out, int n) {
+  int y, cb, cr, x;
+
+  for (x = 0; x < n; ++x) {
+    y = pY[x];
+    cb = pCb[x] - 128;
+    cr = pCr[x] - 128;
+    out[0] = dctClip(((y << 16) + dctCrToR * cr + 32768) >> 16);
+    out[1] = dctClip(((y << 16) + dctCbToG * cb + dctCrToG * cr + 32768)
+		     >> 16);
+    out[2] = dctClip(((y << 16) + dctCbToB * cb + 32768) >> 16);
+    out += 3;
+  }
+}
+
+// Convert one row of YCbCrK pixels to CMYK (K is passed through
+// unchanged).
+static void dctYCCKToCMYKScalar(Guchar *pY, Guchar *pCb, Guchar *pCr,
+				Guchar *pK, Guchar *out, int n) {
+  int y, cb, cr, x;
+
+  for (x = 0; x < n; ++x) {
+    y = pY[x];
+    cb = pCb[x] - 128;
+    cr = pCr[x] - 128;
+    out[0] = 255 - dctClip(((y << 16) + dctCrToR * cr + 32768) >> 16);
+    out[1] = 255 - dctClip(((y << 16) + dctCbToG * cb + dctCrToG * cr
+			    + 32768) >> 16);
+    out[2] = 255 - dctClip(((y << 16) + dctCbToB * cb + 32768) >> 16);
+    out[3] = pK[x];
+    out += 4;
+  }
+}
+
+// Convert YCbCr to RGB, or YCbCrK to CMYK, in place, on n pixels of
+// the (int) progressive-mode frame buffer.
+static void dctYCbCrToRGBIntScalar(int *p0, int *p1, int *p2, int n,
+				   GBool invert) {
+  int y, cb, cr, r, g, b, x;
+
+  for (x = 0; x < n; ++x) {
+    y = p0[x];
+    cb = p1[x] - 128;
+    cr = p2[x] - 128;
+    r = dctClip(((y << 16) + dctCrToR * cr + 32768) >> 16);
+    g = dctClip(((y << 16) + dctCbToG * cb + dctCrToG * cr + 32768) >> 16);
+    b = dctClip(((y << 16) + dctCbToB * cb + 32768) >> 16);
+    if (invert) {
+      r = 255 - r;
+      g = 255 - g;
+      b = 255 - b;
+    }
+    p0[x] = r;
+    p1[x] = g;
+    p2[x] = b;
+  }
+}
+
+#if DCT_SIMD
+
+// One 1-D IDCT pass (stages 4 to 1 of the scalar code) on eight
+// vectors of 32-bit ints, using the supplied add/sub/mul/shift
+// operations.  x0..x7 are overwritten with the results.
+#define dctIDCT1D(x0, x1, x2, x3, x4, x5, x6, x7, T, ADD, SUB, MUL, SRA) \
+  {									\
+    T v0, v1, v2, v3, v4, v5, v6, v7, t0, t1, t2;			\
+    /* stage 4 */							\
+    v0 = x0;								\
+    v1 = x4;								\
+    v2 = x2;								\
+    v3 = x6;								\
+    v4 = SUB(x1, x7);							\
+    v7 = ADD(x1, x7);							\
+    v5 = SRA(MUL(x3, dctSqrt2));					\
+    v6 = SRA(MUL(x5, dctSqrt2));					\
+    /* stage 3 */							\
+    t0 = SUB(v0, v1);							\
+    v0 = ADD(v0, v1);							\
+    v1 = t0;								\
+    t0 = MUL(ADD(v2, v3), dctSqrt2Cos6);				\
+    t1 = MUL(v3, dctSqrt2Cos6PSin6);					\
+    t2 = MUL(v2, dctSqrt2Sin6MCos6);					\
+    v2 = SRA(SUB(t0, t1));						\
+    v3 = SRA(ADD(t0, t2));						\
+    t0 = SUB(v4, v6);							\
+    v4 = ADD(v4, v6);							\
+    v6 = t0;								\
+    t0 = ADD(v7, v5);							\
+    v5 = SUB(v7, v5);							\
+    v7 = t0;								\
+    /* stage 2 */							\
+    t0 = SUB(v0, v3);							\
+    v0 = ADD(v0, v3);							\
+    v3 = t0;								\
+    t0 = SUB(v1, v2);							\
+    v1 = ADD(v1, v2);							\
+    v2 = t0;								\
+    t0 = MUL(ADD(v4, v7), dctCos3);					\
+    t1 = MUL(v7, dctCos3PSin3);						\
+    t2 = MUL(v4, dctSin3MCos3);						\
+    v4 = SRA(SUB(t0, t1));						\
+    v7 = SRA(ADD(t0, t2));						\
+    t0 = MUL(ADD(v5, v6), dctCos1);					\
+    t1 = MUL(v6, dctCos1PSin1);						\
+    t2 = MUL(v5, dctSin1MCos1);						\
+    v5 = SRA(SUB(t0, t1));						\
+    v6 = SRA(ADD(t0, t2));						\
+    /* stage 1 */							\
+    x0 = ADD(v0, v7);							\
+    x7 = SUB(v0, v7);							\
+    x1 = ADD(v1, v6);							\
+    x6 = SUB(v1, v6);							\
+    x2 = ADD(v2, v5);							\
+    x5 = SUB(v2, v5);							\
+    x3 = ADD(v3, v4);							\
+    x4 = SUB(v3, v4);							\
+  }
+
+//----- SSE2
+
+// SSE2 has no 32-bit multiply-low, so build it from two 32x32->64
+// multiplies (the low 32 bits are the same for signed and unsigned).
+static inline __m128i dctMulSSE2(__m128i a, __m128i b) {
+  __m128i even, odd;
+
+  even = _mm_mul_epu32(a, b);
+  odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			    _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+#define dctAddSSE2(a, b) _mm_add_epi32(a, b)
+#define dctSubSSE2(a, b) _mm_sub_epi32(a, b)
+#define dctMulCSSE2(a, c) dctMulSSE2(a, _mm_set1_epi32(c))
+#define dctSraSSE2(a) _mm_srai_epi32(a, 12)
+
+static inline void dctTranspose4x4SSE2(__m128i &r0, __m128i &r1,
+				       __m128i &r2, __m128i &r3) {
+  __m128i t0, t1, t2, t3;
+
+  t0 = _mm_unpacklo_epi32(r0, r1);
+  t1 = _mm_unpacklo_epi32(r2, r3);
+  t2 = _mm_unpackhi_epi32(r0, r1);
+  t3 = _mm_unpackhi_epi32(r2, r3);
+  r0 = _mm_unpacklo_epi64(t0, t1);
+  r1 = _mm_unpackhi_epi64(t0, t1);
+  r2 = _mm_unpacklo_epi64(t2, t3);
+  r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+// Transpose an 8x8 block stored as lo[i] = row i, columns 0-3 and
+// hi[i] = row i, columns 4-7.
+static inline void dctTranspose8x8SSE2(__m128i lo[8], __m128i hi[8]) {
+  __m128i t;
+  int i;
+
+  dctTranspose4x4SSE2(lo[0], lo[1], lo[2], lo[3]);
+  dctTranspose4x4SSE2(hi[0], hi[1], hi[2], hi[3]);
+  dctTranspose4x4SSE2(lo[4], lo[5], lo[6], lo[7]);
+  dctTranspose4x4SSE2(hi[4], hi[5], hi[6], hi[7]);
+  for (i = 0; i < 4; ++i) {
+    t = hi[i];
+    hi[i] = lo[i + 4];
+    lo[i + 4] = t;
+  }
+}
+
+// Compute dctClip(128 + (x >> 3)) on eight ints, exactly matching the
+// dctClip lookup table (including its handling of out-of-range
+// values), and pack the results into bytes.
+static inline __m128i dctOutputSSE2(__m128i a, __m128i b) {
+  __m128i off, mask, bad;
+
+  off = _mm_set1_epi32(dctClipOffset);
+  mask = _mm_set1_epi32(dctClipMask);
+  bad = _mm_set1_epi32(dctClipMask - dctClipOffset);
+  a = _mm_add_epi32(_mm_srai_epi32(a, 3), _mm_set1_epi32(128 + dctClipOffset));
+  a = _mm_sub_epi32(_mm_and_si128(a, mask), off);
+  a = _mm_andnot_si128(_mm_cmpeq_epi32(a, bad), a);
+  b = _mm_add_epi32(_mm_srai_epi32(b, 3), _mm_set1_epi32(128 + dctClipOffset));
+  b = _mm_sub_epi32(_mm_and_si128(b, mask), off);
+  b = _mm_andnot_si128(_mm_cmpeq_epi32(b, bad), b);
+  return _mm_packs_epi32(a, b);
+}
+
+static void dctTransformSSE2(Gushort *quantTable,
+			     int dataIn[64], Guchar dataOut[64]) {
+  __m128i lo[8], hi[8], q, zero;
+  int i;
+
+  // dequant
+  zero = _mm_setzero_si128();
+  for (i = 0; i < 8; ++i) {
+    q = _mm_loadu_si128((__m128i *)(quantTable + 8 * i));
+    lo[i] = dctMulSSE2(_mm_loadu_si128((__m128i *)(dataIn + 8 * i)),
+		       _mm_unpacklo_epi16(q, zero));
+    hi[i] = dctMulSSE2(_mm_loadu_si128((__m128i *)(dataIn + 8 * i + 4)),
+		       _mm_unpackhi_epi16(q, zero));
+  }
+
+  // inverse DCT on rows -- after the transpose, each vector holds one
+  // coefficient from four rows
+  dctTranspose8x8SSE2(lo, hi);
+  dctIDCT1D(lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7], __m128i,
+	    dctAddSSE2, dctSubSSE2, dctMulCSSE2, dctSraSSE2);
+  dctIDCT1D(hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7], __m128i,
+	    dctAddSSE2, dctSubSSE2, dctMulCSSE2, dctSraSSE2);
+
+  // inverse DCT on columns
+  dctTranspose8x8SSE2(lo, hi);
+  dctIDCT1D(lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7], __m128i,
+	    dctAddSSE2, dctSubSSE2, dctMulCSSE2, dctSraSSE2);
+  dctIDCT1D(hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7], __m128i,
+	    dctAddSSE2, dctSubSSE2, dctMulCSSE2, dctSraSSE2);
+
+  // convert to 8-bit integers
+  for (i = 0; i < 8; i += 2) {
+    _mm_storeu_si128((__m128i *)(dataOut + 8 * i),
+		     _mm_packus_epi16(dctOutputSSE2(lo[i], hi[i]),
+				      dctOutputSSE2(lo[i+1], hi[i+1])));
+  }
+}
+
+// Color convert eight pixels, in 16-bit lanes.  Y, Cb, and Cr are in
+// [0,255], so the results are always in the range where dctClip is a
+// plain clamp.  The 16.16 conversion factors are split into an
+// integer part and a 16-bit fraction (e.g., 1.4020 = 1 + 26345/65536)
+// so that the products fit in _mm_madd_epi16, without changing the
+// results:
+//   ((y << 16) + f * c + 32768) >> 16
+//     = y + i * c + ((f' * c + 32768) >> 16),   f = 65536 * i + f'
+static inline void dctColorSSE2(__m128i y, __m128i cb, __m128i cr,
+				__m128i *r, __m128i *g, __m128i *b) {
+  __m128i c128, round, cbcrLo, cbcrHi, fLo, fHi;
+
+  c128 = _mm_set1_epi16(128);
+  round = _mm_set1_epi32(32768);
+  cb = _mm_sub_epi16(cb, c128);
+  cr = _mm_sub_epi16(cr, c128);
+  cbcrLo = _mm_unpacklo_epi16(cb, cr);
+  cbcrHi = _mm_unpackhi_epi16(cb, cr);
+
+  // R = Y + Cr + ((26345 * Cr + 32768) >> 16)
+  fLo = _mm_srai_epi32(_mm_add_epi32(
+	    _mm_madd_epi16(cbcrLo, _mm_set1_epi32(26345 << 16)), round), 16);
+  fHi = _mm_srai_epi32(_mm_add_epi32(
+	    _mm_madd_epi16(cbcrHi, _mm_set1_epi32(26345 << 16)), round), 16);
+  *r = _mm_add_epi16(_mm_add_epi16(y, cr), _mm_packs_epi32(fLo, fHi));
+
+  // G = Y - Cr + ((-22553 * Cb + 18734 * Cr + 32768) >> 16)
+  fLo = _mm_srai_epi32(_mm_add_epi32(
+	    _mm_madd_epi16(cbcrLo, _mm_set1_epi32((18734 << 16) |
+						  (-22553 & 0xffff))),
+	    round), 16);
+  fHi = _mm_srai_epi32(_mm_add_epi32(
+	    _mm_madd_epi16(cbcrHi, _mm_set1_epi32((18734 << 16) |
+						  (-22553 & 0xffff))),
+	    round), 16);
+  *g = _mm_add_epi16(_mm_sub_epi16(y, cr), _mm_packs_epi32(fLo, fHi));
+
+  // B = Y + 2 * Cb + ((-14942 * Cb + 32768) >> 16)
+  fLo = _mm_srai_epi32(_mm_add_epi32(
+	    _mm_madd_epi16(cbcrLo, _mm_set1_epi32(-14942 & 0xffff)), round),
+	    16);
+  fHi = _mm_srai_epi32(_mm_add_epi32(
+	    _mm_madd_epi16(cbcrHi, _mm_set1_epi32(-14942 & 0xffff)), round),
+	    16);
+  *b = _mm_add_epi16(_mm_add_epi16(y, _mm_add_epi16(cb, cb)),
+		     _mm_packs_epi32(fLo, fHi));
+}
+
+static void dctYCbCrToRGBSSE2(Guchar *pY, Guchar *pCb, Guchar *pCr,
+			      Guchar *out, int n) {
+  Guchar rgb[3][16];
+  __m128i zero, y, cb, cr, rLo, gLo, bLo, rHi, gHi, bHi;
+  int x, i;
+
+  zero = _mm_setzero_si128();
+  for (x = 0; x + 16 <= n; x += 16) {
+    y = _mm_loadu_si128((__m128i *)(pY + x));
+    cb = _mm_loadu_si128((__m128i *)(pCb + x));
+    cr = _mm_loadu_si128((__m128i *)(pCr + x));
+    dctColorSSE2(_mm_unpacklo_epi8(y, zero), _mm_unpacklo_epi8(cb, zero),
+		 _mm_unpacklo_epi8(cr, zero), &rLo, &gLo, &bLo);
+    dctColorSSE2(_mm_unpackhi_epi8(y, zero), _mm_unpackhi_epi8(cb, zero),
+		 _mm_unpackhi_epi8(cr, zero), &rHi, &gHi, &bHi);
+    _mm_storeu_si128((__m128i *)rgb[0], _mm_packus_epi16(rLo, rHi));
+    _mm_storeu_si128((__m128i *)rgb[1], _mm_packus_epi16(gLo, gHi));
+    _mm_storeu_si128((__m128i *)rgb[2], _mm_packus_epi16(bLo, bHi));
+    for (i = 0; i < 16; ++i) {
+      out[0] = rgb[0][i];
+      out[1] = rgb[1][i];
+      out[2] = rgb[2][i];
+      out += 3;
+    }
+  }
+  dctYCbCrToRGBScalar(pY + x, pCb + x, pCr + x, out, n - x);
+}
+
+static void dctYCCKToCMYKSSE2(Guchar *pY, Guchar *pCb, Guchar *pCr,
+			      Guchar *pK, Guchar *out, int n) {
+  Guchar cmy[3][16];
+  __m128i zero, ones, y, cb, cr, rLo, gLo, bLo, rHi, gHi, bHi;
+  int x, i;
+
+  zero = _mm_setzero_si128();
+  ones = _mm_set1_epi8((char)0xff);
+  for (x = 0; x + 16 <= n; x += 16) {
+    y = _mm_loadu_si128((__m128i *)(pY + x));
+    cb = _mm_loadu_si128((__m128i *)(pCb + x));
+    cr = _mm_loadu_si128((__m128i *)(pCr + x));
+    dctColorSSE2(_mm_unpacklo_epi8(y, zero), _mm_unpacklo_epi8(cb, zero),
+		 _mm_unpacklo_epi8(cr, zero), &rLo, &gLo, &bLo);
+    dctColorSSE2(_mm_unpackhi_epi8(y, zero), _mm_unpackhi_epi8(cb, zero),
+		 _mm_unpackhi_epi8(cr, zero), &rHi, &gHi, &bHi);
+    _mm_storeu_si128((__m128i *)cmy[0],
+		     _mm_xor_si128(_mm_packus_epi16(rLo, rHi), ones));
+    _mm_storeu_si128((__m128i *)cmy[1],
+		     _mm_xor_si128(_mm_packus_epi16(gLo, gHi), ones));
+    _mm_storeu_si128((__m128i *)cmy[2],
+		     _mm_xor_si128(_mm_packus_epi16(bLo, bHi), ones));
+    for (i = 0; i < 16; ++i) {
+      out[0] = cmy[0][i];
+      out[1] = cmy[1][i];
+      out[2] = cmy[2][i];
+      out[3] = pK[x + i];
+      out += 4;
+    }
+  }
+  dctYCCKToCMYKScalar(pY + x, pCb + x, pCr + x, pK + x, out, n - x);
+}
+
+static void dctYCbCrToRGBIntSSE2(int *p0, int *p1, int *p2, int n,
+				 GBool invert) {
+  __m128i zero, c255, y, cb, cr, r, g, b;
+  int x;
+
+  zero = _mm_setzero_si128();
+  c255 = _mm_set1_epi16(255);
+  for (x = 0; x + 8 <= n; x += 8) {
+    y = _mm_packs_epi32(_mm_loadu_si128((__m128i *)(p0 + x)),
+			_mm_loadu_si128((__m128i *)(p0 + x + 4)));
+    cb = _mm_packs_epi32(_mm_loadu_si128((__m128i *)(p1 + x)),
+			 _mm_loadu_si128((__m128i *)(p1 + x + 4)));
+    cr = _mm_packs_epi32(_mm_loadu_si128((__m128i *)(p2 + x)),
+			 _mm_loadu_si128((__m128i *)(p2 + x + 4)));
+    dctColorSSE2(y, cb, cr, &r, &g, &b);
+    // clamp to [0,255] (the same as packus + unpack)
+    r = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), zero);
+    g = _mm_unpacklo_epi8(_mm_packus_epi16(g, g), zero);
+    b = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), zero);
+    if (invert) {
+      r = _mm_sub_epi16(c255, r);
+      g = _mm_sub_epi16(c255, g);
+      b = _mm_sub_epi16(c255, b);
+    }
+    _mm_storeu_si128((__m128i *)(p0 + x), _mm_unpacklo_epi16(r, zero));
+    _mm_storeu_si128((__m128i *)(p0 + x + 4), _mm_unpackhi_epi16(r, zero));
+    _mm_storeu_si128((__m128i *)(p1 + x), _mm_unpacklo_epi16(g, zero));
+    _mm_storeu_si128((__m128i *)(p1 + x + 4), _mm_unpackhi_epi16(g, zero));
+    _mm_storeu_si128((__m128i *)(p2 + x), _mm_unpacklo_epi16(b, zero));
+    _mm_storeu_si128((__m128i *)(p2 + x + 4), _mm_unpackhi_epi16(b, zero));
+  }
+  dctYCbCrToRGBIntScalar(p0 + x, p1 + x, p2 + x, n - x, invert);
+}
+
+//----- AVX2
+
+#define dctAddAVX2(a, b) _mm256_add_epi32(a, b)
+#define dctSubAVX2(a, b) _mm256_sub_epi32(a, b)
+#define dctMulCAVX2(a, c) _mm256_mullo_epi32(a, _mm256_set1_epi32(c))
+#define dctSraAVX2(a) _mm256_srai_epi32(a, 12)
+
+DCT_AVX2 static inline void dctTranspose8x8AVX2(__m256i r[8]) {
+  __m256i t0, t1, t2, t3, t4, t5, t6, t7, u0, u1, u2, u3, u4, u5, u6, u7;
+
+  t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+  t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+  t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+  t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+  t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+  u0 = _mm256_unpacklo_epi64(t0, t2);
+  u1 = _mm256_unpackhi_epi64(t0, t2);
+  u2 = _mm256_unpacklo_epi64(t1, t3);
+  u3 = _mm256_unpackhi_epi64(t1, t3);
+  u4 = _mm256_unpacklo_epi64(t4, t6);
+  u5 = _mm256_unpackhi_epi64(t4, t6);
+  u6 = _mm256_unpacklo_epi64(t5, t7);
+  u7 = _mm256_unpackhi_epi64(t5, t7);
+  r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// See dctOutputSSE2.
+DCT_AVX2 static inline __m128i dctOutputAVX2(__m256i a) {
+  __m256i bad;
+
+  bad = _mm256_set1_epi32(dctClipMask - dctClipOffset);
+  a = _mm256_add_epi32(_mm256_srai_epi32(a, 3),
+		       _mm256_set1_epi32(128 + dctClipOffset));
+  a = _mm256_sub_epi32(_mm256_and_si256(a, _mm256_set1_epi32(dctClipMask)),
+		       _mm256_set1_epi32(dctClipOffset));
+  a = _mm256_andnot_si256(_mm256_cmpeq_epi32(a, bad), a);
+  return _mm_packs_epi32(_mm256_castsi256_si128(a),
+			 _mm256_extracti128_si256(a, 1));
+}
+
+DCT_AVX2 static void dctTransformAVX2(Gushort *quantTable,
+				      int dataIn[64], Guchar dataOut[64]) {
+  __m256i r[8];
+  int i;
+
+  // dequant
+  for (i = 0; i < 8; ++i) {
+    r[i] = _mm256_mullo_epi32(
+	       _mm256_loadu_si256((__m256i *)(dataIn + 8 * i)),
+	       _mm256_cvtepu16_epi32(
+		   _mm_loadu_si128((__m128i *)(quantTable + 8 * i))));
+  }
+
+  // inverse DCT on rows
+  dctTranspose8x8AVX2(r);
+  dctIDCT1D(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], __m256i,
+	    dctAddAVX2, dctSubAVX2, dctMulCAVX2, dctSraAVX2);
+
+  // inverse DCT on columns
+  dctTranspose8x8AVX2(r);
+  dctIDCT1D(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], __m256i,
+	    dctAddAVX2, dctSubAVX2, dctMulCAVX2, dctSraAVX2);
+
+  // convert to 8-bit integers
+  for (i = 0; i < 8; i += 2) {
+    _mm_storeu_si128((__m128i *)(dataOut + 8 * i),
+		     _mm_packus_epi16(dctOutputAVX2(r[i]),
+				      dctOutputAVX2(r[i+1])));
+  }
+}
+
+#endif // DCT_SIMD
+
+static void (*dctTransform)(Gushort *quantTable,
+			    int dataIn[64], Guchar dataOut[64]);
+static void (*dctYCbCrToRGB)(Guchar *pY, Guchar *pCb, Guchar *pCr,
+			     Guchar *out, int n);
+static void (*dctYCCKToCMYK)(Guchar *pY, Guchar *pCb, Guchar *pCr,
+			     Guchar *pK, Guchar *out, int n);
+static void (*dctYCbCrToRGBInt)(int *p0, int *p1, int *p2, int n,
+				GBool invert);
+
+static inline void dctKernelsInit() {
+  static int initDone = 0;
+
+  if (!initDone) {
+    dctTransform = &dctTransformScalar;
+    dctYCbCrToRGB = &dctYCbCrToRGBScalar;
+    dctYCCKToCMYK = &dctYCCKToCMYKScalar;
+    dctYCbCrToRGBInt = &dctYCbCrToRGBIntScalar;
+#if DCT_SIMD
+    dctTransform = &dctTransformSSE2;
+    dctYCbCrToRGB = &dctYCbCrToRGBSSE2;
+    dctYCCKToCMYK = &dctYCCKToCMYKSSE2;
+    dctYCbCrToRGBInt = &dctYCbCrToRGBIntSSE2;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      dctTransform = &dctTransformAVX2;
+    }
+#endif
+    initDone = 1;
+  }
+}
+
+DCTStream::DCTStream(Stream *strA, GBool colorXformA):
+    FilterStream(strA) {
+  int i;
+
+  colorXform = colorXformA;
+  progressive = interleaved = gFalse;
+  width = height = 0;
+  reduction = 0;
+  outWidth = outHeight = 0;
+  mcuWidth = mcuHeight = 0;
+  numComps = 0;
+  comp = 0;
+  x = y = 0;
+  for (i = 0; i < 4; ++i) {
+    frameBuf[i] = NULL;
+  }
+  rowBuf = NULL;
+  memset(dcHuffTables, 0, sizeof(dcHuffTables));
+  memset(acHuffTables, 0, sizeof(acHuffTables));
+  for (i = 0; i < 4; ++i) {
+    compRowBuf[i] = NULL;
+  }
+
+  dctClipInit();
+  dctKernelsInit();
+}
+
+DCTStream::~DCTStream() {
+  close();
+  delete str;
+}
+
+void DCTStream::reset() {
+  GMemTagScope memTag(gMemTagStream);
+  PerfTraceScope trace("stream", "DCTStream::reset");
+  int i;
+
+  str->reset();
+
+  progressive = interleaved = gFalse;
+  width = height = 0;
+  numComps = 0;
+  numQuantTables = 0;
+  numDCHuffTables = 0;
+  numACHuffTables = 0;
+  gotJFIFMarker = gFalse;
+  gotAdobeMarker = gFalse;
+  restartInterval = 0;
+
+  if (!readHeader()) {
+    // force an EOF condition
+    progressive = gTrue;
+    y = outHeight = height;
+    return;
+  }
+
+  // compute the output size
+  if (reduction < 0) {
+    reduction = 0;
+  } else if (reduction > 3) {
+    reduction = 3;
+  }
+  outWidth = (width + (1 << reduction) - 1) >> reduction;
+  outHeight = (height + (1 << reduction) - 1) >> reduction;
+
+  // compute MCU size
+  if (numComps == 1) {
+    compInfo[0].hSample = compInfo[0].vSample = 1;
+  }
+  mcuWidth = compInfo[0].hSample;
+  mcuHeight = compInfo[0].vSample;
+  for (i = 1; i < numComps; ++i) {
+    if (compInfo[i].hSample > mcuWidth) {
+      mcuWidth = compInfo[i].hSample;
+    }
+    if (compInfo[i].vSample > mcuHeight) {
+      mcuHeight = compInfo[i].vSample;
+    }
+  }
+  mcuWidth *= 8;
+  mcuHeight *= 8;
+
+  // figure out color transform
+  if (colorXform == -1) {
+    if (numComps == 3) {
+      if (gotJFIFMarker) {
+	colorXform = 1;
+      } else if (compInfo[0].id == 82 && compInfo[1].id == 71 &&
+		 compInfo[2].id == 66) { // ASCII "RGB"
+	colorXform = 0;
+      } else {
+	colorXform = 1;
+      }
+    } else {
+      colorXform = 0;
+    }
+  }
 
   if (progressive || !interleaved) {
 
@@ -2242,7 +3289,7 @@ void DCTStream::reset() {
     if (bufWidth <= 0 || bufHeight <= 0 ||
 	bufWidth > INT_MAX / bufWidth / (int)sizeof(int)) {
       error(errSyntaxError, getPos(), "Invalid image size in DCT stream");
-      y = height;
+      y = outHeight;
       return;
     }
     for (i = 0; i < numComps; ++i) {
@@ -2267,10 +3314,17 @@ void DCTStream::reset() {
 
   } else {
 
-    // allocate a buffer for one row of MCUs
+    // allocate a buffer for one row of MCUs, plus a (padded) buffer
+    // for each component
     bufWidth = ((width + mcuWidth - 1) / mcuWidth) * mcuWidth;
     rowBuf = (Guchar *)gmallocn(numComps * mcuHeight, bufWidth);
     rowBufPtr = rowBufEnd = rowBuf;
+    compRowBufWidth = bufWidth >> reduction;
+    for (i = 0; i < numComps; ++i) {
+      compRowBuf[i] = (Guchar *)gmallocn(mcuHeight >> reduction,
+					 compRowBufWidth);
+      memset(compRowBuf[i], 0, (mcuHeight >> reduction) * compRowBufWidth);
+    }
 
     // initialize counters
     y = -mcuHeight;
@@ -2286,6 +3340,8 @@ void DCTStream::close() {
   for (i = 0; i < 4; ++i) {
     gfree(frameBuf[i]);
     frameBuf[i] = NULL;
+    gfree(compRowBuf[i]);
+    compRowBuf[i] = NULL;
   }
   gfree(rowBuf);
   rowBuf = NULL;
@@ -2296,13 +3352,13 @@ int DCTStream::getChar() {
   int c;
 
   if (progressive || !interleaved) {
-    if (y >= height) {
+    if (y >= outHeight) {
       return EOF;
     }
     c = frameBuf[comp][y * bufWidth + x];
     if (++comp == numComps) {
       comp = 0;
-      if (++x == width) {
+      if (++x == outWidth) {
 	x = 0;
 	++y;
       }
@@ -2325,7 +3381,7 @@ int DCTStream::getChar() {
 
 int DCTStream::lookChar() {
   if (progressive || !interleaved) {
-    if (y >= height) {
+    if (y >= outHeight) {
       return EOF;
     }
     return frameBuf[comp][y * bufWidth + x];
@@ -2354,16 +3410,20 @@ void DCTStream::restart() {
   eobRun = 0;
 }
 
-// Read one row of MCUs from a sequential JPEG stream.
+// Read one row of MCUs from a sequential JPEG stream.  Each component
+// is decoded (and upsampled) into its own buffer, and the components
+// are then color converted and interleaved into rowBuf.
 GBool DCTStream::readMCURow() {
+  PerfTraceScope trace("stream", "DCTStream::readMCURow");
   int data1[64];
   Guchar data2[64];
-  Guchar *p1, *p2;
-  int pY, pCb, pCr, pR, pG, pB;
+  Guchar *p0, *p1, *p2, *p3, *q;
   int h, v, horiz, vert, hSub, vSub;
   int x1, x2, y2, x3, y3, x4, y4, x5, y5, cc, i;
+  int bs, nRows;
   int c;
 
+  bs = 8 >> reduction;
   for (x1 = 0; x1 < width; x1 += mcuWidth) {
 
     // deal with restart marker
@@ -2395,49 +3455,37 @@ GBool DCTStream::readMCURow() {
 			    data1)) {
 	    return gFalse;
 	  }
-	  transformDataUnit(quantTables[compInfo[cc].quantTable],
-			    data1, data2);
-	  if (hSub == 1 && vSub == 1 && x1+x2+8 <= width) {
-	    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
-	      p1 = &rowBuf[((y2+y3) * width + (x1+x2)) * numComps + cc];
-	      p1[0]          = data2[i];
-	      p1[  numComps] = data2[i+1];
-	      p1[2*numComps] = data2[i+2];
-	      p1[3*numComps] = data2[i+3];
-	      p1[4*numComps] = data2[i+4];
-	      p1[5*numComps] = data2[i+5];
-	      p1[6*numComps] = data2[i+6];
-	      p1[7*numComps] = data2[i+7];
+	  if (reduction) {
+	    transformDataUnitReduced(quantTables[compInfo[cc].quantTable],
+				     data1, data2);
+	  } else {
+	    transformDataUnit(quantTables[compInfo[cc].quantTable],
+			      data1, data2);
+	  }
+	  // the component buffers are padded out to a multiple of the
+	  // MCU width, so no clipping is needed here
+	  p1 = &compRowBuf[cc][(y2 >> reduction) * compRowBufWidth +
+			       ((x1 + x2) >> reduction)];
+	  if (hSub == 1 && vSub == 1) {
+	    for (y3 = 0, i = 0; y3 < bs; ++y3, i += bs) {
+	      memcpy(p1, data2 + i, bs);
+	      p1 += compRowBufWidth;
 	    }
-	  } else if (hSub == 2 && vSub == 2 && x1+x2+16 <= width) {
-	    for (y3 = 0, i = 0; y3 < 16; y3 += 2, i += 8) {
-	      p1 = &rowBuf[((y2+y3) * width + (x1+x2)) * numComps + cc];
-	      p2 = p1 + width * numComps;
-	      p1[0] = p1[numComps] =
-		p2[0] = p2[numComps] = data2[i];
-	      p1[2*numComps] = p1[3*numComps] =
-		p2[2*numComps] = p2[3*numComps] = data2[i+1];
-	      p1[4*numComps] = p1[5*numComps] =
-		p2[4*numComps] = p2[5*numComps] = data2[i+2];
-	      p1[6*numComps] = p1[7*numComps] =
-		p2[6*numComps] = p2[7*numComps] = data2[i+3];
-	      p1[8*numComps] = p1[9*numComps] =
-		p2[8*numComps] = p2[9*numComps] = data2[i+4];
-	      p1[10*numComps] = p1[11*numComps] =
-		p2[10*numComps] = p2[11*numComps] = data2[i+5];
-	      p1[12*numComps] = p1[13*numComps] =
-		p2[12*numComps] = p2[13*numComps] = data2[i+6];
-	      p1[14*numComps] = p1[15*numComps] =
-		p2[14*numComps] = p2[15*numComps] = data2[i+7];
+	  } else if (hSub == 2 && vSub == 2) {
+	    for (y3 = 0, i = 0; y3 < bs; ++y3) {
+	      p2 = p1 + compRowBufWidth;
+	      for (x3 = 0; x3 < bs; ++x3, ++i) {
+		p1[2*x3] = p1[2*x3+1] = p2[2*x3] = p2[2*x3+1] = data2[i];
+	      }
+	      p1 += 2 * compRowBufWidth;
 	    }
 	  } else {
-	    p1 = &rowBuf[(y2 * width + (x1+x2)) * numComps + cc];
 	    i = 0;
-	    for (y3 = 0, y4 = 0; y3 < 8; ++y3, y4 += vSub) {
-	      for (x3 = 0, x4 = 0; x3 < 8; ++x3, x4 += hSub) {
+	    for (y3 = 0, y4 = 0; y3 < bs; ++y3, y4 += vSub) {
+	      for (x3 = 0, x4 = 0; x3 < bs; ++x3, x4 += hSub) {
 		for (y5 = 0; y5 < vSub; ++y5) {
-		  for (x5 = 0; x5 < hSub && x1+x2+x4+x5 < width; ++x5) {
-		    p1[((y4+y5) * width + (x4+x5)) * numComps] = data2[i];
+		  for (x5 = 0; x5 < hSub; ++x5) {
+		    p1[(y4+y5) * compRowBufWidth + (x4+x5)] = data2[i];
 		  }
 		}
 		++i;
@@ -2450,43 +3498,59 @@ GBool DCTStream::readMCURow() {
     --restartCtr;
   }
 
-  // color space conversion
-  if (colorXform) {
-    // convert YCbCr to RGB
+  // color space conversion, and interleave the components
+  if (y + mcuHeight <= height) {
+    nRows = mcuHeight >> reduction;
+  } else {
+    nRows = ((height - y) + (1 << reduction) - 1) >> reduction;
+  }
+  for (y2 = 0; y2 < nRows; ++y2) {
+    q = rowBuf + y2 * outWidth * numComps;
+    p0 = compRowBuf[0] + y2 * compRowBufWidth;
+    if (numComps == 1) {
+      memcpy(q, p0, outWidth);
+      continue;
+    }
+    p1 = compRowBuf[1] + y2 * compRowBufWidth;
+    p2 = compRowBuf[2] + y2 * compRowBufWidth;
     if (numComps == 3) {
-      for (i = 0, p1 = rowBuf; i < width * mcuHeight; ++i, p1 += 3) {
-	pY = p1[0];
-	pCb = p1[1] - 128;
-	pCr = p1[2] - 128;
-	pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	p1[0] = dctClip(pR);
-	pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	p1[1] = dctClip(pG);
-	pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	p1[2] = dctClip(pB);
+      if (colorXform) {
+	// convert YCbCr to RGB
+	(*dctYCbCrToRGB)(p0, p1, p2, q, outWidth);
+      } else {
+	for (x2 = 0; x2 < outWidth; ++x2) {
+	  q[0] = p0[x2];
+	  q[1] = p1[x2];
+	  q[2] = p2[x2];
+	  q += 3;
+	}
       }
-    // convert YCbCrK to CMYK (K is passed through unchanged)
     } else if (numComps == 4) {
-      for (i = 0, p1 = rowBuf; i < width * mcuHeight; ++i, p1 += 4) {
-	pY = p1[0];
-	pCb = p1[1] - 128;
-	pCr = p1[2] - 128;
-	pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	p1[0] = 255 - dctClip(pR);
-	pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	p1[1] = 255 - dctClip(pG);
-	pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	p1[2] = 255 - dctClip(pB);
+      p3 = compRowBuf[3] + y2 * compRowBufWidth;
+      if (colorXform) {
+	// convert YCbCrK to CMYK (K is passed through unchanged)
+	(*dctYCCKToCMYK)(p0, p1, p2, p3, q, outWidth);
+      } else {
+	for (x2 = 0; x2 < outWidth; ++x2) {
+	  q[0] = p0[x2];
+	  q[1] = p1[x2];
+	  q[2] = p2[x2];
+	  q[3] = p3[x2];
+	  q += 4;
+	}
+      }
+    } else {
+      // numComps == 2 (invalid, but handle it anyway)
+      for (x2 = 0; x2 < outWidth; ++x2) {
+	q[0] = p0[x2];
+	q[1] = p1[x2];
+	q += 2;
       }
     }
   }
 
   rowBufPtr = rowBuf;
-  if (y + mcuHeight <= height) {
-    rowBufEnd = rowBuf + numComps * width * mcuHeight;
-  } else {
-    rowBufEnd = rowBuf + numComps * width * (height - y);
-  }
+  rowBufEnd = rowBuf + numComps * outWidth * nRows;
 
   return gTrue;
 }
@@ -2799,11 +3863,16 @@ void DCTStream::decodeImage() {
   int dataIn[64];
   Guchar dataOut[64];
   Gushort *quantTable;
-  int pY, pCb, pCr, pR, pG, pB;
   int x1, y1, x2, y2, x3, y3, x4, y4, x5, y5, cc, i;
-  int h, v, horiz, vert, hSub, vSub;
+  int h, v, horiz, vert, hSub, vSub, bs;
   int *p0, *p1, *p2;
 
+  // with reduced resolution, each data unit is transformed in place
+  // and written back (at the reduced size) into the top-left corner
+  // of the frame buffer -- this only overwrites coefficients that
+  // have already been consumed, because data units are processed in
+  // raster order
+  bs = 8 >> reduction;
   for (y1 = 0; y1 < bufHeight; y1 += mcuHeight) {
     for (x1 = 0; x1 < bufWidth; x1 += mcuWidth) {
       for (cc = 0; cc < numComps; ++cc) {
@@ -2832,12 +3901,32 @@ void DCTStream::decodeImage() {
 	    }
 
 	    // transform
-	    transformDataUnit(quantTable, dataIn, dataOut);
+	    if (reduction) {
+	      transformDataUnitReduced(quantTable, dataIn, dataOut);
+	    } else {
+	      transformDataUnit(quantTable, dataIn, dataOut);
+	    }
 
 	    // store back into frameBuf, doing replication for
 	    // subsampled components
-	    p1 = &frameBuf[cc][(y1+y2) * bufWidth + (x1+x2)];
-	    if (hSub == 1 && vSub == 1) {
+	    p1 = &frameBuf[cc][((y1+y2) >> reduction) * bufWidth +
+			       ((x1+x2) >> reduction)];
+	    if (reduction) {
+	      i = 0;
+	      for (y3 = 0; y3 < bs; ++y3) {
+		for (x3 = 0, x4 = 0; x3 < bs; ++x3, x4 += hSub) {
+		  p2 = p1 + x4;
+		  for (y5 = 0; y5 < vSub; ++y5) {
+		    for (x5 = 0; x5 < hSub; ++x5) {
+		      p2[x5] = dataOut[i] & 0xff;
+		    }
+		    p2 += bufWidth;
+		  }
+		  ++i;
+		}
+		p1 += bufWidth * vSub;
+	      }
+	    } else if (hSub == 1 && vSub == 1) {
 	      for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
 		p1[0] = dataOut[i] & 0xff;
 		p1[1] = dataOut[i+1] & 0xff;
@@ -2884,45 +3973,16 @@ void DCTStream::decodeImage() {
       }
 
       // color space conversion
-      if (colorXform) {
-	// convert YCbCr to RGB
-	if (numComps == 3) {
-	  for (y2 = 0; y2 < mcuHeight; ++y2) {
-	    p0 = &frameBuf[0][(y1+y2) * bufWidth + x1];
-	    p1 = &frameBuf[1][(y1+y2) * bufWidth + x1];
-	    p2 = &frameBuf[2][(y1+y2) * bufWidth + x1];
-	    for (x2 = 0; x2 < mcuWidth; ++x2) {
-	      pY = *p0;
-	      pCb = *p1 - 128;
-	      pCr = *p2 - 128;
-	      pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	      *p0++ = dctClip(pR);
-	      pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr +
-		    32768) >> 16;
-	      *p1++ = dctClip(pG);
-	      pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	      *p2++ = dctClip(pB);
-	    }
-	  }
-	// convert YCbCrK to CMYK (K is passed through unchanged)
-	} else if (numComps == 4) {
-	  for (y2 = 0; y2 < mcuHeight; ++y2) {
-	    p0 = &frameBuf[0][(y1+y2) * bufWidth + x1];
-	    p1 = &frameBuf[1][(y1+y2) * bufWidth + x1];
-	    p2 = &frameBuf[2][(y1+y2) * bufWidth + x1];
-	    for (x2 = 0; x2 < mcuWidth; ++x2) {
-	      pY = *p0;
-	      pCb = *p1 - 128;
-	      pCr = *p2 - 128;
-	      pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	      *p0++ = 255 - dctClip(pR);
-	      pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr +
-		    32768) >> 16;
-	      *p1++ = 255 - dctClip(pG);
-	      pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	      *p2++ = 255 - dctClip(pB);
-	    }
-	  }
+      if (colorXform && numComps >= 3) {
+	// convert YCbCr to RGB, or YCbCrK to CMYK (K is passed
+	// through unchanged)
+	for (y2 = 0; y2 < (mcuHeight >> reduction); ++y2) {
+	  y3 = (y1 >> reduction) + y2;
+	  p0 = &frameBuf[0][y3 * bufWidth + (x1 >> reduction)];
+	  p1 = &frameBuf[1][y3 * bufWidth + (x1 >> reduction)];
+	  p2 = &frameBuf[2][y3 * bufWidth + (x1 >> reduction)];
+	  (*dctYCbCrToRGBInt)(p0, p1, p2, mcuWidth >> reduction,
+			      numComps == 4);
 	}
       }
     }
@@ -2930,173 +3990,51 @@ void DCTStream::decodeImage() {
 }
 
 // Transform one data unit -- this performs the dequantization and
-// IDCT steps.  This IDCT algorithm is taken from:
-//   Christoph Loeffler, Adriaan Ligtenberg, George S. Moschytz,
-//   "Practical Fast 1-D DCT Algorithms with 11 Multiplications",
-//   IEEE Intl. Conf. on Acoustics, Speech & Signal Processing, 1989,
-//   988-991.
-// The stage numbers mentioned in the comments refer to Figure 1 in this
-// paper.
+// IDCT steps, using the fastest available kernel.
 void DCTStream::transformDataUnit(Gushort *quantTable,
 				  int dataIn[64], Guchar dataOut[64]) {
-  int v0, v1, v2, v3, v4, v5, v6, v7, t0, t1, t2;
-  int *p;
-  Gushort *q;
-  int i;
+  (*dctTransform)(quantTable, dataIn, dataOut);
+}
+
+// Transform one data unit at reduced resolution, producing an
+// (8 >> reduction) x (8 >> reduction) block.  Only the low-frequency
+// corner of the coefficient block is used: the 1/8 case is just the DC
+// coefficient; the 1/2 and 1/4 cases use a straightforward separable
+// N-point IDCT (with the same scaling as the full 8-point IDCT).
+void DCTStream::transformDataUnitReduced(Gushort *quantTable,
+					 int dataIn[64],
+					 Guchar dataOut[64]) {
+  int tmp[16];
+  int *k;
+  int n, u, v, x, y, t;
+
+  if (reduction >= 3) {
+    dataOut[0] = dctClip(128 + ((dataIn[0] * quantTable[0]) >> 3));
+    return;
+  }
+  n = 8 >> reduction;
+  k = (n == 4) ? dctReduced4 : dctReduced2;
 
   // dequant; inverse DCT on rows
-  for (i = 0; i < 64; i += 8) {
-    p = dataIn + i;
-    q = quantTable + i;
-
-    // check for all-zero AC coefficients
-    if (p[1] == 0 && p[2] == 0 && p[3] == 0 &&
-	p[4] == 0 && p[5] == 0 && p[6] == 0 && p[7] == 0) {
-      t0 = p[0] * q[0];
-      p[0] = t0;
-      p[1] = t0;
-      p[2] = t0;
-      p[3] = t0;
-      p[4] = t0;
-      p[5] = t0;
-      p[6] = t0;
-      p[7] = t0;
-      continue;
+  for (v = 0; v < n; ++v) {
+    for (x = 0; x < n; ++x) {
+      t = 0;
+      for (u = 0; u < n; ++u) {
+	t += k[x*n + u] * (dataIn[v*8 + u] * quantTable[v*8 + u]);
+      }
+      tmp[v*n + x] = t >> 12;
     }
-
-    // stage 4
-    v0 = p[0] * q[0];
-    v1 = p[4] * q[4];
-    v2 = p[2] * q[2];
-    v3 = p[6] * q[6];
-    t0 = p[1] * q[1];
-    t1 = p[7] * q[7];
-    v4 = t0 - t1;
-    v7 = t0 + t1;
-    v5 = (dctSqrt2 * p[3] * q[3]) >> 12;
-    v6 = (dctSqrt2 * p[5] * q[5]) >> 12;
-
-    // stage 3
-    t0 = v0 - v1;
-    v0 = v0 + v1;
-    v1 = t0;
-    t0 = dctSqrt2Cos6 * (v2 + v3);
-    t1 = dctSqrt2Cos6PSin6 * v3;
-    t2 = dctSqrt2Sin6MCos6 * v2;
-    v2 = (t0 - t1) >> 12;
-    v3 = (t0 + t2) >> 12;
-    t0 = v4 - v6;
-    v4 = v4 + v6;
-    v6 = t0;
-    t0 = v7 + v5;
-    v5 = v7 - v5;
-    v7 = t0;
-
-    // stage 2
-    t0 = v0 - v3;
-    v0 = v0 + v3;
-    v3 = t0;
-    t0 = v1 - v2;
-    v1 = v1 + v2;
-    v2 = t0;
-    t0 = dctCos3 * (v4 + v7);
-    t1 = dctCos3PSin3 * v7;
-    t2 = dctSin3MCos3 * v4;
-    v4 = (t0 - t1) >> 12;
-    v7 = (t0 + t2) >> 12;
-    t0 = dctCos1 * (v5 + v6);
-    t1 = dctCos1PSin1 * v6;
-    t2 = dctSin1MCos1 * v5;
-    v5 = (t0 - t1) >> 12;
-    v6 = (t0 + t2) >> 12;
-
-    // stage 1
-    p[0] = v0 + v7;
-    p[7] = v0 - v7;
-    p[1] = v1 + v6;
-    p[6] = v1 - v6;
-    p[2] = v2 + v5;
-    p[5] = v2 - v5;
-    p[3] = v3 + v4;
-    p[4] = v3 - v4;
   }
 
-  // inverse DCT on columns
-  for (i = 0; i < 8; ++i) {
-    p = dataIn + i;
-
-    // check for all-zero AC coefficients
-    if (p[1*8] == 0 && p[2*8] == 0 && p[3*8] == 0 &&
-	p[4*8] == 0 && p[5*8] == 0 && p[6*8] == 0 && p[7*8] == 0) {
-      t0 = p[0*8];
-      p[1*8] = t0;
-      p[2*8] = t0;
-      p[3*8] = t0;
-      p[4*8] = t0;
-      p[5*8] = t0;
-      p[6*8] = t0;
-      p[7*8] = t0;
-      continue;
+  // inverse DCT on columns; convert to 8-bit integers
+  for (y = 0; y < n; ++y) {
+    for (x = 0; x < n; ++x) {
+      t = 0;
+      for (v = 0; v < n; ++v) {
+	t += k[y*n + v] * tmp[v*n + x];
+      }
+      dataOut[y*n + x] = dctClip(128 + ((t + 8192) >> 14));
     }
-
-    // stage 4
-    v0 = p[0*8];
-    v1 = p[4*8];
-    v2 = p[2*8];
-    v3 = p[6*8];
-    v4 = p[1*8] - p[7*8];
-    v7 = p[1*8] + p[7*8];
-    v5 = (dctSqrt2 * p[3*8]) >> 12;
-    v6 = (dctSqrt2 * p[5*8]) >> 12;
-
-    // stage 3
-    t0 = v0 - v1;
-    v0 = v0 + v1;
-    v1 = t0;
-    t0 = dctSqrt2Cos6 * (v2 + v3);
-    t1 = dctSqrt2Cos6PSin6 * v3;
-    t2 = dctSqrt2Sin6MCos6 * v2;
-    v2 = (t0 - t1) >> 12;
-    v3 = (t0 + t2) >> 12;
-    t0 = v4 - v6;
-    v4 = v4 + v6;
-    v6 = t0;
-    t0 = v7 + v5;
-    v5 = v7 - v5;
-    v7 = t0;
-
-    // stage 2
-    t0 = v0 - v3;
-    v0 = v0 + v3;
-    v3 = t0;
-    t0 = v1 - v2;
-    v1 = v1 + v2;
-    v2 = t0;
-    t0 = dctCos3 * (v4 + v7);
-    t1 = dctCos3PSin3 * v7;
-    t2 = dctSin3MCos3 * v4;
-    v4 = (t0 - t1) >> 12;
-    v7 = (t0 + t2) >> 12;
-    t0 = dctCos1 * (v5 + v6);
-    t1 = dctCos1PSin1 * v6;
-    t2 = dctSin1MCos1 * v5;
-    v5 = (t0 - t1) >> 12;
-    v6 = (t0 + t2) >> 12;
-
-    // stage 1
-    p[0*8] = v0 + v7;
-    p[7*8] = v0 - v7;
-    p[1*8] = v1 + v6;
-    p[6*8] = v1 - v6;
-    p[2*8] = v2 + v5;
-    p[5*8] = v2 - v5;
-    p[3*8] = v3 + v4;
-    p[4*8] = v3 - v4;
-  }
-
-  // convert to 8-bit integers
-  for (i = 0; i < 64; ++i) {
-    dataOut[i] = dctClip(128 + (dataIn[i] >> 3));
   }
 }
 
@@ -4430,6 +5368,7 @@ void FlateStream::readSome() {
       endOfBlock = gTrue;
   }
 
+  perfCounters.inflatedBytes += remain;
   return;
 
 err:
@@ -361,6 +361,127 @@ private:
   GBool needFree;
 };
 
+//------------------------------------------------------------------------
+// RangeStream
+//
+// A file that is read through a callback, in byte ranges -- e.g., a
+// PDF file on a remote server that supports range requests.  The
+// data is fetched in fixed-size blocks, which are kept in an LRU
+// cache shared by the RangeStream and all of its substreams.  A
+// stream that is read sequentially fetches several blocks at once
+// (doubling up to rangeStreamMaxReadAhead), but never past its own
+// end.
+//------------------------------------------------------------------------
+
+// Read <size> bytes at offset <pos> into <buf>.  Returns the number
+// of bytes read, which is less than <size> only at the end of the
+// file, or -1 on error.
+typedef int (*RangeStreamReadFunc)(void *data, GFileOffset pos,
+				   char *buf, int size);
+
+#define rangeStreamBufSize 1024
+#define rangeStreamMaxReadAhead 16
+
+struct RangeStreamBlock {
+  int blk;			// block number, or -1 if unused
+  int len;			// bytes of data (blockSize, except at EOF)
+  char *data;
+  int prev, next;		// LRU list (slot numbers, -1 at the ends)
+};
+
+class RangeStreamCache {
+public:
+
+  // <fileSizeA> is the size of the file; <blockSizeA> is the size of
+  // a block, in bytes; up to <maxBlocksA> blocks are kept.  The new
+  // cache has one reference, which belongs to the caller.
+  RangeStreamCache(RangeStreamReadFunc readFuncA, void *readDataA,
+		   GFileOffset fileSizeA, int blockSizeA, int maxBlocksA);
+
+  void incRefCnt();
+  void decRefCnt();
+
+  GFileOffset getFileSize() { return fileSize; }
+
+  // Copy up to <size> bytes at <pos> into <buf>, fetching any blocks
+  // that aren't cached.  A missing block is fetched together with up
+  // to <readAhead> - 1 following blocks, but nothing at or beyond
+  // <end> is read ahead.  Returns the number of bytes copied, and
+  // sets <fetched> if the callback was used.
+  int read(GFileOffset pos, char *buf, int size, int readAhead,
+	   GFileOffset end, GBool *fetched);
+
+  // Bytes fetched through the callback, and number of calls.
+  GFileOffset getBytesFetched() { return bytesFetched; }
+  int getNumFetches() { return nFetches; }
+
+private:
+
+  ~RangeStreamCache();
+  int fetch(int blk, int readAhead, int endBlk);
+  int takeSlot();
+  void unlinkSlot(int slot);
+  void linkSlot(int slot);
+
+  RangeStreamReadFunc readFunc;
+  void *readData;
+  GFileOffset fileSize;
+  int blockSize;
+  int nBlocks;			// blocks in the file
+  int *slotOf;			// cache slot for each block, or -1
+				//   [nBlocks]
+  RangeStreamBlock *slots;	// [maxBlocks]
+  int maxBlocks;
+  int nSlotsUsed;
+  int lruHead, lruTail;		// most and least recently used slots
+  char *fetchBuf;		// [rangeStreamMaxReadAhead * blockSize]
+  GBool readErr;		// a fetch has failed (reported once)
+  GFileOffset bytesFetched;
+  int nFetches;
+  int refCnt;
+};
+
+class RangeStream: public BaseStream {
+public:
+
+  // The stream takes a reference to <cacheA>.
+  RangeStream(RangeStreamCache *cacheA, GFileOffset startA, GBool limitedA,
+	      GFileOffset lengthA, Object *dictA);
+  virtual ~RangeStream();
+  virtual Stream *makeSubStream(GFileOffset startA, GBool limitedA,
+				GFileOffset lengthA, Object *dictA);
+  virtual StreamKind getKind() { return strWeird; }
+  virtual void reset();
+  virtual void close();
+  virtual int getChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
+  virtual int lookChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
+  virtual GFileOffset getPos() { return bufPos + (int)(bufPtr - buf); }
+  virtual void setPos(GFileOffset pos, int dir = 0);
+  virtual GFileOffset getStart() { return start; }
+  virtual void moveStart(int delta);
+
+  RangeStreamCache *getCache() { return cache; }
+
+private:
+
+  GBool fillBuf();
+  int readCache(char *blk, int size);
+
+  RangeStreamCache *cache;
+  GFileOffset start;
+  GBool limited;
+  GFileOffset length;
+  char buf[rangeStreamBufSize];
+  char *bufPtr;
+  char *bufEnd;
+  GFileOffset bufPos;		// file offset of buf[0]
+  GFileOffset nextPos;		// where a sequential read would go next
+  int readAhead;		// blocks to fetch at once
+};
+
 //------------------------------------------------------------------------
 // EmbedStream
 //
@@ -612,11 +733,19 @@ public:
   virtual GBool isBinary(GBool last = gTrue);
   Stream *getRawStream() { return str; }
 
+  // Decode at 1/2, 1/4, or 1/8 size (reduction = 1, 2, or 3).  This
+  // must be called before reset().  The decoded image is
+  // ceil(width / 2^reduction) x ceil(height / 2^reduction).
+  void reduceResolution(int reductionA) { reduction = reductionA; }
+  int getReduction() { return reduction; }
+
 private:
 
   GBool progressive;		// set if in progressive mode
   GBool interleaved;		// set if in interleaved mode
   int width, height;		// image size
+  int reduction;		// log2 of the output scale-down factor
+  int outWidth, outHeight;	// decoded (possibly reduced) image size
   int mcuWidth, mcuHeight;	// size of min coding unit, in data units
   int bufWidth, bufHeight;	// frameBuf size
   DCTCompInfo compInfo[4];	// info for each component
@@ -637,6 +766,9 @@ private:
   Guchar *rowBuf;
   Guchar *rowBufPtr;		// current position within rowBuf
   Guchar *rowBufEnd;		// end of valid data in rowBuf
+  Guchar *compRowBuf[4];	// one row of MCUs for each component
+				//   (sequential mode)
+  int compRowBufWidth;		// width of each compRowBuf row
   int *frameBuf[4];		// buffer for frame (progressive mode)
   int comp, x, y;		// current position within image/MCU
   int restartCtr;		// MCUs left until restart
@@ -657,6 +789,8 @@ private:
   void decodeImage();
   void transformDataUnit(Gushort *quantTable,
 			 int dataIn[64], Guchar dataOut[64]);
+  void transformDataUnitReduced(Gushort *quantTable,
+				int dataIn[64], Guchar dataOut[64]);
   int readHuffSym(DCTHuffTable *table);
   int readAmp(int size);
   int readBit();
@@ -26,6 +26,7 @@
 #include "GList.h"
 #include "config.h"
 #include "Error.h"
+#include "PerfCounters.h"
 #include "GlobalParams.h"
 #include "UnicodeMap.h"
 #include "UnicodeTypeTable.h"
@@ -1085,6 +1086,7 @@ void TextPage::clear() {
 }
 
 void TextPage::updateFont(GfxState *state) {
+  GMemTagScope memTag(gMemTagText);
   GfxFont *gfxFont;
   double *fm;
   char *name;
@@ -1175,6 +1177,7 @@ void TextPage::updateFont(GfxState *state) {
 void TextPage::addChar(GfxState *state, double x, double y,
 		       double dx, double dy,
 		       CharCode c, int nBytes, Unicode *u, int uLen) {
+  GMemTagScope memTag(gMemTagText);
   double x1, y1, x2, y2, w1, h1, dx2, dy2, ascent, descent, sp;
   double xMin, yMin, xMax, yMax;
   double clipXMin, clipYMin, clipXMax, clipYMax;
@@ -1375,6 +1378,7 @@ void TextPage::addTextoutFormField(int xmin, int ymin, int xmax, int ymax, const
 //------------------------------------------------------------------------
 
 void TextPage::write(void *outputStream, TextOutputFunc outputFunc) {
+  GMemTagScope memTag(gMemTagText);
   UnicodeMap *uMap;
   char space[8], eol[16], eop[8];
   int spaceLen, eolLen, eopLen;
@@ -1492,6 +1496,8 @@ void TextPage::writeReadingOrder(void *outputStream,
 }
 
 GList *TextPage::makeColumns() {
+  GMemTagScope memTag(gMemTagText);
+  PerfTraceScope trace("text", "makeColumns");
   TextBlock *tree;
   GList *columns;
 
@@ -3740,6 +3746,7 @@ GBool TextPage::findText(Unicode *s, int len,
 			 GBool wholeWord,
 			 double *xMin, double *yMin,
 			 double *xMax, double *yMax) {
+  GMemTagScope memTag(gMemTagText);
   TextBlock *tree;
   TextColumn *column;
   TextParagraph *par;
@@ -3972,6 +3979,7 @@ GBool TextPage::findText(Unicode *s, int len,
 
 GString *TextPage::getText(double xMin, double yMin,
 			   double xMax, double yMax) {
+  GMemTagScope memTag(gMemTagText);
   UnicodeMap *uMap;
   char space[8], eol[16];
   int spaceLen, eolLen;
@@ -4141,6 +4149,7 @@ GBool TextPage::findCharRange(int pos, int length,
 }
 
 TextWordList *TextPage::makeWordList() {
+  GMemTagScope memTag(gMemTagText);
   TextBlock *tree;
   GList *columns;
   TextColumn *col;
@@ -6,7 +6,7 @@
 //
 //========================================================================
 
-static int mapUTF8(Unicode u, char *buf, int bufSize) {
+static inline int mapUTF8(Unicode u, char *buf, int bufSize) {
   if        (u <= 0x0000007f) {
     if (bufSize < 1) {
       return 0;
@@ -42,7 +42,7 @@ static int mapUTF8(Unicode u, char *buf, int bufSize) {
   }
 }
 
-static int mapUCS2(Unicode u, char *buf, int bufSize) {
+static inline int mapUCS2(Unicode u, char *buf, int bufSize) {
   if (u <= 0xffff) {
     if (bufSize < 2) {
       return 0;
@@ -33,6 +33,19 @@
 #define xrefSearchSize 1024	// read this many bytes at end of file
 				//   to look for 'startxref'
 
+#define xrefTableBlockSize 16384	// xref table entries are read in
+					//   blocks of this many bytes
+
+#define xrefScanBlockSize 65536	// block size used by constructXRef
+
+#define xrefScanLineLength 255	// constructXRef looks at the first
+				//   this many chars of each line
+
+#define xrefLazyMinEntries 256	// xref table subsections with at least
+				//   this many entries are decoded lazily
+#define xrefLazyBlockEntries 64	// entries in lazy sections are read in
+				//   blocks of this many
+
 //------------------------------------------------------------------------
 // Permission bits
 //------------------------------------------------------------------------
@@ -129,8 +142,9 @@ class ObjectStream {
 public:
 
   // Create an object stream, using object number <objStrNum>,
-  // generation 0.
-  ObjectStream(XRef *xref, int objStrNumA);
+  // generation 0.  The stream is decoded, but only the header is
+  // parsed; each object is parsed the first time it is fetched.
+  ObjectStream(XRef *xrefA, int objStrNumA);
 
   GBool isOk() { return ok; }
 
@@ -145,24 +159,33 @@ public:
 
 private:
 
+  XRef *xref;
   int objStrNum;		// object number of the object stream
   int nObjects;			// number of objects in the stream
-  Object *objs;			// the objects (length = nObjects)
+  char *data;			// the decoded stream
+  int dataLen;			// length of data
+  Object *objs;			// the objects (length = nObjects); none
+				//   until parsed
   int *objNums;			// the object numbers (length = nObjects)
+  int *offsets;			// offset of each object in data
+				//   (length = nObjects)
   GBool ok;
 };
 
-ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
+ObjectStream::ObjectStream(XRef *xrefA, int objStrNumA) {
   Stream *str;
   Parser *parser;
-  int *offsets;
   Object objStr, obj1, obj2;
-  int first, i;
+  int first, dataSize, n, i;
 
+  xref = xrefA;
   objStrNum = objStrNumA;
   nObjects = 0;
+  data = NULL;
+  dataLen = 0;
   objs = NULL;
   objNums = NULL;
+  offsets = NULL;
   ok = gFalse;
 
   if (!xref->fetch(objStrNum, 0, &objStr)->isStream()) {
@@ -196,14 +219,35 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
     error(errSyntaxError, -1, "Too many objects in an object stream");
     goto err1;
   }
+
+  // decode the stream
+  objStr.streamReset();
+  dataSize = 16384;
+  data = (char *)gmalloc(dataSize);
+  while ((n = objStr.getStream()->getBlock(data + dataLen,
+					   dataSize - dataLen)) > 0) {
+    dataLen += n;
+    if (dataLen == dataSize) {
+      if (dataSize > INT_MAX / 2) {
+	error(errSyntaxError, -1, "Object stream is too large");
+	goto err2;
+      }
+      dataSize *= 2;
+      data = (char *)grealloc(data, dataSize);
+    }
+  }
+  objStr.streamClose();
+  if (first > dataLen) {
+    goto err1;
+  }
+
   objs = new Object[nObjects];
   objNums = (int *)gmallocn(nObjects, sizeof(int));
   offsets = (int *)gmallocn(nObjects, sizeof(int));
 
   // parse the header: object numbers and offsets
-  objStr.streamReset();
   obj1.initNull();
-  str = new EmbedStream(objStr.getStream(), &obj1, gTrue, first);
+  str = new MemStream(data, 0, first, &obj1);
   parser = new Parser(xref, new Lexer(xref, str), gFalse);
   for (i = 0; i < nObjects; ++i) {
     parser->getObj(&obj1, gTrue);
@@ -212,47 +256,27 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
       obj1.free();
       obj2.free();
       delete parser;
-      gfree(offsets);
-      goto err2;
+      goto err1;
     }
     objNums[i] = obj1.getInt();
     offsets[i] = obj2.getInt();
     obj1.free();
     obj2.free();
     if (objNums[i] < 0 || offsets[i] < 0 ||
+	offsets[i] > dataLen - first ||
 	(i > 0 && offsets[i] < offsets[i-1])) {
       delete parser;
-      gfree(offsets);
-      goto err2;
+      goto err1;
     }
   }
-  while (str->getChar() != EOF) ;
   delete parser;
-
-  // skip to the first object - this shouldn't be necessary because
-  // the First key is supposed to be equal to offsets[0], but just in
-  // case...
-  if (i < offsets[0]) {
-    objStr.getStream()->discardChars(offsets[0] - i);
-  }
-
-  // parse the objects
   for (i = 0; i < nObjects; ++i) {
-    obj1.initNull();
-    if (i == nObjects - 1) {
-      str = new EmbedStream(objStr.getStream(), &obj1, gFalse, 0);
-    } else {
-      str = new EmbedStream(objStr.getStream(), &obj1, gTrue,
-			    offsets[i+1] - offsets[i]);
-    }
-    parser = new Parser(xref, new Lexer(xref, str), gFalse);
-    parser->getObj(&objs[i]);
-    while (str->getChar() != EOF) ;
-    delete parser;
+    offsets[i] += first;
   }
 
-  gfree(offsets);
   ok = gTrue;
+  objStr.free();
+  return;
 
  err2:
   objStr.streamClose();
@@ -270,20 +294,137 @@ ObjectStream::~ObjectStream() {
     delete[] objs;
   }
   gfree(objNums);
+  gfree(offsets);
+  gfree(data);
 }
 
 Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
+  Stream *str;
+  Parser *parser;
+  Object obj1;
+  int end;
+
   if (objIdx < 0 || objIdx >= nObjects || objNum != objNums[objIdx]) {
     return obj->initNull();
   }
+  if (objs[objIdx].isNone()) {
+    end = objIdx == nObjects - 1 ? dataLen : offsets[objIdx + 1];
+    obj1.initNull();
+    str = new MemStream(data, offsets[objIdx], end - offsets[objIdx], &obj1);
+    parser = new Parser(xref, new Lexer(xref, str), gFalse);
+    parser->getObj(&objs[objIdx]);
+    delete parser;
+  }
   return objs[objIdx].copy(obj);
 }
 
+//------------------------------------------------------------------------
+// xref table entries
+//------------------------------------------------------------------------
+
+// Parse one fixed-width xref table entry ("nnnnnnnnnn ggggg n" plus
+// end-of-line), after any leading whitespace, from <p>.  Returns the
+// number of bytes used, or 0 if <p> doesn't start with a well-formed
+// entry (or with a complete one), in which case the caller falls back
+// to the general parser.
+static int parseXRefTableEntry(const char *p, int len, XRefEntry *entry) {
+  GFileOffset off;
+  int gen, i, j;
+
+  for (i = 0; i < len && Lexer::isSpace(p[i] & 0xff); ++i) ;
+  if (len - i < 19) {
+    return 0;
+  }
+  p += i;
+  off = 0;
+  for (j = 0; j < 10; ++j) {
+    if (p[j] < '0' || p[j] > '9') {
+      return 0;
+    }
+    off = off * 10 + (p[j] - '0');
+  }
+  if (p[10] != ' ') {
+    return 0;
+  }
+  gen = 0;
+  for (j = 11; j < 16; ++j) {
+    if (p[j] < '0' || p[j] > '9') {
+      return 0;
+    }
+    gen = gen * 10 + (p[j] - '0');
+  }
+  if (p[16] != ' ' || !Lexer::isSpace(p[18] & 0xff)) {
+    return 0;
+  }
+  if (p[17] == 'n') {
+    entry->type = xrefEntryUncompressed;
+  } else if (p[17] == 'f') {
+    entry->type = xrefEntryFree;
+  } else {
+    return 0;
+  }
+  entry->offset = off;
+  entry->gen = gen;
+  return i + 19;
+}
+
+//------------------------------------------------------------------------
+// packed entries and lazy sections
+//------------------------------------------------------------------------
+
+// An entry is packed into 64 bits: the offset (or the object stream
+// number, for a compressed object) in the top 42 bits, the generation
+// number (or the index in the object stream) in the next 20 bits, and
+// the type in the low 2 bits.  An entry that hasn't been decoded yet
+// has type xrefPackedLazy, with the number of its section in place of
+// the offset.
+
+#define xrefPackedLazy 3
+#define xrefMaxPackedOffset ((GFileOffset)1 << 42)
+#define xrefMaxPackedGen ((1 << 20) - 1)
+
+#define xrefPack(offset, gen, type)				\
+  (((XRefPackedEntry)(offset) << 22) |				\
+   ((XRefPackedEntry)(gen) << 2) | (XRefPackedEntry)(type))
+#define xrefPackedOffset(e) ((GFileOffset)((e) >> 22))
+#define xrefPackedGen(e) ((int)(((e) >> 2) & xrefMaxPackedGen))
+#define xrefPackedType(e) ((int)((e) & 3))
+
+// An entry that no xref section has set.
+#define xrefPackedUnset (~(XRefPackedEntry)0)
+
+// A run of entries, for objects first .. first+n-1, in an xref table
+// or an xref stream.
+struct XRefSection {
+  int first, n;
+  GFileOffset pos;		// table: file position of the first entry
+  int stride;			// table: length of each entry
+  int lazyStr;			// stream: index in lazyStreams; -1 for
+				//   a table
+};
+
+// An xref stream whose entries haven't been decoded yet.  Its sections
+// are firstSection .. firstSection+nSections-1, in stream order.
+struct XRefLazyStream {
+  Object str;			// the stream
+  int w[3];			// field widths
+  int firstSection, nSections;
+  GBool done;			// set once the stream has been read
+};
+
+// A run of objects, first .. first+n-1, listed in the xref section
+// of an incremental update.
+struct XRefUpdateRange {
+  int first, n;
+  int update;			// index in updatePos
+};
+
 //------------------------------------------------------------------------
 // XRef
 //------------------------------------------------------------------------
 
 XRef::XRef(BaseStream *strA, GBool repair) {
+  GMemTagScope memTag(gMemTagParser);
   GFileOffset pos;
   Object obj;
   XRefPosSet *posSet;
@@ -294,6 +435,15 @@ XRef::XRef(BaseStream *strA, GBool repair) {
   size = 0;
   last = -1;
   entries = NULL;
+  sections = NULL;
+  nSections = sectionsSize = 0;
+  lazyStreams = NULL;
+  nLazyStreams = lazyStreamsSize = 0;
+  updatePos = NULL;
+  nUpdates = updatesSize = 0;
+  updateRanges = NULL;
+  nUpdateRanges = updateRangesSize = 0;
+  repaired = gFalse;
   streamEnds = NULL;
   streamEndsLen = 0;
   for (i = 0; i < objStrCacheSize; ++i) {
@@ -331,7 +481,9 @@ XRef::XRef(BaseStream *strA, GBool repair) {
 
     // read the xref table
     posSet = new XRefPosSet();
-    while (readXRef(&pos, posSet)) ;
+    do {
+      addUpdate(pos);
+    } while (readXRef(&pos, posSet));
     delete posSet;
     if (!ok) {
       errCode = errDamaged;
@@ -366,6 +518,8 @@ XRef::~XRef() {
       cache[i].obj.free();
     }
   }
+  freeSections();
+  freeUpdates();
   gfree(entries);
   trailerDict.free();
   if (streamEnds) {
@@ -448,7 +602,7 @@ GBool XRef::readXRef(GFileOffset *pos, XRefPosSet *posSet) {
     if (!parser->getObj(&obj)->isStream()) {
       goto err2;
     }
-    more = readXRefStream(obj.getStream(), pos);
+    more = readXRefStream(&obj, pos);
     obj.free();
     delete parser;
 
@@ -471,9 +625,10 @@ GBool XRef::readXRefTable(GFileOffset *pos, int offset, XRefPosSet *posSet) {
   Parser *parser;
   Object obj, obj2;
   char buf[6];
-  GFileOffset off, pos2;
-  GBool more;
-  int first, n, newSize, gen, i, c;
+  char blk[xrefTableBlockSize];
+  GFileOffset off, pos2, blkStart;
+  GBool more, fast;
+  int first, n, newSize, gen, blkLen, blkPos, k, i, c;
 
   if (posSet->check(*pos)) {
     error(errSyntaxWarning, -1, "Infinite loop in xref table");
@@ -525,14 +680,35 @@ GBool XRef::readXRefTable(GFileOffset *pos, int offset, XRefPosSet *posSet) {
       if (newSize < 0) {
 	goto err1;
       }
-      entries = (XRefEntry *)greallocn(entries, newSize, sizeof(XRefEntry));
-      for (i = size; i < newSize; ++i) {
-	entries[i].offset = (GFileOffset)-1;
-	entries[i].type = xrefEntryFree;
-      }
-      size = newSize;
+      resizeEntries(newSize);
+    }
+    // large subsections of well-formed entries are only indexed here,
+    // and each entry is read when it is first used
+    if (n >= xrefLazyMinEntries && addLazyTableSection(first, n)) {
+      addUpdateRange(first, n);
+      continue;
     }
+    // well-formed entries are parsed straight from a block buffer; at
+    // the first one that isn't, switch to reading a char at a time
+    fast = gTrue;
+    blkStart = str->getPos();
+    blkLen = blkPos = 0;
     for (i = first; i < first + n; ++i) {
+      if (fast) {
+	if (blkLen - blkPos < 64) {
+	  memmove(blk, blk + blkPos, blkLen - blkPos);
+	  blkStart += blkPos;
+	  blkLen -= blkPos;
+	  blkPos = 0;
+	  blkLen += str->getBlock(blk + blkLen, xrefTableBlockSize - blkLen);
+	}
+	if ((k = parseXRefTableEntry(blk + blkPos, blkLen - blkPos, &entry))) {
+	  blkPos += k;
+	  goto gotEntry;
+	}
+	fast = gFalse;
+	str->setPos(blkStart + blkPos);
+      }
       do {
 	c = str->getChar();
       } while (Lexer::isSpace(c));
@@ -571,23 +747,28 @@ GBool XRef::readXRefTable(GFileOffset *pos, int offset, XRefPosSet *posSet) {
       if (!Lexer::isSpace(c)) {
 	goto err1;
       }
-      if (entries[i].offset == (GFileOffset)-1) {
-	entries[i] = entry;
+     gotEntry:
+      if (entries[i] == xrefPackedUnset) {
+	setEntry(i, entry.offset, entry.gen, entry.type);
 	// PDF files of patents from the IBM Intellectual Property
 	// Network have a bug: the xref table claims to start at 1
 	// instead of 0.
 	if (i == 1 && first == 1 &&
-	    entries[1].offset == 0 && entries[1].gen == 65535 &&
-	    entries[1].type == xrefEntryFree) {
+	    entry.offset == 0 && entry.gen == 65535 &&
+	    entry.type == xrefEntryFree) {
 	  i = first = 0;
 	  entries[0] = entries[1];
-	  entries[1].offset = (GFileOffset)-1;
+	  entries[1] = xrefPackedUnset;
 	}
 	if (i > last) {
 	  last = i;
 	}
       }
     }
+    if (fast) {
+      str->setPos(blkStart + blkPos);
+    }
+    addUpdateRange(first, n);
   }
 
   // read the trailer dictionary
@@ -644,14 +825,69 @@ GBool XRef::readXRefTable(GFileOffset *pos, int offset, XRefPosSet *posSet) {
   return gFalse;
 }
 
-GBool XRef::readXRefStream(Stream *xrefStr, GFileOffset *pos) {
+// Check that the <n> entries of the subsection starting at the current
+// position are all fixed-width (by looking at the first and last
+// ones), and if so, add them as a lazily decoded section and skip
+// over them.  Returns false, at the original position, otherwise.
+GBool XRef::addLazyTableSection(int first, int n) {
+  XRefEntry entry;
+  char buf[64];
+  GFileOffset pos, entryPos;
+  int len, stride, i;
+
+  // the first entry, which also gives the entry length
+  pos = str->getPos();
+  len = str->getBlock(buf, sizeof(buf));
+  for (i = 0; i < len && Lexer::isSpace(buf[i] & 0xff); ++i) ;
+  if (i >= len || buf[i] < '0' || buf[i] > '9' ||
+      parseXRefTableEntry(buf + i, len - i, &entry) != 19 ||
+      i + 20 >= len) {
+    goto err;
+  }
+  // (see the IBM patent workaround in readXRefTable)
+  if (first == 1 && entry.offset == 0 && entry.gen == 65535 &&
+      entry.type == xrefEntryFree) {
+    goto err;
+  }
+  stride = Lexer::isSpace(buf[i + 19] & 0xff) ? 20 : 19;
+  if (buf[i + stride] < '0' || buf[i + stride] > '9') {
+    goto err;
+  }
+  entryPos = pos + i;
+
+  // the last entry, which must be followed by another subsection or
+  // by the trailer
+  str->setPos(entryPos + (GFileOffset)stride * (n - 1));
+  len = str->getBlock(buf, sizeof(buf));
+  if (len < 19 || buf[0] < '0' || buf[0] > '9' ||
+      parseXRefTableEntry(buf, len, &entry) != 19) {
+    goto err;
+  }
+  for (i = 19; i < len && Lexer::isSpace(buf[i] & 0xff); ++i) ;
+  if (i >= len || !(buf[i] == 't' || (buf[i] >= '0' && buf[i] <= '9'))) {
+    goto err;
+  }
+
+  addSection(first, n, entryPos, stride, -1);
+  str->setPos(entryPos + (GFileOffset)stride * n);
+  return gTrue;
+
+ err:
+  str->setPos(pos);
+  return gFalse;
+}
+
+// Index an xref stream.  Its entries are read when one of them is
+// first used (see decodeXRefStream).
+GBool XRef::readXRefStream(Object *xrefStr, GFileOffset *pos) {
   Dict *dict;
+  XRefLazyStream *lazyStr;
   int w[3];
   GBool more;
   Object obj, obj2, idx;
   int newSize, first, n, i;
 
-  dict = xrefStr->getDict();
+  dict = xrefStr->streamGetDict();
 
   if (!dict->lookupNF("Size", &obj)->isInt()) {
     goto err1;
@@ -661,14 +897,7 @@ GBool XRef::readXRefStream(Stream *xrefStr, GFileOffset *pos) {
   if (newSize < 0) {
     goto err1;
   }
-  if (newSize > size) {
-    entries = (XRefEntry *)greallocn(entries, newSize, sizeof(XRefEntry));
-    for (i = size; i < newSize; ++i) {
-      entries[i].offset = (GFileOffset)-1;
-      entries[i].type = xrefEntryFree;
-    }
-    size = newSize;
-  }
+  resizeEntries(newSize);
 
   if (!dict->lookupNF("W", &obj)->isArray() ||
       obj.arrayGetLength() < 3) {
@@ -689,7 +918,21 @@ GBool XRef::readXRefStream(Stream *xrefStr, GFileOffset *pos) {
     goto err0;
   }
 
-  xrefStr->reset();
+  if (nLazyStreams == lazyStreamsSize) {
+    lazyStreamsSize = lazyStreamsSize ? 2 * lazyStreamsSize : 4;
+    lazyStreams = (XRefLazyStream *)greallocn(lazyStreams, lazyStreamsSize,
+					      sizeof(XRefLazyStream));
+  }
+  lazyStr = &lazyStreams[nLazyStreams];
+  xrefStr->copy(&lazyStr->str);
+  for (i = 0; i < 3; ++i) {
+    lazyStr->w[i] = w[i];
+  }
+  lazyStr->firstSection = nSections;
+  lazyStr->nSections = 0;
+  lazyStr->done = gFalse;
+  ++nLazyStreams;
+
   dict->lookupNF("Index", &idx);
   if (idx.isArray()) {
     for (i = 0; i+1 < idx.arrayGetLength(); i += 2) {
@@ -705,17 +948,26 @@ GBool XRef::readXRefStream(Stream *xrefStr, GFileOffset *pos) {
       }
       n = obj.getInt();
       obj.free();
-      if (first < 0 || n < 0 ||
-	  !readXRefStreamSection(xrefStr, w, first, n)) {
+      if (first < 0 || n < 0 || first + n < 0) {
 	idx.free();
 	goto err0;
       }
+      if (first + n > size) {
+	for (newSize = size ? 2 * size : 1024;
+	     first + n > newSize && newSize > 0;
+	     newSize <<= 1) ;
+	if (newSize < 0) {
+	  idx.free();
+	  goto err0;
+	}
+	resizeEntries(newSize);
+      }
+      addSection(first, n, 0, 0, nLazyStreams - 1);
+      addUpdateRange(first, n);
     }
   } else {
-    if (!readXRefStreamSection(xrefStr, w, 0, newSize)) {
-      idx.free();
-      goto err0;
-    }
+    addSection(0, newSize, 0, 0, nLazyStreams - 1);
+    addUpdateRange(0, newSize);
   }
   idx.free();
 
@@ -741,92 +993,312 @@ GBool XRef::readXRefStream(Stream *xrefStr, GFileOffset *pos) {
   return gFalse;
 }
 
-GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
-  GFileOffset offset;
-  int type, gen, c, newSize, i, j;
+// Add a section, and point the entries it sets at it.  The
+// <entries> array must already be large enough.
+void XRef::addSection(int first, int n, GFileOffset pos, int stride,
+		      int lazyStr) {
+  XRefSection *sec;
+  int i;
 
-  if (first + n < 0) {
-    return gFalse;
+  if (nSections == sectionsSize) {
+    sectionsSize = sectionsSize ? 2 * sectionsSize : 16;
+    sections = (XRefSection *)greallocn(sections, sectionsSize,
+					sizeof(XRefSection));
   }
-  if (first + n > size) {
-    for (newSize = size ? 2 * size : 1024;
-	 first + n > newSize && newSize > 0;
-	 newSize <<= 1) ;
-    if (newSize < 0) {
-      return gFalse;
-    }
-    entries = (XRefEntry *)greallocn(entries, newSize, sizeof(XRefEntry));
-    for (i = size; i < newSize; ++i) {
-      entries[i].offset = (GFileOffset)-1;
-      entries[i].type = xrefEntryFree;
-    }
-    size = newSize;
+  sec = &sections[nSections];
+  sec->first = first;
+  sec->n = n;
+  sec->pos = pos;
+  sec->stride = stride;
+  sec->lazyStr = lazyStr;
+  if (lazyStr >= 0) {
+    ++lazyStreams[lazyStr].nSections;
   }
   for (i = first; i < first + n; ++i) {
-    if (w[0] == 0) {
-      type = 1;
-    } else {
-      for (type = 0, j = 0; j < w[0]; ++j) {
-	if ((c = xrefStr->getChar()) == EOF) {
-	  return gFalse;
-	}
-	type = (type << 8) + c;
+    if (entries[i] == xrefPackedUnset) {
+      entries[i] = xrefPack(nSections, 0, xrefPackedLazy);
+      if (i > last) {
+	last = i;
       }
     }
-    for (offset = 0, j = 0; j < w[1]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
-	return gFalse;
-      }
-      offset = (offset << 8) + c;
+  }
+  ++nSections;
+}
+
+void XRef::resizeEntries(int newSize) {
+  int i;
+
+  if (newSize <= size) {
+    return;
+  }
+  entries = (XRefPackedEntry *)greallocn(entries, newSize,
+					 sizeof(XRefPackedEntry));
+  for (i = size; i < newSize; ++i) {
+    entries[i] = xrefPackedUnset;
+  }
+  size = newSize;
+}
+
+void XRef::setEntry(int i, GFileOffset offset, int gen, XRefEntryType type) {
+  // entries that don't fit can't point to a real object
+  if (offset < 0 || offset >= xrefMaxPackedOffset ||
+      gen < 0 || gen > xrefMaxPackedGen) {
+    entries[i] = xrefPack(0, 0, xrefEntryFree);
+  } else {
+    entries[i] = xrefPack(offset, gen, type);
+  }
+}
+
+XRefEntry *XRef::getEntry(int i, XRefEntry *entry) {
+  XRefPackedEntry e;
+
+  e = (i >= 0 && i < size) ? entries[i] : xrefPackedUnset;
+  if (e != xrefPackedUnset && xrefPackedType(e) == xrefPackedLazy) {
+    resolveEntry(i);
+    e = i < size ? entries[i] : xrefPackedUnset;
+  }
+  if (e == xrefPackedUnset || xrefPackedType(e) == xrefPackedLazy) {
+    entry->offset = (GFileOffset)-1;
+    entry->gen = 0;
+    entry->type = xrefEntryFree;
+  } else {
+    entry->offset = xrefPackedOffset(e);
+    entry->gen = xrefPackedGen(e);
+    entry->type = (XRefEntryType)xrefPackedType(e);
+  }
+  return entry;
+}
+
+// Decode lazy entry <i>.  If its section turns out to be damaged, the
+// xref table is reconstructed, as it would have been if the damage had
+// been found when the file was opened.
+void XRef::resolveEntry(int i) {
+  XRefSection *sec;
+  GBool decoded;
+
+  sec = &sections[xrefPackedOffset(entries[i])];
+  if (sec->lazyStr < 0) {
+    decoded = readLazyTableEntry(sec, i);
+  } else {
+    decoded = decodeXRefStream(sec->lazyStr);
+  }
+  if (!decoded && !repaired) {
+    error(errSyntaxWarning, -1,
+	  "PDF file is damaged - attempting to reconstruct xref table...");
+    repaired = gTrue;
+    if (!constructXRef()) {
+      // callers check isOk() after opening the file (PDFDoc) and after
+      // using it (pdftojson)
+      ok = gFalse;
+      errCode = errDamaged;
+    }
+    // constructXRef resets the stream - put the file position back for
+    // any streams that are being read
+    str->close();
+    if (trailerDict.isDict()) {
+      trailerDict.getDict()->setXRef(this);
+    }
+  }
+}
+
+// Read the block of xrefLazyBlockEntries entries containing entry <i>
+// of lazy table section <sec>.  Entries that have already been read
+// are left alone.
+GBool XRef::readLazyTableEntry(XRefSection *sec, int i) {
+  XRefEntry entry;
+  XRefPackedEntry lazyEntry;
+  Stream *entryStr;
+  Object obj;
+  char buf[xrefLazyBlockEntries * 20];
+  int first, n, len, j;
+
+  first = i - (i - sec->first) % xrefLazyBlockEntries;
+  n = sec->first + sec->n - first;
+  if (n > xrefLazyBlockEntries) {
+    n = xrefLazyBlockEntries;
+  }
+  obj.initNull();
+  entryStr = str->makeSubStream(sec->pos +
+				  (GFileOffset)sec->stride * (first - sec->first),
+				gTrue, sec->stride * n, &obj);
+  entryStr->reset();
+  len = entryStr->getBlock(buf, sec->stride * n);
+  entryStr->close();
+  delete entryStr;
+  lazyEntry = xrefPack(sec - sections, 0, xrefPackedLazy);
+  for (j = 0; j < n; ++j) {
+    if (entries[first + j] != lazyEntry) {
+      continue;
     }
-    for (gen = 0, j = 0; j < w[2]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
+    if (len - j * sec->stride < 19 ||
+	buf[j * sec->stride] < '0' || buf[j * sec->stride] > '9' ||
+	parseXRefTableEntry(buf + j * sec->stride, len - j * sec->stride,
+			    &entry) != 19) {
+      // a damaged entry only matters once it is used
+      if (first + j == i) {
 	return gFalse;
       }
-      gen = (gen << 8) + c;
+      continue;
     }
-    if (entries[i].offset == (GFileOffset)-1) {
-      switch (type) {
-      case 0:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryFree;
-	break;
-      case 1:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryUncompressed;
-	break;
-      case 2:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryCompressed;
-	break;
-      default:
-	return gFalse;
+    setEntry(first + j, entry.offset, entry.gen, entry.type);
+  }
+  return gTrue;
+}
+
+// Read all of the entries in lazy xref stream <idx>.
+GBool XRef::decodeXRefStream(int idx) {
+  XRefLazyStream *lazyStr;
+  XRefSection *sec;
+  Stream *xrefStr;
+  GFileOffset offset;
+  int *w;
+  int type, gen, c, i, j, k;
+
+  lazyStr = &lazyStreams[idx];
+  if (lazyStr->done) {
+    return gFalse;
+  }
+  lazyStr->done = gTrue;
+  w = lazyStr->w;
+  xrefStr = lazyStr->str.getStream();
+  xrefStr->reset();
+  for (k = lazyStr->firstSection;
+       k < lazyStr->firstSection + lazyStr->nSections;
+       ++k) {
+    sec = &sections[k];
+    for (i = sec->first; i < sec->first + sec->n; ++i) {
+      if (w[0] == 0) {
+	type = 1;
+      } else {
+	for (type = 0, j = 0; j < w[0]; ++j) {
+	  if ((c = xrefStr->getChar()) == EOF) {
+	    goto err;
+	  }
+	  type = (type << 8) + c;
+	}
       }
-      if (i > last) {
-	last = i;
+      for (offset = 0, j = 0; j < w[1]; ++j) {
+	if ((c = xrefStr->getChar()) == EOF) {
+	  goto err;
+	}
+	offset = (offset << 8) + c;
+      }
+      for (gen = 0, j = 0; j < w[2]; ++j) {
+	if ((c = xrefStr->getChar()) == EOF) {
+	  goto err;
+	}
+	gen = (gen << 8) + c;
+      }
+      if (type < 0 || type > 2) {
+	goto err;
+      }
+      if (entries[i] == xrefPack(k, 0, xrefPackedLazy)) {
+	setEntry(i, offset, gen, (XRefEntryType)type);
       }
     }
   }
-
+  xrefStr->close();
+  lazyStr->str.free();
   return gTrue;
+
+ err:
+  xrefStr->close();
+  lazyStr->str.free();
+  return gFalse;
+}
+
+void XRef::freeSections() {
+  int i;
+
+  for (i = 0; i < nLazyStreams; ++i) {
+    if (!lazyStreams[i].done) {
+      lazyStreams[i].str.free();
+    }
+  }
+  gfree(lazyStreams);
+  lazyStreams = NULL;
+  nLazyStreams = lazyStreamsSize = 0;
+  gfree(sections);
+  sections = NULL;
+  nSections = sectionsSize = 0;
+}
+
+// Start a new update, for the xref section at <pos>.
+void XRef::addUpdate(GFileOffset pos) {
+  if (nUpdates == updatesSize) {
+    updatesSize = updatesSize ? 2 * updatesSize : 4;
+    updatePos = (GFileOffset *)greallocn(updatePos, updatesSize,
+					 sizeof(GFileOffset));
+  }
+  updatePos[nUpdates++] = pos;
+}
+
+// Record that objects first .. first+n-1 are listed in the current
+// update.
+void XRef::addUpdateRange(int first, int n) {
+  XRefUpdateRange *range;
+
+  if (nUpdates == 0 || n <= 0) {
+    return;
+  }
+  if (nUpdateRanges == updateRangesSize) {
+    updateRangesSize = updateRangesSize ? 2 * updateRangesSize : 16;
+    updateRanges = (XRefUpdateRange *)greallocn(updateRanges,
+						updateRangesSize,
+						sizeof(XRefUpdateRange));
+  }
+  range = &updateRanges[nUpdateRanges++];
+  range->first = first;
+  range->n = n;
+  range->update = nUpdates - 1;
+}
+
+void XRef::freeUpdates() {
+  gfree(updatePos);
+  updatePos = NULL;
+  nUpdates = updatesSize = 0;
+  gfree(updateRanges);
+  updateRanges = NULL;
+  nUpdateRanges = updateRangesSize = 0;
+}
+
+void XRef::getUpdatedObjects(int n, char *updated) {
+  XRefUpdateRange *range;
+  int end, i;
+
+  for (i = 0; i < nUpdateRanges; ++i) {
+    range = &updateRanges[i];
+    if (range->update >= n || range->first > last) {
+      continue;
+    }
+    end = range->first + range->n;
+    if (end > last + 1) {
+      end = last + 1;
+    }
+    memset(updated + range->first, 1, end - range->first);
+  }
 }
 
-// Attempt to construct an xref table for a damaged file.
+// Attempt to construct an xref table for a damaged file.  This looks
+// at the start of each line (or of each xrefScanLineLength-char
+// piece of a longer line) for "trailer", "nnn ggg obj" and
+// "endstream".  The file is read in large blocks, and line ends are
+// found with memchr.
 GBool XRef::constructXRef() {
   Parser *parser;
   Object newTrailerDict, obj;
-  char buf[256];
-  GFileOffset pos;
+  char buf[xrefScanLineLength + 1];
+  char *blk, *eol;
+  GFileOffset pos, blkStart;
   int num, gen;
   int newSize;
   int streamEndsSize;
+  int blkLen, blkPos, lineLen, next, n;
   char *p;
-  int i;
-  GBool gotRoot;
+  GBool gotRoot, eof;
 
+  freeSections();
+  freeUpdates();
   gfree(entries);
   size = 0;
   entries = NULL;
@@ -835,15 +1307,61 @@ GBool XRef::constructXRef() {
   streamEndsLen = streamEndsSize = 0;
 
   str->reset();
+  blk = (char *)gmalloc(xrefScanBlockSize);
+  blkStart = str->getPos();
+  blkLen = blkPos = 0;
+  eof = gFalse;
   while (1) {
-    pos = str->getPos();
-    if (!str->getLine(buf, 256)) {
+
+    // make sure the buffer holds a whole line, plus a CR-LF pair
+    if (!eof && blkLen - blkPos < xrefScanLineLength + 2) {
+      memmove(blk, blk + blkPos, blkLen - blkPos);
+      blkStart += blkPos;
+      blkLen -= blkPos;
+      blkPos = 0;
+      n = str->getBlock(blk + blkLen, xrefScanBlockSize - blkLen);
+      if (n == 0) {
+	eof = gTrue;
+      }
+      blkLen += n;
+    }
+    if (blkPos >= blkLen) {
       break;
     }
-    p = buf;
+    pos = blkStart + blkPos;
 
-    // skip whitespace
-    while (*p && Lexer::isSpace(*p & 0xff)) ++p;
+    // find the end of the line
+    lineLen = blkLen - blkPos;
+    if (lineLen > xrefScanLineLength) {
+      lineLen = xrefScanLineLength;
+    }
+    if ((eol = (char *)memchr(blk + blkPos, '\n', lineLen))) {
+      lineLen = (int)(eol - (blk + blkPos));
+    }
+    if ((eol = (char *)memchr(blk + blkPos, '\r', lineLen))) {
+      lineLen = (int)(eol - (blk + blkPos));
+    }
+    next = blkPos + lineLen;
+    if (next < blkLen && lineLen < xrefScanLineLength) {
+      if (blk[next] == '\r' && next + 1 < blkLen && blk[next + 1] == '\n') {
+	++next;
+      }
+      ++next;
+    }
+
+    // skip whitespace, and ignore lines that can't be interesting
+    for (p = blk + blkPos;
+	 p < blk + blkPos + lineLen && *p && Lexer::isSpace(*p & 0xff);
+	 ++p) ;
+    if (p == blk + blkPos + lineLen ||
+	!(*p == 't' || *p == 'e' || isdigit(*p & 0xff))) {
+      blkPos = next;
+      continue;
+    }
+    memcpy(buf, blk + blkPos, lineLen);
+    buf[lineLen] = '\0';
+    p = buf + (p - (blk + blkPos));
+    blkPos = next;
 
     // got trailer dictionary
     if (!strncmp(p, "trailer", 7)) {
@@ -894,21 +1412,15 @@ GBool XRef::constructXRef() {
 		  newSize = (num + 1 + 255) & ~255;
 		  if (newSize < 0) {
 		    error(errSyntaxError, -1, "Bad object number");
+		    gfree(blk);
 		    return gFalse;
 		  }
-		  entries = (XRefEntry *)
-		      greallocn(entries, newSize, sizeof(XRefEntry));
-		  for (i = size; i < newSize; ++i) {
-		    entries[i].offset = (GFileOffset)-1;
-		    entries[i].type = xrefEntryFree;
-		  }
-		  size = newSize;
+		  resizeEntries(newSize);
 		}
-		if (entries[num].type == xrefEntryFree ||
-		    gen >= entries[num].gen) {
-		  entries[num].offset = pos - start;
-		  entries[num].gen = gen;
-		  entries[num].type = xrefEntryUncompressed;
+		if (entries[num] == xrefPackedUnset ||
+		    xrefPackedType(entries[num]) == xrefEntryFree ||
+		    gen >= xrefPackedGen(entries[num])) {
+		  setEntry(num, pos - start, gen, xrefEntryUncompressed);
 		  if (num > last) {
 		    last = num;
 		  }
@@ -928,6 +1440,7 @@ GBool XRef::constructXRef() {
       streamEnds[streamEndsLen++] = pos;
     }
   }
+  gfree(blk);
 
   if (gotRoot) {
     return gTrue;
@@ -974,7 +1487,8 @@ GBool XRef::okToAddNotes(GBool ignoreOwnerPW) {
 }
 
 Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
-  XRefEntry *e;
+  GMemTagScope memTag(gMemTagParser);
+  XRefEntry *e, entry, objStrEntry;
   Parser *parser;
   ObjectStream *objStr;
   Object obj1, obj2, obj3;
@@ -1001,7 +1515,7 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
     }
   }
 
-  e = &entries[num];
+  e = getEntry(num, &entry);
   switch (e->type) {
 
   case xrefEntryUncompressed:
@@ -1040,7 +1554,8 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
     }
 #endif
     if (e->offset >= (GFileOffset)size ||
-	entries[e->offset].type != xrefEntryUncompressed) {
+	getEntry((int)e->offset, &objStrEntry)->type
+	  != xrefEntryUncompressed) {
       error(errSyntaxError, -1, "Invalid object stream");
       goto err;
     }
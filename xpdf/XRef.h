@@ -24,6 +24,9 @@ class Stream;
 class Parser;
 class ObjectStream;
 class XRefPosSet;
+struct XRefSection;
+struct XRefLazyStream;
+struct XRefUpdateRange;
 
 //------------------------------------------------------------------------
 // XRef
@@ -41,6 +44,9 @@ struct XRefEntry {
   XRefEntryType type;
 };
 
+// Entries are stored packed into 64 bits (see XRef.cc).
+typedef unsigned long long XRefPackedEntry;
+
 struct XRefCacheEntry {
   int num;
   int gen;
@@ -105,19 +111,45 @@ public:
   // Returns false if unknown or file is not damaged.
   GBool getStreamEnd(GFileOffset streamStart, GFileOffset *streamEnd);
 
-  // Direct access.
+  // Direct access.  getEntry decodes the entry if it hasn't been
+  // used yet, and fills in <entry>.
   int getSize() { return size; }
-  XRefEntry *getEntry(int i) { return &entries[i]; }
+  XRefEntry *getEntry(int i, XRefEntry *entry);
   Object *getTrailerDict() { return &trailerDict; }
 
+  // Incremental updates.  Each xref section in the chain that starts
+  // at the last 'startxref' is one update, newest first.  There are
+  // none if the xref table was reconstructed.
+  int getNumUpdates() { return nUpdates; }
+  GFileOffset getUpdatePos(int i) { return updatePos[i]; }
+
+  // Set updated[num] for each object listed in the newest <n>
+  // updates.  <updated> must have getNumObjects() entries.
+  void getUpdatedObjects(int n, char *updated);
+
 private:
 
   BaseStream *str;		// input stream
   GFileOffset start;		// offset in file (to allow for garbage
 				//   at beginning of file)
-  XRefEntry *entries;		// xref entries
+  XRefPackedEntry *entries;	// xref entries
   int size;			// size of <entries> array
   int last;			// last used index in <entries>
+  XRefSection *sections;	// sections whose entries are decoded on
+  int nSections;		//   first use
+  int sectionsSize;
+  XRefLazyStream *lazyStreams;	// xref streams that haven't been
+  int nLazyStreams;		//   decoded yet
+  int lazyStreamsSize;
+  GFileOffset *updatePos;	// xref section of each update
+  int nUpdates;
+  int updatesSize;
+  XRefUpdateRange *		// objects listed in each update
+    updateRanges;
+  int nUpdateRanges;
+  int updateRangesSize;
+  GBool repaired;		// set if the xref has been reconstructed
+				//   after a lazy entry turned out bad
   int rootNum, rootGen;		// catalog dict
   GBool ok;			// true if xref table is valid
   int errCode;			// error code (if <ok> is false)
@@ -141,8 +173,19 @@ private:
   GFileOffset getStartXref();
   GBool readXRef(GFileOffset *pos, XRefPosSet *posSet);
   GBool readXRefTable(GFileOffset *pos, int offset, XRefPosSet *posSet);
-  GBool readXRefStreamSection(Stream *xrefStr, int *w, int first, int n);
-  GBool readXRefStream(Stream *xrefStr, GFileOffset *pos);
+  GBool addLazyTableSection(int first, int n);
+  GBool readXRefStream(Object *xrefStr, GFileOffset *pos);
+  void addSection(int first, int n, GFileOffset pos, int stride,
+		  int lazyStr);
+  void addUpdate(GFileOffset pos);
+  void addUpdateRange(int first, int n);
+  void freeUpdates();
+  void resizeEntries(int newSize);
+  void setEntry(int i, GFileOffset offset, int gen, XRefEntryType type);
+  void resolveEntry(int i);
+  GBool readLazyTableEntry(XRefSection *sec, int i);
+  GBool decodeXRefStream(int idx);
+  void freeSections();
   GBool constructXRef();
   ObjectStream *getObjectStream(int objStrNum);
   GFileOffset strToFileOffset(char *s);
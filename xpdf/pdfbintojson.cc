@@ -0,0 +1,176 @@
+//========================================================================
+//
+// pdfbintojson.cc
+//
+// Convert the binary output of pdftojson -binary back to JSON.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parseargs.h"
+#include "gmem.h"
+#include "GString.h"
+#include "JSONBinary.h"
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+static GBool ndjson = gFalse;
+static GBool printVersion = gFalse;
+static GBool printHelp = gFalse;
+
+static ArgDesc argDesc[] = {
+  {"-ndjson",  argFlag,     &ndjson,        0,
+   "write one page object per line"},
+  {"-v",       argFlag,     &printVersion,  0,
+   "print copyright and version info"},
+  {"-h",       argFlag,     &printHelp,     0,
+   "print usage information"},
+  {"-help",    argFlag,     &printHelp,     0,
+   "print usage information"},
+  {"--help",   argFlag,     &printHelp,     0,
+   "print usage information"},
+  {"-?",       argFlag,     &printHelp,     0,
+   "print usage information"},
+  {NULL}
+};
+
+//------------------------------------------------------------------------
+
+// Escape the word text the same way JSONGen does.
+static void appendJSONString(GString *s, const char *p, int len) {
+  int i;
+  char c;
+
+  for (i = 0; i < len; ++i) {
+    c = p[i];
+    switch (c) {
+    case '\\': s->append("\\\\"); break;
+    case '\t': s->append("\\t");  break;
+    case '\n': s->append("\\n");  break;
+    case '\r': s->append("\\r");  break;
+    case '\b': s->append("\\b");  break;
+    case '\f': s->append("\\f");  break;
+    case '"':  s->append("\\\""); break;
+    default:
+      if ((Guchar)c <= 31) {
+	s->append(' ');
+      } else {
+	s->append(c);
+      }
+      break;
+    }
+  }
+}
+
+static void writePage(JSONBinPage *page, FILE *f) {
+  JSONBinWord *w;
+  GString *s;
+  int i;
+
+  s = new GString("{\"formfields\":");
+  s->append(page->formFields, page->formFieldsLen);
+  s->appendf(",\"pages\":{0:d},\"number\":{1:d},\"width\":{2:d},"
+	     "\"height\":{3:d},\"dpi\":{4:.4g},{5:s}\"text\":[",
+	     page->pages, page->number, page->width, page->height,
+	     page->dpi, page->truncated ? "\"truncated\":true," : "");
+  for (i = 0, w = page->words; i < page->nWords; ++i, ++w) {
+    if (i > 0) {
+      s->append(',');
+    }
+    s->appendf("[{0:d},{1:d},{2:d},{3:d},{4:d},\"",
+	       w->top, w->left, w->width, w->height, w->baseline);
+    appendJSONString(s, page->strings[w->text], page->stringLens[w->text]);
+    s->append("\"]");
+  }
+  s->append("]}");
+  fwrite(s->getCString(), 1, s->getLength(), f);
+  delete s;
+}
+
+int main(int argc, char *argv[]) {
+  JSONBinReader *reader;
+  JSONBinPage *page;
+  FILE *in, *out;
+  int nPages, exitCode;
+  GBool ok;
+
+  exitCode = 99;
+
+  // parse args
+  ok = parseArgs(argDesc, &argc, argv);
+  if (!ok || argc != 3 || printVersion || printHelp) {
+    fprintf(stderr, "pdfbintojson version %s\n", xpdfVersion);
+    fprintf(stderr, "%s\n", xpdfCopyright);
+    if (!printVersion) {
+      printUsage("pdfbintojson", "<bin-file> <JSON-file>", argDesc);
+    }
+    goto err0;
+  }
+
+  // open the files ('-' is stdin / stdout)
+  if (!strcmp(argv[1], "-")) {
+    in = stdin;
+  } else if (!(in = fopen(argv[1], "rb"))) {
+    fprintf(stderr, "Couldn't open file '%s'\n", argv[1]);
+    exitCode = 1;
+    goto err0;
+  }
+  if (!strcmp(argv[2], "-")) {
+    out = stdout;
+  } else if (!(out = fopen(argv[2], "wb"))) {
+    fprintf(stderr, "Couldn't open JSON file '%s'\n", argv[2]);
+    exitCode = 2;
+    goto err1;
+  }
+
+  reader = new JSONBinReader(in);
+  if (!reader->isOk()) {
+    fprintf(stderr, "'%s' is not a pdftojson binary file\n", argv[1]);
+    exitCode = 1;
+    goto err2;
+  }
+
+  // convert the pages
+  if (!ndjson) {
+    fputc('[', out);
+  }
+  nPages = 0;
+  while ((page = reader->nextPage())) {
+    if (ndjson) {
+      writePage(page, out);
+      fputc('\n', out);
+    } else {
+      if (nPages > 0) {
+	fputc(',', out);
+      }
+      writePage(page, out);
+    }
+    ++nPages;
+  }
+  if (!ndjson) {
+    fputc(']', out);
+  }
+  if (reader->isCorrupt()) {
+    fprintf(stderr, "Corrupt page record after page %d\n", nPages);
+    exitCode = 1;
+  } else {
+    exitCode = 0;
+  }
+
+  // clean up
+ err2:
+  delete reader;
+  fclose(out);
+ err1:
+  fclose(in);
+ err0:
+
+  // check for memory leaks
+  gMemReport(stderr);
+
+  return exitCode;
+}
@@ -0,0 +1,1255 @@
+//========================================================================
+//
+// pdfmicrobench.cc
+//
+// Microbenchmarks for the core kernels.  Each kernel runs one piece
+// of the library (the lexer, a decoder, a rasterizer operation, ...)
+// on fixed input that is generated at startup, so a change to that
+// piece can be measured in isolation from the rest of the pipeline.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <zlib.h>
+#include "parseargs.h"
+#include "gmem.h"
+#include "GString.h"
+#include "GList.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "UnicodeMap.h"
+#include "SplashBitmap.h"
+#include "SplashPattern.h"
+#include "SplashPath.h"
+#include "SplashGlyphBitmap.h"
+#include "Splash.h"
+#include "PerfCounters.h"
+#include "Error.h"
+#include "config.h"
+
+static char kernelList[256] = "";
+static int reps = 10;
+static int warmup = 3;
+static double minTime = 50;
+static char jsonFileName[256] = "";
+static GBool listKernels = gFalse;
+static char cfgFileName[256] = "";
+static GBool quiet = gFalse;
+static GBool printVersion = gFalse;
+static GBool printHelp = gFalse;
+
+static ArgDesc argDesc[] = {
+  {"-k",       argString,   kernelList,     sizeof(kernelList),
+   "comma-separated list of kernels to run (default: all)"},
+  {"-list",    argFlag,     &listKernels,   0,
+   "list the kernels and exit"},
+  {"-reps",    argInt,      &reps,          0,
+   "number of timed repetitions per kernel"},
+  {"-warmup",  argInt,      &warmup,        0,
+   "number of untimed runs before the repetitions"},
+  {"-mintime", argFP,       &minTime,       0,
+   "minimum time per repetition, in milliseconds"},
+  {"-json",    argString,   jsonFileName,   sizeof(jsonFileName),
+   "write the results as JSON to this file"},
+  {"-cfg",     argString,   cfgFileName,    sizeof(cfgFileName),
+   "configuration file to use in place of .xpdfrc"},
+  {"-q",       argFlag,     &quiet,         0,
+   "don't print any messages or errors"},
+  {"-v",       argFlag,     &printVersion,  0,
+   "print copyright and version info"},
+  {"-h",       argFlag,     &printHelp,     0,
+   "print usage information"},
+  {"-help",    argFlag,     &printHelp,     0,
+   "print usage information"},
+  {"--help",   argFlag,     &printHelp,     0,
+   "print usage information"},
+  {"-?",       argFlag,     &printHelp,     0,
+   "print usage information"},
+  {NULL}
+};
+
+//------------------------------------------------------------------------
+// input generation
+//------------------------------------------------------------------------
+
+// A fixed pseudo-random sequence, so every run sees the same input.
+static Guint rndState;
+
+static void rndSeed(Guint seed) {
+  rndState = seed;
+}
+
+static int rndInt(int n) {
+  rndState = rndState * 1103515245 + 12345;
+  return (int)((rndState >> 8) % (Guint)n);
+}
+
+static double rndReal(double lo, double hi) {
+  return lo + (hi - lo) * rndInt(1 << 20) / (double)(1 << 20);
+}
+
+static void appendWord(GString *s) {
+  static const char *syllables[] = {
+    "ta", "ne", "ri", "mo", "ku", "sa", "le", "vi", "do", "pe",
+    "gra", "sto", "ben", "lu", "fi", "ca", "or", "mi", "tu", "es"
+  };
+  int n, i;
+
+  n = 1 + rndInt(4);
+  for (i = 0; i < n; ++i) {
+    s->append(syllables[rndInt(20)]);
+  }
+}
+
+// Content stream operators in roughly the mix seen in real pages:
+// text, paths, graphics state and XObjects.
+static GString *makeContentStream(int size) {
+  GString *s;
+  int i, n;
+
+  s = new GString();
+  while (s->getLength() < size) {
+    switch (rndInt(10)) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      s->appendf("BT /F{0:d} {1:d} Tf {2:.2f} {3:.2f} Td (",
+		 1 + rndInt(3), 8 + rndInt(6),
+		 rndReal(36, 500), rndReal(36, 750));
+      n = 3 + rndInt(8);
+      for (i = 0; i < n; ++i) {
+	if (i) {
+	  s->append(' ');
+	}
+	appendWord(s);
+      }
+      if (!rndInt(8)) {
+	s->append(" \\(see note\\)");
+      }
+      s->append(") Tj ET\n");
+      break;
+    case 4:
+      s->append("[(");
+      n = 2 + rndInt(6);
+      for (i = 0; i < n; ++i) {
+	appendWord(s);
+	s->appendf(") {0:d} (", rndInt(400) - 200);
+      }
+      appendWord(s);
+      s->append(")] TJ\n");
+      break;
+    case 5:
+    case 6:
+      s->appendf("{0:.3f} {1:.3f} m {2:.3f} {3:.3f} l"
+		 " {4:.3f} {5:.3f} {6:.3f} {7:.3f} {8:.3f} {9:.3f} c h {10:s}\n",
+		 rndReal(0, 612), rndReal(0, 792),
+		 rndReal(0, 612), rndReal(0, 792),
+		 rndReal(0, 612), rndReal(0, 792),
+		 rndReal(0, 612), rndReal(0, 792),
+		 rndReal(0, 612), rndReal(0, 792),
+		 rndInt(2) ? "f" : "S");
+      break;
+    case 7:
+      s->appendf("q {0:.4f} 0 0 {1:.4f} {2:.2f} {3:.2f} cm /Im{4:d} Do Q\n",
+		 rndReal(50, 300), rndReal(50, 300),
+		 rndReal(0, 400), rndReal(0, 600), rndInt(20));
+      break;
+    case 8:
+      s->appendf("{0:.3f} g {1:.3f} {2:.3f} {3:.3f} rg /GS{4:d} gs"
+		 " {5:.2f} w [3 2] 0 d\n",
+		 rndReal(0, 1), rndReal(0, 1), rndReal(0, 1), rndReal(0, 1),
+		 rndInt(4), rndReal(0.5, 4));
+      break;
+    case 9:
+      s->append("<");
+      n = 4 + rndInt(24);
+      for (i = 0; i < n; ++i) {
+	s->appendf("{0:02x}", 0x20 + rndInt(0x5f));
+      }
+      s->append("> Tj\n");
+      break;
+    }
+  }
+  return s;
+}
+
+// Top-level objects of the kinds found in a document body: page,
+// font and annotation dictionaries, and width arrays.
+static GString *makeObjects(int size) {
+  GString *s;
+  int i, n;
+
+  s = new GString();
+  while (s->getLength() < size) {
+    switch (rndInt(4)) {
+    case 0:
+      s->appendf("<< /Type /Page /Parent {0:d} 0 R"
+		 " /MediaBox [0 0 612 792] /Resources << /Font"
+		 " << /F1 {1:d} 0 R /F2 {2:d} 0 R >> /XObject << /Im1 {3:d}"
+		 " 0 R >> /ProcSet [/PDF /Text /ImageB] >> /Contents {4:d} 0 R"
+		 " /Annots [{5:d} 0 R {6:d} 0 R] /Rotate 0 /StructParents {7:d}"
+		 " >>\n",
+		 rndInt(100), rndInt(10000), rndInt(10000), rndInt(10000),
+		 rndInt(10000), rndInt(10000), rndInt(10000), rndInt(500));
+      break;
+    case 1:
+      s->appendf("<< /Type /Font /Subtype /TrueType /BaseFont"
+		 " /ABCDEF+Font{0:d} /FirstChar 32 /LastChar 126 /Widths"
+		 " {1:d} 0 R /FontDescriptor {2:d} 0 R /Encoding"
+		 " /WinAnsiEncoding >>\n",
+		 rndInt(50), rndInt(10000), rndInt(10000));
+      break;
+    case 2:
+      s->append("[");
+      n = 40 + rndInt(60);
+      for (i = 0; i < n; ++i) {
+	s->appendf(" {0:d}", 200 + rndInt(800));
+      }
+      s->append(" ]\n");
+      break;
+    case 3:
+      s->appendf("<< /Type /Annot /Subtype /Link /Rect [{0:.2f} {1:.2f}"
+		 " {2:.2f} {3:.2f}] /Border [0 0 0] /A << /S /URI /URI"
+		 " (http://example.com/",
+		 rndReal(0, 612), rndReal(0, 792),
+		 rndReal(0, 612), rndReal(0, 792));
+      appendWord(s);
+      s->appendf(") >> /M (D:2014{0:02d}{1:02d}120000Z) /F 4 /NM <",
+		 1 + rndInt(12), 1 + rndInt(28));
+      for (i = 0; i < 16; ++i) {
+	s->appendf("{0:02x}", rndInt(256));
+      }
+      s->append("> >>\n");
+      break;
+    }
+  }
+  return s;
+}
+
+//----- JPEG (baseline, 3 components, no subsampling)
+
+static const int jpegZigzag[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const int jpegQuant[64] = {
+  16, 11, 10, 16,  24,  40,  51,  61,  12, 12, 14, 19,  26,  58,  60,  55,
+  14, 13, 16, 24,  40,  57,  69,  56,  14, 17, 22, 29,  51,  87,  80,  62,
+  18, 22, 37, 56,  68, 109, 103,  77,  24, 35, 55, 64,  81, 104, 113,  92,
+  49, 64, 78, 87, 103, 121, 120, 101,  72, 92, 95, 98, 112, 100, 103,  99
+};
+
+static const Guchar jpegDCBits[16] = {
+  0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const Guchar jpegDCVals[12] = {
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const Guchar jpegACBits[16] = {
+  0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d
+};
+
+static const Guchar jpegACVals[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+  0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+  0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+  0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+  0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+  0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+  0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+  0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+  0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+  0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+  0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa
+};
+
+struct JPEGHuffCodes {
+  Gushort code[256];
+  Guchar len[256];
+};
+
+struct JPEGBitWriter {
+  GString *out;
+  Guint acc;
+  int n;
+};
+
+static void jpegHuffCodes(const Guchar *bits, const Guchar *vals,
+			  JPEGHuffCodes *codes) {
+  int code, len, i, k;
+
+  code = 0;
+  k = 0;
+  for (len = 1; len <= 16; ++len) {
+    for (i = 0; i < bits[len - 1]; ++i) {
+      codes->code[vals[k]] = (Gushort)code;
+      codes->len[vals[k]] = (Guchar)len;
+      ++code;
+      ++k;
+    }
+    code <<= 1;
+  }
+}
+
+static void jpegPutBits(JPEGBitWriter *bw, Guint code, int len) {
+  int b;
+
+  bw->acc = (bw->acc << len) | code;
+  bw->n += len;
+  while (bw->n >= 8) {
+    bw->n -= 8;
+    b = (bw->acc >> bw->n) & 0xff;
+    bw->out->append((char)b);
+    if (b == 0xff) {
+      bw->out->append((char)0);
+    }
+  }
+  bw->acc &= (1 << bw->n) - 1;
+}
+
+static void jpegPutValue(JPEGBitWriter *bw, JPEGHuffCodes *codes,
+			 int run, int v) {
+  int a, n;
+
+  a = v < 0 ? -v : v;
+  for (n = 0; a; ++n) {
+    a >>= 1;
+  }
+  jpegPutBits(bw, codes->code[(run << 4) | n], codes->len[(run << 4) | n]);
+  if (n) {
+    jpegPutBits(bw, v >= 0 ? v : v + (1 << n) - 1, n);
+  }
+}
+
+static void jpegSegment(GString *out, int marker, GString *body) {
+  out->append((char)0xff);
+  out->append((char)marker);
+  out->append((char)((body->getLength() + 2) >> 8));
+  out->append((char)(body->getLength() + 2));
+  out->append(body);
+  delete body;
+}
+
+// Encode <w>x<h> interleaved YCbCr samples.  All three components use
+// the luminance quantization and Huffman tables, which is enough to
+// drive every part of the decoder.
+static GString *encodeJPEG(Guchar *ycc, int w, int h) {
+  JPEGHuffCodes dcCodes, acCodes;
+  JPEGBitWriter bw;
+  GString *out, *body;
+  double cosTab[8][8], blk[64], tmp[64], s;
+  int quant[64], coef[64], pred[3];
+  int xb, yb, comp, x, y, u, v, i, run;
+
+  for (i = 0; i < 64; ++i) {
+    // quality 75
+    quant[i] = (jpegQuant[i] * 50 + 50) / 100;
+    if (quant[i] < 1) {
+      quant[i] = 1;
+    }
+  }
+  for (u = 0; u < 8; ++u) {
+    for (x = 0; x < 8; ++x) {
+      cosTab[u][x] = (u == 0 ? sqrt(0.5) : 1.0) * 0.5 *
+	             cos((2 * x + 1) * u * M_PI / 16);
+    }
+  }
+  jpegHuffCodes(jpegDCBits, jpegDCVals, &dcCodes);
+  jpegHuffCodes(jpegACBits, jpegACVals, &acCodes);
+
+  out = new GString();
+  out->append("\xff\xd8", 2);
+  body = new GString();
+  body->append((char)0);
+  for (i = 0; i < 64; ++i) {
+    body->append((char)quant[jpegZigzag[i]]);
+  }
+  jpegSegment(out, 0xdb, body);
+  body = new GString();
+  body->append((char)8);
+  body->append((char)(h >> 8));
+  body->append((char)h);
+  body->append((char)(w >> 8));
+  body->append((char)w);
+  body->append((char)3);
+  for (comp = 1; comp <= 3; ++comp) {
+    body->append((char)comp);
+    body->append((char)0x11);
+    body->append((char)0);
+  }
+  jpegSegment(out, 0xc0, body);
+  body = new GString();
+  body->append((char)0x00);
+  body->append((char *)jpegDCBits, 16);
+  body->append((char *)jpegDCVals, 12);
+  jpegSegment(out, 0xc4, body);
+  body = new GString();
+  body->append((char)0x10);
+  body->append((char *)jpegACBits, 16);
+  body->append((char *)jpegACVals, 162);
+  jpegSegment(out, 0xc4, body);
+  body = new GString();
+  body->append((char)3);
+  for (comp = 1; comp <= 3; ++comp) {
+    body->append((char)comp);
+    body->append((char)0x00);
+  }
+  body->append("\x00\x3f\x00", 3);
+  jpegSegment(out, 0xda, body);
+
+  bw.out = out;
+  bw.acc = 0;
+  bw.n = 0;
+  pred[0] = pred[1] = pred[2] = 0;
+  for (yb = 0; yb < (h + 7) / 8; ++yb) {
+    for (xb = 0; xb < (w + 7) / 8; ++xb) {
+      for (comp = 0; comp < 3; ++comp) {
+	for (y = 0; y < 8; ++y) {
+	  for (x = 0; x < 8; ++x) {
+	    blk[y * 8 + x] =
+	        ycc[((yb * 8 + y < h ? yb * 8 + y : h - 1) * w +
+		     (xb * 8 + x < w ? xb * 8 + x : w - 1)) * 3 + comp]
+	        - 128;
+	  }
+	}
+	for (y = 0; y < 8; ++y) {
+	  for (u = 0; u < 8; ++u) {
+	    s = 0;
+	    for (x = 0; x < 8; ++x) {
+	      s += cosTab[u][x] * blk[y * 8 + x];
+	    }
+	    tmp[y * 8 + u] = s;
+	  }
+	}
+	for (v = 0; v < 8; ++v) {
+	  for (u = 0; u < 8; ++u) {
+	    s = 0;
+	    for (y = 0; y < 8; ++y) {
+	      s += cosTab[v][y] * tmp[y * 8 + u];
+	    }
+	    coef[v * 8 + u] = (int)floor(s / quant[v * 8 + u] + 0.5);
+	  }
+	}
+	jpegPutValue(&bw, &dcCodes, 0, coef[0] - pred[comp]);
+	pred[comp] = coef[0];
+	run = 0;
+	for (i = 1; i < 64; ++i) {
+	  if (coef[jpegZigzag[i]] == 0) {
+	    ++run;
+	    continue;
+	  }
+	  while (run > 15) {
+	    jpegPutBits(&bw, acCodes.code[0xf0], acCodes.len[0xf0]);
+	    run -= 16;
+	  }
+	  jpegPutValue(&bw, &acCodes, run, coef[jpegZigzag[i]]);
+	  run = 0;
+	}
+	if (run) {
+	  jpegPutBits(&bw, acCodes.code[0x00], acCodes.len[0x00]);
+	}
+      }
+    }
+  }
+  if (bw.n) {
+    jpegPutBits(&bw, (1 << (8 - bw.n)) - 1, 8 - bw.n);
+  }
+  out->append("\xff\xd9", 2);
+  return out;
+}
+
+static Guchar clip255(double x) {
+  return x < 0 ? 0 : x > 255 ? 255 : (Guchar)(x + 0.5);
+}
+
+// A photo-like image: smooth gradients, flat rectangles and noise.
+static GString *makeJPEG(int w, int h) {
+  GString *jpeg;
+  Guchar *ycc, *p;
+  double r, g, b;
+  int rx[16], ry[16], rw[16], rh[16], rc[16][3];
+  int x, y, i;
+
+  for (i = 0; i < 16; ++i) {
+    rx[i] = rndInt(w);
+    ry[i] = rndInt(h);
+    rw[i] = 20 + rndInt(w / 4);
+    rh[i] = 20 + rndInt(h / 4);
+    rc[i][0] = rndInt(256);
+    rc[i][1] = rndInt(256);
+    rc[i][2] = rndInt(256);
+  }
+  ycc = (Guchar *)gmallocn(w * h, 3);
+  p = ycc;
+  for (y = 0; y < h; ++y) {
+    for (x = 0; x < w; ++x) {
+      r = 128 + 100 * sin(x * 0.013) * cos(y * 0.007);
+      g = 128 + 90 * sin((x + y) * 0.005);
+      b = 128 + 80 * cos(x * 0.021 - y * 0.017);
+      for (i = 0; i < 16; ++i) {
+	if (x >= rx[i] && x < rx[i] + rw[i] && y >= ry[i] && y < ry[i] + rh[i]) {
+	  r = rc[i][0];
+	  g = rc[i][1];
+	  b = rc[i][2];
+	}
+      }
+      r += rndInt(17) - 8;
+      g += rndInt(17) - 8;
+      b += rndInt(17) - 8;
+      *p++ = clip255(0.299 * r + 0.587 * g + 0.114 * b);
+      *p++ = clip255(-0.1687 * r - 0.3313 * g + 0.5 * b + 128);
+      *p++ = clip255(0.5 * r - 0.4187 * g - 0.0813 * b + 128);
+    }
+  }
+  jpeg = encodeJPEG(ycc, w, h);
+  gfree(ycc);
+  return jpeg;
+}
+
+//----- text page
+
+// A one-page document with a heading and three columns of body text
+// in the (non-embedded) standard fonts.  Sets *nChars to the number of
+// non-space characters on the page.
+static GString *makeTextPDF(int *nChars) {
+  GString *content, *pdf;
+  int offsets[7];
+  double y;
+  int col, len, i;
+
+  content = new GString();
+  content->append("BT /F2 16 Tf 54 740 Td (");
+  for (i = 0; i < 5; ++i) {
+    if (i) {
+      content->append(' ');
+    }
+    appendWord(content);
+  }
+  content->append(") Tj ET\n");
+  for (col = 0; col < 3; ++col) {
+    for (y = 710; y > 60; y -= 11) {
+      content->appendf("BT /F1 9 Tf {0:d} {1:.0f} Td (", 54 + col * 174, y);
+      len = 0;
+      while (len < 30) {
+	if (len) {
+	  content->append(' ');
+	  ++len;
+	}
+	i = content->getLength();
+	appendWord(content);
+	len += content->getLength() - i;
+      }
+      content->append(") Tj ET\n");
+    }
+  }
+  content->append("BT /F1 8 Tf 300 36 Td (1) Tj ET\n");
+  *nChars = 0;
+  for (i = 0; i < content->getLength(); ++i) {
+    if (content->getChar(i) == '(') {
+      for (++i; content->getChar(i) != ')'; ++i) {
+	if (content->getChar(i) != ' ') {
+	  ++*nChars;
+	}
+      }
+    }
+  }
+
+  pdf = new GString("%PDF-1.4\n");
+  offsets[1] = pdf->getLength();
+  pdf->append("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+  offsets[2] = pdf->getLength();
+  pdf->append("2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+  offsets[3] = pdf->getLength();
+  pdf->append("3 0 obj\n<< /Type /Page /Parent 2 0 R"
+	      " /MediaBox [0 0 612 792] /Contents 4 0 R"
+	      " /Resources << /Font << /F1 5 0 R /F2 6 0 R >> >> >>\n"
+	      "endobj\n");
+  offsets[4] = pdf->getLength();
+  pdf->appendf("4 0 obj\n<< /Length {0:d} >>\nstream\n",
+	       content->getLength());
+  pdf->append(content);
+  pdf->append("endstream\nendobj\n");
+  offsets[5] = pdf->getLength();
+  pdf->append("5 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica"
+	      " /Encoding /WinAnsiEncoding >>\nendobj\n");
+  offsets[6] = pdf->getLength();
+  pdf->append("6 0 obj\n<< /Type /Font /Subtype /Type1"
+	      " /BaseFont /Helvetica-Bold /Encoding /WinAnsiEncoding >>\n"
+	      "endobj\n");
+  i = pdf->getLength();
+  pdf->append("xref\n0 7\n0000000000 65535 f \n");
+  for (col = 1; col < 7; ++col) {
+    pdf->appendf("{0:010d} 00000 n \n", offsets[col]);
+  }
+  pdf->appendf("trailer\n<< /Size 7 /Root 1 0 R >>\nstartxref\n{0:d}\n%EOF\n",
+	       i);
+  delete content;
+  return pdf;
+}
+
+//------------------------------------------------------------------------
+// kernels
+//------------------------------------------------------------------------
+
+// Folded into by the kernels, so the compiler can't discard their
+// work, and printed at the end.
+static Guint checksum;
+
+static Stream *makeMemStream(GString *s) {
+  Object obj;
+
+  obj.initNull();
+  return new MemStream(s->getCString(), 0, s->getLength(), &obj);
+}
+
+static GString *streamData;
+
+//----- lexer
+
+static void lexerSetup() {
+  rndSeed(1);
+  streamData = makeContentStream(1 << 20);
+}
+
+static double lexerRun() {
+  Lexer *lexer;
+  Object obj;
+
+  lexer = new Lexer(NULL, makeMemStream(streamData));
+  while (!lexer->getObj(&obj)->isEOF()) {
+    checksum += obj.getType();
+    obj.free();
+  }
+  obj.free();
+  delete lexer;
+  return streamData->getLength() / 1048576.0;
+}
+
+static void streamDataCleanup() {
+  delete streamData;
+}
+
+//----- parser
+
+static void parserSetup() {
+  rndSeed(2);
+  streamData = makeObjects(1 << 20);
+}
+
+static double parserRun() {
+  Parser *parser;
+  Object obj;
+
+  parser = new Parser(NULL, new Lexer(NULL, makeMemStream(streamData)),
+		      gFalse);
+  while (!parser->getObj(&obj)->isEOF()) {
+    checksum += obj.getType();
+    obj.free();
+  }
+  obj.free();
+  delete parser;
+  return streamData->getLength() / 1048576.0;
+}
+
+//----- flate
+
+static GString *flateData;
+static int flateLength;
+
+static void flateSetup() {
+  GString *data;
+  char *buf;
+  uLongf len;
+
+  rndSeed(3);
+  data = makeContentStream(4 << 20);
+  len = compressBound(data->getLength());
+  buf = (char *)gmalloc((int)len);
+  compress2((Bytef *)buf, &len, (Bytef *)data->getCString(),
+	    data->getLength(), 6);
+  flateData = new GString(buf, (int)len);
+  flateLength = data->getLength();
+  gfree(buf);
+  delete data;
+}
+
+static double flateRun() {
+  Stream *str;
+  char buf[65536];
+  int n;
+
+  str = new FlateStream(makeMemStream(flateData), 1, 1, 1, 8);
+  str->reset();
+  while ((n = str->getBlock(buf, sizeof(buf))) > 0) {
+    checksum += n + (buf[0] & 0xff);
+  }
+  delete str;
+  return flateLength / 1048576.0;
+}
+
+static void flateCleanup() {
+  delete flateData;
+}
+
+//----- dct
+
+#define dctSize 768
+
+static void dctSetup() {
+  rndSeed(4);
+  streamData = makeJPEG(dctSize, dctSize);
+}
+
+static double dctRun() {
+  Stream *str;
+  char buf[65536];
+  int n;
+
+  str = new DCTStream(makeMemStream(streamData), -1);
+  str->reset();
+  while ((n = str->getBlock(buf, sizeof(buf))) > 0) {
+    checksum += n + (buf[0] & 0xff);
+  }
+  delete str;
+  return dctSize * dctSize * 3 / 1048576.0;
+}
+
+//----- makecolumns
+
+static TextPage *textPage;
+static int textChars;
+
+static void makeColumnsSetup() {
+  TextOutputControl textOutControl;
+  TextOutputDev *textOut;
+  PDFDoc *doc;
+
+  rndSeed(5);
+  streamData = makeTextPDF(&textChars);
+  doc = new PDFDoc((BaseStream *)makeMemStream(streamData));
+  // same settings as JSONGen
+  textOutControl.mode = textOutReadingOrder;
+  textOutControl.html = gTrue;
+  textOut = new TextOutputDev(NULL, &textOutControl, gFalse);
+  doc->displayPage(textOut, 1, 72, 72, 0, gFalse, gTrue, gFalse);
+  textPage = textOut->takeText();
+  delete textOut;
+  delete doc;
+}
+
+static double makeColumnsRun() {
+  GList *columns;
+
+  columns = textPage->makeColumns();
+  checksum += columns->getLength();
+  deleteGList(columns, TextColumn);
+  return textChars;
+}
+
+static void makeColumnsCleanup() {
+  delete textPage;
+  delete streamData;
+}
+
+//----- splash
+
+#define splashSize 1024
+#define splashNPaths 200
+#define splashNGlyphs 64
+
+static SplashBitmap *bitmap;
+static Splash *splash;
+static SplashPath *paths[splashNPaths];
+static SplashColor pathColors[splashNPaths];
+static double lineWidths[splashNPaths];
+static SplashGlyphBitmap glyphs[splashNGlyphs];
+
+static void splashSetup() {
+  SplashColor white;
+
+  bitmap = new SplashBitmap(splashSize, splashSize, 4, splashModeRGB8,
+			    gFalse);
+  splash = new Splash(bitmap, gTrue);
+  white[0] = white[1] = white[2] = 0xff;
+  splash->clear(white);
+}
+
+static void splashCleanup() {
+  delete splash;
+  delete bitmap;
+}
+
+// Closed shapes made of lines and curves, from small to page-sized.
+static void splashFillSetup() {
+  double cx, cy, r, a;
+  int i, j, n;
+
+  splashSetup();
+  rndSeed(6);
+  for (i = 0; i < splashNPaths; ++i) {
+    paths[i] = new SplashPath();
+    cx = rndReal(0, splashSize);
+    cy = rndReal(0, splashSize);
+    r = rndReal(10, splashSize / 4);
+    n = 3 + rndInt(10);
+    for (j = 0; j < n; ++j) {
+      a = 2 * M_PI * j / n;
+      if (j == 0) {
+	paths[i]->moveTo(cx + r * cos(a), cy + r * sin(a));
+      } else if (rndInt(3)) {
+	paths[i]->lineTo(cx + r * cos(a) * rndReal(0.5, 1),
+			 cy + r * sin(a) * rndReal(0.5, 1));
+      } else {
+	paths[i]->curveTo(cx + r * rndReal(-1, 1), cy + r * rndReal(-1, 1),
+			  cx + r * rndReal(-1, 1), cy + r * rndReal(-1, 1),
+			  cx + r * cos(a), cy + r * sin(a));
+      }
+    }
+    paths[i]->close();
+    pathColors[i][0] = (Guchar)rndInt(256);
+    pathColors[i][1] = (Guchar)rndInt(256);
+    pathColors[i][2] = (Guchar)rndInt(256);
+  }
+}
+
+static double splashFillRun() {
+  int i;
+
+  for (i = 0; i < splashNPaths; ++i) {
+    splash->setFillPattern(new SplashSolidColor(pathColors[i]));
+    splash->fill(paths[i], i & 1);
+  }
+  checksum += bitmap->getDataPtr()[splashSize * 3 * (splashSize / 2)];
+  return splashNPaths;
+}
+
+// Open polylines with curves, stroked at widths from hairline to 4
+// pixels.
+static void splashStrokeSetup() {
+  double x, y;
+  int i, j, n;
+
+  splashSetup();
+  rndSeed(7);
+  for (i = 0; i < splashNPaths; ++i) {
+    paths[i] = new SplashPath();
+    x = rndReal(0, splashSize);
+    y = rndReal(0, splashSize);
+    paths[i]->moveTo(x, y);
+    n = 2 + rndInt(12);
+    for (j = 0; j < n; ++j) {
+      x = fabs(x + rndReal(-150, 150));
+      y = fabs(y + rndReal(-150, 150));
+      if (rndInt(4)) {
+	paths[i]->lineTo(x, y);
+      } else {
+	paths[i]->curveTo(x + rndReal(-50, 50), y + rndReal(-50, 50),
+			  x + rndReal(-50, 50), y + rndReal(-50, 50), x, y);
+      }
+    }
+    pathColors[i][0] = (Guchar)rndInt(256);
+    pathColors[i][1] = (Guchar)rndInt(256);
+    pathColors[i][2] = (Guchar)rndInt(256);
+    lineWidths[i] = rndInt(8) ? rndReal(0.5, 4) : 0;
+  }
+}
+
+static double splashStrokeRun() {
+  int i;
+
+  for (i = 0; i < splashNPaths; ++i) {
+    splash->setStrokePattern(new SplashSolidColor(pathColors[i]));
+    splash->setLineWidth(lineWidths[i]);
+    splash->stroke(paths[i]);
+  }
+  checksum += bitmap->getDataPtr()[splashSize * 3 * (splashSize / 2)];
+  return splashNPaths;
+}
+
+static void splashPathCleanup() {
+  int i;
+
+  for (i = 0; i < splashNPaths; ++i) {
+    delete paths[i];
+  }
+  splashCleanup();
+}
+
+// Anti-aliased glyph bitmaps the size of 10pt text at 150 dpi, drawn
+// in lines across the page.
+static void splashGlyphSetup() {
+  int i, j;
+
+  splashSetup();
+  rndSeed(8);
+  for (i = 0; i < splashNGlyphs; ++i) {
+    glyphs[i].x = -1;
+    glyphs[i].y = 15;
+    glyphs[i].w = 8 + rndInt(6);
+    glyphs[i].h = 16 + rndInt(4);
+    glyphs[i].aa = gTrue;
+    glyphs[i].data = (Guchar *)gmallocn(glyphs[i].w, glyphs[i].h);
+    glyphs[i].freeData = gTrue;
+    for (j = 0; j < glyphs[i].w * glyphs[i].h; ++j) {
+      switch (rndInt(4)) {
+      case 0:  glyphs[i].data[j] = 0;                    break;
+      case 1:  glyphs[i].data[j] = (Guchar)rndInt(256);  break;
+      default: glyphs[i].data[j] = 0xff;                 break;
+      }
+    }
+  }
+}
+
+static double splashGlyphRun() {
+  SplashColor black;
+  int x, y, n;
+
+  black[0] = black[1] = black[2] = 0;
+  splash->setFillPattern(new SplashSolidColor(black));
+  n = 0;
+  for (y = 40; y < splashSize - 20; y += 22) {
+    for (x = 20; x < splashSize - 30; x += glyphs[n % splashNGlyphs].w + 1) {
+      splash->fillGlyph(x + 0.25, y, &glyphs[n % splashNGlyphs]);
+      ++n;
+    }
+  }
+  checksum += bitmap->getDataPtr()[splashSize * 3 * (splashSize / 2)];
+  return n;
+}
+
+static void splashGlyphCleanup() {
+  int i;
+
+  for (i = 0; i < splashNGlyphs; ++i) {
+    gfree(glyphs[i].data);
+  }
+  splashCleanup();
+}
+
+//----- gstring
+
+#define gstringNCalls 1000
+
+static GString *gstringWord;
+
+static void gstringSetup() {
+  gstringWord = new GString("Helvetica-Bold");
+}
+
+// The kinds of format strings JSONGen uses for word boxes and font
+// styles.
+static double gstringRun() {
+  GString *s;
+  int i;
+
+  for (i = 0; i < gstringNCalls; ++i) {
+    s = GString::format("[{0:d},{1:d},{2:d},{3:d},{4:d},\"",
+			i * 7, i * 3 + 20, i & 255, 12, -i);
+    s->appendf("\",{0:.2f},{1:.4g},{2:s},{3:t},{4:x}]",
+	       i * 0.37, i * 1.0001, "regular", gstringWord, i * 13);
+    checksum += s->getLength();
+    delete s;
+  }
+  return 2 * gstringNCalls;
+}
+
+static void gstringCleanup() {
+  delete gstringWord;
+}
+
+//----- unicodemap
+
+#define unicodeMapNChars 65536
+
+static Unicode *unicodeChars;
+static UnicodeMap *unicodeMap;
+
+// Mostly ASCII, some Latin-1 and general punctuation, a little CJK
+// and a few characters outside the BMP.
+static void unicodeMapSetup(const char *encoding) {
+  GString *name;
+  int i, r;
+
+  rndSeed(9);
+  unicodeChars = (Unicode *)gmallocn(unicodeMapNChars, sizeof(Unicode));
+  for (i = 0; i < unicodeMapNChars; ++i) {
+    r = rndInt(100);
+    if (r < 75) {
+      unicodeChars[i] = 0x20 + rndInt(0x5f);
+    } else if (r < 87) {
+      unicodeChars[i] = 0xa0 + rndInt(0x60);
+    } else if (r < 93) {
+      unicodeChars[i] = 0x2000 + rndInt(0x70);
+    } else if (r < 99) {
+      unicodeChars[i] = 0x4e00 + rndInt(0x5200);
+    } else {
+      unicodeChars[i] = 0x1f300 + rndInt(0x300);
+    }
+  }
+  name = new GString(encoding);
+  unicodeMap = globalParams->getUnicodeMap(name);
+  delete name;
+}
+
+static void unicodeMapUTF8Setup() {
+  unicodeMapSetup("UTF-8");
+}
+
+static void unicodeMapLatin1Setup() {
+  unicodeMapSetup("Latin1");
+}
+
+static double unicodeMapRun() {
+  char buf[8];
+  int i;
+
+  for (i = 0; i < unicodeMapNChars; ++i) {
+    checksum += unicodeMap->mapUnicode(unicodeChars[i], buf, sizeof(buf));
+  }
+  return unicodeMapNChars;
+}
+
+static void unicodeMapCleanup() {
+  unicodeMap->decRefCnt();
+  gfree(unicodeChars);
+}
+
+//------------------------------------------------------------------------
+
+struct Kernel {
+  const char *name;
+  const char *unit;		// what run() returns a count of
+  const char *desc;
+  void (*setup)();		// build the input (not timed)
+  double (*run)();		// one iteration
+  void (*cleanup)();
+};
+
+static Kernel kernels[] = {
+  {"lexer",         "MB",     "Lexer tokens from a 1 MB content stream",
+   &lexerSetup,         &lexerRun,         &streamDataCleanup},
+  {"parser",        "MB",     "Parser objects from 1 MB of dicts and arrays",
+   &parserSetup,        &parserRun,        &streamDataCleanup},
+  {"flate",         "MB",     "FlateStream inflate of a 4 MB content stream",
+   &flateSetup,         &flateRun,         &flateCleanup},
+  {"dct",           "MB",     "DCTStream decode of a 768x768 color JPEG",
+   &dctSetup,           &dctRun,           &streamDataCleanup},
+  {"makecolumns",   "chars",  "TextPage::makeColumns on a 3-column page",
+   &makeColumnsSetup,   &makeColumnsRun,   &makeColumnsCleanup},
+  {"splash-fill",   "paths",  "Splash::fill, anti-aliased, RGB8",
+   &splashFillSetup,    &splashFillRun,    &splashPathCleanup},
+  {"splash-stroke", "paths",  "Splash::stroke, anti-aliased, RGB8",
+   &splashStrokeSetup,  &splashStrokeRun,  &splashPathCleanup},
+  {"splash-glyph",  "glyphs", "Splash::fillGlyph with 8-bit glyphs, RGB8",
+   &splashGlyphSetup,   &splashGlyphRun,   &splashGlyphCleanup},
+  {"gstring",       "calls",  "GString::format and appendf",
+   &gstringSetup,       &gstringRun,       &gstringCleanup},
+  {"unicodemap-utf8", "chars", "UnicodeMap::mapUnicode to UTF-8",
+   &unicodeMapUTF8Setup, &unicodeMapRun,   &unicodeMapCleanup},
+  {"unicodemap-latin1", "chars", "UnicodeMap::mapUnicode to Latin1",
+   &unicodeMapLatin1Setup, &unicodeMapRun, &unicodeMapCleanup},
+  {NULL}
+};
+
+// Summary of the per-iteration times (in seconds) over the
+// repetitions.
+struct KernelResult {
+  int iters;			// iterations per repetition
+  double units;			// run() count per iteration
+  double min, median, mean, stddev, p90, max;
+};
+
+static int cmpDouble(const void *p1, const void *p2) {
+  double d = *(const double *)p1 - *(const double *)p2;
+  return d < 0 ? -1 : d > 0 ? 1 : 0;
+}
+
+static void runKernel(Kernel *k, KernelResult *res) {
+  double *times;
+  double t, units, sum, sq;
+  int i, j;
+
+  (*k->setup)();
+
+  // the last warmup run sets the number of iterations per repetition
+  t = 0;
+  units = 0;
+  for (i = 0; i < warmup || i == 0; ++i) {
+    t = perfWallTime();
+    units = (*k->run)();
+    t = perfWallTime() - t;
+  }
+  res->iters = 1;
+  if (t > 0 && t * 1000 < minTime) {
+    res->iters = (int)ceil(minTime / (t * 1000));
+  }
+  res->units = units;
+
+  times = (double *)gmallocn(reps, sizeof(double));
+  for (i = 0; i < reps; ++i) {
+    t = perfWallTime();
+    for (j = 0; j < res->iters; ++j) {
+      (*k->run)();
+    }
+    times[i] = (perfWallTime() - t) / res->iters;
+  }
+  (*k->cleanup)();
+
+  qsort(times, reps, sizeof(double), &cmpDouble);
+  sum = 0;
+  for (i = 0; i < reps; ++i) {
+    sum += times[i];
+  }
+  res->mean = sum / reps;
+  sq = 0;
+  for (i = 0; i < reps; ++i) {
+    sq += (times[i] - res->mean) * (times[i] - res->mean);
+  }
+  res->stddev = reps > 1 ? sqrt(sq / (reps - 1)) : 0;
+  res->min = times[0];
+  res->max = times[reps - 1];
+  res->median = (reps & 1) ? times[reps / 2]
+                           : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+  res->p90 = times[(int)ceil(0.9 * reps) - 1];
+  gfree(times);
+}
+
+static GBool kernelSelected(Kernel *k) {
+  const char *p;
+  int n;
+
+  if (!kernelList[0]) {
+    return gTrue;
+  }
+  n = (int)strlen(k->name);
+  for (p = kernelList; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL) {
+    if (!strncmp(p, k->name, n) && (p[n] == ',' || p[n] == '\0')) {
+      return gTrue;
+    }
+  }
+  return gFalse;
+}
+
+int main(int argc, char *argv[]) {
+  KernelResult *results;
+  FILE *f;
+  GBool ok, first;
+  int nKernels, nSelected, exitCode, i;
+
+  exitCode = 99;
+
+  // parse args
+  ok = parseArgs(argDesc, &argc, argv);
+  if (!ok || argc != 1 || printVersion || printHelp) {
+    fprintf(stderr, "pdfmicrobench version %s\n", xpdfVersion);
+    fprintf(stderr, "%s\n", xpdfCopyright);
+    if (!printVersion) {
+      printUsage("pdfmicrobench", "", argDesc);
+    }
+    goto err0;
+  }
+  if (listKernels) {
+    for (i = 0; kernels[i].name; ++i) {
+      printf("%-18s %s\n", kernels[i].name, kernels[i].desc);
+    }
+    exitCode = 0;
+    goto err0;
+  }
+  if (reps < 1 || warmup < 0 || minTime < 0) {
+    fprintf(stderr, "Invalid -reps, -warmup or -mintime value\n");
+    goto err0;
+  }
+  for (nKernels = 0; kernels[nKernels].name; ++nKernels) ;
+  nSelected = 0;
+  for (i = 0; i < nKernels; ++i) {
+    if (kernelSelected(&kernels[i])) {
+      ++nSelected;
+    }
+  }
+  if (!nSelected) {
+    fprintf(stderr, "No kernels match '%s' (see -list)\n", kernelList);
+    goto err0;
+  }
+
+  // read config file
+  globalParams = new GlobalParams(cfgFileName);
+  if (quiet) {
+    globalParams->setErrQuiet(quiet);
+  }
+
+  results = (KernelResult *)gmallocn(nKernels, sizeof(KernelResult));
+  printf("%-18s %6s %10s %10s %10s %9s %10s %12s\n",
+	 "kernel", "iters", "min us", "median us", "mean us", "stddev %",
+	 "p90 us", "throughput");
+  for (i = 0; i < nKernels; ++i) {
+    if (!kernelSelected(&kernels[i])) {
+      continue;
+    }
+    runKernel(&kernels[i], &results[i]);
+    printf("%-18s %6d %10.1f %10.1f %10.1f %9.2f %10.1f %12.1f %s/s\n",
+	   kernels[i].name, results[i].iters, results[i].min * 1e6,
+	   results[i].median * 1e6, results[i].mean * 1e6,
+	   100 * results[i].stddev / results[i].mean, results[i].p90 * 1e6,
+	   results[i].units / results[i].median, kernels[i].unit);
+    fflush(stdout);
+  }
+  if (!quiet) {
+    fprintf(stderr, "checksum %08x\n", checksum);
+  }
+
+  exitCode = 0;
+  if (jsonFileName[0]) {
+    if (!(f = fopen(jsonFileName, "wb"))) {
+      error(errIO, -1, "Couldn't open file '{0:s}'", jsonFileName);
+      exitCode = 2;
+    } else {
+      fprintf(f, "{\"format\":1,\"reps\":%d,\"kernels\":{", reps);
+      first = gTrue;
+      for (i = 0; i < nKernels; ++i) {
+	if (!kernelSelected(&kernels[i])) {
+	  continue;
+	}
+	fprintf(f, "%s\n\"%s\":{\"unit\":\"%s\",\"iterations\":%d,"
+		"\"minUs\":%.3f,\"medianUs\":%.3f,\"meanUs\":%.3f,"
+		"\"stddevUs\":%.3f,\"p90Us\":%.3f,\"maxUs\":%.3f,"
+		"\"perSec\":%.3f}",
+		first ? "" : ",", kernels[i].name, kernels[i].unit,
+		results[i].iters, results[i].min * 1e6,
+		results[i].median * 1e6, results[i].mean * 1e6,
+		results[i].stddev * 1e6, results[i].p90 * 1e6,
+		results[i].max * 1e6, results[i].units / results[i].median);
+	first = gFalse;
+      }
+      fprintf(f, "\n}}\n");
+      fclose(f);
+    }
+  }
+
+  gfree(results);
+  delete globalParams;
+
+ err0:
+  // check for memory leaks
+  Object::memCheck(stderr);
+  gMemReport(stderr);
+
+  return exitCode;
+}
@@ -10,13 +10,27 @@
 #include <aconf.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#ifdef _WIN32
+#  include <io.h>
+#  include <fcntl.h>
+#endif
 #include "parseargs.h"
 #include "gmem.h"
 #include "gfile.h"
 #include "GString.h"
 #include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
 #include "PDFDoc.h"
 #include "JSONGen.h"
+#include "GzipWriter.h"
+#include "PerfCounters.h"
+#include "ProbeOutputDev.h"
+#include "PageChanges.h"
+#include "ExtractCache.h"
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "config.h"
@@ -26,13 +40,33 @@
 static int firstPage = 1;
 static int lastPage = 0;
 static int resolution = 150;
+static int maxPixels = 0;
+static int maxWidth = 0;
+static int maxHeight = 0;
 static GBool skipInvisible = gFalse;
 static GBool createPng = gFalse;
 static GBool createFullPng = gFalse;
+static GBool ndjson = gFalse;
+static GBool binary = gFalse;
+static GBool gzip = gFalse;
+static int zlevel = -1;
+static double pageTimeout = 0;
+static int maxOps = 0;
+static int maxImagePixels = 0;
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
 static GBool quiet = gFalse;
 static char cfgFileName[256] = "";
+static char profileFileName[256] = "";
+static char traceFileName[256] = "";
+static char memStatsFileName[256] = "";
+static GBool probe = gFalse;
+static GBool probeAll = gFalse;
+static char prevFileName[256] = "";
+static char prevSizeStr[32] = "";
+static char cacheDir[256] = "";
+static int cacheSize = 1024;
+static int rangeBlockSize = 0;
 static GBool printVersion = gFalse;
 static GBool printHelp = gFalse;
 
@@ -43,12 +77,32 @@ static ArgDesc argDesc[] = {
    "last page to convert"},
   {"-r",      argInt,      &resolution,     0,
    "resolution, in DPI (default is 150)"},
+  {"-maxpixels", argInt,    &maxPixels,     0,
+   "max pixels per page image (overrides -r)"},
+  {"-maxwidth", argInt,     &maxWidth,      0,
+   "max width of page images, in pixels (overrides -r)"},
+  {"-maxheight", argInt,    &maxHeight,     0,
+   "max height of page images, in pixels (overrides -r)"},
   {"-skipinvisible", argFlag, &skipInvisible, 0,
    "do not draw invisible text"},
   {"-createpng", argFlag, &createPng, 0,
    "output png with and without text"},
   {"-createfullpng", argFlag, &createFullPng, 0,
    "output png with and without text"},
+  {"-ndjson",  argFlag,     &ndjson,        0,
+   "write one page object per line, flushed after each page"},
+  {"-binary",  argFlag,     &binary,        0,
+   "write the compact binary format (see pdfbintojson)"},
+  {"-gzip",    argFlag,     &gzip,          0,
+   "gzip-compress the JSON output"},
+  {"-zlevel",  argInt,      &zlevel,        0,
+   "compression level (0-9) for -gzip and the PNG files"},
+  {"-timeout", argFP,       &pageTimeout,   0,
+   "max time per page, in seconds; the rest of the page is skipped"},
+  {"-maxops",  argInt,      &maxOps,        0,
+   "max content stream operators per page"},
+  {"-maximagepixels", argInt, &maxImagePixels, 0,
+   "max decoded image pixels per page"},
   {"-opw",     argString,   ownerPassword,  sizeof(ownerPassword),
    "owner password (for encrypted files)"},
   {"-upw",     argString,   userPassword,   sizeof(userPassword),
@@ -57,6 +111,26 @@ static ArgDesc argDesc[] = {
    "don't print any messages or errors"},
   {"-cfg",     argString,   cfgFileName,    sizeof(cfgFileName),
    "configuration file to use in place of .xpdfrc"},
+  {"-profile", argString,   profileFileName, sizeof(profileFileName),
+   "write per-page timings and counters to this JSON file"},
+  {"-trace",   argString,   traceFileName,  sizeof(traceFileName),
+   "write a Chrome trace-event file (chrome://tracing, Perfetto)"},
+  {"-memstats", argString,  memStatsFileName, sizeof(memStatsFileName),
+   "write per-subsystem allocation stats to this JSON file"},
+  {"-probe",   argFlag,     &probe,         0,
+   "only report whether the document has a text layer (JSON summary)"},
+  {"-probeall", argFlag,    &probeAll,      0,
+   "with -probe, look at every page instead of stopping when sure"},
+  {"-prev",    argString,   prevFileName,   sizeof(prevFileName),
+   "output for an earlier revision: copy the pages that haven't changed"},
+  {"-prevsize", argString,  prevSizeStr,    sizeof(prevSizeStr),
+   "size of the earlier revision's PDF file (default: newest update only)"},
+  {"-cache",   argString,   cacheDir,       sizeof(cacheDir),
+   "directory for a cache of converted pages, shared between runs"},
+  {"-cachesize", argInt,    &cacheSize,     0,
+   "max size of the -cache directory, in MB (default is 1024)"},
+  {"-rangeread", argInt,    &rangeBlockSize, 0,
+   "read the PDF file in blocks of this many KB, as for a remote file"},
   {"-v",       argFlag,     &printVersion,  0,
    "print copyright and version info"},
   {"-h",       argFlag,     &printHelp,     0,
@@ -76,6 +150,880 @@ static int writeToFile(void *file, const char *data, int size) {
   return (int)fwrite(data, 1, size, (FILE *)file);
 }
 
+// JSON output: either the file itself, or a GzipWriter on top of it.
+static FILE *jsonFile;
+static GzipWriter *jsonGzip = NULL;
+
+static int writeJSON(void *stream, const char *data, int size) {
+  if (jsonGzip) {
+    return jsonGzip->write(data, size);
+  }
+  return writeToFile(jsonFile, data, size);
+}
+
+static void flushJSON() {
+  if (jsonGzip) {
+    jsonGzip->flush();
+  } else {
+    fflush(jsonFile);
+  }
+}
+
+static GBool closeJSON() {
+  GBool ok;
+
+  ok = gTrue;
+  if (jsonGzip) {
+    ok = jsonGzip->close();
+    delete jsonGzip;
+    jsonGzip = NULL;
+  }
+  if (ferror(jsonFile)) {
+    ok = gFalse;
+  }
+  fclose(jsonFile);
+  return ok;
+}
+
+//------------------------------------------------------------------------
+// PDF input from stdin
+//------------------------------------------------------------------------
+
+// Read all of stdin into memory, in large blocks, so that it can be
+// opened in place with a MemStream.  Returns NULL on error.
+static char *readStdin(Guint *len) {
+  char *buf;
+  int size, n;
+
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+#endif
+  size = 1 << 20;
+  *len = 0;
+  buf = (char *)gmalloc(size);
+  while ((n = (int)fread(buf + *len, 1, size - *len, stdin)) > 0) {
+    *len += n;
+    if ((int)*len == size) {
+      if (size > INT_MAX / 2) {
+	error(errIO, -1, "PDF file on stdin is too large");
+	gfree(buf);
+	return NULL;
+      }
+      size *= 2;
+      buf = (char *)grealloc(buf, size);
+    }
+  }
+  if (ferror(stdin)) {
+    error(errIO, -1, "Couldn't read PDF file from stdin");
+    gfree(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+//------------------------------------------------------------------------
+// -rangeread input
+//------------------------------------------------------------------------
+
+// The PDF file is read through a RangeStream, as if it were on a
+// remote server, with the local file standing in for the server.
+// The bytes fetched go into the profile.
+
+#define rangeCacheSize (32 << 20)
+
+static FILE *rangeFile = NULL;
+static RangeStreamCache *rangeCache = NULL;
+
+static int readRange(void *file, GFileOffset pos, char *buf, int size) {
+  if (gfseek((FILE *)file, pos, SEEK_SET)) {
+    return -1;
+  }
+  return (int)fread(buf, 1, size, (FILE *)file);
+}
+
+static PDFDoc *openRangeDoc(char *pdfFileName, GString *ownerPW,
+			    GString *userPW) {
+  Object obj;
+  GFileOffset size;
+  int blockSize;
+
+  if (!(rangeFile = openFile(pdfFileName, "rb"))) {
+    error(errIO, -1, "Couldn't open file '{0:s}'", pdfFileName);
+    return NULL;
+  }
+  gfseek(rangeFile, 0, SEEK_END);
+  size = gftell(rangeFile);
+  blockSize = rangeBlockSize << 10;
+  rangeCache = new RangeStreamCache(&readRange, rangeFile, size, blockSize,
+				    rangeCacheSize / blockSize);
+  obj.initNull();
+  return new PDFDoc(new RangeStream(rangeCache, 0, gFalse, 0, &obj),
+		    ownerPW, userPW);
+}
+
+static void closeRangeDoc() {
+  if (rangeCache) {
+    rangeCache->decRefCnt();
+    rangeCache = NULL;
+  }
+  if (rangeFile) {
+    fclose(rangeFile);
+    rangeFile = NULL;
+  }
+}
+
+//------------------------------------------------------------------------
+// -profile output
+//------------------------------------------------------------------------
+
+static FILE *profFile = NULL;
+static double profWall, profCPU;	// at the start of the run
+
+static void writeJSONString(FILE *f, const char *str) {
+  const char *p;
+
+  fputc('"', f);
+  for (p = str; *p; ++p) {
+    if (*p == '"' || *p == '\\') {
+      fprintf(f, "\\%c", *p);
+    } else if ((unsigned char)*p < 0x20) {
+      fprintf(f, "\\u%04x", *p);
+    } else {
+      fputc(*p, f);
+    }
+  }
+  fputc('"', f);
+}
+
+static void writeProfileCounters(PerfCounters *c) {
+  fprintf(profFile, "\"ops\":%lld,\"images\":%lld,\"imagePixels\":%lld,"
+	  "\"inflatedBytes\":%lld",
+	  c->ops, c->images, c->imagePixels, c->inflatedBytes);
+}
+
+// Start the profile file, with the time taken to open the document.
+static GBool startProfile(char *pdfFileName, PDFDoc *doc,
+			  double openWall, double openCPU,
+			  PerfCounters *openCounters) {
+  if (!(profFile = fopen(profileFileName, "wb"))) {
+    return gFalse;
+  }
+  fprintf(profFile, "{\"file\":");
+  writeJSONString(profFile, pdfFileName);
+  fprintf(profFile, ",\"pages\":%d,\"open\":{\"wall\":%.6f,\"cpu\":%.6f,",
+	  doc->getNumPages(), openWall, openCPU);
+  writeProfileCounters(openCounters);
+  fprintf(profFile, "},\"page\":[");
+  return gTrue;
+}
+
+static void writeProfilePage(JSONGen *jsonGen, int pg, GBool first,
+			     double wall, double cpu) {
+  JSONGenStage *st;
+  int i;
+
+  fprintf(profFile, "%s\n{\"number\":%d,\"wall\":%.6f,\"cpu\":%.6f,"
+	  "\"stages\":{",
+	  first ? "" : ",", pg, wall, cpu);
+  for (i = 0; i < jsonGen->getNumStages(); ++i) {
+    st = jsonGen->getStage(i);
+    fprintf(profFile, "%s\"%s\":{\"wall\":%.6f,\"cpu\":%.6f}",
+	    i ? "," : "", st->name, st->wall, st->cpu);
+  }
+  fprintf(profFile, "},\"chars\":%d,\"words\":%d,%s",
+	  jsonGen->getPageChars(), jsonGen->getPageWords(),
+	  jsonGen->getPageTruncated() ? "\"truncated\":true," : "");
+  writeProfileCounters(jsonGen->getPageCounters());
+  fprintf(profFile, "}");
+}
+
+// A page that was copied instead of converted: <how> is "reused"
+// (-prev) or "cached" (-cache).
+static void writeProfileCopiedPage(int pg, GBool first, const char *how,
+				   double wall, double cpu) {
+  fprintf(profFile, "%s\n{\"number\":%d,\"wall\":%.6f,\"cpu\":%.6f,"
+	  "\"%s\":true}",
+	  first ? "" : ",", pg, wall, cpu, how);
+}
+
+static void finishProfile() {
+  fprintf(profFile, "]");
+  if (rangeCache) {
+    fprintf(profFile, ",\"fetched\":{\"bytes\":%lld,\"requests\":%d,"
+	    "\"fileSize\":%lld}",
+	    (long long)rangeCache->getBytesFetched(),
+	    rangeCache->getNumFetches(),
+	    (long long)rangeCache->getFileSize());
+  }
+  fprintf(profFile, ",\"wall\":%.6f,\"cpu\":%.6f}\n",
+	  perfWallTime() - profWall, perfCPUTime() - profCPU);
+  fclose(profFile);
+  profFile = NULL;
+}
+
+//------------------------------------------------------------------------
+// -memstats output
+//------------------------------------------------------------------------
+
+// The document is split into phases (opening it, and each page).  For
+// each subsystem (see gmem.h), a phase records the allocations made
+// during it and the peak bytes in use at any point during it,
+// including memory still held from earlier phases.
+
+static FILE *memFile = NULL;
+static GMemStats memPhaseStart[gMemTagAll + 1];
+static long long memDocPeak[gMemTagAll + 1];
+
+static void startMemPhase() {
+  int tag;
+
+  for (tag = 0; tag <= gMemTagAll; ++tag) {
+    gMemGetStats(tag, &memPhaseStart[tag]);
+  }
+  gMemResetPeaks();
+}
+
+static void writeMemPhase() {
+  GMemStats st;
+  int tag;
+
+  for (tag = 0; tag <= gMemTagAll; ++tag) {
+    gMemGetStats(tag, &st);
+    fprintf(memFile, "%s\"%s\":{\"allocs\":%lld,\"allocBytes\":%lld,"
+	    "\"peakBytes\":%lld}",
+	    tag ? "," : "", gMemTagName(tag),
+	    st.allocs - memPhaseStart[tag].allocs,
+	    st.allocBytes - memPhaseStart[tag].allocBytes, st.peakBytes);
+    if (st.peakBytes > memDocPeak[tag]) {
+      memDocPeak[tag] = st.peakBytes;
+    }
+  }
+}
+
+static void writeMemOpen(char *pdfFileName) {
+  fprintf(memFile, "{\"file\":");
+  writeJSONString(memFile, pdfFileName);
+  fprintf(memFile, ",\"open\":{");
+  writeMemPhase();
+  fprintf(memFile, "},\"page\":[");
+}
+
+static void writeMemPage(int pg, GBool first) {
+  fprintf(memFile, "%s\n{\"number\":%d,", first ? "" : ",", pg);
+  writeMemPhase();
+  fprintf(memFile, "}");
+}
+
+// The document totals: all allocations since the start of the
+// program, the peak over all phases, and what is still in use.
+static void finishMemStats() {
+  GMemStats st;
+  int tag;
+
+  fprintf(memFile, "],\"document\":{");
+  for (tag = 0; tag <= gMemTagAll; ++tag) {
+    gMemGetStats(tag, &st);
+    if (st.peakBytes > memDocPeak[tag]) {
+      memDocPeak[tag] = st.peakBytes;
+    }
+    fprintf(memFile, "%s\"%s\":{\"allocs\":%lld,\"allocBytes\":%lld,"
+	    "\"peakBytes\":%lld,\"liveBytes\":%lld}",
+	    tag ? "," : "", gMemTagName(tag), st.allocs, st.allocBytes,
+	    memDocPeak[tag], st.liveBytes);
+  }
+  fprintf(memFile, "}}\n");
+  fclose(memFile);
+  memFile = NULL;
+}
+
+//------------------------------------------------------------------------
+// -probe mode
+//------------------------------------------------------------------------
+
+// Pages are interpreted with ProbeOutputDev, which skips the rest of a
+// page once it has enough text.  An evenly spaced sample of the pages
+// is looked at first; if the sampled pages agree on whether there is
+// a text layer, the remaining pages are skipped (unless -probeall).
+
+#define probeSamplePages 8
+
+static const char *probeClassNames[] = {
+  "empty", "text", "ocr", "scanned", "unmapped"
+};
+
+struct ProbePage {
+  GBool done;
+  ProbePageClass cls;
+  int glyphs, mappedGlyphs, invisibleGlyphs, fonts, images;
+  double imageCoverage;
+  GBool decided;		// rest of the page skipped
+  GBool truncated;		// page cut off by -timeout / -maxops
+};
+
+static ProbeOutputDev *probeOut;
+static double probePageStart;
+static long long probePageOps;
+static GBool probeTruncated;
+
+static GBool probeAbortCheck(void *data) {
+  if (probeOut->isPageDecided()) {
+    return gTrue;
+  }
+  if ((maxOps > 0 && perfCounters.ops - probePageOps > maxOps) ||
+      (pageTimeout > 0 && perfWallTime() - probePageStart > pageTimeout)) {
+    probeTruncated = gTrue;
+    return gTrue;
+  }
+  return gFalse;
+}
+
+static void probePage(PDFDoc *doc, int pg, ProbePage *p) {
+  PerfTraceScope trace("pdftojson", "probe", "number", pg);
+
+  probePageStart = perfWallTime();
+  probePageOps = perfCounters.ops;
+  probeTruncated = gFalse;
+  doc->displayPage(probeOut, pg, 72, 72, 0, gFalse, gTrue, gFalse,
+		   &probeAbortCheck, NULL);
+  p->done = gTrue;
+  p->cls = probeOut->getPageClass();
+  p->glyphs = probeOut->getGlyphs();
+  p->mappedGlyphs = probeOut->getMappedGlyphs();
+  p->invisibleGlyphs = probeOut->getInvisibleGlyphs();
+  p->fonts = probeOut->getFonts();
+  p->images = probeOut->getImages();
+  p->imageCoverage = probeOut->getImageCoverage();
+  p->decided = probeOut->isPageDecided();
+  p->truncated = probeTruncated;
+}
+
+// Write the probe summary for pages <firstPage>..<lastPage> to <f>.
+static GBool probeDoc(PDFDoc *doc, char *pdfFileName, FILE *f) {
+  ProbePage *pages, *p;
+  int counts[probeUnmapped + 1];
+  int nPages, nSample, nText, nNoText, nProbed, pg, i;
+  const char *textLayer;
+  GBool complete, ok;
+
+  nPages = lastPage - firstPage + 1;
+  pages = (ProbePage *)gmallocn(nPages, sizeof(ProbePage));
+  memset(pages, 0, nPages * sizeof(ProbePage));
+  probeOut = new ProbeOutputDev();
+
+  // the sample
+  nSample = nPages < probeSamplePages ? nPages : probeSamplePages;
+  for (i = 0; i < nSample; ++i) {
+    pg = nSample > 1 ? i * (nPages - 1) / (nSample - 1) : 0;
+    if (!pages[pg].done) {
+      probePage(doc, firstPage + pg, &pages[pg]);
+    }
+  }
+
+  // if the sample is mixed, look at everything else
+  nText = nNoText = 0;
+  for (i = 0; i < nPages; ++i) {
+    if (pages[i].done) {
+      if (pages[i].cls == probeText || pages[i].cls == probeOCR) {
+	++nText;
+      } else if (pages[i].cls != probeEmpty) {
+	++nNoText;
+      }
+    }
+  }
+  if (probeAll || (nText && nNoText)) {
+    for (i = 0; i < nPages; ++i) {
+      if (!pages[i].done) {
+	probePage(doc, firstPage + i, &pages[i]);
+      }
+    }
+  }
+
+  memset(counts, 0, sizeof(counts));
+  nProbed = 0;
+  for (i = 0; i < nPages; ++i) {
+    if (pages[i].done) {
+      ++counts[pages[i].cls];
+      ++nProbed;
+    }
+  }
+  complete = nProbed == nPages;
+  nText = counts[probeText] + counts[probeOCR];
+  nNoText = counts[probeScanned] + counts[probeUnmapped];
+  if (!nText) {
+    textLayer = "none";
+  } else if (!nNoText) {
+    textLayer = "full";
+  } else {
+    textLayer = "partial";
+  }
+
+  fprintf(f, "{\"file\":");
+  writeJSONString(f, pdfFileName);
+  fprintf(f, ",\"pages\":%d,\"probed\":%d,\"complete\":%s,"
+	  "\"textLayer\":\"%s\",\"classes\":{",
+	  doc->getNumPages(), nProbed, complete ? "true" : "false",
+	  textLayer);
+  for (i = 0; i <= probeUnmapped; ++i) {
+    fprintf(f, "%s\"%s\":%d", i ? "," : "", probeClassNames[i], counts[i]);
+  }
+  fprintf(f, "},\"page\":[");
+  nProbed = 0;
+  for (i = 0; i < nPages; ++i) {
+    p = &pages[i];
+    if (!p->done) {
+      continue;
+    }
+    fprintf(f, "%s\n{\"number\":%d,\"class\":\"%s\",\"glyphs\":%d,"
+	    "\"mappedGlyphs\":%d,\"invisibleGlyphs\":%d,\"fonts\":%d,"
+	    "\"images\":%d,\"imageCoverage\":%.3f%s%s}",
+	    nProbed++ ? "," : "", firstPage + i, probeClassNames[p->cls],
+	    p->glyphs, p->mappedGlyphs, p->invisibleGlyphs, p->fonts,
+	    p->images, p->imageCoverage,
+	    p->decided ? ",\"decided\":true" : "",
+	    p->truncated ? ",\"truncated\":true" : "");
+  }
+  fprintf(f, "]}\n");
+  ok = !ferror(f);
+
+  delete probeOut;
+  probeOut = NULL;
+  gfree(pages);
+  return ok;
+}
+
+//------------------------------------------------------------------------
+// -prev mode
+//------------------------------------------------------------------------
+
+// The earlier output is split into its page records (this works for
+// the JSON array and for -ndjson).  A page that PageChanges says is
+// unchanged is copied from there instead of being converted, as long
+// as its record is complete and was written at the same resolution.
+
+static char *prevBuf = NULL;	// the earlier output
+static char **prevRecs = NULL;	// start of each page's record [nPages]
+static int *prevRecLens = NULL;	// length of each page's record
+static PageChanges *pageChanges = NULL;
+
+// <p> points to the opening quote.
+static char *skipJSONString(char *p, char *end) {
+  for (++p; p < end; ++p) {
+    if (*p == '\\') {
+      ++p;
+    } else if (*p == '"') {
+      return p + 1;
+    }
+  }
+  return end;
+}
+
+// Return the value of <key> in the JSON object <p> .. <end>, or NULL
+// if it isn't there.  Nested objects are not searched.
+static char *findJSONField(char *p, char *end, const char *key) {
+  char *q;
+  int keyLen, depth;
+
+  keyLen = (int)strlen(key);
+  depth = 0;
+  while (p < end) {
+    if (*p == '"') {
+      q = skipJSONString(p, end);
+      if (depth == 1 && q - p == keyLen + 2 && !strncmp(p + 1, key, keyLen)) {
+	while (q < end && isspace(*q & 0xff)) {
+	  ++q;
+	}
+	if (q < end && *q == ':') {
+	  for (++q; q < end && isspace(*q & 0xff); ++q) ;
+	  return q;
+	}
+      }
+      p = q;
+    } else {
+      if (*p == '{' || *p == '[') {
+	++depth;
+      } else if (*p == '}' || *p == ']') {
+	--depth;
+      }
+      ++p;
+    }
+  }
+  return NULL;
+}
+
+// Read the earlier output, and index its page records.
+static GBool readPrevOutput(int nPages) {
+  FILE *f;
+  char *p, *end, *rec, *val;
+  int len, size, n, depth, pg;
+
+  if (!(f = fopen(prevFileName, "rb"))) {
+    error(errIO, -1, "Couldn't open file '{0:s}'", prevFileName);
+    return gFalse;
+  }
+  size = 65536;
+  len = 0;
+  prevBuf = (char *)gmalloc(size);
+  while ((n = (int)fread(prevBuf + len, 1, size - len, f)) > 0) {
+    len += n;
+    if (len == size) {
+      if (size > INT_MAX / 2) {
+	error(errIO, -1, "File '{0:s}' is too large", prevFileName);
+	fclose(f);
+	return gFalse;
+      }
+      size *= 2;
+      prevBuf = (char *)grealloc(prevBuf, size);
+    }
+  }
+  fclose(f);
+  for (p = prevBuf, end = prevBuf + len; p < end && isspace(*p & 0xff); ++p) ;
+  if (p == end || (*p != '[' && *p != '{')) {
+    error(errIO, -1,
+	  "File '{0:s}' isn't JSON or NDJSON output (-binary and -gzip "
+	  "output can't be used with -prev)", prevFileName);
+    return gFalse;
+  }
+
+  prevRecs = (char **)gmallocn(nPages, sizeof(char *));
+  prevRecLens = (int *)gmallocn(nPages, sizeof(int));
+  for (pg = 0; pg < nPages; ++pg) {
+    prevRecs[pg] = NULL;
+    prevRecLens[pg] = 0;
+  }
+  while (p < end) {
+    if (*p != '{') {
+      ++p;
+      continue;
+    }
+    rec = p;
+    depth = 0;
+    while (p < end) {
+      if (*p == '"') {
+	p = skipJSONString(p, end);
+	continue;
+      }
+      if (*p == '{' || *p == '[') {
+	++depth;
+      } else if ((*p == '}' || *p == ']') && --depth == 0) {
+	break;
+      }
+      ++p;
+    }
+    if (p == end) {
+      break;
+    }
+    ++p;
+    if (!(val = findJSONField(rec, p, "pages")) || atoi(val) != nPages ||
+	!(val = findJSONField(rec, p, "number")) ||
+	(pg = atoi(val)) < 1 || pg > nPages ||
+	findJSONField(rec, p, "truncated")) {
+      continue;
+    }
+    prevRecs[pg - 1] = rec;
+    prevRecLens[pg - 1] = (int)(p - rec);
+  }
+  return gTrue;
+}
+
+// If page <pg> can be copied from the earlier output, write it and
+// return true.
+static GBool writePrevPage(JSONGen *jsonGen, int pg) {
+  GString *dpi;
+  char *val;
+  int n;
+
+  if (!prevRecs || !prevRecs[pg - 1] || pageChanges->isPageChanged(pg)) {
+    return gFalse;
+  }
+  val = findJSONField(prevRecs[pg - 1], prevRecs[pg - 1] + prevRecLens[pg - 1],
+		      "dpi");
+  dpi = GString::format("{0:.4g}", jsonGen->getPageResolution(pg));
+  n = dpi->getLength();
+  if (!val || strncmp(val, dpi->getCString(), n) ||
+      (val[n] != ',' && val[n] != '}')) {
+    delete dpi;
+    return gFalse;
+  }
+  delete dpi;
+  writeJSON(NULL, prevRecs[pg - 1], prevRecLens[pg - 1]);
+  return gTrue;
+}
+
+static void freePrevOutput() {
+  delete pageChanges;
+  pageChanges = NULL;
+  gfree(prevBuf);
+  prevBuf = NULL;
+  gfree(prevRecs);
+  prevRecs = NULL;
+  gfree(prevRecLens);
+  prevRecLens = NULL;
+}
+
+//------------------------------------------------------------------------
+// -cache mode
+//------------------------------------------------------------------------
+
+// Each converted page is stored in the cache, keyed by everything its
+// output depends on (see ExtractCache), and a page with the same key
+// -- in this file or any other -- is copied from there, with its page
+// number and page count filled in.  The list of page keys is stored
+// for the whole file, so that a file seen before doesn't need its
+// pages hashed again.  Pages cut short by -timeout etc. aren't stored.
+
+static ExtractCache *cache = NULL;
+static ExtractCacheKey cacheDocKey;
+static ExtractCacheKey *cachePageKeys = NULL;	// [nPages]
+static GBool cacheDocStarted;		// ExtractCache::startDoc was called
+static GBool cacheKeysAdded;		// any page keys not yet in the
+					//   document entry
+
+// Collects a copy of everything written to a JSON or PNG stream.
+struct CacheCapture {
+  FILE *f;			// PNG file, or NULL for the JSON stream
+  GString *buf;
+};
+
+static int writeCapture(void *stream, const char *data, int size) {
+  CacheCapture *cap = (CacheCapture *)stream;
+
+  cap->buf->append(data, size);
+  if (cap->f) {
+    return writeToFile(cap->f, data, size);
+  }
+  return writeJSON(NULL, data, size);
+}
+
+// Everything besides the PDF file that affects the output: the
+// options, and the settings from the config files (text encoding is
+// always UTF-8).
+static GString *getCacheOptions() {
+  GString *options, *config;
+
+  options = GString::format("pdftojson {0:s} r={1:d} maxpixels={2:d} "
+			    "maxwidth={3:d} maxheight={4:d} "
+			    "skipinvisible={5:d} createpng={6:d} "
+			    "createfullpng={7:d} zlevel={8:d}\n",
+			    xpdfVersion, resolution, maxPixels,
+			    maxWidth, maxHeight, skipInvisible ? 1 : 0,
+			    createPng ? 1 : 0, createFullPng ? 1 : 0, zlevel);
+  config = globalParams->getConfigKey();
+  options->append(config);
+  delete config;
+  return options;
+}
+
+static void startCache(PDFDoc *doc) {
+  GString *options;
+  ExtractCacheKey *keys;
+  int nPages, n, pg;
+
+  options = getCacheOptions();
+  cache = new ExtractCache(cacheDir, (GFileOffset)cacheSize << 20, options);
+  delete options;
+  if (!cache->isOk()) {
+    error(errIO, -1, "Couldn't use cache directory '{0:s}'", cacheDir);
+    delete cache;
+    cache = NULL;
+    return;
+  }
+  nPages = doc->getNumPages();
+  cachePageKeys = (ExtractCacheKey *)gmallocn(nPages,
+					      sizeof(ExtractCacheKey));
+  memset(cachePageKeys, 0, nPages * sizeof(ExtractCacheKey));
+  cacheDocStarted = gFalse;
+  cacheKeysAdded = gFalse;
+  cache->getDocKey(doc->getBaseStream(), &cacheDocKey);
+  if (cache->lookupDoc(&cacheDocKey, &n, &keys)) {
+    if (n == nPages) {
+      memcpy(cachePageKeys, keys, nPages * sizeof(ExtractCacheKey));
+    }
+    gfree(keys);
+  }
+  for (pg = 0; pg < nPages; ++pg) {
+    if (ExtractCache::isNullKey(&cachePageKeys[pg])) {
+      cacheKeysAdded = gTrue;
+      break;
+    }
+  }
+}
+
+static ExtractCacheKey *getCachePageKey(PDFDoc *doc, int pg) {
+  ExtractCacheKey *key;
+
+  key = &cachePageKeys[pg - 1];
+  if (ExtractCache::isNullKey(key)) {
+    if (!cacheDocStarted) {
+      cache->startDoc(doc, &cacheDocKey);
+      cacheDocStarted = gTrue;
+    }
+    cache->getPageKey(pg, key);
+  }
+  return key;
+}
+
+// Write the page record <data>, replacing the values of its integer
+// fields <key1> and <key2> with <val1> and <val2>.
+static void writeCachedRecord(char *data, int len, const char *key1,
+			      int val1, const char *key2, int val2) {
+  GString *s;
+  char *end, *p, *q1, *q2, *q;
+
+  end = data + len;
+  q1 = findJSONField(data, end, key1);
+  q2 = findJSONField(data, end, key2);
+  if (!q1 || !q2) {
+    writeJSON(NULL, data, len);
+    return;
+  }
+  p = data;
+  while (q1 || q2) {
+    if (q1 && (!q2 || q1 < q2)) {
+      q = q1;
+      s = GString::format("{0:d}", val1);
+      q1 = NULL;
+    } else {
+      q = q2;
+      s = GString::format("{0:d}", val2);
+      q2 = NULL;
+    }
+    writeJSON(NULL, p, (int)(q - p));
+    writeJSON(NULL, s->getCString(), s->getLength());
+    delete s;
+    for (p = q; p < end && (*p == '-' || (*p >= '0' && *p <= '9')); ++p) ;
+  }
+  writeJSON(NULL, p, (int)(end - p));
+}
+
+// Return a copy of the page record <data> with the page number in
+// each of its form fields ([top,left,width,height,page,...]) set to
+// <pg>.
+static GString *setFormFieldPages(char *data, int len, int pg) {
+  GString *rec, *s;
+  char *end, *p, *q;
+  int n, depth;
+
+  rec = new GString();
+  end = data + len;
+  if (!(q = findJSONField(data, end, "formfields")) ||
+      q >= end || *q != '[') {
+    rec->append(data, len);
+    return rec;
+  }
+  s = GString::format("{0:d}", pg);
+  p = data;
+  ++q;
+  while (q < end) {
+    for (; q < end && (isspace(*q & 0xff) || *q == ','); ++q) ;
+    if (q >= end || *q != '[') {
+      break;
+    }
+    // the first four values are numbers, so the page number follows
+    // the fourth comma
+    for (n = 0; q < end && n < 4; ++q) {
+      if (*q == ',') {
+	++n;
+      }
+    }
+    for (; q < end && isspace(*q & 0xff); ++q) ;
+    rec->append(p, (int)(q - p));
+    rec->append(s);
+    for (p = q; p < end && (*p == '-' || (*p >= '0' && *p <= '9')); ++p) ;
+    // skip the rest of the entry
+    for (q = p, depth = 1; q < end && depth > 0; ) {
+      if (*q == '"') {
+	q = skipJSONString(q, end);
+      } else {
+	if (*q == '[') {
+	  ++depth;
+	} else if (*q == ']') {
+	  --depth;
+	}
+	++q;
+      }
+    }
+  }
+  delete s;
+  rec->append(p, (int)(end - p));
+  return rec;
+}
+
+// If page <pg> is in the cache, write it (and its PNG files) and
+// return true.
+static GBool writeCachedPage(PDFDoc *doc, int pg,
+			     FILE *pngFile, FILE *pngFile2) {
+  GString *json, *png, *fullPng, *rec;
+  GBool hit;
+
+  if (!cache->lookupPage(getCachePageKey(doc, pg), &json, &png, &fullPng)) {
+    return gFalse;
+  }
+  hit = (!pngFile || png) && (!pngFile2 || fullPng);
+  if (hit) {
+    rec = setFormFieldPages(json->getCString(), json->getLength(), pg);
+    writeCachedRecord(rec->getCString(), rec->getLength(),
+		      "pages", doc->getNumPages(), "number", pg);
+    delete rec;
+    if (pngFile) {
+      writeToFile(pngFile, png->getCString(), png->getLength());
+    }
+    if (pngFile2) {
+      writeToFile(pngFile2, fullPng->getCString(), fullPng->getLength());
+    }
+  }
+  delete json;
+  if (png) {
+    delete png;
+  }
+  if (fullPng) {
+    delete fullPng;
+  }
+  return hit;
+}
+
+// Convert page <pg>, and store it in the cache.
+static int convertAndCachePage(JSONGen *jsonGen, PDFDoc *doc, int pg,
+			       FILE *pngFile, FILE *pngFile2) {
+  CacheCapture json, png, fullPng;
+  int err;
+
+  json.f = NULL;
+  json.buf = new GString();
+  png.f = pngFile;
+  png.buf = new GString();
+  fullPng.f = pngFile2;
+  fullPng.buf = new GString();
+  err = jsonGen->convertPage(pg, &writeCapture, &json, &writeCapture,
+			     pngFile ? &png : NULL,
+			     pngFile2 ? &fullPng : NULL, createPng);
+  if (err == errNone && !jsonGen->getPageTruncated()) {
+    cache->storePage(getCachePageKey(doc, pg), json.buf,
+		     pngFile ? png.buf : (GString *)NULL,
+		     pngFile2 ? fullPng.buf : (GString *)NULL);
+  }
+  delete json.buf;
+  delete png.buf;
+  delete fullPng.buf;
+  return err;
+}
+
+// Store the page keys for the document (if the run got that far), and
+// trim the cache.
+static void finishCache(GBool ok, PDFDoc *doc) {
+  if (!cache) {
+    return;
+  }
+  if (ok && cacheKeysAdded) {
+    cache->storeDoc(&cacheDocKey, doc->getNumPages(), cachePageKeys);
+  }
+  delete cache;
+  cache = NULL;
+  gfree(cachePageKeys);
+  cachePageKeys = NULL;
+}
+
+//------------------------------------------------------------------------
+
 int main(int argc, char *argv[]) {
     PDFDoc *doc;
     GString *fileName;
@@ -83,12 +1031,21 @@ int main(int argc, char *argv[]) {
     GString *ownerPW, *userPW;
     JSONGen *jsonGen;
     GString *htmlFileName, *pngFileName, *pngFileName2, *pngURL;
-    FILE *jsonFile, *pngFile, *pngFile2;
+    char *pngPrefix;
+    FILE *pngFile, *pngFile2;
+    char *pdfBuf;
+    Guint pdfLen;
+    PerfCounters openCounters;
+    GFileOffset prevSize;
+    char *p;
+    double pageWall, pageCPU;
     int pg, err, exitCode;
-    GBool ok;
+    GBool ok, reused, cached;
     
     exitCode = 99;
     
+    doc = NULL;
+    pdfBuf = NULL;
     pngFile = NULL;
     pngFile2 = NULL;
     // parse args
@@ -101,7 +1058,32 @@ int main(int argc, char *argv[]) {
         }
         goto err0;
     }
-    fileName = new GString(argv[1]);
+    // the PNG files are named after the JSON file, or the PDF file
+    if (!strcmp(argv[1], "-") && !strcmp(argv[2], "-") &&
+        (createPng || createFullPng)) {
+        error(errCommandLine, -1, "-createpng and -createfullpng need a "
+              "PDF or JSON file name, to name the PNG files after");
+        goto err0;
+    }
+    if (rangeBlockSize < 0 || rangeBlockSize > 4096 ||
+        (rangeBlockSize > 0 && !strcmp(argv[1], "-"))) {
+        error(errCommandLine, -1, "-rangeread needs a PDF file name, and a "
+              "block size between 1 and 4096 KB");
+        goto err0;
+    }
+    if (memStatsFileName[0]) {
+#ifdef GMEM_ACCOUNTING
+        if (!(memFile = fopen(memStatsFileName, "wb"))) {
+            error(errIO, -1, "Couldn't open memory stats file '{0:s}'",
+                  memStatsFileName);
+            goto err0;
+        }
+#else
+        error(errConfig, -1,
+              "-memstats needs a build with --enable-mem-accounting");
+        goto err0;
+#endif
+    }
     jsonFilename = new GString(argv[2]);
     
     // read config file
@@ -123,14 +1105,38 @@ int main(int argc, char *argv[]) {
     } else {
         userPW = NULL;
     }
-    doc = new PDFDoc(fileName, ownerPW, userPW);
+    if (traceFileName[0] && !perfTraceStart(traceFileName)) {
+        error(errIO, -1, "Couldn't open trace file '{0:s}'", traceFileName);
+    }
+    profWall = perfWallTime();
+    profCPU = perfCPUTime();
+    openCounters = perfCounters;
+    if (memFile) {
+        startMemPhase();
+    }
+    perfTraceBegin("pdftojson", "open");
+    // read the PDF file from stdin if its name is '-'
+    if (!strcmp(argv[1], "-")) {
+        if ((pdfBuf = readStdin(&pdfLen))) {
+            doc = JSONGen::openDoc(pdfBuf, pdfLen, ownerPW, userPW);
+        }
+    } else if (rangeBlockSize > 0) {
+        doc = openRangeDoc(argv[1], ownerPW, userPW);
+    } else {
+        fileName = new GString(argv[1]);
+        doc = new PDFDoc(fileName, ownerPW, userPW);
+    }
+    perfTraceEnd();
+    if (memFile) {
+        writeMemOpen(argv[1]);
+    }
     if (userPW) {
         delete userPW;
     }
     if (ownerPW) {
         delete ownerPW;
     }
-    if (!doc->isOk()) {
+    if (!doc || !doc->isOk()) {
         exitCode = 1;
         goto err1;
     }
@@ -151,6 +1157,77 @@ int main(int argc, char *argv[]) {
     if (lastPage < 1 || lastPage > doc->getNumPages()) {
         lastPage = doc->getNumPages();
     }
+
+    // in probe mode, just write the summary
+    if (probe) {
+        if (!jsonFilename->cmp("-")) {
+            jsonFile = stdout;
+        } else if (!(jsonFile = fopen(jsonFilename->getCString(), "wb"))) {
+            error(errIO, -1, "Couldn't open JSON file '{0:t}'", jsonFilename);
+            delete jsonFilename;
+            goto err1;
+        }
+        exitCode = probeDoc(doc, argv[1], jsonFile) ? 0 : 2;
+        if (jsonFile != stdout) {
+            fclose(jsonFile);
+        }
+        delete jsonFilename;
+        goto err1;
+    }
+
+    // with -prev, find the pages that have changed since the earlier
+    // revision
+    if (prevFileName[0]) {
+        if (binary || createPng || createFullPng) {
+            error(errCommandLine, -1, "-prev can't be used with -binary, "
+                  "-createpng or -createfullpng");
+            delete jsonFilename;
+            goto err1;
+        }
+        prevSize = 0;
+        for (p = prevSizeStr; *p >= '0' && *p <= '9'; ++p) {
+            prevSize = 10 * prevSize + (*p - '0');
+        }
+        if (*p) {
+            error(errCommandLine, -1, "Invalid -prevsize '{0:s}'",
+                  prevSizeStr);
+            delete jsonFilename;
+            goto err1;
+        }
+        pageChanges = new PageChanges(doc, prevSize);
+        if (!pageChanges->isOk()) {
+            error(errSyntaxWarning, -1,
+                  "Couldn't tell which pages changed since the earlier "
+                  "revision - converting all pages");
+        } else {
+            readPrevOutput(doc->getNumPages());
+        }
+    }
+
+    if (cacheDir[0]) {
+        if (binary) {
+            error(errCommandLine, -1, "-cache can't be used with -binary");
+            delete jsonFilename;
+            goto err1;
+        }
+        startCache(doc);
+    }
+
+    // start the profile, now that the open time is known
+    if (profileFileName[0]) {
+        openCounters.ops = perfCounters.ops - openCounters.ops;
+        openCounters.images = perfCounters.images - openCounters.images;
+        openCounters.imagePixels =
+            perfCounters.imagePixels - openCounters.imagePixels;
+        openCounters.inflatedBytes =
+            perfCounters.inflatedBytes - openCounters.inflatedBytes;
+        if (!startProfile(argv[1], doc, perfWallTime() - profWall,
+                          perfCPUTime() - profCPU, &openCounters)) {
+            error(errIO, -1, "Couldn't open profile file '{0:s}'",
+                  profileFileName);
+            goto err1;
+        }
+    }
     
     // set up the JSONGen object
     jsonGen = new JSONGen(resolution);
@@ -159,24 +1236,58 @@ int main(int argc, char *argv[]) {
         goto err1;
     }
     jsonGen->setDrawInvisibleText(!skipInvisible);
+    jsonGen->setMaxPixels(maxPixels);
+    jsonGen->setMaxWidth(maxWidth);
+    jsonGen->setMaxHeight(maxHeight);
+    jsonGen->setBinaryOutput(binary);
+    jsonGen->setPNGCompressionLevel(zlevel);
+    jsonGen->setPageTimeLimit(pageTimeout);
+    jsonGen->setMaxOps(maxOps);
+    jsonGen->setMaxImagePixels(maxImagePixels);
+    jsonGen->setProfile(profileFileName[0] != '\0');
     jsonGen->startDoc(doc);
     
-    if (!(jsonFile = fopen(jsonFilename->getCString(), "wb"))) {
+    // write to stdout if the JSON file name is '-'; the PNG files are
+    // then named after the PDF file
+    if (!jsonFilename->cmp("-")) {
+        jsonFile = stdout;
+        pngPrefix = argv[1];
+    } else if (!(jsonFile = fopen(jsonFilename->getCString(), "wb"))) {
         error(errIO, -1, "Couldn't open JSON file '{0:t}'", jsonFilename);
         delete jsonFilename;
-        delete pngFileName;
         goto err2;
+    } else {
+        pngPrefix = argv[2];
+    }
+    if (gzip) {
+        jsonGzip = new GzipWriter(jsonFile, zlevel);
+        if (!jsonGzip->isOk()) {
+            error(errConfig, -1, "Invalid compression level {0:d}", zlevel);
+            closeJSON();
+            delete jsonFilename;
+            goto err2;
+        }
+    }
+    if (binary) {
+        jsonGen->writeBinaryHeader(&writeJSON, NULL);
+    } else if (!ndjson) {
+        writeJSON(NULL, "[", 1);
     }
-    fprintf(jsonFile,"[");
     // convert the pages
     for (pg = firstPage; pg <= lastPage; ++pg) {
+        pageWall = perfWallTime();
+        pageCPU = perfCPUTime();
+        if (memFile) {
+            startMemPhase();
+        }
+        PerfTraceScope trace("pdftojson", "page", "number", pg);
         if (createPng)
         {
-            pngFileName = GString::format("{0:s}-page{1:d}-notext.png", argv[2], pg);
+            pngFileName = GString::format("{0:s}-page{1:d}-notext.png", pngPrefix, pg);
             //printf("png=%s\n",pngFileName->getCString());
             if (!(pngFile = fopen(pngFileName->getCString(), "wb"))) {
                 error(errIO, -1, "Couldn't open PNG file '{0:t}'", pngFileName);
-                fclose(jsonFile);
+                closeJSON();
                 delete pngFileName;
                 delete jsonFilename;
                 goto err2;
@@ -184,11 +1295,11 @@ int main(int argc, char *argv[]) {
         }
         if (createFullPng)
         {
-            pngFileName2 = GString::format("{0:s}-page{1:d}.png", argv[2], pg);
+            pngFileName2 = GString::format("{0:s}-page{1:d}.png", pngPrefix, pg);
             //printf("png2=%s\n",pngFileName2->getCString());
             if (!(pngFile2 = fopen(pngFileName2->getCString(), "wb"))) {
                 error(errIO, -1, "Couldn't open PNG file '{0:t}'", pngFileName2);
-                fclose(jsonFile);
+                closeJSON();
                 fclose(pngFile);
                 delete pngFileName;
                 delete pngFileName2;
@@ -196,12 +1307,30 @@ int main(int argc, char *argv[]) {
                 goto err2;
             }
         }
-        err = jsonGen->convertPage(pg, &writeToFile, jsonFile,&writeToFile, pngFile, pngFile2, createPng);
-        if (pg < lastPage)
-            fprintf(jsonFile,",");
+        cached = gFalse;
+        if ((reused = writePrevPage(jsonGen, pg))) {
+            err = errNone;
+        } else if (cache && (cached = writeCachedPage(doc, pg, pngFile,
+                                                      pngFile2))) {
+            err = errNone;
+        } else if (cache) {
+            err = convertAndCachePage(jsonGen, doc, pg, pngFile, pngFile2);
+        } else {
+            err = jsonGen->convertPage(pg, &writeJSON, NULL,&writeToFile, pngFile, pngFile2, createPng);
+        }
+        if (binary) {
+            // binary page records are self-delimiting
+            flushJSON();
+        } else if (ndjson) {
+            // hand each page to the consumer as soon as it is done
+            writeJSON(NULL, "\n", 1);
+            flushJSON();
+        } else if (pg < lastPage) {
+            writeJSON(NULL, ",", 1);
+        }
         if (err != errNone) {
             error(errIO, -1, "Error converting page {0:d}", pg);
-            fclose(jsonFile);
+            closeJSON();
             delete jsonFilename;
             if (createPng)
             {
@@ -228,17 +1357,56 @@ int main(int argc, char *argv[]) {
             fclose(pngFile2);
             delete pngFileName2;
         }
+        if (profFile && (reused || cached)) {
+            writeProfileCopiedPage(pg, pg == firstPage,
+                                   reused ? "reused" : "cached",
+                                   perfWallTime() - pageWall,
+                                   perfCPUTime() - pageCPU);
+        } else if (profFile) {
+            writeProfilePage(jsonGen, pg, pg == firstPage,
+                             perfWallTime() - pageWall,
+                             perfCPUTime() - pageCPU);
+        }
+        if (memFile) {
+            writeMemPage(pg, pg == firstPage);
+        }
+    }
+    if (!binary && !ndjson) {
+        writeJSON(NULL, "]", 1);
+    }
+    if (!closeJSON()) {
+        error(errIO, -1, "Error writing JSON file '{0:t}'", jsonFilename);
+        delete jsonFilename;
+        exitCode = 2;
+        goto err2;
     }
-    fprintf(jsonFile,"]");
-    fclose(jsonFile);
     delete jsonFilename;
+    // xref sections are decoded on first use: one that turned out to be
+    // damaged beyond repair leaves objects unreadable, as if the file
+    // had failed to open
+    if (!doc->getXRef()->isOk()) {
+        error(errSyntaxError, -1, "Couldn't read xref table");
+        exitCode = 1;
+        goto err2;
+    }
     exitCode = 0;
     
     // clean up
 err2:
     delete jsonGen;
 err1:
+    finishCache(exitCode == 0, doc);
+    freePrevOutput();
+    if (profFile) {
+        finishProfile();
+    }
+    if (memFile) {
+        finishMemStats();
+    }
+    perfTraceStop();
     delete doc;
+    gfree(pdfBuf);
+    closeRangeDoc();
     delete globalParams;
 err0:
     